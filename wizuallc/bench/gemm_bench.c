@@ -0,0 +1,87 @@
+// Benchmarks the runtime matrix multiply (c_matmul) against a plain i-k-j loop.
+// Usage: gemm_bench [n ...]   (default 256, 512, 1024 and 2048; square n x n)
+// Thread count comes from WIZUALL_NUM_THREADS like any generated program.
+// The plain loop is skipped above NAIVE_MAX, where it takes too long.
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "runtime_mem.h"
+#include "runtime_parallel.h"
+#include "runtime_matrix.h"
+
+#define NAIVE_MAX 1024
+
+static double seconds_since(const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)(now.tv_sec - start->tv_sec) + (double)(now.tv_nsec - start->tv_nsec) * 1e-9;
+}
+
+// Uniform values in [-1, 1) (xorshift64)
+static void fill_random(double *values, size_t count, uint64_t state) {
+    for (size_t i = 0; i < count; ++i) {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        values[i] = (double)(state >> 11) / 4503599627370496.0 - 1.0;
+    }
+}
+
+// C = A * B, the textbook loop order that streams rows of B and C
+static void naive_matmul(const double *a, const double *b, double *c, size_t n) {
+    memset(c, 0, n * n * sizeof(double));
+    for (size_t i = 0; i < n; ++i) {
+        for (size_t p = 0; p < n; ++p) {
+            double a_ip = a[i * n + p];
+            for (size_t j = 0; j < n; ++j) c[i * n + j] += a_ip * b[p * n + j];
+        }
+    }
+}
+
+static void report(const char *name, size_t n, double seconds) {
+    printf("  %-10s %10.1f ms  %8.2f GFLOP/s\n", name, seconds * 1e3, 2.0 * n * n * n / seconds / 1e9);
+}
+
+int main(int argc, char **argv) {
+    size_t default_sizes[] = { 256, 512, 1024, 2048 };
+    size_t size_count = argc > 1 ? (size_t)argc - 1 : sizeof(default_sizes) / sizeof(default_sizes[0]);
+
+    printf("Threads: %ld\n", (long)runtime_thread_count());
+    for (size_t s = 0; s < size_count; ++s) {
+        size_t n = argc > 1 ? (size_t)strtoull(argv[s + 1], NULL, 10) : default_sizes[s];
+        if (n == 0) continue;
+        printf("%ld x %ld:\n", (long)n, (long)n);
+        double *a = (double *)runtime_buffer_alloc(n * n * sizeof(double));
+        double *b = (double *)runtime_buffer_alloc(n * n * sizeof(double));
+        fill_random(a, n * n, 0x9E3779B97F4A7C15ULL);
+        fill_random(b, n * n, 0xD1B54A32D192ED03ULL);
+
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        double *c = c_matmul(a, n, n, b, n, n);
+        report("c_matmul", n, seconds_since(&start));
+
+        if (n <= NAIVE_MAX) {
+            double *expected = (double *)malloc(n * n * sizeof(double));
+            if (!expected) { perror("malloc failed"); return 1; }
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            naive_matmul(a, b, expected, n);
+            report("naive", n, seconds_since(&start));
+
+            double max_error = 0.0;
+            for (size_t i = 0; i < n * n; ++i) max_error = fmax(max_error, fabs(c[i] - expected[i]));
+            if (max_error > 1e-9 * n) {
+                fprintf(stderr, "c_matmul differs from the plain loop by %g\n", max_error);
+                return 1;
+            }
+            free(expected);
+        }
+        runtime_buffer_release(a);
+        runtime_buffer_release(b);
+        runtime_buffer_release(c);
+    }
+    return 0;
+}
\ No newline at end of file
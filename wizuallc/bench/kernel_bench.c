@@ -0,0 +1,153 @@
+// Benchmarks the two backends of the generated code on the same loops: the
+// runtime thread pool (runtime_parallel_for) and OpenMP (wizuallc --openmp).
+// Usage: kernel_bench [n ...]   (default 10^5, 10^6 and 10^7 elements)
+// "add" is an element-wise vector kernel (v1 + v2 into a new buffer, walked in
+// VECTOR_CHUNK chunks) and "reduce" a parallel for with a + reduction, both in
+// the shape wizuallc emits. Thread counts come from WIZUALL_NUM_THREADS and
+// OMP_NUM_THREADS.
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+#include <omp.h>
+#include "runtime_mem.h"
+#include "runtime_parallel.h"
+
+#define VECTOR_CHUNK 65536
+#define WZ_OMP_MIN_SIZE 32768
+#define RUNS 5 // Best of
+
+static double seconds_since(const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)(now.tv_sec - start->tv_sec) + (double)(now.tv_nsec - start->tv_nsec) * 1e-9;
+}
+
+typedef struct {
+    const double *a, *b;
+    double *result;
+    size_t size;
+    size_t tasks;
+} AddJob;
+
+// The pool has no element-wise kernels of its own: a task adds one block
+static void add_task(size_t task, void *arg) {
+    AddJob *job = (AddJob *)arg;
+    size_t begin = (size_t)runtime_range_start(0, (int64_t)job->size, job->tasks, task);
+    size_t end = (size_t)runtime_range_start(0, (int64_t)job->size, job->tasks, task + 1);
+    for (size_t i = begin; i < end; ++i) job->result[i] = job->a[i] + job->b[i];
+}
+
+static void add_pool(const double *a, const double *b, double *result, size_t size) {
+    AddJob job = { a, b, result, size, runtime_range_tasks(0, (int64_t)size, 0, 0) };
+    runtime_parallel_for(job.tasks, add_task, &job);
+}
+
+// As emitted by emit_chunk_loop_begin with --openmp
+static void add_openmp(const double *a, const double *b, double *result, size_t size) {
+    #pragma omp parallel if(size >= WZ_OMP_MIN_SIZE)
+    for (size_t start = 0; start < size; start += VECTOR_CHUNK) {
+        size_t end = (size - start > VECTOR_CHUNK) ? start + VECTOR_CHUNK : size;
+        #pragma omp for simd schedule(static)
+        for (size_t i = start; i < end; ++i) {
+            result[i] = a[i] + b[i];
+        }
+    }
+}
+
+typedef struct {
+    const double *a;
+    int64_t begin, end;
+    size_t tasks;
+    double *partial;
+} SumJob;
+
+static void sum_task(size_t task, void *arg) {
+    SumJob *job = (SumJob *)arg;
+    int64_t first = runtime_range_start(job->begin, job->end, job->tasks, task);
+    int64_t last = runtime_range_start(job->begin, job->end, job->tasks, task + 1);
+    double acc = 0.0;
+    for (int64_t i = first; i < last; ++i) acc += job->a[i] * 0.5;
+    job->partial[task] = acc;
+}
+
+// The task function of a parallel for, run by the pool and combined in block order
+static double sum_pool(const double *a, size_t size) {
+    SumJob job = { a, 0, (int64_t)size, runtime_range_tasks(0, (int64_t)size, 0, 0), NULL };
+    job.partial = (double *)malloc((job.tasks + 1) * sizeof(double));
+    if (!job.partial) { perror("malloc failed"); exit(1); }
+    runtime_parallel_for(job.tasks, sum_task, &job);
+    double acc = 0.0;
+    for (size_t t = 0; t < job.tasks; ++t) acc += job.partial[t];
+    free(job.partial);
+    return acc;
+}
+
+// The same task function run by an OpenMP loop with a reduction clause
+static double sum_openmp(const double *a, size_t size) {
+    SumJob job = { a, 0, (int64_t)size, runtime_range_tasks_for(0, (int64_t)size, 0, 0, (size_t)omp_get_max_threads()), NULL };
+    job.partial = (double *)malloc((job.tasks + 1) * sizeof(double));
+    if (!job.partial) { perror("malloc failed"); exit(1); }
+    double acc = 0.0;
+    #pragma omp parallel for schedule(static, 1) if(job.tasks > 1) reduction(+: acc)
+    for (size_t t = 0; t < job.tasks; ++t) {
+        sum_task(t, &job);
+        acc += job.partial[t];
+    }
+    free(job.partial);
+    return acc;
+}
+
+static void report(const char *name, size_t size, double seconds) {
+    printf("  %-14s %9.3f ms  %8.2f Gelem/s\n", name, seconds * 1e3, (double)size / seconds / 1e9);
+}
+
+int main(int argc, char **argv) {
+    size_t default_sizes[] = { 100000, 1000000, 10000000 };
+    size_t size_count = argc > 1 ? (size_t)argc - 1 : sizeof(default_sizes) / sizeof(default_sizes[0]);
+
+    printf("Threads: pool %ld, OpenMP %d\n", (long)runtime_thread_count(), omp_get_max_threads());
+    for (size_t s = 0; s < size_count; ++s) {
+        size_t n = argc > 1 ? (size_t)strtoull(argv[s + 1], NULL, 10) : default_sizes[s];
+        if (n == 0) continue;
+        printf("%ld elements:\n", (long)n);
+        double *a = (double *)runtime_buffer_alloc(n * sizeof(double));
+        double *b = (double *)runtime_buffer_alloc(n * sizeof(double));
+        double *result = (double *)runtime_buffer_alloc(n * sizeof(double));
+        for (size_t i = 0; i < n; ++i) {
+            a[i] = (double)(i % 1000);
+            b[i] = 1.0 / (double)(i + 1);
+        }
+
+        double best[4] = { 1e300, 1e300, 1e300, 1e300 };
+        double sums[2] = { 0.0, 0.0 };
+        for (int run = 0; run < RUNS; ++run) {
+            struct timespec start;
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            add_pool(a, b, result, n);
+            best[0] = fmin(best[0], seconds_since(&start));
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            add_openmp(a, b, result, n);
+            best[1] = fmin(best[1], seconds_since(&start));
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            sums[0] = sum_pool(a, n);
+            best[2] = fmin(best[2], seconds_since(&start));
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            sums[1] = sum_openmp(a, n);
+            best[3] = fmin(best[3], seconds_since(&start));
+        }
+        report("add pool", n, best[0]);
+        report("add openmp", n, best[1]);
+        report("reduce pool", n, best[2]);
+        report("reduce openmp", n, best[3]);
+        if (fabs(sums[0] - sums[1]) > 1e-9 * fabs(sums[0])) {
+            fprintf(stderr, "The reductions differ: %.17g vs %.17g\n", sums[0], sums[1]);
+            return 1;
+        }
+        runtime_buffer_release(a);
+        runtime_buffer_release(b);
+        runtime_buffer_release(result);
+    }
+    return 0;
+}
\ No newline at end of file
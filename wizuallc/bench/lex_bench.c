@@ -0,0 +1,109 @@
+// Benchmarks the lexer alone (no parser): tokens per second and MB/s when the
+// source is mapped with lexer_open, and when flex reads it through stdio.
+// Usage: lex_bench [file.wz ...]   (default: a generated script of SOURCE_MB MB)
+// The generated script repeats the statements of a typical generated program:
+// arithmetic on many variables, vector literals, calls, loops and comments.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "ast.h"
+#include "symtab.h"
+#include "y.tab.h"
+
+#define SOURCE_MB 64
+#define RUNS 3 // Best of
+
+extern int yylex(void);
+extern int yylex_destroy(void);
+extern void yyrestart(FILE *input);
+extern int lexer_open(const char *path);
+extern void lexer_close(void);
+
+YYSTYPE yylval; // Defined by the parser, which is not linked in
+
+static double seconds_since(const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)(now.tv_sec - start->tv_sec) + (double)(now.tv_nsec - start->tv_nsec) * 1e-9;
+}
+
+static long file_size(const char *path) {
+    FILE *fp = fopen(path, "rb");
+    if (!fp) { perror(path); exit(1); }
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fclose(fp);
+    return size;
+}
+
+static void generate_source(const char *path, long bytes) {
+    FILE *fp = fopen(path, "wb");
+    if (!fp) { perror(path); exit(1); }
+    for (long i = 0; ftell(fp) < bytes; ++i) {
+        long v = i % 1000; // Distinct variable names
+        fprintf(fp, "# Block %ld\n", i);
+        fprintf(fp, "x%ld = x%ld * 2.5 + y%ld / 0.125 - 17;\n", v, (v + 1) % 1000, v);
+        fprintf(fp, "v%ld = [1, 2.75, 3, .5, 1000000] + x%ld;\n", v, v);
+        fprintf(fp, "for i in range(0, n%ld) { s = s + i * 0.5; }\n", v);
+        fprintf(fp, "if (s) { print(median(v%ld)); } else { print(\"none\"); }\n", v);
+    }
+    fclose(fp);
+}
+
+// Scans the current input to the end, returning the number of tokens
+static long scan_tokens(void) {
+    long tokens = 0;
+    int token;
+    while ((token = yylex()) != 0) {
+        if (token == STRING) free(yylval.string_val);
+        ++tokens;
+    }
+    return tokens;
+}
+
+static void report(const char *name, long bytes, long tokens, double seconds) {
+    printf("  %-6s %9.1f ms  %8.1f MB/s  %7.1f Mtokens/s\n", name, seconds * 1e3,
+           (double)bytes / seconds / 1e6, (double)tokens / seconds / 1e6);
+}
+
+static void bench_file(const char *path) {
+    long bytes = file_size(path);
+    long tokens = 0;
+    double best_mmap = 1e300, best_stdio = 1e300;
+    printf("%s (%.1f MB):\n", path, (double)bytes / 1e6);
+    for (int run = 0; run < RUNS; ++run) {
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        if (!lexer_open(path)) { perror(path); exit(1); }
+        tokens = scan_tokens();
+        lexer_close();
+        double seconds = seconds_since(&start);
+        if (seconds < best_mmap) best_mmap = seconds;
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        FILE *fp = fopen(path, "r");
+        if (!fp) { perror(path); exit(1); }
+        yyrestart(fp);
+        scan_tokens();
+        yylex_destroy();
+        fclose(fp);
+        seconds = seconds_since(&start);
+        if (seconds < best_stdio) best_stdio = seconds;
+    }
+    report("mmap", bytes, tokens, best_mmap);
+    report("stdio", bytes, tokens, best_stdio);
+}
+
+int main(int argc, char **argv) {
+    if (argc > 1) {
+        for (int i = 1; i < argc; ++i) bench_file(argv[i]);
+    } else {
+        const char *path = "lex_bench_input.wz";
+        generate_source(path, (long)SOURCE_MB * 1000000);
+        bench_file(path);
+        remove(path);
+    }
+    symbol_table_destroy();
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,75 @@
+// Benchmarks the runtime radix sort (c_sort) against qsort and std::sort.
+// Usage: sort_bench [size ...]   (default 1M, 10M and 100M elements)
+// Thread count comes from WIZUALL_NUM_THREADS like any generated program.
+// 1B elements needs about 32 GB of memory (input, copies and sort scratch).
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+extern "C" {
+#include "runtime_mem.h"
+#include "runtime_parallel.h"
+#include "runtime_sort.h"
+}
+
+static int compare_doubles(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Uniform values over a wide range of signs and magnitudes (xorshift64)
+static void fill_random(std::vector<double> &values) {
+    uint64_t state = 0x9E3779B97F4A7C15ULL;
+    for (double &value : values) {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        value = (double)(int64_t)state / 1048576.0;
+    }
+}
+
+static void report(const char *name, size_t size, double seconds) {
+    printf("  %-10s %10.1f ms  %8.1f M elements/s\n", name, seconds * 1e3, size / seconds / 1e6);
+}
+
+int main(int argc, char **argv) {
+    std::vector<size_t> sizes;
+    for (int i = 1; i < argc; ++i) sizes.push_back((size_t)strtoull(argv[i], NULL, 10));
+    if (sizes.empty()) sizes = {1000000, 10000000, 100000000};
+
+    printf("Threads: %zu\n", runtime_thread_count());
+    for (size_t size : sizes) {
+        printf("%zu elements:\n", size);
+        std::vector<double> input(size);
+        fill_random(input);
+
+        auto start = std::chrono::steady_clock::now();
+        double *radix = c_sort(input.data(), size);
+        report("c_sort", size, seconds_since(start));
+
+        std::vector<double> expected(input);
+        start = std::chrono::steady_clock::now();
+        std::sort(expected.begin(), expected.end());
+        report("std::sort", size, seconds_since(start));
+
+        std::vector<double> sorted(input);
+        start = std::chrono::steady_clock::now();
+        qsort(sorted.data(), size, sizeof(double), compare_doubles);
+        report("qsort", size, seconds_since(start));
+
+        if (size > 0 && memcmp(radix, expected.data(), size * sizeof(double)) != 0) {
+            fprintf(stderr, "c_sort output differs from std::sort\n");
+            return 1;
+        }
+        runtime_buffer_release(radix);
+    }
+    return 0;
+}
\ No newline at end of file
@@ -10,7 +10,9 @@
 typedef enum {
     NODE_TYPE_UNKNOWN = 0,
     NODE_TYPE_NUMBER,        // Scalar number (double)
+    NODE_TYPE_STRING,        // String literal (only valid as a builtin argument)
     NODE_TYPE_VECTOR,        // Vector literal (list of expression nodes)
+    NODE_TYPE_DENSE_VECTOR,  // Vector literal of plain numbers, as one array (built by the lexer)
     NODE_TYPE_IDENTIFIER,    // Variable identifier (string)
     NODE_TYPE_BINARY_OP,     // Binary operation (+, -, *, /)
     NODE_TYPE_UNARY_OP,      // Unary operation (e.g., negation '-'/+)
@@ -18,7 +20,10 @@ typedef enum {
     NODE_TYPE_STATEMENT_LIST, // Sequence of statements
     NODE_TYPE_IF,            // If statement
     NODE_TYPE_WHILE,         // While loop
-    NODE_TYPE_FUNC_CALL      // External function call
+    NODE_TYPE_FOR,           // Counted loop: [parallel] for i in range(a, b)
+    NODE_TYPE_FUNC_CALL,     // External function call
+    NODE_TYPE_FUNC_DEF,      // Function definition (top level only)
+    NODE_TYPE_RETURN         // Return statement (inside a function body)
 } NodeType;
 
 //------------------------------------------------------------------------------
@@ -38,6 +43,12 @@ typedef struct {
     size_t capacity;        // Allocated capacity of the items array
 } NodeList;
 
+// Structure for a dense vector literal
+typedef struct {
+    double *values;          // 'count' elements (owned by the node)
+    size_t count;
+} DenseVectorNode;
+
 // Structure for Binary Operation
 typedef struct {
     char op;                 // The operator character: '+', '-', '*', '/'
@@ -71,19 +82,56 @@ typedef struct {
     struct ASTNode *loop_body;   // Statement list (block)
 } WhileNode;
 
+// Reduction clause of a parallel for: reduce(op: variable)
+typedef struct {
+    char op;                 // '+', '<' (min) or '>' (max)
+    struct Symbol *variable;
+} Reduction;
+
+// Structure for Counted Loop
+typedef struct {
+    struct Symbol *index_symbol;  // Loop variable (scalar)
+    struct ASTNode *range_start;  // First index (inclusive)
+    struct ASTNode *range_end;    // Last index (exclusive)
+    struct ASTNode *loop_body;    // Statement
+    int is_parallel;              // Iterations run on the runtime thread pool
+    Reduction *reductions;        // Parallel only
+    size_t reduction_count;
+    int dynamic_schedule;         // schedule(dynamic): chunks are handed out as threads free up
+    struct ASTNode *chunk_size;   // Optional chunk size for schedule(dynamic, n), can be NULL
+    int index_live_after;         // Set by optimize_ast: 1 if the index is read after the loop, 0 if not, -1 if not analysed
+} ForNode;
+
 // Structure for Function Call
 typedef struct {
     struct Symbol *function_symbol; // Symbol for the function identifier
     NodeList arguments;             // List of expression nodes for arguments
 } FuncCallNode;
 
+// Structure for Function Definition
+typedef struct {
+    struct Symbol *function_symbol; // Global symbol for the function name
+    NodeList parameters;            // IDENTIFIER nodes for the parameters
+    struct ASTNode *body;           // Statement list (block)
+    struct Symbol *locals;          // Symbols of the function's scope (owned by the node)
+} FuncDefNode;
+
+// Structure for Return Statement
+typedef struct {
+    struct ASTNode *expression;
+} ReturnNode;
+
 // Main AST Node Structure
 typedef struct ASTNode {
     NodeType type;
+    int is_integer; // Set by infer_integers: a scalar expression that is always an integer within +-2^53
+    int site;       // Set by number_profile_sites: what a profile records about the node is under this number (0: none)
     // Add line number tracking later if needed: int line_number;
     union {
         double number_value;    // For NODE_TYPE_NUMBER
+        char *string_value;     // For NODE_TYPE_STRING (owned by the node)
         NodeList vector_elements; // For NODE_TYPE_VECTOR
+        DenseVectorNode dense_vector; // For NODE_TYPE_DENSE_VECTOR
         // char *identifier_name;  // For NODE_TYPE_IDENTIFIER
         struct Symbol *identifier_symbol; // Pointer to symbol table entry
         BinaryOpNode binary_op;   // For NODE_TYPE_BINARY_OP
@@ -92,7 +140,10 @@ typedef struct ASTNode {
         NodeList statement_list;  // For NODE_TYPE_STATEMENT_LIST
         IfNode if_stmt;         // For NODE_TYPE_IF
         WhileNode while_loop;   // For NODE_TYPE_WHILE
+        ForNode for_loop;       // For NODE_TYPE_FOR
         FuncCallNode func_call; // For NODE_TYPE_FUNC_CALL
+        FuncDefNode func_def;   // For NODE_TYPE_FUNC_DEF
+        ReturnNode return_stmt; // For NODE_TYPE_RETURN
     } data;
 } ASTNode;
 
@@ -102,15 +153,20 @@ typedef struct ASTNode {
 
 ASTNode* ast_new_node(NodeType type);
 ASTNode* ast_new_number(double value);
+ASTNode* ast_new_string(char *value);
 ASTNode* ast_new_identifier(struct Symbol *sym);
 ASTNode* ast_new_binary_op(char op, ASTNode *left, ASTNode *right);
 ASTNode* ast_new_unary_op(char op, ASTNode *operand);
 ASTNode* ast_new_assignment(struct Symbol *sym, ASTNode *expression);
 ASTNode* ast_new_vector();
+ASTNode* ast_new_dense_vector(double *values, size_t count);
 ASTNode* ast_new_statement_list();
 ASTNode* ast_new_if(ASTNode *condition, ASTNode *if_branch, ASTNode *else_branch);
 ASTNode* ast_new_while(ASTNode *condition, ASTNode *loop_body);
+ASTNode* ast_new_for(struct Symbol *index_sym, ASTNode *range_start, ASTNode *range_end);
 ASTNode* ast_new_func_call(struct Symbol *func_sym, NodeList args);
+ASTNode* ast_new_func_def(struct Symbol *func_sym, NodeList params, ASTNode *body, struct Symbol *locals);
+ASTNode* ast_new_return(ASTNode *expression);
 
 // Function to add an element to a vector node
 void ast_add_vector_element(ASTNode *vector_node, ASTNode *element);
@@ -118,6 +174,14 @@ void ast_add_vector_element(ASTNode *vector_node, ASTNode *element);
 // Function to add a statement to a statement list node
 void ast_add_statement(ASTNode *list_node, ASTNode *statement);
 
+// Function to add an argument to a function call's argument list
+void ast_add_argument(NodeList *list, ASTNode *argument);
+
+// Functions to complete a for node: parallel clauses, then the body
+void ast_add_reduction(ASTNode *for_node, char op, struct Symbol *variable);
+void ast_set_schedule(ASTNode *for_node, int dynamic_schedule, ASTNode *chunk_size);
+ASTNode* ast_set_for_body(ASTNode *for_node, ASTNode *loop_body);
+
 //------------------------------------------------------------------------------
 // Destructor Function (Declaration)
 //------------------------------------------------------------------------------
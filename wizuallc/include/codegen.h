@@ -2,6 +2,7 @@
 #define CODEGEN_H
 
 #include "ast.h" // Include AST node definitions
+#include "runtime_profile.h" // ProfileSite
 
 /**
  * @brief Generates C code from the given AST and writes it to a file.
@@ -11,5 +12,57 @@
  */
 void generate_code(ASTNode *ast_root, const char *output_filename);
 
+/**
+ * @brief Streaming code generation, as the program is parsed: codegen_begin,
+ *        then codegen_function / codegen_statement for each top-level item in
+ *        source order, then codegen_end, which writes the declarations and
+ *        main around the statements generated so far.
+ *
+ * @param output_filename The name of the C file to create.
+ * @return int 1 on success, 0 if the output file cannot be created.
+ */
+int codegen_begin(const char *output_filename);
+
+/**
+ * @brief Registers a function definition; calls after this point use it.
+ *        The node must stay alive until codegen_end (bodies are compiled at
+ *        their calls).
+ */
+void codegen_function(ASTNode *func_def);
+
+/**
+ * @brief Generates one top-level statement into its own C block, with its
+ *        own temporaries. The statement can be freed as soon as this returns.
+ */
+void codegen_statement(ASTNode *statement);
+
+/**
+ * @brief Completes the output file started by codegen_begin.
+ */
+void codegen_end(void);
+
+/**
+ * @brief Selects the OpenMP backend (wizuallc --openmp) for the code generated
+ *        next: the element-wise kernels and parallel for loops become OpenMP
+ *        loops instead of running on the runtime thread pool. The output is
+ *        then compiled with -fopenmp.
+ */
+void codegen_set_openmp(int enabled);
+
+/**
+ * @brief Instruments the code generated next (wizuallc --pgo-gen): the program
+ *        records a profile of its sites (numbered by number_profile_sites)
+ *        and writes it when it exits (see runtime_profile.h).
+ */
+void codegen_set_profile_generate(size_t site_count, uint64_t fingerprint);
+
+/**
+ * @brief Generates the code that follows using a profile (wizuallc --pgo-use)
+ *        read by runtime_profile_load, for branch hints, parallel for
+ *        thresholds, inlining and where a large program is cut into parts.
+ *        The profile must stay alive until codegen_end.
+ */
+void codegen_set_profile(const ProfileSite *sites);
+
 
 #endif // CODEGEN_H 
\ No newline at end of file
@@ -0,0 +1,68 @@
+#ifndef OPTIMIZE_H
+#define OPTIMIZE_H
+
+#include "ast.h" // Include AST node definitions
+#include <stdint.h> // For uint64_t
+
+/**
+ * @brief Removes dead code from the AST before code generation, using a
+ *        backward liveness analysis over the program and every function body:
+ *        - expression statements without side effects (their value is
+ *          discarded anyway);
+ *        - assignments whose value is never read before the variable is
+ *          assigned again or goes out of scope (dead stores); if the
+ *          right-hand side has side effects it is kept as an expression
+ *          statement;
+ *        - statements after a return, and ifs left with two empty branches.
+ *        Calls are side-effect free only if listed in the purity table of
+ *        built-ins, or (for functions defined with 'def') if their bodies
+ *        only make such calls; I/O built-ins and external calls are kept.
+ *
+ * @param ast_root The root statement list; modified in place.
+ * @return int Number of statements removed or simplified.
+ */
+int optimize_ast(ASTNode *ast_root);
+
+/**
+ * @brief Splits variables into versions so each can have its own static type:
+ *        the assignments that reach a common use (through branches and loops)
+ *        form one web, and every web beyond the first of a name gets a new
+ *        symbol "name__N" in the same scope (SSA renaming, with the webs that
+ *        meet at joins merged back). Run after optimize_ast.
+ *
+ * @param ast_root The root statement list; its symbol pointers are rewritten.
+ * @return int Number of versions created.
+ */
+int rename_variables(ASTNode *ast_root);
+
+/**
+ * @brief Interval analysis over scalar variables: a variable whose values are
+ *        provably integers within +-2^53 (so double arithmetic on them is
+ *        exact) is marked is_integer and declared int64_t by codegen, as are
+ *        the expressions computed only from such values. Accumulators in for
+ *        loops are bounded by step x trip count, and the counter of
+ *        while (x - c) or while (c - x) stepped by 1 towards c by the
+ *        interval from its start to c; a value that can grow without bound
+ *        (e.g. any other while-loop counter) stays double. Run after
+ *        rename_variables.
+ *
+ * @param ast_root The root statement list.
+ * @return int Number of integer variables.
+ */
+int infer_integers(ASTNode *ast_root);
+
+/**
+ * @brief Numbers the nodes a profile records (wizuallc --pgo-gen / --pgo-use,
+ *        see runtime_profile.h) in program order from 1, in node->site: every
+ *        top-level statement, ifs, whiles, parallel for loops, assignments and
+ *        calls, including those in function bodies. Run last, on the AST that
+ *        is generated.
+ *
+ * @param ast_root The root statement list.
+ * @param fingerprint Receives a hash of the shape of the program, so that the
+ *        profile of another program is not applied to it.
+ * @return int Number of sites.
+ */
+int number_profile_sites(ASTNode *ast_root, uint64_t *fingerprint);
+
+#endif // OPTIMIZE_H
\ No newline at end of file
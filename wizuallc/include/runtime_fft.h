@@ -0,0 +1,64 @@
+#ifndef RUNTIME_FFT_H
+#define RUNTIME_FFT_H
+
+#include <stdlib.h> // For size_t
+
+/*
+ * Complex values are stored interleaved: element 2k is the real part and
+ * element 2k+1 the imaginary part of complex value k.
+ */
+
+/**
+ * @brief In-place complex FFT of n interleaved complex values (2n doubles).
+ *        Powers of two use a recursive radix-4/2 transform with cached
+ *        twiddle tables and SSE2 butterflies, split across the runtime thread
+ *        pool for large n; other lengths use Bluestein's algorithm on top of
+ *        it. The forward transform uses exp(-2*pi*i*j*k/n).
+ *
+ * @param data 2n doubles, replaced by the transform.
+ * @param n Number of complex values.
+ * @param inverse Non-zero for the inverse transform (scaled by 1/n).
+ */
+void runtime_fft(double *data, size_t n, int inverse);
+
+/**
+ * @brief Runtime function behind fft(v): the spectrum of a real vector,
+ *        bins 0 .. size/2 as interleaved complex values. Even sizes run a
+ *        complex FFT of half the length.
+ *
+ * @param out_size Receives the number of doubles returned (2 * (size/2 + 1)).
+ * @return double* New runtime buffer (see runtime_mem.h), NULL if size is 0.
+ */
+double *c_fft(const double *data, size_t size, size_t *out_size);
+
+/**
+ * @brief Runtime function behind ifft(spectrum) and ifft(spectrum, n): the
+ *        real vector whose spectrum (as returned by c_fft) is given.
+ *
+ * @param spectrum Interleaved bins 0 .. n/2 (extra bins are ignored).
+ * @param size Number of doubles in spectrum; must be even.
+ * @param length Output length n, or a negative value for 2 * (bins - 1).
+ * @return double* New runtime buffer of 'length' elements. Exits with a
+ *         runtime error if the spectrum is too short for the length.
+ */
+double *c_ifft(const double *spectrum, size_t size, double length, size_t *out_size);
+
+/**
+ * @brief Runtime function behind convolve(a, b): the full linear convolution
+ *        (length a_size + b_size - 1). Short kernels are convolved directly;
+ *        longer ones through one forward and one inverse FFT, which may leave
+ *        rounding noise around 1e-15 relative to the largest output.
+ *
+ * @param out_size Receives the output length.
+ * @return double* New runtime buffer, NULL if either input is empty.
+ */
+double *c_convolve(const double *a, size_t a_size, const double *b, size_t b_size, size_t *out_size);
+
+/**
+ * @brief Runtime function behind correlate(a, b): the full cross-correlation,
+ *        i.e. the convolution of a with b reversed. Output k pairs b[0] with
+ *        a[k - (b_size - 1)].
+ */
+double *c_correlate(const double *a, size_t a_size, const double *b, size_t b_size, size_t *out_size);
+
+#endif // RUNTIME_FFT_H
\ No newline at end of file
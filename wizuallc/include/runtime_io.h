@@ -0,0 +1,97 @@
+#ifndef RUNTIME_IO_H
+#define RUNTIME_IO_H
+
+#include <stdlib.h> // For size_t
+
+/**
+ * @brief Runtime function behind read_csv("file", col).
+ *        The first request for a file parses all of its numeric columns in one
+ *        parallel pass (mmap, newline-aligned chunks) and caches them, so reading
+ *        further columns of the same file costs no extra I/O. A non-numeric first
+ *        line is treated as a header and skipped; missing fields become NaN.
+ *
+ * @param path Path of the CSV file.
+ * @param column Zero-based column index.
+ * @param out_size Receives the number of rows.
+ * @return double* Runtime buffer (see runtime_mem.h) owned by the caller, or NULL
+ *         for an empty file. Exits with a runtime error if the file cannot be
+ *         read or the column does not exist.
+ */
+double *c_read_csv_column(const char *path, double column, size_t *out_size);
+
+/**
+ * @brief Parses the number in [begin, end) exactly like a CSV field: up to 19
+ *        significant digits with a small exponent take a fast exact path,
+ *        anything else goes through strtod. The compiler's lexer uses it for
+ *        numeric literals.
+ *
+ * @return double The value, or NaN if the text is not a complete number.
+ */
+double runtime_parse_number(const char *begin, const char *end);
+
+/**
+ * @brief Writes the same text as print(x) for a scalar: the shortest decimal
+ *        that reads back as exactly value, or nan / inf / -inf. The compiler
+ *        uses it to write numeric literals into the generated C.
+ *
+ * @param out Receives at most 24 characters, not NUL-terminated.
+ * @return size_t Number of characters written.
+ */
+size_t runtime_format_number(char *out, double value);
+
+/**
+ * @brief Releases every column cached by c_read_csv_column.
+ *        Generated programs call this before exiting.
+ */
+void c_csv_cache_clear(void);
+
+/**
+ * @brief Runtime function behind print(x) for scalars. Writes the shortest
+ *        decimal text that reads back as exactly the same double, then a newline.
+ *
+ * @param value The value to print.
+ */
+void c_print_scalar(double value);
+
+/**
+ * @brief Runtime function behind print(x) for vectors. Prints "[a, b, ...]" on
+ *        one line; large vectors are formatted in parallel and written in blocks.
+ *
+ * @param data Vector data.
+ * @param size Number of elements.
+ */
+void c_print_vector(const double *data, size_t size);
+
+/**
+ * @brief Runtime function behind print("text").
+ *
+ * @param text The text to print (a newline is added).
+ */
+void c_print_string(const char *text);
+
+/**
+ * @brief Runtime function behind save_vector(x, "file").
+ *        Files ending in .txt or .csv get one value per line (formatted in
+ *        parallel, same text as print); anything else gets the raw doubles in
+ *        native byte order, written straight from the vector in large blocks.
+ *
+ * @param data Vector data; must be a runtime buffer (see runtime_mem.h).
+ * @param size Number of elements.
+ * @param path Output file, created or truncated. Exits with a runtime error
+ *        if it cannot be written.
+ */
+void c_save_vector(const double *data, size_t size, const char *path);
+
+/**
+ * @brief Writes any vector's elements as raw binary in native byte order
+ *        (save_vector for f32 and i64 vectors), the same way c_save_vector
+ *        writes binary files.
+ *
+ * @param data Vector data; must be a runtime buffer (see runtime_mem.h).
+ * @param size Number of elements.
+ * @param element_size Size of one element in bytes.
+ * @param path Output file, created or truncated.
+ */
+void c_save_binary(const void *data, size_t size, size_t element_size, const char *path);
+
+#endif // RUNTIME_IO_H
\ No newline at end of file
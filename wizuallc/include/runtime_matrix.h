@@ -0,0 +1,54 @@
+#ifndef RUNTIME_MATRIX_H
+#define RUNTIME_MATRIX_H
+
+#include <stdlib.h> // For size_t
+
+/*
+ * Matrices are stored row-major in one runtime buffer (see runtime_mem.h):
+ * element (i, j) of a rows x cols matrix is data[i * cols + j]. Each function
+ * returns a new runtime buffer, or NULL if the result has no elements.
+ */
+
+/**
+ * @brief Runtime function behind matmul(a, b): the matrix product. A and B
+ *        are packed into contiguous panels sized for the caches and
+ *        multiplied 4x4 at a time by an SSE2 register-blocked micro-kernel;
+ *        blocks of the result are computed in parallel on the runtime thread
+ *        pool.
+ *
+ * @return double* New a_rows x b_cols buffer. Exits with a runtime error if
+ *         a_cols != b_rows.
+ */
+double *c_matmul(const double *a, size_t a_rows, size_t a_cols,
+                 const double *b, size_t b_rows, size_t b_cols);
+
+/**
+ * @brief Runtime function behind matvec(m, v): the product of a matrix and a
+ *        column vector, rows computed in parallel.
+ *
+ * @return double* New buffer of 'rows' elements. Exits with a runtime error
+ *         if x_size != cols.
+ */
+double *c_matvec(const double *a, size_t rows, size_t cols, const double *x, size_t x_size);
+
+/**
+ * @brief Runtime function behind transpose(m), copied in cache-sized tiles.
+ *
+ * @return double* New cols x rows buffer.
+ */
+double *c_transpose(const double *a, size_t rows, size_t cols);
+
+/**
+ * @brief Runtime functions behind row(m, i) and col(m, j): a copy of one row
+ *        or column (zero-based) as a vector, so the vector built-ins and
+ *        element-wise kernels apply to it. Not a view: a vector buffer must
+ *        start with its own runtime_mem header, which an offset into the
+ *        matrix buffer does not have.
+ *
+ * @return double* New buffer of cols (row) or rows (col) elements. Exits with
+ *         a runtime error if the index is not an integer in range.
+ */
+double *c_matrix_row(const double *a, size_t rows, size_t cols, double index);
+double *c_matrix_col(const double *a, size_t rows, size_t cols, double index);
+
+#endif // RUNTIME_MATRIX_H
\ No newline at end of file
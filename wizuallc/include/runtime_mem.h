@@ -0,0 +1,64 @@
+#ifndef RUNTIME_MEM_H
+#define RUNTIME_MEM_H
+
+#include <stdlib.h> // For size_t
+
+/**
+ * @brief Alignment in bytes of the data of every buffer (a cache line, and
+ *        enough for any SIMD load). Generated kernels tell the C compiler
+ *        through __builtin_assume_aligned.
+ */
+#define RUNTIME_BUFFER_ALIGNMENT 64
+
+/**
+ * @brief Allocates a reference-counted data buffer (refcount starts at 1).
+ *        All Vector data in generated code is allocated through this so that
+ *        runtime functions can hold on to a buffer without copying it.
+ *        When WIZUALL_MEM_BUDGET is set (out-of-core mode), buffers of at least
+ *        WIZUALL_SPILL_THRESHOLD bytes that would exceed the budget are backed
+ *        by an mmap'd spill file in WIZUALL_SCRATCH_DIR instead of the heap.
+ *        The data is RUNTIME_BUFFER_ALIGNMENT aligned.
+ *
+ * @param bytes Number of bytes to allocate.
+ * @return void* Pointer to the buffer data, or NULL if bytes is 0. Exits on error.
+ */
+void *runtime_buffer_alloc(size_t bytes);
+
+/**
+ * @brief Resizes a buffer that is not shared (refcount must be 1).
+ *
+ * @param data Buffer returned by runtime_buffer_alloc (or NULL).
+ * @param bytes New size in bytes.
+ * @return void* Pointer to the (possibly moved) buffer data. Exits on error.
+ */
+void *runtime_buffer_realloc(void *data, size_t bytes);
+
+/**
+ * @brief Adds a reference to a buffer. Buffers are treated as immutable once
+ *        they are shared, so a retained buffer acts as a snapshot.
+ *
+ * @param data Buffer returned by runtime_buffer_alloc (NULL is ignored).
+ * @return void* The same pointer, for convenience.
+ */
+void *runtime_buffer_retain(void *data);
+
+/**
+ * @brief Drops a reference to a buffer, freeing it when the last one is gone.
+ *
+ * @param data Buffer returned by runtime_buffer_alloc (NULL is ignored).
+ */
+void runtime_buffer_release(void *data);
+
+/**
+ * @brief Streaming hint for kernels that walk a buffer front to back in chunks.
+ *        For buffers spilled to disk (out-of-core mode) this drops the pages of
+ *        the previous chunk and asks the kernel to read ahead the next one.
+ *        It is a cheap no-op for buffers that live in RAM.
+ *
+ * @param data Buffer returned by runtime_buffer_alloc (NULL is ignored).
+ * @param chunk_begin Byte offset of the chunk about to be processed.
+ * @param chunk_end Byte offset one past the end of that chunk.
+ */
+void runtime_buffer_stream(const void *data, size_t chunk_begin, size_t chunk_end);
+
+#endif // RUNTIME_MEM_H
\ No newline at end of file
@@ -0,0 +1,58 @@
+#ifndef RUNTIME_PARALLEL_H
+#define RUNTIME_PARALLEL_H
+
+#include <stdlib.h> // For size_t
+#include <stdint.h> // For int64_t
+
+/**
+ * @brief Task callback for runtime_parallel_for.
+ *
+ * @param task Index of the task to run (0 .. task_count-1).
+ * @param ctx The context pointer passed to runtime_parallel_for.
+ */
+typedef void (*RuntimeTaskFn)(size_t task, void *ctx);
+
+/**
+ * @brief Returns the number of threads used by the runtime thread pool.
+ *        Taken from WIZUALL_NUM_THREADS, or the number of online CPUs.
+ */
+size_t runtime_thread_count(void);
+
+/**
+ * @brief Runs fn(task, ctx) for every task in [0, task_count) on the runtime
+ *        thread pool and returns once all tasks are done. Tasks are handed out
+ *        dynamically, so uneven tasks balance themselves. The calling thread
+ *        takes part. Nested calls (from inside a task) run serially.
+ *
+ * @param task_count Number of tasks.
+ * @param fn Task callback.
+ * @param ctx Context pointer passed through to fn.
+ */
+void runtime_parallel_for(size_t task_count, RuntimeTaskFn fn, void *ctx);
+
+/**
+ * @brief Splits the index range [begin, end) of a parallel for loop into
+ *        tasks for runtime_parallel_for. Static scheduling makes one equal
+ *        block per thread. Dynamic scheduling makes blocks of at most 'chunk'
+ *        indices (about eight blocks per thread if chunk <= 0), which threads
+ *        claim as they become free, for iterations of uneven cost.
+ *
+ * @return size_t Number of tasks, 0 for an empty range.
+ */
+size_t runtime_range_tasks(int64_t begin, int64_t end, int dynamic_schedule, int64_t chunk);
+
+/**
+ * @brief runtime_range_tasks for a given number of threads instead of the
+ *        pool's, for loops run by another scheduler (the OpenMP code of
+ *        wizuallc --openmp). Does not start the pool.
+ */
+size_t runtime_range_tasks_for(int64_t begin, int64_t end, int dynamic_schedule, int64_t chunk, size_t threads);
+
+/**
+ * @brief First index of a task made by runtime_range_tasks. Task t covers
+ *        [runtime_range_start(.., t), runtime_range_start(.., t + 1)); task
+ *        'task_count' gives end.
+ */
+int64_t runtime_range_start(int64_t begin, int64_t end, size_t task_count, size_t task);
+
+#endif // RUNTIME_PARALLEL_H
\ No newline at end of file
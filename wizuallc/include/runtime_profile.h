@@ -0,0 +1,87 @@
+#ifndef RUNTIME_PROFILE_H
+#define RUNTIME_PROFILE_H
+
+#include <stdlib.h> // For size_t
+#include <stdint.h> // For uint64_t, int64_t
+
+/**
+ * @brief What a profile holds for one site (a numbered AST node, see
+ *        number_profile_sites in optimize.h). Each kind of site uses its own
+ *        fields, so a top-level if has both its time and its branch counts:
+ *        - top-level statement: ns;
+ *        - if / while condition: count (evaluations), taken (true);
+ *        - parallel for: count (runs), taken (iterations), work_ns (time
+ *          spent in its tasks, summed over the threads);
+ *        - assignment of a vector: count, size_min, size_max, size_sum;
+ *        - call of a function defined with 'def': count.
+ */
+typedef struct {
+    uint64_t count;
+    uint64_t taken;
+    uint64_t ns;
+    uint64_t work_ns;
+    uint64_t size_min;
+    uint64_t size_max;
+    uint64_t size_sum;
+} ProfileSite;
+
+/**
+ * @brief Starts recording a profile (programs generated with wizuallc
+ *        --pgo-gen call it first). The profile is written as JSON when the
+ *        program exits, to WIZUALL_PROFILE (default wizuall_profile.json).
+ *
+ * @param site_count Sites of the program (1 .. site_count).
+ * @param fingerprint Shape of the program, checked by runtime_profile_load.
+ */
+void runtime_profile_begin(size_t site_count, uint64_t fingerprint);
+
+/**
+ * @brief Monotonic clock in nanoseconds, for runtime_profile_time / _work.
+ */
+uint64_t runtime_profile_clock(void);
+
+/**
+ * @brief Adds the time since 'start' (runtime_profile_clock) to a statement.
+ */
+void runtime_profile_time(size_t site, uint64_t start);
+
+/**
+ * @brief Adds the time since 'start' to the work of a parallel for (called by
+ *        each of its tasks).
+ */
+void runtime_profile_work(size_t site, uint64_t start);
+
+/**
+ * @brief Counts one evaluation of an if / while condition.
+ *
+ * @return int 'taken', so the call can stand for the condition.
+ */
+int runtime_profile_branch(size_t site, int taken);
+
+/**
+ * @brief Counts one run of a parallel for over 'iterations' indices.
+ */
+void runtime_profile_loop(size_t site, int64_t iterations);
+
+/**
+ * @brief Records the size of a vector assigned at a site.
+ */
+void runtime_profile_size(size_t site, size_t size);
+
+/**
+ * @brief Counts one call.
+ */
+void runtime_profile_count(size_t site);
+
+/**
+ * @brief Reads a profile written by runtime_profile_begin (wizuallc
+ *        --pgo-use). Prints an error and returns NULL if the file cannot be
+ *        read or is the profile of another program (site count or
+ *        fingerprint differ).
+ *
+ * @return ProfileSite* site_count + 1 sites, indexed by site (0 unused), sites
+ *         missing from the file zero. Free with free().
+ */
+ProfileSite *runtime_profile_load(const char *path, size_t site_count, uint64_t fingerprint);
+
+#endif // RUNTIME_PROFILE_H
\ No newline at end of file
@@ -0,0 +1,68 @@
+#ifndef RUNTIME_QUANTILE_H
+#define RUNTIME_QUANTILE_H
+
+#include <stdlib.h> // For size_t
+
+/**
+ * @brief Mergeable approximate quantile sketch (KLL). Uses O(k) memory no
+ *        matter how many values are added, so it can summarise data that is
+ *        streamed in batches and never held in memory at once. Sketches built
+ *        over separate parts of the data can be merged.
+ */
+typedef struct RuntimeSketch RuntimeSketch;
+
+/**
+ * @brief Creates an empty sketch.
+ *
+ * @param k Accuracy parameter: the rank error is roughly 1.7 / k (k = 200
+ *          gives about 1%). Values below 8 are raised to 8.
+ * @return RuntimeSketch* New sketch. Exits on allocation failure.
+ */
+RuntimeSketch *runtime_sketch_create(size_t k);
+
+/**
+ * @brief Adds a batch of values to the sketch. NaNs are ignored.
+ */
+void runtime_sketch_add(RuntimeSketch *sketch, const double *values, size_t count);
+
+/**
+ * @brief Merges src into dst. src is left unchanged. Both sketches should
+ *        have been created with the same k.
+ */
+void runtime_sketch_merge(RuntimeSketch *dst, const RuntimeSketch *src);
+
+/**
+ * @brief Returns the approximate q-quantile (q in [0, 1]) of the values
+ *        added so far, or NaN if the sketch is empty. q = 0 and q = 1 give
+ *        the exact minimum and maximum.
+ */
+double runtime_sketch_quantile(const RuntimeSketch *sketch, double q);
+
+/**
+ * @brief Frees a sketch created by runtime_sketch_create (NULL is ignored).
+ */
+void runtime_sketch_free(RuntimeSketch *sketch);
+
+/**
+ * @brief Runtime function behind quantile(v, q) and median(v): the exact
+ *        q-quantile, interpolating linearly between the two closest order
+ *        statistics. Uses Floyd-Rivest selection (expected O(n)) on a copy
+ *        of the data instead of a full sort. NaNs are ignored.
+ *
+ * @return double The quantile, or NaN if there are no values. Exits with a
+ *         runtime error if q is outside [0, 1].
+ */
+double c_quantile(const double *data, size_t size, double q);
+
+/**
+ * @brief Runtime function behind quantile_approx(v, q): the q-quantile from
+ *        KLL sketches built per chunk on the runtime thread pool and merged.
+ *        Needs no copy of the data, and walks spilled vectors as a stream.
+ *
+ * @param data Vector data; must be a runtime buffer (see runtime_mem.h).
+ * @return double The approximate quantile, or NaN if there are no values.
+ *         Exits with a runtime error if q is outside [0, 1].
+ */
+double c_quantile_approx(const double *data, size_t size, double q);
+
+#endif // RUNTIME_QUANTILE_H
\ No newline at end of file
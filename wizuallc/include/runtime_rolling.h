@@ -0,0 +1,45 @@
+#ifndef RUNTIME_ROLLING_H
+#define RUNTIME_ROLLING_H
+
+#include <stdlib.h> // For size_t
+
+/*
+ * Rolling-window statistics. Element i of the result summarises the trailing
+ * window data[i-window+1 .. i]; the first window-1 elements (whose window is
+ * incomplete) and windows containing a NaN are NaN. The vector is split into
+ * chunks on the runtime thread pool, each reading window-1 elements of halo
+ * before its start. Each call returns a new runtime buffer (see runtime_mem.h)
+ * of 'size' elements, and exits with a runtime error if window is not a
+ * positive integer.
+ */
+
+/**
+ * @brief rolling_sum(v, w): running sum, re-anchored (summed afresh) every
+ *        few thousand elements to stop rounding error building up.
+ */
+double *c_rolling_sum(const double *data, size_t size, double window);
+
+/**
+ * @brief rolling_mean(v, w): rolling_sum divided by the window size.
+ */
+double *c_rolling_mean(const double *data, size_t size, double window);
+
+/**
+ * @brief rolling_std(v, w): sample standard deviation (divides by w-1, so a
+ *        window of 1 gives NaN), from running sums of x and x^2 taken
+ *        relative to a value of the window, re-anchored like rolling_sum.
+ */
+double *c_rolling_std(const double *data, size_t size, double window);
+
+/**
+ * @brief rolling_min(v, w): window minimum from a monotonic deque, O(1)
+ *        amortised per element regardless of the window size.
+ */
+double *c_rolling_min(const double *data, size_t size, double window);
+
+/**
+ * @brief rolling_max(v, w): window maximum, like rolling_min.
+ */
+double *c_rolling_max(const double *data, size_t size, double window);
+
+#endif // RUNTIME_ROLLING_H
\ No newline at end of file
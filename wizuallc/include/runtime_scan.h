@@ -0,0 +1,70 @@
+#ifndef RUNTIME_SCAN_H
+#define RUNTIME_SCAN_H
+
+#include <stdlib.h> // For size_t
+
+/**
+ * @brief How block summaries are combined by runtime_blocked_scan.
+ */
+typedef enum {
+    RUNTIME_SCAN_SUM,    // Carries add up (identity 0)
+    RUNTIME_SCAN_PRODUCT // Carries multiply (identity 1)
+} RuntimeScanOp;
+
+/**
+ * @brief Pass 1 callback: returns the summary (sum, product, count, ...) of
+ *        elements [begin, end).
+ */
+typedef double (*RuntimeBlockReduceFn)(size_t begin, size_t end, void *ctx);
+
+/**
+ * @brief Pass 2 callback: processes elements [begin, end) given the combined
+ *        summary of everything before begin.
+ */
+typedef void (*RuntimeBlockScanFn)(size_t begin, size_t end, double carry, void *ctx);
+
+/**
+ * @brief Two-pass blocked scan skeleton on the runtime thread pool.
+ *        Splits [0, size) into blocks, reduces every block in parallel, scans
+ *        the block summaries serially, then runs scan on every block in
+ *        parallel with its carry-in. Small inputs run as a single block.
+ *        cumsum, cumprod and compact are built on it.
+ *
+ * @param size Number of elements.
+ * @param op How summaries combine.
+ * @param reduce Pass 1 callback.
+ * @param scan Pass 2 callback.
+ * @param ctx Context pointer passed through to both callbacks.
+ */
+void runtime_blocked_scan(size_t size, RuntimeScanOp op, RuntimeBlockReduceFn reduce,
+                          RuntimeBlockScanFn scan, void *ctx);
+
+/**
+ * @brief Runtime function behind cumsum(v): inclusive running sum.
+ *        Blocks are summed independently, so rounding can differ slightly
+ *        from a strictly sequential sum.
+ *
+ * @return double* New runtime buffer (see runtime_mem.h) of 'size' elements.
+ */
+double *c_cumsum(const double *data, size_t size);
+
+/**
+ * @brief Runtime function behind cumprod(v): inclusive running product.
+ *
+ * @return double* New runtime buffer (see runtime_mem.h) of 'size' elements.
+ */
+double *c_cumprod(const double *data, size_t size);
+
+/**
+ * @brief Runtime function behind compact(v, mask): the elements of data whose
+ *        mask entry is non-zero, in order. Output positions come from a
+ *        parallel scan of the mask.
+ *
+ * @param out_size Receives the number of elements kept.
+ * @return double* New runtime buffer, or NULL if nothing is kept. Exits with a
+ *         runtime error if the sizes differ.
+ */
+double *c_compact(const double *data, size_t size, const double *mask, size_t mask_size,
+                  size_t *out_size);
+
+#endif // RUNTIME_SCAN_H
\ No newline at end of file
@@ -0,0 +1,30 @@
+#ifndef RUNTIME_SORT_H
+#define RUNTIME_SORT_H
+
+#include <stdlib.h> // For size_t
+#include <stdint.h> // For int64_t
+
+/**
+ * @brief Runtime function behind sort(v): the elements in ascending order.
+ *        LSD radix sort on the IEEE-754 bit patterns, parallelised on the
+ *        runtime thread pool with per-chunk histograms. -0 sorts before +0
+ *        and every NaN sorts last (NaNs come back as the default quiet NaN).
+ *
+ * @param data Input values.
+ * @param size Number of values.
+ * @return double* New runtime buffer (see runtime_mem.h) of 'size' elements.
+ */
+double *c_sort(const double *data, size_t size);
+
+/**
+ * @brief Runtime function behind argsort(v): the zero-based indices that
+ *        would sort data, with the same ordering as c_sort. The sort is
+ *        stable, so equal values keep their original order.
+ *
+ * @param data Input values.
+ * @param size Number of values.
+ * @return int64_t* New runtime buffer of 'size' indices.
+ */
+int64_t *c_argsort(const double *data, size_t size);
+
+#endif // RUNTIME_SORT_H
\ No newline at end of file
@@ -5,7 +5,11 @@
 
 /**
  * @brief Runtime function to generate a scatter plot from two vectors.
- *        Writes data to "plot_data.txt" and calls gnuplot via "plot.gp".
+ *        Queues the plot on a background render worker and returns immediately.
+ *        The worker streams the data to one persistent gnuplot process
+ *        (configured once from "plot.gp") and batches pending plots into a multiplot.
+ *        The data buffers are retained (not copied), so they must come from
+ *        runtime_buffer_alloc (see runtime_mem.h).
  *
  * @param x_data Pointer to the double array for X coordinates.
  * @param x_size Number of elements in x_data.
@@ -14,4 +18,10 @@
  */
 void c_scatter_plot(double *x_data, size_t x_size, double *y_data, size_t y_size);
 
-#endif // RUNTIME_VIZ_H 
\ No newline at end of file
+/**
+ * @brief Waits until every queued plot has been rendered and stops the render
+ *        worker and its gnuplot session. Generated programs call this before exiting.
+ */
+void c_plot_flush(void);
+
+#endif // RUNTIME_VIZ_H
\ No newline at end of file
@@ -9,15 +9,33 @@
 typedef enum {
     SYMBOL_TYPE_UNDEFINED, // Should not happen after insert
     SYMBOL_TYPE_SCALAR,
-    SYMBOL_TYPE_VECTOR
+    SYMBOL_TYPE_VECTOR,
+    SYMBOL_TYPE_MATRIX,    // 2-D, row-major f64 elements
+    SYMBOL_TYPE_STRING     // Only for expression results (string literal arguments)
 } SymbolType;
 
+//------------------------------------------------------------------------------
+// Vector Element Type (dtype) Enum
+//------------------------------------------------------------------------------
+typedef enum {
+    DTYPE_F64 = 0, // double (default for literals, read_vector, read_csv)
+    DTYPE_F32,     // float, converted with to_f32()
+    DTYPE_I64      // int64_t, converted with to_i64()
+} DType;
+
 //------------------------------------------------------------------------------
 // Symbol Structure
 //------------------------------------------------------------------------------
 typedef struct Symbol {
     char *name;            // Symbol name (identifier)
     SymbolType type;       // Current type of the symbol
+    DType dtype;           // Element type if type is VECTOR
+    int type_known;        // Set by codegen at the first use as a variable; later uses must match
+    size_t rows, cols;     // Matrix shape where codegen knows it at this point of the program (0 = unknown)
+    struct Symbol *base;   // Variable this version was split from by rename_variables (NULL for source names)
+    int entry_unread;      // Set by rename_variables: its value before the first assignment (0) is never read
+    struct Symbol *storage; // Set by codegen: another version of the same variable whose C variable this one reuses
+    int is_integer;        // Set by infer_integers: only ever holds integers that fit an int64_t (declared as one)
 
     union {
         double scalar_value; // Value if type is SCALAR
@@ -51,6 +69,37 @@ Symbol *symbol_lookup(const char *name);
  */
 Symbol *symbol_insert(const char *name);
 
+/**
+ * @brief Opens a new scope for a function body. Until the matching
+ *        symbol_pop_scope, symbol_lookup and symbol_insert only see the
+ *        symbols of this scope (function bodies don't see global variables).
+ */
+void symbol_push_scope();
+
+/**
+ * @brief Reopens a function scope closed earlier, so symbols can be added to
+ *        it. Close it again with symbol_pop_scope, which returns the
+ *        extended list.
+ *
+ * @param symbols The list returned by symbol_pop_scope.
+ */
+void symbol_reopen_scope(Symbol *symbols);
+
+/**
+ * @brief Closes the innermost scope opened by symbol_push_scope.
+ *
+ * @return Symbol* The scope's symbols, linked through 'next'. The caller takes
+ *         ownership and frees them with symbol_list_free.
+ */
+Symbol *symbol_pop_scope();
+
+/**
+ * @brief Frees a list of symbols returned by symbol_pop_scope.
+ *
+ * @param list Head of the list (NULL is ignored).
+ */
+void symbol_list_free(Symbol *list);
+
 /**
  * @brief Sets the value of a symbol to a scalar.
  *        Frees any existing vector data associated with the symbol.
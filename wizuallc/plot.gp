@@ -1,4 +1,8 @@
 # Gnuplot script: plot.gp
+# Loaded once when the runtime starts its persistent gnuplot session.
+# The runtime then streams each scatter_plot as inline binary data
+# (plot '-' binary ...), so this file only holds the session settings.
+
 # Sets the output terminal (e.g., PNG, WXT, Aqua)
 # Adjust the terminal based on your environment
 # set terminal pngcairo size 800,600 enhanced font 'Verdana,10'
@@ -8,10 +12,4 @@ set terminal wxt size 800,600 title 'WIZUALL Scatter Plot' enhanced # Interactiv
 # Set plot title and labels
 set title "Scatter Plot from WIZUALL"
 set xlabel "X Axis"
-set ylabel "Y Axis"
-
-# Plot the data from plot_data.txt using column 1 as X and column 2 as Y
-plot 'plot_data.txt' using 1:2 with points pointtype 7 title 'Data Points'
-
-# Optional: Pause if using an interactive terminal (like wxt)
-# pause -1 "Press Enter or close window to exit..." 
\ No newline at end of file
+set ylabel "Y Axis"
\ No newline at end of file
@@ -37,6 +37,8 @@ ASTNode* ast_new_node(NodeType type) {
         exit(EXIT_FAILURE);
     }
     node->type = type;
+    node->is_integer = 0;
+    node->site = 0;
     // Initialize union members to 0/NULL where applicable
     memset(&node->data, 0, sizeof(node->data)); 
     return node;
@@ -49,6 +51,13 @@ ASTNode* ast_new_number(double value) {
     return node;
 }
 
+// String literal node (takes ownership of value)
+ASTNode* ast_new_string(char *value) {
+    ASTNode *node = ast_new_node(NODE_TYPE_STRING);
+    node->data.string_value = value;
+    return node;
+}
+
 // Identifier node
 ASTNode* ast_new_identifier(Symbol *sym) { // Takes Symbol*
     ASTNode *node = ast_new_node(NODE_TYPE_IDENTIFIER);
@@ -92,6 +101,14 @@ ASTNode* ast_new_vector() {
     return node;
 }
 
+// Dense vector node (takes ownership of values)
+ASTNode* ast_new_dense_vector(double *values, size_t count) {
+    ASTNode *node = ast_new_node(NODE_TYPE_DENSE_VECTOR);
+    node->data.dense_vector.values = values;
+    node->data.dense_vector.count = count;
+    return node;
+}
+
 // Statement list node (initially empty)
 ASTNode* ast_new_statement_list() {
     ASTNode *node = ast_new_node(NODE_TYPE_STATEMENT_LIST);
@@ -118,6 +135,17 @@ ASTNode* ast_new_while(ASTNode *condition, ASTNode *loop_body) {
     return node;
 }
 
+// Counted loop node; the body (and for parallel loops, the clauses) are added
+// once parsed
+ASTNode* ast_new_for(Symbol *index_sym, ASTNode *range_start, ASTNode *range_end) {
+    ASTNode *node = ast_new_node(NODE_TYPE_FOR);
+    node->data.for_loop.index_symbol = index_sym;
+    node->data.for_loop.range_start = range_start;
+    node->data.for_loop.range_end = range_end;
+    node->data.for_loop.index_live_after = -1; // Streamed programs are not analysed
+    return node;
+}
+
 // Function Call node
 ASTNode* ast_new_func_call(Symbol *func_sym, NodeList args) {
     ASTNode *node = ast_new_node(NODE_TYPE_FUNC_CALL);
@@ -126,6 +154,23 @@ ASTNode* ast_new_func_call(Symbol *func_sym, NodeList args) {
     return node;
 }
 
+// Function Definition node (takes ownership of the local symbols)
+ASTNode* ast_new_func_def(Symbol *func_sym, NodeList params, ASTNode *body, Symbol *locals) {
+    ASTNode *node = ast_new_node(NODE_TYPE_FUNC_DEF);
+    node->data.func_def.function_symbol = func_sym;
+    node->data.func_def.parameters = params;
+    node->data.func_def.body = body;
+    node->data.func_def.locals = locals;
+    return node;
+}
+
+// Return statement node
+ASTNode* ast_new_return(ASTNode *expression) {
+    ASTNode *node = ast_new_node(NODE_TYPE_RETURN);
+    node->data.return_stmt.expression = expression;
+    return node;
+}
+
 // Add element to vector
 void ast_add_vector_element(ASTNode *vector_node, ASTNode *element) {
     if (!vector_node || vector_node->type != NODE_TYPE_VECTOR || !element) return;
@@ -134,6 +179,34 @@ void ast_add_vector_element(ASTNode *vector_node, ASTNode *element) {
     list->items[list->count++] = element;
 }
 
+// Add a reduction clause to a for node
+void ast_add_reduction(ASTNode *for_node, char op, Symbol *variable) {
+    if (!for_node || for_node->type != NODE_TYPE_FOR) return;
+    ForNode *loop = &for_node->data.for_loop;
+    Reduction *grown = (Reduction *)realloc(loop->reductions, (loop->reduction_count + 1) * sizeof(Reduction));
+    if (!grown) {
+        perror("Failed to reallocate reduction list");
+        exit(EXIT_FAILURE);
+    }
+    loop->reductions = grown;
+    loop->reductions[loop->reduction_count].op = op;
+    loop->reductions[loop->reduction_count].variable = variable;
+    loop->reduction_count++;
+}
+
+// Set the schedule clause of a for node
+void ast_set_schedule(ASTNode *for_node, int dynamic_schedule, ASTNode *chunk_size) {
+    if (!for_node || for_node->type != NODE_TYPE_FOR) return;
+    ast_free_node(for_node->data.for_loop.chunk_size); // A later clause wins
+    for_node->data.for_loop.dynamic_schedule = dynamic_schedule;
+    for_node->data.for_loop.chunk_size = chunk_size;
+}
+
+ASTNode* ast_set_for_body(ASTNode *for_node, ASTNode *loop_body) {
+    for_node->data.for_loop.loop_body = loop_body;
+    return for_node;
+}
+
 // Add statement to list
 void ast_add_statement(ASTNode *list_node, ASTNode *statement) {
     if (!list_node || list_node->type != NODE_TYPE_STATEMENT_LIST || !statement) return;
@@ -160,6 +233,9 @@ void ast_free_node(ASTNode *node) {
         case NODE_TYPE_NUMBER:
             // No dynamic memory directly in this node type data
             break;
+        case NODE_TYPE_STRING:
+            free(node->data.string_value);
+            break;
         case NODE_TYPE_IDENTIFIER:
             // free(node->data.identifier_name); // No longer freeing name here
             // Symbol pointer is just a reference, not owned by AST node
@@ -183,6 +259,9 @@ void ast_free_node(ASTNode *node) {
             }
             free(node->data.vector_elements.items); // Free the list array itself
             break;
+        case NODE_TYPE_DENSE_VECTOR:
+            free(node->data.dense_vector.values);
+            break;
         case NODE_TYPE_STATEMENT_LIST:
             // Free all statement nodes in the list
             for (size_t i = 0; i < node->data.statement_list.count; ++i) {
@@ -201,6 +280,13 @@ void ast_free_node(ASTNode *node) {
             ast_free_node(node->data.while_loop.condition);
             ast_free_node(node->data.while_loop.loop_body);
             break;
+        case NODE_TYPE_FOR:
+            ast_free_node(node->data.for_loop.range_start);
+            ast_free_node(node->data.for_loop.range_end);
+            ast_free_node(node->data.for_loop.loop_body);
+            ast_free_node(node->data.for_loop.chunk_size);
+            free(node->data.for_loop.reductions);
+            break;
         case NODE_TYPE_FUNC_CALL:
              // Don't free the symbol, it's owned by the symbol table
              // Free the argument nodes
@@ -209,6 +295,17 @@ void ast_free_node(ASTNode *node) {
             }
             free(node->data.func_call.arguments.items); // Free the argument list array
             break;
+        case NODE_TYPE_FUNC_DEF:
+            for (size_t i = 0; i < node->data.func_def.parameters.count; ++i) {
+                ast_free_node(node->data.func_def.parameters.items[i]);
+            }
+            free(node->data.func_def.parameters.items);
+            ast_free_node(node->data.func_def.body);
+            symbol_list_free(node->data.func_def.locals); // The function's scope
+            break;
+        case NODE_TYPE_RETURN:
+            ast_free_node(node->data.return_stmt.expression);
+            break;
         case NODE_TYPE_UNKNOWN:
         default:
             // Should not happen in a well-formed tree
@@ -246,6 +343,10 @@ void print_ast(ASTNode *node, int indent) {
             printf("NUMBER: %f\n", node->data.number_value);
             break;
 
+        case NODE_TYPE_STRING:
+            printf("STRING: \"%s\"\n", node->data.string_value);
+            break;
+
         case NODE_TYPE_IDENTIFIER:
             // Print name from symbol table entry
             printf("IDENTIFIER: %s\n", 
@@ -277,6 +378,14 @@ void print_ast(ASTNode *node, int indent) {
             }
             break;
 
+        case NODE_TYPE_DENSE_VECTOR: { // Only the first few elements of large literals
+            size_t shown = node->data.dense_vector.count < 8 ? node->data.dense_vector.count : 8;
+            printf("DENSE_VECTOR: %ld element(s) [", (long)node->data.dense_vector.count);
+            for (size_t i = 0; i < shown; ++i) printf("%s%g", i ? ", " : "", node->data.dense_vector.values[i]);
+            printf("%s]\n", shown < node->data.dense_vector.count ? ", ..." : "");
+            break;
+        }
+
         case NODE_TYPE_STATEMENT_LIST:
             printf("STATEMENT_LIST:\n");
             for (size_t i = 0; i < node->data.statement_list.count; ++i) {
@@ -310,6 +419,26 @@ void print_ast(ASTNode *node, int indent) {
             print_ast(node->data.while_loop.loop_body, indent + 2);
             break;
 
+        case NODE_TYPE_FOR:
+            printf("%sFOR: %s\n", node->data.for_loop.is_parallel ? "PARALLEL " : "",
+                node->data.for_loop.index_symbol->name);
+            print_indent(indent + 1); printf("Range:\n");
+            print_ast(node->data.for_loop.range_start, indent + 2);
+            print_ast(node->data.for_loop.range_end, indent + 2);
+            for (size_t i = 0; i < node->data.for_loop.reduction_count; ++i) {
+                char op = node->data.for_loop.reductions[i].op;
+                print_indent(indent + 1);
+                printf("Reduce: %s %s\n", op == '+' ? "+" : (op == '<' ? "min" : "max"),
+                    node->data.for_loop.reductions[i].variable->name);
+            }
+            if (node->data.for_loop.dynamic_schedule) {
+                print_indent(indent + 1); printf("Schedule: dynamic\n");
+                print_ast(node->data.for_loop.chunk_size, indent + 2);
+            }
+            print_indent(indent + 1); printf("Body:\n");
+            print_ast(node->data.for_loop.loop_body, indent + 2);
+            break;
+
         case NODE_TYPE_FUNC_CALL:
             printf("FUNC_CALL: %s\n",
                 node->data.func_call.function_symbol ? node->data.func_call.function_symbol->name : "(null symbol!)");
@@ -323,6 +452,21 @@ void print_ast(ASTNode *node, int indent) {
             }
             break;
 
+        case NODE_TYPE_FUNC_DEF:
+            printf("FUNC_DEF: %s\n", node->data.func_def.function_symbol->name);
+            print_indent(indent + 1); printf("Parameters:\n");
+            for (size_t i = 0; i < node->data.func_def.parameters.count; ++i) {
+                print_ast(node->data.func_def.parameters.items[i], indent + 2);
+            }
+            print_indent(indent + 1); printf("Body:\n");
+            print_ast(node->data.func_def.body, indent + 2);
+            break;
+
+        case NODE_TYPE_RETURN:
+            printf("RETURN\n");
+            print_ast(node->data.return_stmt.expression, indent + 1);
+            break;
+
         case NODE_TYPE_UNKNOWN:
         default:
             printf("UNKNOWN NODE TYPE: %d\n", node->type);
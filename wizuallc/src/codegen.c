@@ -2,34 +2,163 @@
 #include "ast.h"
 #include "symtab.h" // May need symbol info during generation
 #include "runtime_viz.h" // Include runtime declarations
+#include "runtime_io.h"
+#include "runtime_parallel.h" // Partitions are generated on the runtime thread pool
+#include "runtime_profile.h" // ProfileSite (--pgo-use)
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdarg.h> // For va_list, va_start, va_end
 #include <string.h>
 #include <assert.h> // For assertions
+#include <math.h>   // For isinf, signbit
 
 // Structure to hold the result of expression code generation
 typedef struct {
     char* code;         // C code fragment (literal, variable name, temporary)
     SymbolType type;    // Type of the result (SCALAR or VECTOR)
+    DType dtype;        // Element type if type is VECTOR
     int is_temporary;   // Flag indicating if 'code' refers to a temporary that might need cleanup
+    size_t rows, cols;  // Matrix shape if known at compile time (0 = unknown)
 } ExprResult;
 
-// Global file pointer for the output C file
-static FILE *output_file = NULL;
-static int temp_var_counter = 0; // Counter for temporary variable names
-static int codegen_error_occurred = 0; // Global flag for semantic errors
+// Generated C names for each vector dtype (indexed by DType)
+typedef struct {
+    const char *name;        // WIZUALL name, as in to_f32()
+    const char *vector_type; // Generated struct type
+    const char *elem_type;   // C element type
+    const char *suffix;      // Helper name suffix, e.g. vector_add_f32
+} DTypeInfo;
+
+static const DTypeInfo dtype_info[] = {
+    { "f64", "Vector",    "double",  ""     },
+    { "f32", "VectorF32", "float",   "_f32" },
+    { "i64", "VectorI64", "int64_t", "_i64" }
+};
+#define DTYPE_COUNT 3
+
+// Type of each temporary, so they can be declared after the statements are generated
+typedef struct {
+    SymbolType type;
+    DType dtype;
+    int owner;          // 0 for main, otherwise the id of the function clone that declares it
+    char *name;         // Owned here; expression results only borrow it
+} TempInfo;
+
+// Static type of a value; function clones are specialised on their argument types
+typedef struct {
+    SymbolType type;
+    DType dtype;        // Element type if type is VECTOR
+    size_t rows, cols;  // Matrix shape if known (0 = unknown)
+} ValueType;
+
+// One C version of a user function, for one combination of argument types
+typedef struct {
+    ValueType *params;
+    char *c_name;       // wz_<name>_<index>
+    ValueType result;   // Return type, valid once has_result is set
+    int has_result;
+} FunctionClone;
+
+// A function defined with 'def', and the clones generated for it so far
+typedef struct {
+    ASTNode *def;       // The NODE_TYPE_FUNC_DEF node
+    FunctionClone *clones;
+    int clone_count;
+    int clone_capacity;
+    int active;         // Bodies of this function being generated right now (no inlining while > 0)
+    int partition_mark; // Last partition (1-based) found to call it (see make_partitions)
+} UserFunction;
+
+// The function body being generated, innermost first (NULL in main)
+typedef struct FunctionContext {
+    UserFunction *function;
+    int clone_index;    // Clone being generated, -1 when the body is inlined into the caller
+    char *result_var;   // Receives the return value (inlined: a caller temporary made at the return)
+    ValueType result;
+    int has_result;
+    int return_count;
+    struct FunctionContext *outer;
+} FunctionContext;
+
+// Functions whose body has at most this many statements, no control flow and
+// a single return at the end are inlined instead of called
+#define INLINE_MAX_STATEMENTS 8
+
+// The state of generating statements is per thread: partitions of the program
+// are generated in parallel (see Parallel Code Generation)
+static _Thread_local FILE *output_file = NULL;
+static _Thread_local int temp_var_counter = 0; // Counter for temporary variable names
+static _Thread_local TempInfo *temp_infos = NULL; // Type of temporary i, grown as temps are created
+static _Thread_local int temp_infos_capacity = 0;
+static _Thread_local int codegen_error_occurred = 0; // Flag for semantic errors
+static _Thread_local FILE *error_file = NULL;       // Semantic errors go here (NULL: stderr)
+static UserFunction *user_functions = NULL; // Functions defined with 'def'
+static int user_function_count = 0;
+static _Thread_local FunctionContext *current_function = NULL;
+static _Thread_local int current_owner = 0;       // Owner of new temporaries (see TempInfo)
+static _Thread_local int body_counter = 0;        // Clones and parallel loop bodies generated so far (owner ids)
+static _Thread_local int loop_counter = 0;        // Names the C variables of each for loop
+static _Thread_local int loop_partition = 0;      // Partition being generated, part of loop names
+static _Thread_local int parallel_body_depth = 0; // Parallel loop bodies being generated in the current function
+static _Thread_local FILE *prototype_file = NULL; // Clone prototypes, then definitions, go before main
+static _Thread_local FILE *function_file = NULL;
+static int openmp = 0; // --openmp: kernels and parallel for loops are OpenMP loops (see codegen_set_openmp)
+static size_t profile_sites = 0;          // --pgo-gen: sites the program records (see Profile-Guided Optimisation)
+static uint64_t profile_fingerprint = 0;
+static const ProfileSite *profile = NULL; // --pgo-use: the profile, indexed by site
 
 //------------------------------------------------------------------------------
 // Forward Declarations for All Static Functions
 //------------------------------------------------------------------------------
 static void report_codegen_error(const char *format, ...);
 static void emit(int indent_level, const char *format, ...);
-static char* new_temp_scalar_var();
-static char* new_temp_vector_var();
+static char* new_temp_var(const char *prefix, SymbolType type, DType dtype);
+static char* new_temp_scalar_var(DType dtype);
+static char* new_temp_vector_var(DType dtype);
+static char* new_temp_matrix_var();
+static const char* type_name(SymbolType type, DType dtype);
+static void emit_chunk_loop_begin(const char *operands[], int operand_count, int vectorizable);
+static void emit_chunk_loop_end();
+static void emit_vector_basics(const DTypeInfo *info);
+static void emit_binary_vector_kernel(const DTypeInfo *info, const char *func_name, const char *op_name, char op, const char *comment);
+static void emit_scalar_vector_kernel(const DTypeInfo *info, const char *func_name, char op, const char *comment);
+static void emit_conversion_kernel(const DTypeInfo *from, const DTypeInfo *to);
+static void convert_vector_result(ExprResult *res, DType to);
+static void forget_assigned_shapes(ASTNode *node);
+static size_t literal_dimension(ASTNode *node);
+static int builtin_returns_void(const char *func_name);
 static void generate_runtime_helpers();
+static Symbol* storage_of(Symbol *sym);
+static const char* var_name(Symbol *sym);
+static const char* source_name(Symbol *sym);
+static void fix_symbol_type(Symbol *sym, SymbolType type, DType dtype);
+static void declare_symbol(Symbol *sym);
+static void declare_temps(int owner);
+static void free_symbol(Symbol *sym, const char *prefix);
+static void free_temps(int owner);
 static void declare_variables();
-static void generate_cleanup_code();
+static void generate_cleanup_code(const char *prefix);
+static ValueType value_type_of(const ExprResult *res);
+static int value_types_equal(const ValueType *a, const ValueType *b);
+static const char* c_type_name(const ValueType *type);
+static void emit_store(const char *target, const ValueType *type, const char *code);
+static void register_function(ASTNode *func_def);
+static UserFunction* find_user_function(const char *name);
+static int function_is_inlinable(UserFunction *function, const ASTNode *call);
+static int is_parameter(FuncDefNode *def, Symbol *sym);
+static Symbol* save_locals(FuncDefNode *def);
+static void restore_locals(FuncDefNode *def, Symbol *saved);
+static void bind_parameters(FuncDefNode *def, const ValueType *params);
+static void copy_file(FILE *from);
+static FILE* generate_body(FunctionContext *ctx);
+static int generate_clone(UserFunction *function, const ValueType *params);
+static ExprResult generate_user_call(UserFunction *function, ASTNode *call, ExprResult *args);
+static int generate_loop_range(ForNode *loop, ExprResult *start, ExprResult *end);
+static void collect_symbols(ASTNode *node, Symbol ***symbols, size_t *count, size_t *capacity);
+static void generate_for(ASTNode *node);
+static void generate_parallel_for(ASTNode *node);
+static FILE* open_output(const char *path);
 static ExprResult generate_expression(ASTNode *node);
 static void generate_statement(ASTNode *node);
 
@@ -37,12 +166,13 @@ static void generate_statement(ASTNode *node);
 // Error Reporting Helper
 //------------------------------------------------------------------------------
 static void report_codegen_error(const char *format, ...) {
-    fprintf(stderr, "Semantic Error: ");
+    FILE *errors = error_file ? error_file : stderr;
+    fprintf(errors, "Semantic Error: ");
     va_list args;
     va_start(args, format);
-    vfprintf(stderr, format, args);
+    vfprintf(errors, format, args);
     va_end(args);
-    fprintf(stderr, "\n");
+    fprintf(errors, "\n");
     codegen_error_occurred = 1; // Set the flag
 }
 
@@ -61,40 +191,191 @@ static void emit(int indent_level, const char *format, ...) {
     fprintf(output_file, "\n"); // FIX: Use fprintf directly for newline
 }
 
+//------------------------------------------------------------------------------
+// Profile-Guided Optimisation
+// With --pgo-gen the generated program records a profile of its sites (nodes
+// numbered by number_profile_sites): the time of each top-level statement, how
+// often if and while conditions hold, the iterations and work of parallel for
+// loops, the sizes of assigned vectors and the calls of user functions. With
+// --pgo-use codegen reads it back and
+// - hints conditions that go one way at least PGO_BRANCH_PERCENT of the time
+//   (WZ_LIKELY / WZ_UNLIKELY);
+// - versions parallel for loops on their trip count: a run with less work
+//   than PGO_PARALLEL_MIN_NS, going by the profiled cost of an iteration, is
+//   one task (on the calling thread) instead of being handed out;
+// - inlines bodies of up to PGO_HOT_INLINE_STATEMENTS statements at calls
+//   made at least PGO_HOT_CALLS times, and nothing at calls never made;
+// - in a program split into parts, gives each statement taking at least
+//   1/PGO_HOT_SHARE of the time a part of its own (see Program Parts), so gcc
+//   optimises it apart from the code around it.
+//------------------------------------------------------------------------------
+#define PGO_BRANCH_PERCENT 90
+#define PGO_MIN_EVALUATIONS 16     // Conditions evaluated fewer times get no hint
+#define PGO_PARALLEL_MIN_NS 50000  // About what handing out tasks to the pool costs
+#define PGO_HOT_CALLS 1000
+#define PGO_HOT_INLINE_STATEMENTS 32
+#define PGO_HOT_SHARE 10
+
+static int split_program = 0;      // The statements fill more than one part (set by generate_code)
+static uint64_t profiled_ns = 0;   // Time of all top-level statements in the profile
+
+// Whether the program records what happens at 'node' (--pgo-gen)
+static int recording(const ASTNode *node) {
+    return profile_sites > 0 && node->site > 0;
+}
+
+// What the profile says about 'node' (--pgo-use), or NULL
+static const ProfileSite* profile_of(const ASTNode *node) {
+    return (profile && node->site > 0) ? &profile[node->site] : NULL;
+}
+
+// The C test that the scalar 'condition' of an if or while (node) holds,
+// counted (--pgo-gen) or with a branch hint (--pgo-use). Returns a new string.
+static char* condition_test(const ASTNode *node, const ExprResult *result) {
+    const char *condition = result->code;
+    const char *zero = (result->dtype == DTYPE_I64) ? "0" : "0.0"; // Integer conditions get an integer test
+    size_t size = strlen(condition) + 64;
+    char *test = (char*)malloc(size);
+    if (!test) { perror("malloc failed for condition"); exit(1); }
+    const ProfileSite *site = profile_of(node);
+    if (recording(node)) {
+        snprintf(test, size, "runtime_profile_branch(%d, (%s) != %s)", node->site, condition, zero);
+    } else if (site && site->count >= PGO_MIN_EVALUATIONS && site->taken * 100 >= site->count * PGO_BRANCH_PERCENT) {
+        snprintf(test, size, "WZ_LIKELY((%s) != %s)", condition, zero);
+    } else if (site && site->count >= PGO_MIN_EVALUATIONS && (site->count - site->taken) * 100 >= site->count * PGO_BRANCH_PERCENT) {
+        snprintf(test, size, "WZ_UNLIKELY((%s) != %s)", condition, zero);
+    } else {
+        snprintf(test, size, "(%s) != %s", condition, zero);
+    }
+    return test;
+}
+
+// Runs of a parallel for with fewer iterations than this are not worth
+// handing out (0: no profile of the loop, or every run is)
+static int64_t parallel_min_iterations(const ASTNode *loop) {
+    const ProfileSite *site = profile_of(loop);
+    if (!site || site->taken == 0) return 0;
+    double per_iteration = (double)site->work_ns / (double)site->taken;
+    double iterations = (per_iteration > 0) ? ceil(PGO_PARALLEL_MIN_NS / per_iteration) : (double)INT64_MAX;
+    if (iterations <= 1) return 0;
+    return (iterations >= (double)INT64_MAX) ? INT64_MAX : (int64_t)iterations;
+}
+
+// Whether a top-level statement gets a program part of its own
+static int isolated_statement(const ASTNode *statement) {
+    const ProfileSite *site = profile_of(statement);
+    return split_program && site && profiled_ns > 0 && site->ns * PGO_HOT_SHARE >= profiled_ns;
+}
+
 //------------------------------------------------------------------------------
 // Temporary Variable Name Helpers
 //------------------------------------------------------------------------------
-static char* new_temp_scalar_var() {
+static char* new_temp_var(const char *prefix, SymbolType type, DType dtype) {
+    if (temp_var_counter >= temp_infos_capacity) {
+        temp_infos_capacity = (temp_infos_capacity == 0) ? 32 : temp_infos_capacity * 2;
+        temp_infos = (TempInfo*)realloc(temp_infos, temp_infos_capacity * sizeof(TempInfo));
+        if (!temp_infos) { perror("realloc failed for temp infos"); exit(1); }
+    }
+    temp_infos[temp_var_counter].type = type;
+    temp_infos[temp_var_counter].dtype = dtype;
+    temp_infos[temp_var_counter].owner = current_owner;
     char buffer[16];
-    snprintf(buffer, sizeof(buffer), "_ts%d", temp_var_counter++);
-    return strdup(buffer);
+    snprintf(buffer, sizeof(buffer), "%s%d", prefix, temp_var_counter);
+    temp_infos[temp_var_counter].name = strdup(buffer);
+    return temp_infos[temp_var_counter++].name;
 }
 
-static char* new_temp_vector_var() {
-    char buffer[16];
-    snprintf(buffer, sizeof(buffer), "_tv%d", temp_var_counter++);
-    return strdup(buffer);
+// Forgets every temporary (once they are declared and freed in the output)
+static void release_temps(void) {
+    for (int i = 0; i < temp_var_counter; ++i) free(temp_infos[i].name);
+    temp_var_counter = 0;
+}
+
+static char* new_temp_scalar_var(DType dtype) {
+    return new_temp_var("_ts", SYMBOL_TYPE_SCALAR, dtype);
+}
+
+static char* new_temp_vector_var(DType dtype) {
+    return new_temp_var("_tv", SYMBOL_TYPE_VECTOR, dtype);
+}
+
+static char* new_temp_matrix_var() {
+    return new_temp_var("_tm", SYMBOL_TYPE_MATRIX, DTYPE_F64);
+}
+
+// Name of a type for error messages, e.g. "f32 vector"
+static const char* type_name(SymbolType type, DType dtype) {
+    static const char *vector_names[DTYPE_COUNT] = { "f64 vector", "f32 vector", "i64 vector" };
+    switch (type) {
+        case SYMBOL_TYPE_SCALAR: return "scalar";
+        case SYMBOL_TYPE_VECTOR: return vector_names[dtype];
+        case SYMBOL_TYPE_MATRIX: return "matrix";
+        case SYMBOL_TYPE_STRING: return "string";
+        default: return "undefined";
+    }
 }
 
 //------------------------------------------------------------------------------
-// Generate Runtime Helper Functions (Vector Ops, etc.)
+// Element-wise Kernel Emitters
+// Every element-wise helper has the same shape: allocate the result, then walk
+// the operands chunk by chunk (see VECTOR_STREAM) applying one C operator.
+// Each is emitted once per dtype it supports, named with the dtype's suffix.
+// With --openmp one parallel region (for large enough vectors) walks the
+// chunks, and each chunk is a worksharing simd loop; its implicit barrier
+// keeps the chunks in order for the streaming hints. Loops that can exit
+// (division by zero) are not marked simd.
+// The loops go through restrict, aligned pointers. The result is always a
+// buffer the kernel has just created, and buffers are never written once
+// they can be shared (assignment shares them, see vector_assign). So the
+// result cannot overlap an operand, and operands that are the same vector
+// (v + v) are only read. Every buffer is RUNTIME_BUFFER_ALIGNMENT aligned
+// (runtime_mem.h). gcc drops restrict on locals once the pointer reaches the
+// streaming hints, so the loop also says so directly (WZ_NO_ALIAS, or the
+// simd clause with --openmp) and vectorises without runtime overlap checks.
 //------------------------------------------------------------------------------
-static void generate_runtime_helpers() {
-    emit(0, "// --- Runtime Helper Functions ---");
-    // Vector Struct Definition
+static void emit_chunk_loop_begin(const char *operands[], int operand_count, int vectorizable) {
+    if (openmp) emit(1, "#pragma omp parallel if(result.size >= WZ_OMP_MIN_SIZE)");
+    emit(1, "for (size_t start = 0; start < result.size; start += VECTOR_CHUNK) {");
+    emit(2, "size_t end = (result.size - start > VECTOR_CHUNK) ? start + VECTOR_CHUNK : result.size;");
+    if (openmp) {
+        emit(2, "#pragma omp single nowait");
+        emit(2, "{");
+        for (int k = 0; k < operand_count; ++k) {
+            emit(3, "VECTOR_STREAM(%s, start, end);", operands[k]);
+        }
+        emit(2, "}");
+        emit(2, vectorizable ? "#pragma omp for simd schedule(static)" : "#pragma omp for schedule(static)");
+    } else {
+        for (int k = 0; k < operand_count; ++k) {
+            emit(2, "VECTOR_STREAM(%s, start, end);", operands[k]);
+        }
+        if (vectorizable) emit(2, "WZ_NO_ALIAS");
+    }
+    emit(2, "for (size_t i = start; i < end; ++i) {");
+}
+
+static void emit_chunk_loop_end() {
+    emit(2, "}");
+    emit(1, "}");
+}
+
+// Struct and memory helpers for one dtype
+static void emit_vector_basics(const DTypeInfo *info) {
+    const char *V = info->vector_type;
+    const char *S = info->suffix;
+    emit(0, "// --- %s vectors ---", info->name);
     emit(0, "typedef struct {");
-    emit(1, "double* data;");
+    emit(1, "%s* data;", info->elem_type);
     emit(1, "size_t size;");
-    emit(0, "} Vector;");
+    emit(0, "} %s;", V);
     emit(0, "");
     // Function to create/allocate a vector (simple version)
-    emit(0, "// Creates a vector (allocates data). Caller must free using vector_free.");
-    emit(0, "Vector vector_create(size_t size) {");
-    emit(1, "Vector v;");
+    emit(0, "// Creates a vector (allocates data). Caller must free using vector_free_data%s.", S);
+    emit(0, "static inline %s vector_create%s(size_t size) {", V, S);
+    emit(1, "%s v;", V);
     emit(1, "v.size = size;");
     emit(1, "if (size > 0) {");
-    emit(2, "v.data = (double*)malloc(size * sizeof(double));");
-    emit(2, "if (!v.data) { perror(\"vector_create malloc failed\"); exit(1); }");
+    emit(2, "v.data = (%s*)runtime_buffer_alloc(size * sizeof(%s));", info->elem_type, info->elem_type);
     emit(1, "} else {");
     emit(2, "v.data = NULL;");
     emit(1, "}");
@@ -102,106 +383,419 @@ static void generate_runtime_helpers() {
     emit(0, "}");
     emit(0, "");
     // Function to free vector data
-    emit(0, "// Frees the data array within a vector struct.");
-    emit(0, "void vector_free_data(Vector *v) {");
+    emit(0, "// Releases the data array within a vector struct (freed once no snapshot holds it).");
+    emit(0, "static inline void vector_free_data%s(%s *v) {", S, V);
     emit(1, "if (v && v->data) {");
-    emit(2, "free(v->data);");
+    emit(2, "runtime_buffer_release(v->data);");
     emit(2, "v->data = NULL;");
     emit(2, "v->size = 0;");
     emit(1, "}");
     emit(0, "}");
     emit(0, "");
-    // Function to assign/copy vector data (deep copy)
-    emit(0, "// Assigns vector src to dst (deep copy). Frees existing dst data.");
-    emit(0, "void vector_assign(Vector *dst, const Vector src) {");
-    emit(1, "vector_free_data(dst); // Free existing data in destination");
-    emit(1, "dst->size = src.size;");
-    emit(1, "if (src.size > 0 && src.data) {");
-    emit(2, "dst->data = (double*)malloc(src.size * sizeof(double));");
-    emit(2, "if (!dst->data) { perror(\"vector_assign malloc failed\"); exit(1); }");
-    emit(2, "memcpy(dst->data, src.data, src.size * sizeof(double));");
-    emit(1, "} else {");
-    emit(2, "dst->data = NULL;");
-    emit(1, "}");
+    // Function to assign vector data (buffers are immutable, so share instead of copying)
+    emit(0, "// Assigns vector src to dst by sharing its buffer. Releases existing dst data.");
+    emit(0, "static inline void vector_assign%s(%s *dst, const %s src) {", S, V, V);
+    emit(1, "runtime_buffer_retain(src.data); // Retain first: src and dst may share a buffer");
+    emit(1, "vector_free_data%s(dst);", S);
+    emit(1, "*dst = src;");
     emit(0, "}");
     emit(0, "");
-    // --- Vector Arithmetic --- (Element-wise)
-    // Vector Add
-    emit(0, "// Adds two vectors element-wise. Creates a new result vector.");
-    emit(0, "Vector vector_add(Vector v1, Vector v2) {");
-    emit(1, "if (v1.size != v2.size) { fprintf(stderr, \"Runtime Error: Vector size mismatch for add (%ld != %ld)\\n\", (long)v1.size, (long)v2.size); exit(1); }");
-    emit(1, "Vector result = vector_create(v1.size);");
-    emit(1, "for (size_t i = 0; i < result.size; ++i) {");
-    emit(2, "result.data[i] = v1.data[i] + v2.data[i];");
-    emit(2, "}");
+    // Function to store a freshly created vector (takes ownership, no extra reference)
+    emit(0, "// Stores a newly created vector in dst (takes ownership). Releases existing dst data.");
+    emit(0, "static inline void vector_set%s(%s *dst, %s src) {", S, V, V);
+    emit(1, "vector_free_data%s(dst);", S);
+    emit(1, "*dst = src;");
+    emit(0, "}");
+    emit(0, "");
+}
+
+// Vector (op) Vector -> new Vector. Division also checks for zero divisors.
+// i64 arithmetic wraps on overflow (done in uint64_t, where it is defined).
+static void emit_binary_vector_kernel(const DTypeInfo *info, const char *func_name, const char *op_name, char op, const char *comment) {
+    const char *operands[] = { "v1", "v2", "result" };
+    const char *V = info->vector_type;
+    emit(0, "// %s Creates a new result vector.", comment);
+    emit(0, "static inline %s %s%s(%s v1, %s v2) {", V, func_name, info->suffix, V, V);
+    emit(1, "if (v1.size != v2.size) { fprintf(stderr, \"Runtime Error: Vector size mismatch for %s (%%ld != %%ld)\\n\", (long)v1.size, (long)v2.size); exit(1); }", op_name);
+    emit(1, "%s result = vector_create%s(v1.size);", V, info->suffix);
+    emit(1, "const %s *restrict a = WZ_ASSUME_ALIGNED(v1.data);", info->elem_type);
+    emit(1, "const %s *restrict b = WZ_ASSUME_ALIGNED(v2.data);", info->elem_type);
+    emit(1, "%s *restrict out = WZ_ASSUME_ALIGNED(result.data);", info->elem_type);
+    emit_chunk_loop_begin(operands, 3, op != '/');
+    if (op == '/') {
+        emit(3, "if (b[i] == 0) { fprintf(stderr, \"Runtime Error: Division by zero in vector division at index %%ld\\n\", (long)i); exit(1); }");
+    }
+    if (strcmp(info->elem_type, "int64_t") == 0) {
+        emit(3, "out[i] = (int64_t)((uint64_t)a[i] %c (uint64_t)b[i]);", op);
+    } else {
+        emit(3, "out[i] = a[i] %c b[i];", op);
+    }
+    emit_chunk_loop_end();
     emit(1, "return result;");
     emit(0, "}");
     emit(0, "");
-    // Vector Subtract
-    emit(0, "// Subtracts v2 from v1 element-wise. Creates a new result vector.");
-    emit(0, "Vector vector_sub(Vector v1, Vector v2) {");
-    emit(1, "if (v1.size != v2.size) { fprintf(stderr, \"Runtime Error: Vector size mismatch for sub (%ld != %ld)\\n\", (long)v1.size, (long)v2.size); exit(1); }");
-    emit(1, "Vector result = vector_create(v1.size);");
-    emit(1, "for (size_t i = 0; i < result.size; ++i) {");
-    emit(2, "result.data[i] = v1.data[i] - v2.data[i];");
-    emit(2, "}");
+}
+
+// Vector (op) scalar -> new Vector (scalar broadcast to every element).
+// The scalar is converted to the element type first, so f32 stays f32.
+static void emit_scalar_vector_kernel(const DTypeInfo *info, const char *func_name, char op, const char *comment) {
+    const char *operands[] = { "v", "result" };
+    const char *V = info->vector_type;
+    emit(0, "// %s Creates new vector.", comment);
+    emit(0, "static inline %s %s%s(%s v, double s) {", V, func_name, info->suffix, V);
+    emit(1, "%s result = vector_create%s(v.size);", V, info->suffix);
+    emit(1, "const %s s_elem = (%s)s;", info->elem_type, info->elem_type);
+    emit(1, "const %s *restrict a = WZ_ASSUME_ALIGNED(v.data);", info->elem_type);
+    emit(1, "%s *restrict out = WZ_ASSUME_ALIGNED(result.data);", info->elem_type);
+    emit_chunk_loop_begin(operands, 2, 1);
+    emit(3, "out[i] = a[i] %c s_elem;", op);
+    emit_chunk_loop_end();
     emit(1, "return result;");
     emit(0, "}");
     emit(0, "");
-    // Vector Multiply (Element-wise)
-    emit(0, "// Multiplies two vectors element-wise. Creates a new result vector.");
-    emit(0, "Vector vector_mul(Vector v1, Vector v2) {");
-    emit(1, "if (v1.size != v2.size) { fprintf(stderr, \"Runtime Error: Vector size mismatch for mul (%ld != %ld)\\n\", (long)v1.size, (long)v2.size); exit(1); }");
-    emit(1, "Vector result = vector_create(v1.size);");
-    emit(1, "for (size_t i = 0; i < result.size; ++i) {");
-    emit(2, "result.data[i] = v1.data[i] * v2.data[i];");
-    emit(2, "}");
+}
+
+// Converts a vector to another dtype: vector_<from>_to_<to>. Floating point
+// to i64 truncates toward zero and saturates (NaN becomes 0).
+static void emit_conversion_kernel(const DTypeInfo *from, const DTypeInfo *to) {
+    const char *operands[] = { "v", "result" };
+    emit(0, "// Converts a %s vector to %s.", from->name, to->name);
+    emit(0, "static inline %s vector_%s_to_%s(%s v) {", to->vector_type, from->name, to->name, from->vector_type);
+    emit(1, "%s result = vector_create%s(v.size);", to->vector_type, to->suffix);
+    emit(1, "const %s *restrict a = WZ_ASSUME_ALIGNED(v.data);", from->elem_type);
+    emit(1, "%s *restrict out = WZ_ASSUME_ALIGNED(result.data);", to->elem_type);
+    emit_chunk_loop_begin(operands, 2, 1);
+    if (strcmp(to->elem_type, "int64_t") == 0) {
+        emit(3, "out[i] = i64_from_double((double)a[i]);");
+    } else {
+        emit(3, "out[i] = (%s)a[i];", to->elem_type);
+    }
+    emit_chunk_loop_end();
     emit(1, "return result;");
     emit(0, "}");
     emit(0, "");
-    // Vector Divide (Element-wise)
-    emit(0, "// Divides v1 by v2 element-wise. Creates a new result vector. Checks for division by zero.");
-    emit(0, "Vector vector_div(Vector v1, Vector v2) {");
-    emit(1, "if (v1.size != v2.size) { fprintf(stderr, \"Runtime Error: Vector size mismatch for div (%ld != %ld)\\n\", (long)v1.size, (long)v2.size); exit(1); }");
-    emit(1, "Vector result = vector_create(v1.size);");
-    emit(1, "for (size_t i = 0; i < result.size; ++i) {");
-    emit(2, "if (v2.data[i] == 0.0) { fprintf(stderr, \"Runtime Error: Division by zero in vector division at index %ld\\n\", (long)i); exit(1); }");
-    emit(2, "result.data[i] = v1.data[i] / v2.data[i];");
-    emit(2, "}");
+}
+
+// Built-ins that are only used as statements (no C value to discard)
+static int builtin_returns_void(const char *func_name) {
+    return strcmp(func_name, "scatter_plot") == 0 ||
+           strcmp(func_name, "print") == 0 ||
+           strcmp(func_name, "save_vector") == 0;
+}
+
+//------------------------------------------------------------------------------
+// Generate Runtime Helper Functions (Vector Ops, etc.)
+//------------------------------------------------------------------------------
+// The helpers are static inline so that each file of a split program (see
+// Program Parts) can include them
+static void generate_runtime_helpers() {
+    emit(0, "// --- Runtime Helper Functions ---");
+    // Streaming hint used by the chunked kernels below
+    emit(0, "// Element-wise kernels walk their operands in chunks of VECTOR_CHUNK elements.");
+    emit(0, "// For vectors spilled to disk (out-of-core mode) each chunk drops the pages");
+    emit(0, "// of the previous one and reads ahead the next; otherwise this is a no-op.");
+    emit(0, "#define VECTOR_CHUNK 65536");
+    emit(0, "#define VECTOR_STREAM(v, begin, end) runtime_buffer_stream((v).data, (begin) * sizeof(*(v).data), (end) * sizeof(*(v).data))");
+    emit(0, "// Vector data is RUNTIME_BUFFER_ALIGNMENT aligned (see runtime_mem.h).");
+    emit(0, "#if defined(__GNUC__)");
+    emit(0, "#define WZ_ASSUME_ALIGNED(p) __builtin_assume_aligned((p), RUNTIME_BUFFER_ALIGNMENT)");
+    emit(0, "#else");
+    emit(0, "#define WZ_ASSUME_ALIGNED(p) ((void *)(p))");
+    emit(0, "#endif");
+    emit(0, "// Marks a kernel loop whose output never overlaps its inputs.");
+    emit(0, "#if defined(__clang__)");
+    emit(0, "#define WZ_NO_ALIAS _Pragma(\"clang loop vectorize(assume_safety)\")");
+    emit(0, "#elif defined(__GNUC__)");
+    emit(0, "#define WZ_NO_ALIAS _Pragma(\"GCC ivdep\")");
+    emit(0, "#else");
+    emit(0, "#define WZ_NO_ALIAS");
+    emit(0, "#endif");
+    emit(0, "");
+    if (profile_sites > 0) {
+        emit(0, "// Generated with --pgo-gen: the program writes a profile (runtime_profile.h) when it exits.");
+        emit(0, "");
+    }
+    if (profile) {
+        emit(0, "// Generated with --pgo-use: branch hints from the profile.");
+        emit(0, "#if defined(__GNUC__)");
+        emit(0, "#define WZ_LIKELY(c) __builtin_expect(!!(c), 1)");
+        emit(0, "#define WZ_UNLIKELY(c) __builtin_expect(!!(c), 0)");
+        emit(0, "#else");
+        emit(0, "#define WZ_LIKELY(c) (c)");
+        emit(0, "#define WZ_UNLIKELY(c) (c)");
+        emit(0, "#endif");
+        emit(0, "");
+    }
+    if (openmp) {
+        emit(0, "// Generated with --openmp: the kernels and parallel for loops are OpenMP loops.");
+        emit(0, "// Kernels on fewer than WZ_OMP_MIN_SIZE elements run on one thread.");
+        emit(0, "#ifdef _OPENMP");
+        emit(0, "#include <omp.h>");
+        emit(0, "#define wz_omp_threads() ((size_t)omp_get_max_threads())");
+        emit(0, "#else");
+        emit(0, "#warning \"Generated with --openmp: compile with -fopenmp (make OPENMP=1) to run the loops in parallel\"");
+        emit(0, "#define wz_omp_threads() ((size_t)1)");
+        emit(0, "#endif");
+        emit(0, "#define WZ_OMP_MIN_SIZE 32768");
+        emit(0, "");
+    }
+    // Used by the conversions to i64
+    emit(0, "// Truncates toward zero, saturating out-of-range values; NaN becomes 0.");
+    emit(0, "static inline int64_t i64_from_double(double x) {");
+    emit(1, "if (isnan(x)) return 0;");
+    emit(1, "if (x >= 9223372036854775808.0) return INT64_MAX;");
+    emit(1, "if (x <= -9223372036854775808.0) return INT64_MIN;");
+    emit(1, "return (int64_t)x;");
+    emit(0, "}");
+    emit(0, "");
+    // Vector structs and memory helpers, one set per dtype
+    for (int d = 0; d < DTYPE_COUNT; ++d) {
+        emit_vector_basics(&dtype_info[d]);
+    }
+    // Function to build a vector from a C array (used for literals, always f64)
+    emit(0, "// Creates a vector holding a copy of a C array.");
+    emit(0, "static inline Vector vector_from_array(const double *values, size_t size) {");
+    emit(1, "Vector v = vector_create(size);");
+    emit(1, "if (size > 0) memcpy(v.data, values, size * sizeof(double));");
+    emit(1, "return v;");
+    emit(0, "}");
+    emit(0, "");
+    // --- Vector Arithmetic --- (Element-wise). i64 division promotes to f64 in codegen.
+    for (int d = 0; d < DTYPE_COUNT; ++d) {
+        const DTypeInfo *info = &dtype_info[d];
+        emit_binary_vector_kernel(info, "vector_add", "add", '+', "Adds two vectors element-wise.");
+        emit_binary_vector_kernel(info, "vector_sub", "sub", '-', "Subtracts v2 from v1 element-wise.");
+        emit_binary_vector_kernel(info, "vector_mul", "mul", '*', "Multiplies two vectors element-wise.");
+        if (d != DTYPE_I64) {
+            emit_binary_vector_kernel(info, "vector_div", "div", '/', "Divides v1 by v2 element-wise. Checks for division by zero.");
+        }
+    }
+    // --- Scalar-Vector Arithmetic --- (Broadcasting scalar). i64 vectors promote to f64.
+    emit_scalar_vector_kernel(&dtype_info[DTYPE_F64], "vector_add_scalar", '+', "Adds scalar to each element of a vector.");
+    emit_scalar_vector_kernel(&dtype_info[DTYPE_F32], "vector_add_scalar", '+', "Adds scalar to each element of a vector.");
+    // --- dtype Conversions --- (to_f64, to_f32, to_i64 and implicit promotion)
+    for (int from = 0; from < DTYPE_COUNT; ++from) {
+        for (int to = 0; to < DTYPE_COUNT; ++to) {
+            if (from != to) emit_conversion_kernel(&dtype_info[from], &dtype_info[to]);
+        }
+    }
+    // --- Scans --- (see runtime_scan.h)
+    emit(0, "// Inclusive running sum of v.");
+    emit(0, "static inline Vector vector_cumsum(Vector v) {");
+    emit(1, "Vector result;");
+    emit(1, "result.data = c_cumsum(v.data, v.size);");
+    emit(1, "result.size = v.size;");
+    emit(1, "return result;");
+    emit(0, "}");
+    emit(0, "");
+    emit(0, "// Inclusive running product of v.");
+    emit(0, "static inline Vector vector_cumprod(Vector v) {");
+    emit(1, "Vector result;");
+    emit(1, "result.data = c_cumprod(v.data, v.size);");
+    emit(1, "result.size = v.size;");
+    emit(1, "return result;");
+    emit(0, "}");
+    emit(0, "");
+    emit(0, "// Elements of v whose mask entry is non-zero, in order.");
+    emit(0, "static inline Vector vector_compact(Vector v, Vector mask) {");
+    emit(1, "Vector result;");
+    emit(1, "result.data = c_compact(v.data, v.size, mask.data, mask.size, &result.size);");
+    emit(1, "return result;");
+    emit(0, "}");
+    emit(0, "");
+    // --- Rolling Windows --- (see runtime_rolling.h)
+    emit(0, "// Applies one of the c_rolling_* functions to v.");
+    emit(0, "static inline Vector vector_rolling(double *(*rolling)(const double *, size_t, double), Vector v, double window) {");
+    emit(1, "Vector result;");
+    emit(1, "result.data = rolling(v.data, v.size, window);");
+    emit(1, "result.size = v.size;");
+    emit(1, "return result;");
+    emit(0, "}");
+    emit(0, "");
+    // --- Spectral --- (see runtime_fft.h). Spectra are interleaved (re, im) pairs.
+    emit(0, "// Spectrum of a real vector: bins 0 .. v.size/2.");
+    emit(0, "static inline Vector vector_fft(Vector v) {");
+    emit(1, "Vector result;");
+    emit(1, "result.data = c_fft(v.data, v.size, &result.size);");
+    emit(1, "return result;");
+    emit(0, "}");
+    emit(0, "");
+    emit(0, "// Real vector of the given length (negative: inferred) from its spectrum.");
+    emit(0, "static inline Vector vector_ifft(Vector spectrum, double length) {");
+    emit(1, "Vector result;");
+    emit(1, "result.data = c_ifft(spectrum.data, spectrum.size, length, &result.size);");
     emit(1, "return result;");
     emit(0, "}");
     emit(0, "");
-    // --- Scalar-Vector Arithmetic --- (Broadcasting scalar)
-    // Add Scalar to Vector
-    emit(0, "// Adds scalar to each element of a vector. Creates new vector.");
-    emit(0, "Vector vector_add_scalar(Vector v, double s) {");
-    emit(1, "Vector result = vector_create(v.size);");
-    emit(1, "for (size_t i = 0; i < result.size; ++i) {");
-    emit(2, "result.data[i] = v.data[i] + s;");
+    emit(0, "// Applies c_convolve or c_correlate to a and b.");
+    emit(0, "static inline Vector vector_convolve(double *(*convolve)(const double *, size_t, const double *, size_t, size_t *), Vector a, Vector b) {");
+    emit(1, "Vector result;");
+    emit(1, "result.data = convolve(a.data, a.size, b.data, b.size, &result.size);");
+    emit(1, "return result;");
+    emit(0, "}");
+    emit(0, "");
+    // --- Sorting --- (see runtime_sort.h)
+    emit(0, "// Elements of v in ascending order (NaNs last).");
+    emit(0, "static inline Vector vector_sort(Vector v) {");
+    emit(1, "Vector result;");
+    emit(1, "result.data = c_sort(v.data, v.size);");
+    emit(1, "result.size = v.size;");
+    emit(1, "return result;");
+    emit(0, "}");
+    emit(0, "");
+    emit(0, "// Zero-based indices that sort v (stable).");
+    emit(0, "static inline VectorI64 vector_argsort(Vector v) {");
+    emit(1, "VectorI64 result;");
+    emit(1, "result.data = c_argsort(v.data, v.size);");
+    emit(1, "result.size = v.size;");
+    emit(1, "return result;");
+    emit(0, "}");
+    emit(0, "");
+    // --- Matrices --- (see runtime_matrix.h). f64 only, row-major in one runtime
+    // buffer, so the elements can go through the vector kernels as they are.
+    emit(0, "// --- Matrices ---");
+    emit(0, "typedef struct {");
+    emit(1, "double* data;");
+    emit(1, "size_t rows;");
+    emit(1, "size_t cols;");
+    emit(0, "} Matrix;");
+    emit(0, "");
+    emit(0, "// Releases the data of a matrix (freed once nothing else shares it).");
+    emit(0, "static inline void matrix_free_data(Matrix *m) {");
+    emit(1, "if (m && m->data) runtime_buffer_release(m->data);");
+    emit(1, "m->data = NULL;");
+    emit(1, "m->rows = 0;");
+    emit(1, "m->cols = 0;");
+    emit(0, "}");
+    emit(0, "");
+    emit(0, "// Assigns matrix src to dst by sharing its buffer. Releases existing dst data.");
+    emit(0, "static inline void matrix_assign(Matrix *dst, const Matrix src) {");
+    emit(1, "runtime_buffer_retain(src.data); // Retain first: src and dst may share a buffer");
+    emit(1, "matrix_free_data(dst);");
+    emit(1, "*dst = src;");
+    emit(0, "}");
+    emit(0, "");
+    emit(0, "// Stores a newly created matrix in dst (takes ownership). Releases existing dst data.");
+    emit(0, "static inline void matrix_set(Matrix *dst, Matrix src) {");
+    emit(1, "matrix_free_data(dst);");
+    emit(1, "*dst = src;");
+    emit(0, "}");
+    emit(0, "");
+    emit(0, "// The elements of m as a vector (borrowed: no reference is taken).");
+    emit(0, "static inline Vector matrix_elements(Matrix m) {");
+    emit(1, "Vector v;");
+    emit(1, "v.data = m.data;");
+    emit(1, "v.size = m.rows * m.cols;");
+    emit(1, "return v;");
+    emit(0, "}");
+    emit(0, "");
+    emit(0, "// Makes a newly created vector of rows * cols elements into a matrix (takes ownership).");
+    emit(0, "static inline Matrix matrix_wrap(Vector v, size_t rows, size_t cols) {");
+    emit(1, "Matrix m;");
+    emit(1, "m.data = v.data;");
+    emit(1, "m.rows = rows;");
+    emit(1, "m.cols = cols;");
+    emit(1, "return m;");
+    emit(0, "}");
+    emit(0, "");
+    emit(0, "// matrix(v, rows, cols): v read row by row. Shares v's buffer, no copy.");
+    emit(0, "static inline Matrix matrix_from_vector(Vector v, double rows, double cols) {");
+    emit(1, "if (!(rows >= 0) || !(cols >= 0) || rows != floor(rows) || cols != floor(cols) || rows * cols != (double)v.size) {");
+    emit(2, "fprintf(stderr, \"Runtime Error: Cannot shape a vector of %%ld elements as a %%g x %%g matrix\\n\", (long)v.size, rows, cols);");
+    emit(2, "exit(1);");
     emit(1, "}");
+    emit(1, "Matrix m;");
+    emit(1, "m.data = (double*)runtime_buffer_retain(v.data);");
+    emit(1, "m.rows = (size_t)rows;");
+    emit(1, "m.cols = (size_t)cols;");
+    emit(1, "return m;");
+    emit(0, "}");
+    emit(0, "");
+    emit(0, "// Matrix (op) Matrix through one of the vector kernels (vector_add etc.) on the elements.");
+    emit(0, "static inline Matrix matrix_elementwise(Vector (*op)(Vector, Vector), const char *op_name, Matrix a, Matrix b) {");
+    emit(1, "if (a.rows != b.rows || a.cols != b.cols) {");
+    emit(2, "fprintf(stderr, \"Runtime Error: Matrix shape mismatch for %%s (%%ldx%%ld vs %%ldx%%ld)\\n\", op_name, (long)a.rows, (long)a.cols, (long)b.rows, (long)b.cols);");
+    emit(2, "exit(1);");
+    emit(1, "}");
+    emit(1, "return matrix_wrap(op(matrix_elements(a), matrix_elements(b)), a.rows, a.cols);");
+    emit(0, "}");
+    emit(0, "");
+    emit(0, "// Adds scalar to each element of a matrix.");
+    emit(0, "static inline Matrix matrix_add_scalar(Matrix m, double s) {");
+    emit(1, "return matrix_wrap(vector_add_scalar(matrix_elements(m), s), m.rows, m.cols);");
+    emit(0, "}");
+    emit(0, "");
+    emit(0, "// Matrix product a * b.");
+    emit(0, "static inline Matrix matrix_matmul(Matrix a, Matrix b) {");
+    emit(1, "Matrix result;");
+    emit(1, "result.data = c_matmul(a.data, a.rows, a.cols, b.data, b.rows, b.cols);");
+    emit(1, "result.rows = a.rows;");
+    emit(1, "result.cols = b.cols;");
+    emit(1, "return result;");
+    emit(0, "}");
+    emit(0, "");
+    emit(0, "// Matrix-vector product m * v.");
+    emit(0, "static inline Vector matrix_matvec(Matrix m, Vector v) {");
+    emit(1, "Vector result;");
+    emit(1, "result.data = c_matvec(m.data, m.rows, m.cols, v.data, v.size);");
+    emit(1, "result.size = m.rows;");
+    emit(1, "return result;");
+    emit(0, "}");
+    emit(0, "");
+    emit(0, "// Transpose of m.");
+    emit(0, "static inline Matrix matrix_transpose(Matrix m) {");
+    emit(1, "Matrix result;");
+    emit(1, "result.data = c_transpose(m.data, m.rows, m.cols);");
+    emit(1, "result.rows = m.cols;");
+    emit(1, "result.cols = m.rows;");
+    emit(1, "return result;");
+    emit(0, "}");
+    emit(0, "");
+    emit(0, "// Copy of row i (row) or column i (col) of m, as a vector.");
+    emit(0, "static inline Vector matrix_row(Matrix m, double i) {");
+    emit(1, "Vector result;");
+    emit(1, "result.data = c_matrix_row(m.data, m.rows, m.cols, i);");
+    emit(1, "result.size = m.cols;");
     emit(1, "return result;");
     emit(0, "}");
     emit(0, "");
+    emit(0, "static inline Vector matrix_col(Matrix m, double i) {");
+    emit(1, "Vector result;");
+    emit(1, "result.data = c_matrix_col(m.data, m.rows, m.cols, i);");
+    emit(1, "result.size = m.rows;");
+    emit(1, "return result;");
+    emit(0, "}");
+    emit(0, "");
+    emit(0, "// Prints a matrix one row per line.");
+    emit(0, "static inline void matrix_print(Matrix m) {");
+    emit(1, "for (size_t i = 0; i < m.rows; ++i) c_print_vector(m.data + i * m.cols, m.cols);");
+    emit(0, "}");
+    emit(0, "");
     // --- Runtime Data Reading ---
+    emit(0, "// Reads one column of a CSV file (see runtime_io.h). The file is parsed once.");
+    emit(0, "static inline Vector runtime_read_csv(const char *path, double column) {");
+    emit(1, "Vector v;");
+    emit(1, "v.data = c_read_csv_column(path, column, &v.size);");
+    emit(1, "return v;");
+    emit(0, "}");
+    emit(0, "");
     emit(0, "// Reads a vector (space-separated doubles) from stdin until newline.");
-    emit(0, "Vector runtime_read_vector() {");
+    emit(0, "static inline Vector runtime_read_vector() {");
     emit(1, "Vector v = vector_create(0); // Start with empty vector");
     emit(1, "double num;");
     emit(1, "size_t capacity = 0;");
-    emit(1, "printf(\"\">>> Enter vector elements separated by spaces, then press Enter:\\n\");"); // Prompt with escaped quote
+    emit(1, "printf(\">>> Enter vector elements separated by spaces, then press Enter:\\n\");");
     emit(1, "int status;");
-    emit(1, "while ((status = scanf(\"%%lf\", &num)) == 1) { // Escaped % in scanf format string");
+    emit(1, "while ((status = scanf(\"%%lf\", &num)) == 1) { // Escaped %% in scanf format string");
     emit(2, "// Resize buffer if needed (simple doubling strategy)");
     emit(2, "if (v.size >= capacity) {");
     emit(3, "capacity = (capacity == 0) ? 8 : capacity * 2;");
-    emit(3, "double* new_data = (double*)realloc(v.data, capacity * sizeof(double));");
-    emit(3, "if (!new_data) { perror(\"read_vector realloc failed\"); vector_free_data(&v); exit(1); }");
-    emit(3, "v.data = new_data;");
+    emit(3, "v.data = (double*)runtime_buffer_realloc(v.data, capacity * sizeof(double));");
     emit(2, "}");
     emit(2, "v.data[v.size++] = num;");
     emit(2, "// Stop reading on newline character");
-    emit(2, "char next_char = getchar();");
-    emit(2, "if (next_char == '\n' || next_char == EOF) { break; }");
+    emit(2, "int next_char = getchar();");
+    emit(2, "if (next_char == '\\n' || next_char == EOF) { break; }");
     emit(2, "ungetc(next_char, stdin); // Put back non-newline char");
     emit(1, "}");
     emit(1, "// Handle case where scanf failed before reading any number or after some numbers");
@@ -210,8 +804,8 @@ static void generate_runtime_helpers() {
     emit(1, "}");
     emit(1, "// Clear remaining input buffer until newline or EOF");
     emit(1, "int c;");
-    emit(1, "while ((c = getchar()) != '\n' && c != EOF);"); 
-    emit(1, "printf(\"\"<<< Read %ld elements.\\n\"\", (long)v.size); // Confirmation with escaped quotes");
+    emit(1, "while ((c = getchar()) != '\\n' && c != EOF);");
+    emit(1, "printf(\"<<< Read %%ld elements.\\n\", (long)v.size);");
     emit(1, "return v;");
     emit(0, "}");
     emit(0, "");
@@ -219,27 +813,115 @@ static void generate_runtime_helpers() {
     emit(0, "");
 }
 
+//------------------------------------------------------------------------------
+// Variable Versions
+// rename_variables gives each web of assignments to a name its own symbol, so
+// each can get its own type here. Versions that end up with the same type
+// share one C variable (their values are never live at the same time), which
+// keeps the buffer of a reassigned vector from outliving its last use.
+//------------------------------------------------------------------------------
+static Symbol* storage_of(Symbol *sym) {
+    return sym->storage ? sym->storage : sym;
+}
+
+// The C variable that holds the symbol's value
+static const char* var_name(Symbol *sym) {
+    return storage_of(sym)->name;
+}
+
+// The name in the source program, for messages
+static const char* source_name(Symbol *sym) {
+    return sym->base ? sym->base->name : sym->name;
+}
+
+// Sets the type of a variable at its first assignment (or use), and looks for
+// an earlier version of the same name with that type to share storage with.
+// Not inside parallel loop bodies, whose variables are copied per task.
+// Scalars are int64_t if infer_integers proved they only hold integers.
+static void fix_symbol_type(Symbol *sym, SymbolType type, DType dtype) {
+    if (type == SYMBOL_TYPE_SCALAR) dtype = sym->is_integer ? DTYPE_I64 : DTYPE_F64;
+    sym->type = type;
+    sym->dtype = dtype;
+    sym->type_known = 1;
+    sym->storage = NULL;
+    if (parallel_body_depth > 0) return;
+    Symbol *root = sym->base ? sym->base : sym;
+    Symbol *scope = current_function ? current_function->function->def->data.func_def.locals : symbol_get_list_head();
+    for (Symbol *other = scope; other != NULL; other = other->next) {
+        // Versions of other names may be being generated on another thread
+        if (other == sym || (other->base ? other->base : other) != root) continue;
+        if (other->storage || !other->type_known) continue;
+        if (other->type == type && (type == SYMBOL_TYPE_MATRIX || other->dtype == dtype)) {
+            sym->storage = other;
+            return;
+        }
+    }
+}
+
 //------------------------------------------------------------------------------
 // Generate Variable Declarations
 //------------------------------------------------------------------------------
+// Declares one variable, zero / empty (nothing if it was never used as a variable)
+static void declare_symbol(Symbol *sym) {
+    if (!sym->type_known) {
+        // Never used as a variable (e.g. a function name)
+    } else if (sym->storage) {
+        // Shares the C variable of another version
+    } else if (sym->type == SYMBOL_TYPE_SCALAR && sym->dtype == DTYPE_I64) {
+        emit(1, "int64_t %s = 0;", sym->name);
+    } else if (sym->type == SYMBOL_TYPE_SCALAR) {
+        emit(1, "double %s = 0.0;", sym->name);
+    } else if (sym->type == SYMBOL_TYPE_VECTOR) {
+        emit(1, "%s %s = { NULL, 0 };", dtype_info[sym->dtype].vector_type, sym->name);
+    } else if (sym->type == SYMBOL_TYPE_MATRIX) {
+        emit(1, "Matrix %s = { NULL, 0, 0 };", sym->name);
+    } else { // Should not happen
+         emit(1, "// WARNING: Undefined symbol type for %s", sym->name);
+    }
+}
+
+// Declares the temporaries of main (owner 0) or of one function clone
+static void declare_temps(int owner) {
+    for (int i = 0; i < temp_var_counter; ++i) {
+        if (temp_infos[i].owner != owner) continue;
+        if (temp_infos[i].type == SYMBOL_TYPE_VECTOR) {
+            emit(1, "%s _tv%d = { NULL, 0 };", dtype_info[temp_infos[i].dtype].vector_type, i);
+        } else if (temp_infos[i].type == SYMBOL_TYPE_MATRIX) {
+            emit(1, "Matrix _tm%d = { NULL, 0, 0 };", i);
+        } else if (temp_infos[i].dtype == DTYPE_I64) {
+            emit(1, "int64_t _ts%d;", i);
+        } else {
+            emit(1, "double _ts%d;", i);
+        }
+    }
+}
+
+// 'prefix' reaches the variable ("wz_main." for the context of a split program)
+static void free_symbol(Symbol *sym, const char *prefix) {
+    if (sym->storage) {
+        // Freed through the version that declares it
+    } else if (sym->type_known && sym->type == SYMBOL_TYPE_VECTOR) {
+        emit(1, "vector_free_data%s(&%s%s);", dtype_info[sym->dtype].suffix, prefix, sym->name);
+    } else if (sym->type_known && sym->type == SYMBOL_TYPE_MATRIX) {
+        emit(1, "matrix_free_data(&%s%s);", prefix, sym->name);
+    }
+}
+
+static void free_temps(int owner) {
+    for (int i = 0; i < temp_var_counter; ++i) {
+        if (temp_infos[i].owner != owner) continue;
+        if (temp_infos[i].type == SYMBOL_TYPE_VECTOR) {
+            emit(1, "vector_free_data%s(&_tv%d);", dtype_info[temp_infos[i].dtype].suffix, i);
+        } else if (temp_infos[i].type == SYMBOL_TYPE_MATRIX) {
+            emit(1, "matrix_free_data(&_tm%d);", i);
+        }
+    }
+}
+
 static void declare_variables() {
     emit(1, "// --- Variable Declarations ---");
-    Symbol *current = symbol_get_list_head();
-    while (current != NULL) {
-        if (current->type == SYMBOL_TYPE_SCALAR) {
-            emit(1, "double %s = 0.0;", current->name);
-        } else if (current->type == SYMBOL_TYPE_VECTOR) {
-            emit(1, "Vector %s = { NULL, 0 };", current->name);
-        } else { // Should not happen
-             emit(1, "// WARNING: Undefined symbol type for %s", current->name);
-        }
-        current = current->next;
-    }
-    // Declare temporary variables needed by generate_expression
-    emit(1, "// Temporary variables (up to %d scalar, %d vector)", 20, 20); // Added comment
-    for(int i = 0; i < 20; ++i) { // Increased number of temps
-       emit(1, "double _ts%d;", i);
-       emit(1, "Vector _tv%d = { NULL, 0 };", i);
+    for (Symbol *current = symbol_get_list_head(); current != NULL; current = current->next) {
+        declare_symbol(current);
     }
     emit(1, "// ---------------------------");
     emit(0, ""); // Add newline after declarations
@@ -248,30 +930,112 @@ static void declare_variables() {
 //------------------------------------------------------------------------------
 // Generate Cleanup Code (Freeing Vectors)
 //------------------------------------------------------------------------------
-static void generate_cleanup_code() {
+static void generate_cleanup_code(const char *prefix) {
      emit(1, "// --- Cleanup Code ---");
-     Symbol *current = symbol_get_list_head();
-     while (current != NULL) {
-         if (current->type == SYMBOL_TYPE_VECTOR) {
-             emit(1, "vector_free_data(&%s);", current->name);
-         }
-         current = current->next;
-     }
-     // Free temporary vectors (Approximate - better tracking needed)
-     for(int i = 0; i < temp_var_counter; ++i) { 
-          emit(1, "vector_free_data(&_tv%d);", i);
+     emit(1, "c_plot_flush(); // Wait for queued plots to finish rendering");
+     emit(1, "c_csv_cache_clear();");
+     for (Symbol *current = symbol_get_list_head(); current != NULL; current = current->next) {
+         free_symbol(current, prefix);
      }
      emit(1, "// --------------------");
      emit(0, "");
 }
 
+//------------------------------------------------------------------------------
+// dtype Promotion Helper
+// Converts a vector expression result to dtype 'to' through a new temporary
+// (no-op for scalars and vectors that already have that dtype).
+//------------------------------------------------------------------------------
+static void convert_vector_result(ExprResult *res, DType to) {
+    if (res->type != SYMBOL_TYPE_VECTOR || res->dtype == to) return;
+    char* temp_vector_var = new_temp_vector_var(to);
+    emit(1, "vector_set%s(&%s, vector_%s_to_%s(%s));", dtype_info[to].suffix, temp_vector_var,
+         dtype_info[res->dtype].name, dtype_info[to].name, res->code);
+    if (res->is_temporary) free(res->code);
+    res->code = temp_vector_var;
+    res->dtype = to;
+    res->is_temporary = 0; // It's a declared temp variable
+}
+
+//------------------------------------------------------------------------------
+// Matrix Shape Tracking
+// Shapes are followed in program order so mismatches can be reported at
+// compile time (the generated helpers check again at run time). Code that may
+// run any number of times (if branches, loop bodies) makes the shapes of the
+// variables it assigns unknown, both inside it and after it.
+//------------------------------------------------------------------------------
+static void forget_assigned_shapes(ASTNode *node) {
+    if (!node) return;
+    switch (node->type) {
+        case NODE_TYPE_ASSIGNMENT:
+            node->data.assignment.target_symbol->rows = 0;
+            node->data.assignment.target_symbol->cols = 0;
+            break;
+        case NODE_TYPE_STATEMENT_LIST:
+            for (size_t i = 0; i < node->data.statement_list.count; ++i) {
+                forget_assigned_shapes(node->data.statement_list.items[i]);
+            }
+            break;
+        case NODE_TYPE_IF:
+            forget_assigned_shapes(node->data.if_stmt.if_branch);
+            forget_assigned_shapes(node->data.if_stmt.else_branch);
+            break;
+        case NODE_TYPE_WHILE:
+            forget_assigned_shapes(node->data.while_loop.loop_body);
+            break;
+        case NODE_TYPE_FOR:
+            forget_assigned_shapes(node->data.for_loop.loop_body);
+            break;
+        default:
+            break;
+    }
+}
+
+// Number of elements of a vector literal (dense or not), or -1 for other nodes
+static long literal_length(ASTNode *node) {
+    if (node->type == NODE_TYPE_VECTOR) return (long)node->data.vector_elements.count;
+    if (node->type == NODE_TYPE_DENSE_VECTOR) return (long)node->data.dense_vector.count;
+    return -1;
+}
+
+// Writes the elements of a dense vector literal as C initializers, 8 per line
+static void emit_number_array(const double *values, size_t count) {
+    char line[8 * 32];
+    size_t length = 0;
+    for (size_t i = 0; i < count; ++i) {
+        char *out = line + length;
+        if (isinf(values[i])) { // Too many digits for a double
+            length += (size_t)sprintf(out, "%sINFINITY", values[i] < 0 ? "-" : "");
+        } else if (values[i] == 0.0 && signbit(values[i])) {
+            length += (size_t)sprintf(out, "-0.0");
+        } else {
+            length += runtime_format_number(out, values[i]);
+        }
+        if (i + 1 < count) line[length++] = ',';
+        if ((i + 1) % 8 == 0 || i + 1 == count) {
+            line[length] = '\0';
+            emit(2, "%s", line);
+            length = 0;
+        } else {
+            line[length++] = ' ';
+        }
+    }
+}
+
+// Literal matrix dimension (a non-negative integer number node), or 0
+static size_t literal_dimension(ASTNode *node) {
+    if (node->type != NODE_TYPE_NUMBER) return 0;
+    double value = node->data.number_value;
+    return (value >= 1.0 && value == (double)(size_t)value) ? (size_t)value : 0;
+}
+
 //------------------------------------------------------------------------------
 // Generate C code for an Expression Node
 // Returns: An ExprResult struct containing C code and type information.
 //          The 'code' field must be freed by the caller if is_temporary is true!
 //------------------------------------------------------------------------------
 static ExprResult generate_expression(ASTNode *node) {
-    ExprResult result = {strdup("0.0"), SYMBOL_TYPE_SCALAR, 1}; // Default to scalar 0, mark as temp
+    ExprResult result = {NULL, SYMBOL_TYPE_SCALAR, DTYPE_F64, 0, 0, 0}; // Scalar 0 unless a case sets the code
     char static_buffer[256]; 
 
     if (!node) {
@@ -287,62 +1051,124 @@ static ExprResult generate_expression(ASTNode *node) {
 
     switch (node->type) {
         case NODE_TYPE_NUMBER:
-            snprintf(static_buffer, sizeof(static_buffer), "%f", node->data.number_value);
+            if (node->is_integer) { // Exact integer (see infer_integers)
+                snprintf(static_buffer, sizeof(static_buffer), "%.0f", node->data.number_value);
+                result.dtype = DTYPE_I64;
+            } else {
+                snprintf(static_buffer, sizeof(static_buffer), "%f", node->data.number_value);
+            }
             result.code = strdup(static_buffer);
             result.type = SYMBOL_TYPE_SCALAR;
             result.is_temporary = 1; // Literal code needs freeing by caller
             break;
 
+        case NODE_TYPE_STRING: {
+            // Emit as a C string literal; the lexer already excludes quotes and newlines
+            const char *text = node->data.string_value;
+            char *literal = (char*)malloc(2 * strlen(text) + 3);
+            if (!literal) { perror("malloc failed for string literal"); exit(1); }
+            char *out = literal;
+            *out++ = '"';
+            for (; *text; ++text) {
+                if (*text == '\\') *out++ = '\\';
+                *out++ = *text;
+            }
+            *out++ = '"';
+            *out = '\0';
+            result.code = literal;
+            result.type = SYMBOL_TYPE_STRING;
+            result.is_temporary = 1;
+            break;
+        }
+
         case NODE_TYPE_IDENTIFIER:
             assert(node->data.identifier_symbol != NULL); 
-            result.code = strdup(node->data.identifier_symbol->name);
+            if (!node->data.identifier_symbol->type_known) { // Used before assignment: stays scalar 0.0
+                fix_symbol_type(node->data.identifier_symbol, SYMBOL_TYPE_SCALAR, DTYPE_F64);
+            }
+            result.code = strdup(var_name(node->data.identifier_symbol));
             result.type = node->data.identifier_symbol->type; // Get type from symbol table
+            result.dtype = node->data.identifier_symbol->dtype;
+            result.rows = node->data.identifier_symbol->rows;
+            result.cols = node->data.identifier_symbol->cols;
             result.is_temporary = 1; // Variable name code needs freeing
             break;
 
         case NODE_TYPE_VECTOR: { 
-            char* temp_vec_var_name = new_temp_vector_var();
+            char* temp_vec_var_name = new_temp_vector_var(DTYPE_F64);
             size_t count = node->data.vector_elements.count;
             char temp_array_name[64];
             snprintf(temp_array_name, sizeof(temp_array_name), "%s_init_data", temp_vec_var_name);
 
+            // Elements first: computing one (e.g. a negation) emits statements
+            ExprResult *elements = (ExprResult*)malloc((count ? count : 1) * sizeof(ExprResult));
+            if (!elements) { perror("malloc failed for vector literal"); exit(1); }
+            for (size_t i = 0; i < count; ++i) {
+                 elements[i] = generate_expression(node->data.vector_elements.items[i]);
+            }
             emit(1, "// Generating vector literal for %s", temp_vec_var_name);
             emit(1, "double %s[] = {", temp_array_name);
             for (size_t i = 0; i < count; ++i) {
                  // Assume elements are scalar for now
-                 ExprResult elem_res = generate_expression(node->data.vector_elements.items[i]);
-                 if(elem_res.type != SYMBOL_TYPE_SCALAR) {
+                 if(elements[i].type != SYMBOL_TYPE_SCALAR) {
                      emit(2, "/* WARNING: Non-scalar in vector literal */ 0.0%s", (i == count - 1) ? "" : ",");
                  } else {
-                     emit(2, "%s%s", elem_res.code, (i == count - 1) ? "" : ",");
+                     emit(2, "%s%s", elements[i].code, (i == count - 1) ? "" : ",");
                  }
-                 if(elem_res.is_temporary) free(elem_res.code);
+                 if(elements[i].is_temporary) free(elements[i].code);
             }
+            free(elements);
             emit(1, "};");
-            emit(1, "vector_assign(&%s, (Vector){ %s, %ld });", temp_vec_var_name, temp_array_name, count);
+            emit(1, "vector_set(&%s, vector_from_array(%s, %ld));", temp_vec_var_name, temp_array_name, (long)count);
 
-            result.code = strdup(temp_vec_var_name);
+            result.code = temp_vec_var_name;
             result.type = SYMBOL_TYPE_VECTOR;
             result.is_temporary = 0; // It's a declared temp variable, not just code fragment
             break;
         }
 
+        case NODE_TYPE_DENSE_VECTOR: { // Constant data, copied into a new buffer on each evaluation
+            char* temp_vec_var_name = new_temp_vector_var(DTYPE_F64);
+            size_t count = node->data.dense_vector.count;
+            emit(1, "// Generating vector literal for %s (%ld numbers)", temp_vec_var_name, (long)count);
+            emit(1, "static const double %s_init_data[] = {", temp_vec_var_name);
+            emit_number_array(node->data.dense_vector.values, count);
+            emit(1, "};");
+            emit(1, "vector_set(&%s, vector_from_array(%s_init_data, %ld));", temp_vec_var_name, temp_vec_var_name, (long)count);
+            result.code = temp_vec_var_name;
+            result.type = SYMBOL_TYPE_VECTOR;
+            result.is_temporary = 0;
+            break;
+        }
+
         case NODE_TYPE_BINARY_OP: {
             left_res = generate_expression(node->data.binary_op.left);
             right_res = generate_expression(node->data.binary_op.right);
 
             // Type checking and operation dispatch
             if (left_res.type == SYMBOL_TYPE_SCALAR && right_res.type == SYMBOL_TYPE_SCALAR) {
-                char* temp_scalar_var = new_temp_scalar_var();
-                emit(1, "%s = (%s) %c (%s);", 
-                     temp_scalar_var, left_res.code, node->data.binary_op.op, right_res.code);
-                result.code = strdup(temp_scalar_var);
+                // int64_t arithmetic where infer_integers proved the result exact;
+                // otherwise double (int64_t operands are converted, so '/' is true division)
+                int both_integer = left_res.dtype == DTYPE_I64 && right_res.dtype == DTYPE_I64;
+                DType dtype = (both_integer && node->is_integer) ? DTYPE_I64 : DTYPE_F64;
+                char* temp_scalar_var = new_temp_scalar_var(dtype);
+                emit(1, "%s = %s(%s) %c (%s);", temp_scalar_var, (both_integer && dtype == DTYPE_F64) ? "(double)" : "",
+                     left_res.code, node->data.binary_op.op, right_res.code);
+                result.code = temp_scalar_var;
                 result.type = SYMBOL_TYPE_SCALAR;
+                result.dtype = dtype;
                 result.is_temporary = 0; // It's a declared temp variable
             }
             // Vector + Vector
             else if (left_res.type == SYMBOL_TYPE_VECTOR && right_res.type == SYMBOL_TYPE_VECTOR) {
-                 char* temp_vector_var = new_temp_vector_var();
+                 // Promotion: equal dtypes are kept, mixed dtypes widen to f64,
+                 // and i64 division is true division (f64)
+                 DType dtype = (left_res.dtype == right_res.dtype) ? left_res.dtype : DTYPE_F64;
+                 if (dtype == DTYPE_I64 && node->data.binary_op.op == '/') dtype = DTYPE_F64;
+                 convert_vector_result(&left_res, dtype);
+                 convert_vector_result(&right_res, dtype);
+                 const char* suffix = dtype_info[dtype].suffix;
+                 char* temp_vector_var = new_temp_vector_var(dtype);
                  const char* op_func = "";
                  switch(node->data.binary_op.op) {
                      case '+': op_func = "vector_add"; break;
@@ -352,9 +1178,10 @@ static ExprResult generate_expression(ASTNode *node) {
                      default: emit(1, "// ERROR: Unsupported vector binary op '%c'", node->data.binary_op.op); break;
                  }
                  if (strlen(op_func) > 0) {
-                    emit(1, "%s = %s(%s, %s);", temp_vector_var, op_func, left_res.code, right_res.code);
-                    result.code = strdup(temp_vector_var);
+                    emit(1, "vector_set%s(&%s, %s%s(%s, %s));", suffix, temp_vector_var, op_func, suffix, left_res.code, right_res.code);
+                    result.code = temp_vector_var;
                     result.type = SYMBOL_TYPE_VECTOR;
+                    result.dtype = dtype;
                     result.is_temporary = 0; // It's a declared temp variable
                  } else {
                     result.code = strdup("/* Invalid vector op */");
@@ -364,37 +1191,76 @@ static ExprResult generate_expression(ASTNode *node) {
             }
             // Vector + Scalar (Example - only handling add for now)
             else if (left_res.type == SYMBOL_TYPE_VECTOR && right_res.type == SYMBOL_TYPE_SCALAR && node->data.binary_op.op == '+') {
-                char* temp_vector_var = new_temp_vector_var();
-                emit(1, "%s = vector_add_scalar(%s, %s);", temp_vector_var, left_res.code, right_res.code);
-                result.code = strdup(temp_vector_var);
+                if (left_res.dtype == DTYPE_I64) convert_vector_result(&left_res, DTYPE_F64); // Scalars are f64
+                const char* suffix = dtype_info[left_res.dtype].suffix;
+                char* temp_vector_var = new_temp_vector_var(left_res.dtype);
+                emit(1, "vector_set%s(&%s, vector_add_scalar%s(%s, %s));", suffix, temp_vector_var, suffix, left_res.code, right_res.code);
+                result.code = temp_vector_var;
                 result.type = SYMBOL_TYPE_VECTOR;
+                result.dtype = left_res.dtype;
                 result.is_temporary = 0;
             }
              // Scalar + Vector (Example - only handling add for now)
             else if (left_res.type == SYMBOL_TYPE_SCALAR && right_res.type == SYMBOL_TYPE_VECTOR && node->data.binary_op.op == '+') {
-                 char* temp_vector_var = new_temp_vector_var();
+                 if (right_res.dtype == DTYPE_I64) convert_vector_result(&right_res, DTYPE_F64); // Scalars are f64
+                 const char* suffix = dtype_info[right_res.dtype].suffix;
+                 char* temp_vector_var = new_temp_vector_var(right_res.dtype);
                  // Assuming vector_add_scalar is commutative for addition, reuse it
-                 emit(1, "%s = vector_add_scalar(%s, %s);", temp_vector_var, right_res.code, left_res.code);
-                 result.code = strdup(temp_vector_var);
+                 emit(1, "vector_set%s(&%s, vector_add_scalar%s(%s, %s));", suffix, temp_vector_var, suffix, right_res.code, left_res.code);
+                 result.code = temp_vector_var;
                  result.type = SYMBOL_TYPE_VECTOR;
+                 result.dtype = right_res.dtype;
                  result.is_temporary = 0;
             }
+            // Matrix (op) Matrix, element-wise through the vector kernels
+            else if (left_res.type == SYMBOL_TYPE_MATRIX && right_res.type == SYMBOL_TYPE_MATRIX) {
+                const char* op_func = NULL;
+                switch (node->data.binary_op.op) {
+                    case '+': op_func = "vector_add"; break;
+                    case '-': op_func = "vector_sub"; break;
+                    case '*': op_func = "vector_mul"; break;
+                    case '/': op_func = "vector_div"; break;
+                    default: break;
+                }
+                if ((left_res.rows && right_res.rows && left_res.rows != right_res.rows) ||
+                    (left_res.cols && right_res.cols && left_res.cols != right_res.cols)) {
+                    report_codegen_error("Matrix shape mismatch for '%c' (%ldx%ld vs %ldx%ld).", node->data.binary_op.op,
+                        (long)left_res.rows, (long)left_res.cols, (long)right_res.rows, (long)right_res.cols);
+                } else if (!op_func) {
+                    report_codegen_error("Unsupported matrix binary operation '%c'.", node->data.binary_op.op);
+                } else {
+                    char* temp_matrix_var = new_temp_matrix_var();
+                    emit(1, "matrix_set(&%s, matrix_elementwise(%s, \"%s\", %s, %s));",
+                         temp_matrix_var, op_func, op_func + 7, left_res.code, right_res.code);
+                    result.code = temp_matrix_var;
+                    result.type = SYMBOL_TYPE_MATRIX;
+                    result.rows = left_res.rows ? left_res.rows : right_res.rows;
+                    result.cols = left_res.cols ? left_res.cols : right_res.cols;
+                    result.is_temporary = 0;
+                }
+            }
+            // Matrix + Scalar / Scalar + Matrix ('+' only, as for vectors)
+            else if (node->data.binary_op.op == '+' &&
+                     ((left_res.type == SYMBOL_TYPE_MATRIX && right_res.type == SYMBOL_TYPE_SCALAR) ||
+                      (left_res.type == SYMBOL_TYPE_SCALAR && right_res.type == SYMBOL_TYPE_MATRIX))) {
+                ExprResult *matrix_res = (left_res.type == SYMBOL_TYPE_MATRIX) ? &left_res : &right_res;
+                ExprResult *scalar_res = (left_res.type == SYMBOL_TYPE_MATRIX) ? &right_res : &left_res;
+                char* temp_matrix_var = new_temp_matrix_var();
+                emit(1, "matrix_set(&%s, matrix_add_scalar(%s, %s));", temp_matrix_var, matrix_res->code, scalar_res->code);
+                result.code = temp_matrix_var;
+                result.type = SYMBOL_TYPE_MATRIX;
+                result.rows = matrix_res->rows;
+                result.cols = matrix_res->cols;
+                result.is_temporary = 0;
+            }
             else if ( (left_res.type == SYMBOL_TYPE_VECTOR && right_res.type == SYMBOL_TYPE_SCALAR) || 
                       (left_res.type == SYMBOL_TYPE_SCALAR && right_res.type == SYMBOL_TYPE_VECTOR) ) {
-                 // Scalar-Vector Operations (Example: Addition only)
-                 if (node->data.binary_op.op == '+') {
-                     char* temp_vector_var = new_temp_vector_var();
-                     emit(1, "%s = vector_add_scalar(%s, %s);", temp_vector_var, left_res.code, right_res.code);
-                     result.code = strdup(temp_vector_var);
-                     result.type = SYMBOL_TYPE_VECTOR;
-                     result.is_temporary = 0;
-                 } else {
-                     report_codegen_error("Unsupported binary operation '%c' between scalar and vector.", node->data.binary_op.op);
-                     // result is already default error value
-                 }
+                 // Scalar-Vector Operations ('+' is handled above)
+                 report_codegen_error("Unsupported binary operation '%c' between scalar and vector.", node->data.binary_op.op);
+                 // result is already default error value
             } else {
-                report_codegen_error("Type mismatch for binary operation '%c' (LHS: %d, RHS: %d).", 
-                    node->data.binary_op.op, left_res.type, right_res.type);
+                report_codegen_error("Type mismatch for binary operation '%c' (LHS: %s, RHS: %s).", 
+                    node->data.binary_op.op, type_name(left_res.type, left_res.dtype), type_name(right_res.type, right_res.dtype));
                 // result is already default error value
             }
 
@@ -408,11 +1274,13 @@ static ExprResult generate_expression(ASTNode *node) {
             left_res = generate_expression(node->data.unary_op.operand);
             // Assuming scalar negation for now
             if (left_res.type == SYMBOL_TYPE_SCALAR && node->data.unary_op.op == '-') {
-                 char* temp_scalar_var = new_temp_scalar_var();
-                 emit(1, "%s = %c(%s);", 
-                      temp_scalar_var, node->data.unary_op.op, left_res.code);
-                 result.code = strdup(temp_scalar_var);
+                 DType dtype = (left_res.dtype == DTYPE_I64 && node->is_integer) ? DTYPE_I64 : DTYPE_F64;
+                 char* temp_scalar_var = new_temp_scalar_var(dtype);
+                 emit(1, "%s = %c%s(%s);", temp_scalar_var, node->data.unary_op.op,
+                      (left_res.dtype == DTYPE_I64 && dtype == DTYPE_F64) ? "(double)" : "", left_res.code);
+                 result.code = temp_scalar_var;
                  result.type = SYMBOL_TYPE_SCALAR;
+                 result.dtype = dtype;
                  result.is_temporary = 0;
             } else {
                 report_codegen_error("Unsupported unary operation '%c' or type mismatch (Type: %d).", 
@@ -435,9 +1303,9 @@ static ExprResult generate_expression(ASTNode *node) {
             // Handle built-in/special functions first
             if (strcmp(func_name, "read_vector") == 0) {
                 if (arg_count == 0) {
-                    char* temp_vector_var = new_temp_vector_var();
-                    emit(1, "%s = runtime_read_vector();", temp_vector_var);
-                    result.code = strdup(temp_vector_var);
+                    char* temp_vector_var = new_temp_vector_var(DTYPE_F64);
+                    emit(1, "vector_set(&%s, runtime_read_vector());", temp_vector_var);
+                    result.code = temp_vector_var;
                     result.type = SYMBOL_TYPE_VECTOR;
                     result.is_temporary = 0; // It's a declared temp variable
                 } else {
@@ -459,12 +1327,17 @@ static ExprResult generate_expression(ASTNode *node) {
                 arg_results[i] = generate_expression(node->data.func_call.arguments.items[i]);
             }
             
-            // 2. Handle specific known functions (like scatter_plot)
-            if (strcmp(func_name, "scatter_plot") == 0) {
+            // 2. Handle functions defined with 'def' (these hide built-ins of the same name),
+            //    then specific known functions (like scatter_plot)
+            UserFunction *user_function = find_user_function(func_name);
+            if (user_function) {
+                result = generate_user_call(user_function, node, arg_results);
+            } else if (strcmp(func_name, "scatter_plot") == 0) {
                 if (arg_count == 2 && 
                     arg_results[0].type == SYMBOL_TYPE_VECTOR && 
                     arg_results[1].type == SYMBOL_TYPE_VECTOR) {
-                    
+                    convert_vector_result(&arg_results[0], DTYPE_F64); // The runtime plots doubles
+                    convert_vector_result(&arg_results[1], DTYPE_F64);
                     emit(1, "c_scatter_plot(%s.data, %s.size, %s.data, %s.size);", 
                          arg_results[0].code, arg_results[0].code, 
                          arg_results[1].code, arg_results[1].code);
@@ -478,33 +1351,360 @@ static ExprResult generate_expression(ASTNode *node) {
                     result.type = SYMBOL_TYPE_SCALAR;
                     result.is_temporary = 1;
                 }
-            } 
-            // Handle generic/other external functions (assuming scalar return)
-            else {
-                // Build C argument string
-                size_t arg_str_capacity = arg_count * 25 + 5; 
-                char* arg_str = (char*)malloc(arg_str_capacity);
-                if (!arg_str) { perror("malloc failed for arg string"); exit(1); }
-                arg_str[0] = '\0'; 
-                for (size_t i = 0; i < arg_count; ++i) {
-                    if (i > 0) { strncat(arg_str, ", ", arg_str_capacity - strlen(arg_str) - 1); }
-                    if (arg_results[i].type == SYMBOL_TYPE_VECTOR) {
-                        char vec_arg_part[128];
-                        snprintf(vec_arg_part, sizeof(vec_arg_part), "%s.data, %s.size", 
-                                 arg_results[i].code, arg_results[i].code);
-                        strncat(arg_str, vec_arg_part, arg_str_capacity - strlen(arg_str) - 1);
-                    } else {
-                        strncat(arg_str, arg_results[i].code, arg_str_capacity - strlen(arg_str) - 1);
+            } else if (strcmp(func_name, "read_csv") == 0) {
+                if (arg_count == 2 &&
+                    arg_results[0].type == SYMBOL_TYPE_STRING &&
+                    arg_results[1].type == SYMBOL_TYPE_SCALAR) {
+                    char* temp_vector_var = new_temp_vector_var(DTYPE_F64);
+                    emit(1, "vector_set(&%s, runtime_read_csv(%s, %s));",
+                         temp_vector_var, arg_results[0].code, arg_results[1].code);
+                    result.code = temp_vector_var;
+                    result.type = SYMBOL_TYPE_VECTOR;
+                    result.is_temporary = 0; // It's a declared temp variable
+                } else {
+                    report_codegen_error("read_csv() expects a file name string and a column index.");
+                    result.code = strdup("/* invalid read_csv call */");
+                    result.type = SYMBOL_TYPE_VECTOR;
+                    result.is_temporary = 1;
+                }
+            } else if (strcmp(func_name, "cumsum") == 0 || strcmp(func_name, "cumprod") == 0) {
+                if (arg_count == 1 && arg_results[0].type == SYMBOL_TYPE_VECTOR) {
+                    convert_vector_result(&arg_results[0], DTYPE_F64); // Scans run on doubles
+                    char* temp_vector_var = new_temp_vector_var(DTYPE_F64);
+                    emit(1, "vector_set(&%s, vector_%s(%s));", temp_vector_var, func_name, arg_results[0].code);
+                    result.code = temp_vector_var;
+                    result.type = SYMBOL_TYPE_VECTOR;
+                    result.is_temporary = 0; // It's a declared temp variable
+                } else {
+                    report_codegen_error("%s() expects 1 vector argument.", func_name);
+                    result.code = strdup("/* invalid scan call */");
+                    result.type = SYMBOL_TYPE_VECTOR;
+                    result.is_temporary = 1;
+                }
+            } else if (strcmp(func_name, "quantile") == 0 || strcmp(func_name, "quantile_approx") == 0 ||
+                       strcmp(func_name, "median") == 0) {
+                int is_median = (strcmp(func_name, "median") == 0);
+                if (arg_count == (is_median ? 1u : 2u) &&
+                    arg_results[0].type == SYMBOL_TYPE_VECTOR &&
+                    (is_median || arg_results[1].type == SYMBOL_TYPE_SCALAR)) {
+                    convert_vector_result(&arg_results[0], DTYPE_F64);
+                    char* temp_scalar_var = new_temp_scalar_var(DTYPE_F64);
+                    emit(1, "%s = c_%s(%s.data, %s.size, %s);", temp_scalar_var,
+                         is_median ? "quantile" : func_name, arg_results[0].code, arg_results[0].code,
+                         is_median ? "0.5" : arg_results[1].code);
+                    result.code = temp_scalar_var;
+                    result.type = SYMBOL_TYPE_SCALAR;
+                    result.is_temporary = 0; // It's a declared temp variable
+                } else {
+                    report_codegen_error(is_median ? "median() expects 1 vector argument."
+                                                   : "%s() expects a vector and a scalar quantile.", func_name);
+                    result.code = strdup("/* invalid quantile call */ 0.0");
+                    result.type = SYMBOL_TYPE_SCALAR;
+                    result.is_temporary = 1;
+                }
+            } else if (strncmp(func_name, "rolling_", 8) == 0 &&
+                       (strcmp(func_name + 8, "sum") == 0 || strcmp(func_name + 8, "mean") == 0 ||
+                        strcmp(func_name + 8, "std") == 0 || strcmp(func_name + 8, "min") == 0 ||
+                        strcmp(func_name + 8, "max") == 0)) {
+                if (arg_count == 2 &&
+                    arg_results[0].type == SYMBOL_TYPE_VECTOR &&
+                    arg_results[1].type == SYMBOL_TYPE_SCALAR) {
+                    convert_vector_result(&arg_results[0], DTYPE_F64);
+                    char* temp_vector_var = new_temp_vector_var(DTYPE_F64);
+                    emit(1, "vector_set(&%s, vector_rolling(c_%s, %s, %s));",
+                         temp_vector_var, func_name, arg_results[0].code, arg_results[1].code);
+                    result.code = temp_vector_var;
+                    result.type = SYMBOL_TYPE_VECTOR;
+                    result.is_temporary = 0; // It's a declared temp variable
+                } else {
+                    report_codegen_error("%s() expects a vector and a window size.", func_name);
+                    result.code = strdup("/* invalid rolling call */");
+                    result.type = SYMBOL_TYPE_VECTOR;
+                    result.is_temporary = 1;
+                }
+            } else if (strcmp(func_name, "fft") == 0 || strcmp(func_name, "ifft") == 0) {
+                int is_inverse = (strcmp(func_name, "ifft") == 0);
+                if (arg_count >= 1 && arg_results[0].type == SYMBOL_TYPE_VECTOR &&
+                    (arg_count == 1 || (is_inverse && arg_count == 2 && arg_results[1].type == SYMBOL_TYPE_SCALAR))) {
+                    convert_vector_result(&arg_results[0], DTYPE_F64);
+                    char* temp_vector_var = new_temp_vector_var(DTYPE_F64);
+                    if (is_inverse) {
+                        emit(1, "vector_set(&%s, vector_ifft(%s, %s));", temp_vector_var, arg_results[0].code,
+                             arg_count == 2 ? arg_results[1].code : "-1.0");
+                    } else {
+                        emit(1, "vector_set(&%s, vector_fft(%s));", temp_vector_var, arg_results[0].code);
+                    }
+                    result.code = temp_vector_var;
+                    result.type = SYMBOL_TYPE_VECTOR;
+                    result.is_temporary = 0; // It's a declared temp variable
+                } else {
+                    report_codegen_error(is_inverse ? "ifft() expects a spectrum vector and an optional length."
+                                                    : "fft() expects 1 vector argument.");
+                    result.code = strdup("/* invalid fft call */");
+                    result.type = SYMBOL_TYPE_VECTOR;
+                    result.is_temporary = 1;
+                }
+            } else if (strcmp(func_name, "convolve") == 0 || strcmp(func_name, "correlate") == 0) {
+                if (arg_count == 2 &&
+                    arg_results[0].type == SYMBOL_TYPE_VECTOR &&
+                    arg_results[1].type == SYMBOL_TYPE_VECTOR) {
+                    convert_vector_result(&arg_results[0], DTYPE_F64);
+                    convert_vector_result(&arg_results[1], DTYPE_F64);
+                    char* temp_vector_var = new_temp_vector_var(DTYPE_F64);
+                    emit(1, "vector_set(&%s, vector_convolve(c_%s, %s, %s));",
+                         temp_vector_var, func_name, arg_results[0].code, arg_results[1].code);
+                    result.code = temp_vector_var;
+                    result.type = SYMBOL_TYPE_VECTOR;
+                    result.is_temporary = 0; // It's a declared temp variable
+                } else {
+                    report_codegen_error("%s() expects 2 vector arguments.", func_name);
+                    result.code = strdup("/* invalid convolve call */");
+                    result.type = SYMBOL_TYPE_VECTOR;
+                    result.is_temporary = 1;
+                }
+            } else if (strcmp(func_name, "sort") == 0 || strcmp(func_name, "argsort") == 0) {
+                // sort keeps values as f64; argsort returns i64 indices
+                DType dtype = (strcmp(func_name, "sort") == 0) ? DTYPE_F64 : DTYPE_I64;
+                if (arg_count == 1 && arg_results[0].type == SYMBOL_TYPE_VECTOR) {
+                    convert_vector_result(&arg_results[0], DTYPE_F64);
+                    char* temp_vector_var = new_temp_vector_var(dtype);
+                    emit(1, "vector_set%s(&%s, vector_%s(%s));", dtype_info[dtype].suffix,
+                         temp_vector_var, func_name, arg_results[0].code);
+                    result.code = temp_vector_var;
+                    result.type = SYMBOL_TYPE_VECTOR;
+                    result.dtype = dtype;
+                    result.is_temporary = 0; // It's a declared temp variable
+                } else {
+                    report_codegen_error("%s() expects 1 vector argument.", func_name);
+                    result.code = strdup("/* invalid sort call */");
+                    result.type = SYMBOL_TYPE_VECTOR;
+                    result.dtype = dtype;
+                    result.is_temporary = 1;
+                }
+            } else if (strcmp(func_name, "compact") == 0) {
+                if (arg_count == 2 &&
+                    arg_results[0].type == SYMBOL_TYPE_VECTOR &&
+                    arg_results[1].type == SYMBOL_TYPE_VECTOR) {
+                    convert_vector_result(&arg_results[0], DTYPE_F64);
+                    convert_vector_result(&arg_results[1], DTYPE_F64);
+                    char* temp_vector_var = new_temp_vector_var(DTYPE_F64);
+                    emit(1, "vector_set(&%s, vector_compact(%s, %s));",
+                         temp_vector_var, arg_results[0].code, arg_results[1].code);
+                    result.code = temp_vector_var;
+                    result.type = SYMBOL_TYPE_VECTOR;
+                    result.is_temporary = 0; // It's a declared temp variable
+                } else {
+                    report_codegen_error("compact() expects a vector and a mask vector.");
+                    result.code = strdup("/* invalid compact call */");
+                    result.type = SYMBOL_TYPE_VECTOR;
+                    result.is_temporary = 1;
+                }
+            } else if (strcmp(func_name, "matrix") == 0) {
+                if (arg_count == 3 &&
+                    arg_results[0].type == SYMBOL_TYPE_VECTOR &&
+                    arg_results[1].type == SYMBOL_TYPE_SCALAR &&
+                    arg_results[2].type == SYMBOL_TYPE_SCALAR) {
+                    ASTNode **args = node->data.func_call.arguments.items;
+                    size_t rows = literal_dimension(args[1]);
+                    size_t cols = literal_dimension(args[2]);
+                    long length = literal_length(args[0]);
+                    if (rows && cols && length >= 0 && (size_t)length != rows * cols) {
+                        report_codegen_error("matrix(): cannot shape %ld elements as a %ldx%ld matrix.",
+                            length, (long)rows, (long)cols);
+                    }
+                    convert_vector_result(&arg_results[0], DTYPE_F64);
+                    char* temp_matrix_var = new_temp_matrix_var();
+                    emit(1, "matrix_set(&%s, matrix_from_vector(%s, %s, %s));", temp_matrix_var,
+                         arg_results[0].code, arg_results[1].code, arg_results[2].code);
+                    result.code = temp_matrix_var;
+                    result.type = SYMBOL_TYPE_MATRIX;
+                    result.rows = rows;
+                    result.cols = cols;
+                    result.is_temporary = 0; // It's a declared temp variable
+                } else {
+                    report_codegen_error("matrix() expects a vector, a row count and a column count.");
+                    result.code = strdup("/* invalid matrix call */");
+                    result.type = SYMBOL_TYPE_MATRIX;
+                    result.is_temporary = 1;
+                }
+            } else if (strcmp(func_name, "rows") == 0 || strcmp(func_name, "cols") == 0) {
+                if (arg_count == 1 && arg_results[0].type == SYMBOL_TYPE_MATRIX) {
+                    char* temp_scalar_var = new_temp_scalar_var(DTYPE_F64);
+                    emit(1, "%s = (double)%s.%s;", temp_scalar_var, arg_results[0].code, func_name);
+                    result.code = temp_scalar_var;
+                    result.type = SYMBOL_TYPE_SCALAR;
+                    result.is_temporary = 0; // It's a declared temp variable
+                } else {
+                    report_codegen_error("%s() expects 1 matrix argument.", func_name);
+                    result.code = strdup("/* invalid shape call */ 0.0");
+                    result.type = SYMBOL_TYPE_SCALAR;
+                    result.is_temporary = 1;
+                }
+            } else if (strcmp(func_name, "row") == 0 || strcmp(func_name, "col") == 0) {
+                if (arg_count == 2 &&
+                    arg_results[0].type == SYMBOL_TYPE_MATRIX &&
+                    arg_results[1].type == SYMBOL_TYPE_SCALAR) {
+                    char* temp_vector_var = new_temp_vector_var(DTYPE_F64);
+                    emit(1, "vector_set(&%s, matrix_%s(%s, %s));", temp_vector_var, func_name,
+                         arg_results[0].code, arg_results[1].code);
+                    result.code = temp_vector_var;
+                    result.type = SYMBOL_TYPE_VECTOR;
+                    result.is_temporary = 0; // It's a declared temp variable
+                } else {
+                    report_codegen_error("%s() expects a matrix and an index.", func_name);
+                    result.code = strdup("/* invalid row/col call */");
+                    result.type = SYMBOL_TYPE_VECTOR;
+                    result.is_temporary = 1;
+                }
+            } else if (strcmp(func_name, "transpose") == 0) {
+                if (arg_count == 1 && arg_results[0].type == SYMBOL_TYPE_MATRIX) {
+                    char* temp_matrix_var = new_temp_matrix_var();
+                    emit(1, "matrix_set(&%s, matrix_transpose(%s));", temp_matrix_var, arg_results[0].code);
+                    result.code = temp_matrix_var;
+                    result.type = SYMBOL_TYPE_MATRIX;
+                    result.rows = arg_results[0].cols;
+                    result.cols = arg_results[0].rows;
+                    result.is_temporary = 0; // It's a declared temp variable
+                } else {
+                    report_codegen_error("transpose() expects 1 matrix argument.");
+                    result.code = strdup("/* invalid transpose call */");
+                    result.type = SYMBOL_TYPE_MATRIX;
+                    result.is_temporary = 1;
+                }
+            } else if (strcmp(func_name, "matmul") == 0) {
+                if (arg_count == 2 &&
+                    arg_results[0].type == SYMBOL_TYPE_MATRIX &&
+                    arg_results[1].type == SYMBOL_TYPE_MATRIX) {
+                    if (arg_results[0].cols && arg_results[1].rows && arg_results[0].cols != arg_results[1].rows) {
+                        report_codegen_error("matmul() shape mismatch (%ldx%ld times %ldx%ld).",
+                            (long)arg_results[0].rows, (long)arg_results[0].cols,
+                            (long)arg_results[1].rows, (long)arg_results[1].cols);
+                    }
+                    char* temp_matrix_var = new_temp_matrix_var();
+                    emit(1, "matrix_set(&%s, matrix_matmul(%s, %s));", temp_matrix_var,
+                         arg_results[0].code, arg_results[1].code);
+                    result.code = temp_matrix_var;
+                    result.type = SYMBOL_TYPE_MATRIX;
+                    result.rows = arg_results[0].rows;
+                    result.cols = arg_results[1].cols;
+                    result.is_temporary = 0; // It's a declared temp variable
+                } else {
+                    report_codegen_error("matmul() expects 2 matrix arguments.");
+                    result.code = strdup("/* invalid matmul call */");
+                    result.type = SYMBOL_TYPE_MATRIX;
+                    result.is_temporary = 1;
+                }
+            } else if (strcmp(func_name, "matvec") == 0) {
+                if (arg_count == 2 &&
+                    arg_results[0].type == SYMBOL_TYPE_MATRIX &&
+                    arg_results[1].type == SYMBOL_TYPE_VECTOR) {
+                    ASTNode *vector_arg = node->data.func_call.arguments.items[1];
+                    long length = literal_length(vector_arg);
+                    if (arg_results[0].cols && length >= 0 && (size_t)length != arg_results[0].cols) {
+                        report_codegen_error("matvec() shape mismatch (%ld columns, vector of %ld).",
+                            (long)arg_results[0].cols, length);
+                    }
+                    convert_vector_result(&arg_results[1], DTYPE_F64);
+                    char* temp_vector_var = new_temp_vector_var(DTYPE_F64);
+                    emit(1, "vector_set(&%s, matrix_matvec(%s, %s));", temp_vector_var,
+                         arg_results[0].code, arg_results[1].code);
+                    result.code = temp_vector_var;
+                    result.type = SYMBOL_TYPE_VECTOR;
+                    result.is_temporary = 0; // It's a declared temp variable
+                } else {
+                    report_codegen_error("matvec() expects a matrix and a vector.");
+                    result.code = strdup("/* invalid matvec call */");
+                    result.type = SYMBOL_TYPE_VECTOR;
+                    result.is_temporary = 1;
+                }
+            } else if (strcmp(func_name, "print") == 0) {
+                if (arg_count == 1 && arg_results[0].type == SYMBOL_TYPE_SCALAR) {
+                    emit(1, "c_print_scalar(%s);", arg_results[0].code);
+                } else if (arg_count == 1 && arg_results[0].type == SYMBOL_TYPE_MATRIX) {
+                    emit(1, "matrix_print(%s);", arg_results[0].code);
+                } else if (arg_count == 1 && arg_results[0].type == SYMBOL_TYPE_VECTOR) {
+                    convert_vector_result(&arg_results[0], DTYPE_F64);
+                    emit(1, "c_print_vector(%s.data, %s.size);", arg_results[0].code, arg_results[0].code);
+                } else if (arg_count == 1 && arg_results[0].type == SYMBOL_TYPE_STRING) {
+                    emit(1, "c_print_string(%s);", arg_results[0].code);
+                } else {
+                    report_codegen_error("print() expects 1 argument.");
+                }
+                result.code = strdup("/* print call */");
+                result.type = SYMBOL_TYPE_SCALAR;
+                result.is_temporary = 1;
+            } else if (strcmp(func_name, "save_vector") == 0) {
+                if (arg_count == 2 &&
+                    arg_results[0].type == SYMBOL_TYPE_VECTOR &&
+                    arg_results[1].type == SYMBOL_TYPE_STRING) {
+                    // Binary files keep the vector's dtype; text is written from doubles
+                    const char* path = node->data.func_call.arguments.items[1]->data.string_value;
+                    size_t path_length = strlen(path);
+                    int as_text = path_length >= 4 && (strcmp(path + path_length - 4, ".txt") == 0 ||
+                                                       strcmp(path + path_length - 4, ".csv") == 0);
+                    if (arg_results[0].dtype == DTYPE_F64 || as_text) {
+                        convert_vector_result(&arg_results[0], DTYPE_F64);
+                        emit(1, "c_save_vector(%s.data, %s.size, %s);",
+                             arg_results[0].code, arg_results[0].code, arg_results[1].code);
+                    } else {
+                        emit(1, "c_save_binary(%s.data, %s.size, sizeof(%s), %s);",
+                             arg_results[0].code, arg_results[0].code,
+                             dtype_info[arg_results[0].dtype].elem_type, arg_results[1].code);
+                    }
+                } else {
+                    report_codegen_error("save_vector() expects a vector and a file name string.");
+                }
+                result.code = strdup("/* save_vector call */");
+                result.type = SYMBOL_TYPE_SCALAR;
+                result.is_temporary = 1;
+            } else if (strcmp(func_name, "to_f64") == 0 || strcmp(func_name, "to_f32") == 0 ||
+                       strcmp(func_name, "to_i64") == 0) {
+                DType dtype = DTYPE_F64;
+                for (int d = 0; d < DTYPE_COUNT; ++d) {
+                    if (strcmp(func_name + 3, dtype_info[d].name) == 0) dtype = (DType)d;
+                }
+                if (arg_count == 1 && arg_results[0].type == SYMBOL_TYPE_VECTOR) {
+                    convert_vector_result(&arg_results[0], dtype);
+                    // Hand the (possibly unchanged) argument over as the result
+                    result.code = arg_results[0].is_temporary ? arg_results[0].code : strdup(arg_results[0].code);
+                    result.type = SYMBOL_TYPE_VECTOR;
+                    result.dtype = dtype;
+                    result.is_temporary = 1;
+                    arg_results[0].is_temporary = 0; // Ownership moved to result
+                } else {
+                    report_codegen_error("%s() expects 1 vector argument.", func_name);
+                    result.code = strdup("/* invalid conversion call */");
+                    result.type = SYMBOL_TYPE_VECTOR;
+                    result.dtype = dtype;
+                    result.is_temporary = 1;
+                }
+            }
+            // Handle generic/other external functions (assuming scalar return)
+            else {
+                // Build C argument string
+                size_t arg_str_capacity = arg_count * 25 + 5; 
+                char* arg_str = (char*)malloc(arg_str_capacity);
+                if (!arg_str) { perror("malloc failed for arg string"); exit(1); }
+                arg_str[0] = '\0'; 
+                for (size_t i = 0; i < arg_count; ++i) {
+                    if (i > 0) { strncat(arg_str, ", ", arg_str_capacity - strlen(arg_str) - 1); }
+                    if (arg_results[i].type == SYMBOL_TYPE_VECTOR) {
+                        char vec_arg_part[128];
+                        snprintf(vec_arg_part, sizeof(vec_arg_part), "%s.data, %s.size", 
+                                 arg_results[i].code, arg_results[i].code);
+                        strncat(arg_str, vec_arg_part, arg_str_capacity - strlen(arg_str) - 1);
+                    } else {
+                        strncat(arg_str, arg_results[i].code, arg_str_capacity - strlen(arg_str) - 1);
                     }
                 }
 
                 // Assume scalar return, store in temp
-                char* temp_scalar_var = new_temp_scalar_var();
+                char* temp_scalar_var = new_temp_scalar_var(DTYPE_F64);
                 emit(1, "%s = %s(%s); // Generic function call result", 
                      temp_scalar_var, func_name, arg_str);
                 free(arg_str); // Free the built C argument string
 
-                result.code = strdup(temp_scalar_var);
+                result.code = temp_scalar_var;
                 result.type = SYMBOL_TYPE_SCALAR; 
                 result.is_temporary = 0; // It's a declared temp variable
             }
@@ -527,6 +1727,10 @@ static ExprResult generate_expression(ASTNode *node) {
             result.is_temporary = 1;
             break;
     }
+    if (!result.code) { // Error paths leave the default value
+        result.code = strdup("0.0");
+        result.is_temporary = 1;
+    }
     return result;
 }
 
@@ -553,7 +1757,7 @@ static void generate_statement(ASTNode *node) {
         case NODE_TYPE_ASSIGNMENT: {
             assert(node->data.assignment.target_symbol != NULL);
             Symbol* target_sym = node->data.assignment.target_symbol;
-            const char* target_var = target_sym->name;
+            const char* target_var = var_name(target_sym);
             
             emit(1, "// Assignment to %s (Type: %d)", target_var, target_sym->type);
             expr_res = generate_expression(node->data.assignment.expression);
@@ -563,17 +1767,32 @@ static void generate_statement(ASTNode *node) {
             }
             emit(1, "// RHS Type: %d", expr_res.type);
 
-            // Type checking and assignment
+            // The first assignment (or use) of a variable version fixes its type and dtype
+            if (!target_sym->type_known) {
+                fix_symbol_type(target_sym, expr_res.type, expr_res.dtype);
+                target_var = var_name(target_sym);
+            }
+
+            // Type checking and assignment (dtypes must match; convert with to_f32() etc.)
             if (!((target_sym->type == SYMBOL_TYPE_SCALAR && expr_res.type == SYMBOL_TYPE_SCALAR) || 
-                  (target_sym->type == SYMBOL_TYPE_VECTOR && expr_res.type == SYMBOL_TYPE_VECTOR))) {
-                report_codegen_error("Type mismatch in assignment to '%s' (Target: %d, RHS: %d)", 
-                    target_var, target_sym->type, expr_res.type);
+                  (target_sym->type == SYMBOL_TYPE_VECTOR && expr_res.type == SYMBOL_TYPE_VECTOR &&
+                   target_sym->dtype == expr_res.dtype) ||
+                  (target_sym->type == SYMBOL_TYPE_MATRIX && expr_res.type == SYMBOL_TYPE_MATRIX))) {
+                report_codegen_error("Type mismatch in assignment to '%s' (Target: %s, RHS: %s)", 
+                    source_name(target_sym), type_name(target_sym->type, target_sym->dtype), type_name(expr_res.type, expr_res.dtype));
             } else {
                 // Emit the actual assignment
-                if (target_sym->type == SYMBOL_TYPE_SCALAR) {
+                if (target_sym->type == SYMBOL_TYPE_SCALAR && target_sym->dtype == DTYPE_I64 && expr_res.dtype != DTYPE_I64) {
+                    emit(1, "%s = (int64_t)(%s);", target_var, expr_res.code); // An integer value (see infer_integers)
+                } else if (target_sym->type == SYMBOL_TYPE_SCALAR) {
                     emit(1, "%s = %s;", target_var, expr_res.code);
+                } else if (target_sym->type == SYMBOL_TYPE_MATRIX) {
+                    emit(1, "matrix_assign(&%s, %s);", target_var, expr_res.code);
+                    target_sym->rows = expr_res.rows;
+                    target_sym->cols = expr_res.cols;
                 } else {
-                    emit(1, "vector_assign(&%s, %s);", target_var, expr_res.code);
+                    emit(1, "vector_assign%s(&%s, %s);", dtype_info[target_sym->dtype].suffix, target_var, expr_res.code);
+                    if (recording(node)) emit(1, "runtime_profile_size(%d, %s.size);", node->site, target_var);
                      // If RHS was a temporary vector result, it might need freeing *after* assign
                      // This requires more careful temporary management than currently implemented.
                      // emit(1, "// vector_free_data(&%s); // Potentially free RHS temp if needed", expr_res.code);
@@ -589,15 +1808,17 @@ static void generate_statement(ASTNode *node) {
 
         // Handle standalone expressions/calls (value discarded)
         case NODE_TYPE_NUMBER:     
+        case NODE_TYPE_STRING:
         case NODE_TYPE_IDENTIFIER: 
         case NODE_TYPE_VECTOR:     
+        case NODE_TYPE_DENSE_VECTOR:
         case NODE_TYPE_BINARY_OP:  
         case NODE_TYPE_UNARY_OP:   
         case NODE_TYPE_FUNC_CALL:  // generate_expression handles the call
             emit(1, "// Expression/Call statement (value discarded)");
             expr_res = generate_expression(node); 
             // No need to cast void for specific calls like scatter_plot if handled in generate_expression
-            if (node->type != NODE_TYPE_FUNC_CALL || strcmp(node->data.func_call.function_symbol->name, "scatter_plot") != 0) {
+            if (node->type != NODE_TYPE_FUNC_CALL || !builtin_returns_void(node->data.func_call.function_symbol->name)) {
                  emit(1, "(void)(%s); // Discard result", expr_res.code);
             }
             // Cleanup temporary result code if needed
@@ -612,6 +1833,7 @@ static void generate_statement(ASTNode *node) {
 
         case NODE_TYPE_IF: {
             emit(1, "// If statement");
+            forget_assigned_shapes(node);
             // Generate condition code
             expr_res = generate_expression(node->data.if_stmt.condition);
             if (codegen_error_occurred) {
@@ -622,14 +1844,17 @@ static void generate_statement(ASTNode *node) {
                 report_codegen_error("Non-scalar condition used for IF statement.");
                 emit(1, "if (0) { // Type error in condition");
             } else {
-                // Check scalar result against 0.0 for truthiness
-                emit(1, "if ((%s) != 0.0) {", expr_res.code);
+                // Check scalar result against 0 for truthiness
+                char *test = condition_test(node, &expr_res);
+                emit(1, "if (%s) {", test);
+                free(test);
             }
             if (expr_res.is_temporary) free(expr_res.code);
 
             // Generate "then" branch (should be a statement list / block)
             generate_statement(node->data.if_stmt.if_branch); 
             emit(1, "}"); // Close "then" block
+            forget_assigned_shapes(node); // The else branch doesn't see the then branch's assignments
 
             // Generate optional "else" branch
             if (node->data.if_stmt.else_branch) {
@@ -637,42 +1862,108 @@ static void generate_statement(ASTNode *node) {
                 generate_statement(node->data.if_stmt.else_branch);
                 emit(1, "}"); // Close "else" block
             }
+            forget_assigned_shapes(node);
             break;
         }
 
         case NODE_TYPE_WHILE: {
              emit(1, "// While loop");
-             // Generate condition code
+             forget_assigned_shapes(node);
+             // The condition may need statements of its own (temporaries), so it
+             // is generated inside the loop and re-evaluated on every iteration
+             emit(1, "while (1) {");
              expr_res = generate_expression(node->data.while_loop.condition);
               if (codegen_error_occurred) {
-                 emit(1, "while (0) { // Type error in condition");
+                 if (expr_res.is_temporary) free(expr_res.code);
+                 emit(1, "} // Type error in condition");
                  break;
              }
              if (expr_res.type != SYMBOL_TYPE_SCALAR) {
                  report_codegen_error("Non-scalar condition used for WHILE statement.");
-                 emit(1, "while (0) { // Type error in condition");
+                 emit(1, "break; // Type error in condition");
              } else {
-                 // Check scalar result against 0.0 for truthiness
-                 emit(1, "while ((%s) != 0.0) {", expr_res.code);
+                 // Check scalar result against 0 for truthiness
+                 char *test = condition_test(node, &expr_res);
+                 emit(1, "if (!(%s)) break;", test);
+                 free(test);
              }
-             // Note: We don't free expr_res.code here because it's used inside the loop!
-             // If it refers to a temporary variable, that variable needs to be available
-             // and potentially recalculated in each iteration. This simple codegen 
-             // doesn't handle that complexity well. A better approach would re-evaluate
-             // the condition *inside* the generated C loop if it involves temps.
-             // For now, we assume the condition code refers to variables or literals 
-             // that are valid throughout the loop.
-             // if (expr_res.is_temporary) free(expr_res.code); // DON'T FREE YET
+             if (expr_res.is_temporary) free(expr_res.code);
 
             // Generate loop body (should be a statement list / block)
              generate_statement(node->data.while_loop.loop_body);
              emit(1, "} // End while");
-
-             // If the condition involved temporary C code that needs freeing, it's complex.
-             // We leak it for now in this simple version if is_temporary was true.
+             forget_assigned_shapes(node);
              break;
         }
 
+        case NODE_TYPE_FOR:
+            if (node->data.for_loop.is_parallel) {
+                generate_parallel_for(node);
+            } else {
+                generate_for(node);
+            }
+            break;
+
+        case NODE_TYPE_FUNC_DEF: // Compiled where it is called (see generate_user_call)
+            emit(1, "// Function %s() defined", node->data.func_def.function_symbol->name);
+            break;
+
+        case NODE_TYPE_RETURN: {
+            FunctionContext *ctx = current_function;
+            if (!ctx) {
+                report_codegen_error("'return' used outside a function.");
+                break;
+            }
+            if (parallel_body_depth > 0) {
+                report_codegen_error("'return' cannot leave a parallel for loop.");
+                break;
+            }
+            const char *func_name = ctx->function->def->data.func_def.function_symbol->name;
+            emit(1, "// Return from %s()", func_name);
+            expr_res = generate_expression(node->data.return_stmt.expression);
+            if (codegen_error_occurred) {
+                if (expr_res.is_temporary) free(expr_res.code);
+                break;
+            }
+            if (expr_res.type == SYMBOL_TYPE_STRING) {
+                report_codegen_error("%s() cannot return a string.", func_name);
+                if (expr_res.is_temporary) free(expr_res.code);
+                break;
+            }
+
+            // All returns of a body must agree on the type (clones keep it where
+            // recursive calls can see it)
+            ValueType type = value_type_of(&expr_res);
+            ValueType *result = &ctx->result;
+            int *has_result = &ctx->has_result;
+            if (ctx->clone_index >= 0) {
+                result = &ctx->function->clones[ctx->clone_index].result;
+                has_result = &ctx->function->clones[ctx->clone_index].has_result;
+            }
+            if (!*has_result) {
+                *result = type;
+                *has_result = 1;
+            } else if (result->type != type.type || result->dtype != type.dtype) {
+                report_codegen_error("%s() returns both %s and %s values.", func_name,
+                    type_name(result->type, result->dtype), type_name(type.type, type.dtype));
+            } else if (result->rows != type.rows || result->cols != type.cols) {
+                result->rows = 0; // Shape depends on the return taken
+                result->cols = 0;
+            }
+            if (!codegen_error_occurred) {
+                if (!ctx->result_var) { // Inlined: the caller's temporary holds the value
+                    ctx->result_var = (type.type == SYMBOL_TYPE_VECTOR) ? new_temp_vector_var(type.dtype)
+                                    : (type.type == SYMBOL_TYPE_MATRIX) ? new_temp_matrix_var()
+                                    : new_temp_scalar_var(DTYPE_F64);
+                }
+                emit_store(ctx->result_var, &type, expr_res.code);
+                if (ctx->clone_index >= 0) emit(1, "goto wz_return;");
+            }
+            ctx->return_count++;
+            if (expr_res.is_temporary) free(expr_res.code);
+            break;
+        }
+
         default:
              emit(1, "// Statement generation not implemented for node type %d", node->type);
             break;
@@ -680,65 +1971,1568 @@ static void generate_statement(ASTNode *node) {
 }
 
 //------------------------------------------------------------------------------
-// Main code generation function (entry point)
+// User-Defined Functions
+// A call to a function defined with 'def' is compiled in one of two ways:
+//  - small straight-line bodies are inlined at the call site, with the
+//    function's locals renamed so they cannot clash with the caller's;
+//  - anything else calls a static C function generated for that exact
+//    combination of argument types (and matrix shapes). Each combination gets
+//    its own clone, so bodies are type checked and compiled like main code.
+// Bodies only see their parameters and locals (see symbol_push_scope()).
 //------------------------------------------------------------------------------
-void generate_code(ASTNode *ast_root, const char *output_filename) {
-    if (!ast_root || ast_root->type != NODE_TYPE_STATEMENT_LIST) {
-        fprintf(stderr, "Error: Cannot generate code from empty or non-statement-list root AST.\n");
-        return;
+static ValueType value_type_of(const ExprResult *res) {
+    ValueType type;
+    type.type = res->type;
+    type.dtype = (res->type == SYMBOL_TYPE_VECTOR) ? res->dtype : DTYPE_F64;
+    type.rows = (res->type == SYMBOL_TYPE_MATRIX) ? res->rows : 0;
+    type.cols = (res->type == SYMBOL_TYPE_MATRIX) ? res->cols : 0;
+    return type;
+}
+
+static int value_types_equal(const ValueType *a, const ValueType *b) {
+    return a->type == b->type && a->dtype == b->dtype && a->rows == b->rows && a->cols == b->cols;
+}
+
+// C type of a value, e.g. "VectorF32"
+static const char* c_type_name(const ValueType *type) {
+    if (type->type == SYMBOL_TYPE_VECTOR) return dtype_info[type->dtype].vector_type;
+    if (type->type == SYMBOL_TYPE_MATRIX) return "Matrix";
+    return (type->dtype == DTYPE_I64) ? "int64_t" : "double";
+}
+
+// target = code, retaining vector/matrix buffers like an assignment
+static void emit_store(const char *target, const ValueType *type, const char *code) {
+    if (type->type == SYMBOL_TYPE_VECTOR) {
+        emit(1, "vector_assign%s(&%s, %s);", dtype_info[type->dtype].suffix, target, code);
+    } else if (type->type == SYMBOL_TYPE_MATRIX) {
+        emit(1, "matrix_assign(&%s, %s);", target, code);
+    } else {
+        emit(1, "%s = %s;", target, code);
     }
+}
 
-    output_file = fopen(output_filename, "w");
-    if (!output_file) {
-        perror("Failed to open output C file");
+static void register_function(ASTNode *item) {
+    FuncDefNode *def = &item->data.func_def;
+    const char *name = def->function_symbol->name;
+    if (find_user_function(name)) {
+        report_codegen_error("Function '%s' is defined more than once.", name);
         return;
     }
-    temp_var_counter = 0; 
-    codegen_error_occurred = 0;
+    for (size_t p = 0; p < def->parameters.count; ++p) {
+        for (size_t q = 0; q < p; ++q) {
+            if (def->parameters.items[p]->data.identifier_symbol == def->parameters.items[q]->data.identifier_symbol) {
+                report_codegen_error("Parameter '%s' of function '%s' is declared more than once.",
+                                     def->parameters.items[p]->data.identifier_symbol->name, name);
+            }
+        }
+    }
+    UserFunction *grown = (UserFunction*)realloc(user_functions, (user_function_count + 1) * sizeof(UserFunction));
+    if (!grown) { perror("realloc failed for user functions"); exit(1); }
+    user_functions = grown;
+    memset(&user_functions[user_function_count], 0, sizeof(UserFunction));
+    user_functions[user_function_count++].def = item;
+}
 
-    // Emit C Boilerplate & Helpers
-    emit(0, "// Generated by WIZUALL Compiler");
-    emit(0, "");
-    emit(0, "#include <stdio.h>");
-    emit(0, "#include <stdlib.h>");
-    emit(0, "#include <math.h>"); 
-    emit(0, "#include <string.h> // For memcpy");
-    emit(0, "#include <stddef.h> // For size_t");
-    emit(0, "#include <assert.h>");
-    emit(0, "#include \"runtime_viz.h\" // Include viz function declarations");
+static UserFunction* find_user_function(const char *name) {
+    for (int i = 0; i < user_function_count; ++i) {
+        if (strcmp(user_functions[i].def->data.func_def.function_symbol->name, name) == 0) {
+            return &user_functions[i];
+        }
+    }
+    return NULL;
+}
+
+// Straight-line bodies of at most INLINE_MAX_STATEMENTS ending in the only
+// return; with a profile, more at hot calls and none at calls never made
+static int function_is_inlinable(UserFunction *function, const ASTNode *call) {
+    if (function->active) return 0; // Recursive call: the body is being generated already
+    size_t max_statements = INLINE_MAX_STATEMENTS;
+    const ProfileSite *site = profile_of(call);
+    if (site && site->count == 0) return 0;
+    if (site && site->count >= PGO_HOT_CALLS) max_statements = PGO_HOT_INLINE_STATEMENTS;
+    NodeList *body = &function->def->data.func_def.body->data.statement_list;
+    if (body->count == 0 || body->count > max_statements) return 0;
+    for (size_t i = 0; i < body->count; ++i) {
+        NodeType type = body->items[i]->type;
+        if (type == NODE_TYPE_IF || type == NODE_TYPE_WHILE || type == NODE_TYPE_FOR ||
+            type == NODE_TYPE_STATEMENT_LIST) return 0;
+        if (type == NODE_TYPE_RETURN && i != body->count - 1) return 0;
+    }
+    return body->items[body->count - 1]->type == NODE_TYPE_RETURN;
+}
+
+static int is_parameter(FuncDefNode *def, Symbol *sym) {
+    for (size_t p = 0; p < def->parameters.count; ++p) {
+        if (def->parameters.items[p]->data.identifier_symbol == sym) return 1;
+    }
+    return 0;
+}
+
+// The same local symbols are reused for every clone and inlined copy of a
+// body (which may nest through recursion), so their codegen state is saved,
+// reset for the new body and restored afterwards
+static Symbol* save_locals(FuncDefNode *def) {
+    size_t count = 0;
+    for (Symbol *sym = def->locals; sym != NULL; sym = sym->next) ++count;
+    Symbol *saved = (Symbol*)malloc((count > 0 ? count : 1) * sizeof(Symbol));
+    if (!saved) { perror("malloc failed for saved locals"); exit(1); }
+    size_t i = 0;
+    for (Symbol *sym = def->locals; sym != NULL; sym = sym->next) {
+        saved[i++] = *sym;
+        sym->type = SYMBOL_TYPE_SCALAR;
+        sym->dtype = DTYPE_F64;
+        sym->type_known = 0;
+        sym->rows = 0;
+        sym->cols = 0;
+        sym->storage = NULL;
+    }
+    return saved;
+}
+
+static void restore_locals(FuncDefNode *def, Symbol *saved) {
+    size_t i = 0;
+    for (Symbol *sym = def->locals; sym != NULL; sym = sym->next) {
+        *sym = saved[i++]; // Also restores the name and the list link
+    }
+    free(saved);
+}
+
+static void bind_parameters(FuncDefNode *def, const ValueType *params) {
+    for (size_t p = 0; p < def->parameters.count; ++p) {
+        Symbol *sym = def->parameters.items[p]->data.identifier_symbol;
+        sym->type = params[p].type;
+        sym->dtype = params[p].dtype;
+        sym->rows = params[p].rows;
+        sym->cols = params[p].cols;
+        sym->type_known = 1;
+    }
+}
+
+// Appends a scratch file to the output and closes it
+static void copy_file(FILE *from) {
+    rewind(from);
+    char copy_buffer[4096];
+    size_t copied;
+    while ((copied = fread(copy_buffer, 1, sizeof(copy_buffer), from)) > 0) {
+        fwrite(copy_buffer, 1, copied, output_file);
+    }
+    fclose(from);
+}
+
+// Generates the body of 'function' for one signature into a new scratch file;
+// the output goes back to the caller's file when it is done
+static FILE* generate_body(FunctionContext *ctx) {
+    FILE *saved_output = output_file;
+    output_file = tmpfile();
+    if (!output_file) { perror("Failed to create temporary file for function body"); exit(1); }
+    ctx->outer = current_function;
+    current_function = ctx;
+    int saved_parallel_depth = parallel_body_depth;
+    parallel_body_depth = 0; // A return in the body leaves the function, not a loop task
+    ctx->function->active++;
+    NodeList *body = &ctx->function->def->data.func_def.body->data.statement_list;
+    for (size_t i = 0; i < body->count; ++i) {
+        generate_statement(body->items[i]);
+    }
+    ctx->function->active--;
+    parallel_body_depth = saved_parallel_depth;
+    current_function = ctx->outer;
+    FILE *body_file = output_file;
+    output_file = saved_output;
+    return body_file;
+}
+
+// Index of the clone of 'function' for these parameter types, generating it
+// (into function_file, with a prototype in prototype_file) on first use.
+// Clones are not static: in a split program they are called from other parts.
+static int generate_clone(UserFunction *function, const ValueType *params) {
+    FuncDefNode *def = &function->def->data.func_def;
+    size_t param_count = def->parameters.count;
+    for (int i = 0; i < function->clone_count; ++i) {
+        size_t p = 0;
+        while (p < param_count && value_types_equal(&function->clones[i].params[p], &params[p])) ++p;
+        if (p == param_count) return i;
+    }
+
+    if (function->clone_count == function->clone_capacity) {
+        function->clone_capacity = (function->clone_capacity == 0) ? 4 : function->clone_capacity * 2;
+        function->clones = (FunctionClone*)realloc(function->clones, function->clone_capacity * sizeof(FunctionClone));
+        if (!function->clones) { perror("realloc failed for function clones"); exit(1); }
+    }
+    int index = function->clone_count++;
+    FunctionClone *clone = &function->clones[index];
+    clone->params = (ValueType*)malloc((param_count > 0 ? param_count : 1) * sizeof(ValueType));
+    if (!clone->params) { perror("malloc failed for clone parameters"); exit(1); }
+    memcpy(clone->params, params, param_count * sizeof(ValueType));
+    char c_name[256];
+    snprintf(c_name, sizeof(c_name), "wz_%s_%d", def->function_symbol->name, index);
+    clone->c_name = strdup(c_name);
+    clone->has_result = 0;
+
+    // Generate the body with its own temporaries (declared in the clone)
+    Symbol *saved_locals = save_locals(def);
+    bind_parameters(def, params);
+    int saved_owner = current_owner;
+    int owner = current_owner = ++body_counter;
+    FunctionContext ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.function = function;
+    ctx.clone_index = index;
+    ctx.result_var = strdup("wz_result");
+    FILE *body_file = generate_body(&ctx);
+    current_owner = saved_owner;
+
+    // Nested clones may have moved the array
+    clone = &function->clones[index];
+    ValueType result = { SYMBOL_TYPE_SCALAR, DTYPE_F64, 0, 0 }; // No return: 0.0
+    if (clone->has_result) result = clone->result;
+
+    // Signature, e.g. "static VectorF64 wz_f_0(VectorF64 a, double b)"
+    size_t signature_size = strlen(clone->c_name) + 64;
+    for (size_t p = 0; p < param_count; ++p) {
+        signature_size += strlen(def->parameters.items[p]->data.identifier_symbol->name) + 32;
+    }
+    char *signature = (char*)malloc(signature_size);
+    if (!signature) { perror("malloc failed for function signature"); exit(1); }
+    int length = snprintf(signature, signature_size, "%s %s(", c_type_name(&result), clone->c_name);
+    for (size_t p = 0; p < param_count; ++p) {
+        length += snprintf(signature + length, signature_size - length, "%s%s %s", (p > 0) ? ", " : "",
+                           c_type_name(&params[p]), def->parameters.items[p]->data.identifier_symbol->name);
+    }
+    if (param_count == 0) length += snprintf(signature + length, signature_size - length, "void");
+    snprintf(signature + length, signature_size - length, ")");
+
+    FILE *saved_output = output_file;
+    output_file = prototype_file;
+    emit(0, "%s;", signature);
+    output_file = function_file;
+    emit(0, "// %s() specialised for these argument types", def->function_symbol->name);
+    emit(0, "%s {", signature);
+    for (Symbol *sym = def->locals; sym != NULL; sym = sym->next) {
+        if (!is_parameter(def, sym)) declare_symbol(sym);
+    }
+    if (result.type == SYMBOL_TYPE_SCALAR) {
+        emit(1, "double wz_result = 0.0;");
+    } else if (result.type == SYMBOL_TYPE_VECTOR) {
+        emit(1, "%s wz_result = { NULL, 0 };", c_type_name(&result));
+    } else {
+        emit(1, "Matrix wz_result = { NULL, 0, 0 };");
+    }
+    declare_temps(owner);
+    // Parameters share the caller's buffers and are released with the locals
+    for (size_t p = 0; p < param_count; ++p) {
+        if (params[p].type == SYMBOL_TYPE_VECTOR || params[p].type == SYMBOL_TYPE_MATRIX) {
+            emit(1, "runtime_buffer_retain(%s.data);", def->parameters.items[p]->data.identifier_symbol->name);
+        }
+    }
     emit(0, "");
-    generate_runtime_helpers(); 
-    
-    // Main function start
-    emit(0, "// --- Main Program ---");
-    emit(0, "int main() {");
-    emit(1, "printf(\"Executing generated code...\\n\");");
+    copy_file(body_file);
+    if (ctx.return_count > 0) emit(0, "wz_return:;");
+    for (Symbol *sym = def->locals; sym != NULL; sym = sym->next) {
+        free_symbol(sym, "");
+    }
+    free_temps(owner);
+    emit(1, "return wz_result;");
+    emit(0, "}");
     emit(0, "");
+    output_file = saved_output;
 
-    // Declare variables 
-    declare_variables();
-    
-    // Generate code for program statements
-    emit(1, "// --- Program Statements ---");
-    generate_statement(ast_root); // Use the statement generator for the root list
-    emit(1, "// ------------------------");
-    emit(0, "");
+    free(signature);
+    free(ctx.result_var);
+    restore_locals(def, saved_locals);
+    return index;
+}
 
-    // Generate cleanup code (freeing vectors)
-    generate_cleanup_code();
+static ExprResult generate_user_call(UserFunction *function, ASTNode *call, ExprResult *args) {
+    ExprResult result = {NULL, SYMBOL_TYPE_SCALAR, DTYPE_F64, 0, 0, 0};
+    FuncDefNode *def = &function->def->data.func_def;
+    const char *name = def->function_symbol->name;
+    size_t arg_count = call->data.func_call.arguments.count;
 
-    emit(1, "printf(\"Code execution finished.\\n\");");
-    emit(1, "return 0;");
-    emit(0, "} // end main");
+    if (arg_count != def->parameters.count) {
+        report_codegen_error("%s() expects %ld arguments, got %ld.", name, (long)def->parameters.count, (long)arg_count);
+        result.code = strdup("/* invalid user function call */");
+        result.is_temporary = 1;
+        return result;
+    }
+    ValueType *params = (ValueType*)malloc((arg_count > 0 ? arg_count : 1) * sizeof(ValueType));
+    if (!params) { perror("malloc failed for argument types"); exit(1); }
+    for (size_t i = 0; i < arg_count; ++i) {
+        if (args[i].type == SYMBOL_TYPE_STRING) {
+            report_codegen_error("%s() does not take string arguments.", name);
+            free(params);
+            result.code = strdup("/* invalid user function call */");
+            result.is_temporary = 1;
+            return result;
+        }
+        params[i] = value_type_of(&args[i]);
+    }
 
-    // Close the file
-    fclose(output_file);
-    output_file = NULL;
+    if (recording(call)) emit(1, "runtime_profile_count(%d);", call->site);
+    if (function_is_inlinable(function, call)) {
+        // The locals are declared in a block around the body, where they hide
+        // caller variables of the same name: pass those through a temporary
+        for (size_t p = 0; p < arg_count; ++p) {
+            for (Symbol *sym = def->locals; sym != NULL; sym = sym->next) {
+                if (strcmp(sym->name, args[p].code) != 0) continue;
+                char *temp_var = (params[p].type == SYMBOL_TYPE_VECTOR) ? new_temp_vector_var(params[p].dtype)
+                               : (params[p].type == SYMBOL_TYPE_MATRIX) ? new_temp_matrix_var()
+                               : new_temp_scalar_var(DTYPE_F64);
+                emit_store(temp_var, &params[p], args[p].code);
+                if (args[p].is_temporary) free(args[p].code);
+                args[p].code = temp_var;
+                args[p].is_temporary = 0; // It's a declared temp variable
+                break;
+            }
+        }
+        Symbol *saved_locals = save_locals(def);
+        bind_parameters(def, params);
+        FunctionContext ctx;
+        memset(&ctx, 0, sizeof(ctx));
+        ctx.function = function;
+        ctx.clone_index = -1;
+        FILE *body_file = generate_body(&ctx); // The return stores into a new caller temporary
 
-    if (codegen_error_occurred) {
-        fprintf(stderr, "Code generation failed due to semantic errors. Output file '%s' may be incomplete or incorrect.\n", output_filename);
-        // remove(output_filename);
+        emit(1, "{ // Inlined %s()", name);
+        for (Symbol *sym = def->locals; sym != NULL; sym = sym->next) {
+            declare_symbol(sym);
+        }
+        for (size_t p = 0; p < arg_count; ++p) {
+            emit_store(def->parameters.items[p]->data.identifier_symbol->name, &params[p], args[p].code);
+        }
+        copy_file(body_file);
+        for (Symbol *sym = def->locals; sym != NULL; sym = sym->next) {
+            free_symbol(sym, "");
+        }
+        emit(1, "} // End inlined %s()", name);
+        restore_locals(def, saved_locals);
+
+        result.code = ctx.result_var ? ctx.result_var : strdup("0.0");
+        result.type = ctx.result.type;
+        result.dtype = ctx.result.dtype;
+        result.rows = ctx.result.rows;
+        result.cols = ctx.result.cols;
+        result.is_temporary = (ctx.result_var == NULL);
+        free(params);
+        return result;
+    }
+
+    int index = generate_clone(function, params);
+    FunctionClone *clone = &function->clones[index];
+    if (!clone->has_result) {
+        // No return at all, or a recursive call reached before the first
+        // return: the result is taken to be a scalar (later returns must agree)
+        clone->result.type = SYMBOL_TYPE_SCALAR;
+        clone->result.dtype = DTYPE_F64;
+        clone->result.rows = 0;
+        clone->result.cols = 0;
+        clone->has_result = 1;
+    }
+
+    size_t args_size = 1;
+    for (size_t i = 0; i < arg_count; ++i) args_size += strlen(args[i].code) + 2;
+    char *arg_str = (char*)malloc(args_size);
+    if (!arg_str) { perror("malloc failed for call arguments"); exit(1); }
+    arg_str[0] = '\0';
+    for (size_t i = 0; i < arg_count; ++i) {
+        if (i > 0) strcat(arg_str, ", ");
+        strcat(arg_str, args[i].code);
+    }
+
+    ValueType *type = &clone->result;
+    if (type->type == SYMBOL_TYPE_VECTOR) {
+        result.code = new_temp_vector_var(type->dtype);
+        emit(1, "vector_set%s(&%s, %s(%s));", dtype_info[type->dtype].suffix, result.code, clone->c_name, arg_str);
+    } else if (type->type == SYMBOL_TYPE_MATRIX) {
+        result.code = new_temp_matrix_var();
+        emit(1, "matrix_set(&%s, %s(%s));", result.code, clone->c_name, arg_str);
     } else {
-        printf("Code generation complete: %s\n", output_filename);
+        result.code = new_temp_scalar_var(DTYPE_F64);
+        emit(1, "%s = %s(%s);", result.code, clone->c_name, arg_str);
+    }
+    result.type = type->type;
+    result.dtype = type->dtype;
+    result.rows = type->rows;
+    result.cols = type->cols;
+    result.is_temporary = 0; // It's a declared temp variable
+    free(arg_str);
+    free(params);
+    return result;
+}
+
+//------------------------------------------------------------------------------
+// Counted Loops
+// for i in range(a, b) runs i over the integers in [a, b) (non-integer bounds
+// are rounded up) with an int64_t C loop counter, which gcc can vectorise and
+// unroll. The bounds are evaluated once; afterwards i keeps its last value.
+//
+// A parallel for compiles the body into a task function run on the runtime
+// thread pool over blocks of the range (runtime_range_tasks). Each task works
+// on private copies of the variables the body uses: assignments to them are
+// not visible after the loop, except for the reduction variables, which start
+// from the identity in every task and are combined into the variable in task
+// order afterwards (so '+' gives the same result on every run).
+//------------------------------------------------------------------------------
+
+// Evaluates the bounds of a for loop; returns 0 (after reporting) if they or
+// the loop variable have the wrong type
+static int generate_loop_range(ForNode *loop, ExprResult *start, ExprResult *end) {
+    Symbol *index = loop->index_symbol;
+    *start = generate_expression(loop->range_start);
+    *end = generate_expression(loop->range_end);
+    if (codegen_error_occurred) return 0;
+    if (start->type != SYMBOL_TYPE_SCALAR || end->type != SYMBOL_TYPE_SCALAR) {
+        report_codegen_error("range() expects scalar bounds.");
+        return 0;
+    }
+    if (index->type_known && index->type != SYMBOL_TYPE_SCALAR) {
+        report_codegen_error("Loop variable '%s' must be a scalar (it is a %s).", source_name(index),
+                             type_name(index->type, index->dtype));
+        return 0;
+    }
+    if (!index->type_known) fix_symbol_type(index, SYMBOL_TYPE_SCALAR, DTYPE_I64);
+    return 1;
+}
+
+// Rounds a loop bound up to an integer, unless it already is one
+static const char* loop_bound_cast(const ExprResult *bound) {
+    return (bound->dtype == DTYPE_I64) ? "" : "(int64_t)ceil";
+}
+
+static void add_symbol(Symbol *sym, Symbol ***symbols, size_t *count, size_t *capacity) {
+    sym = storage_of(sym);
+    for (size_t i = 0; i < *count; ++i) {
+        if ((*symbols)[i] == sym) return;
+    }
+    if (*count == *capacity) {
+        *capacity = (*capacity == 0) ? 16 : *capacity * 2;
+        *symbols = (Symbol**)realloc(*symbols, *capacity * sizeof(Symbol*));
+        if (!*symbols) { perror("realloc failed for loop symbols"); exit(1); }
+    }
+    (*symbols)[(*count)++] = sym;
+}
+
+// Variables read or assigned anywhere in 'node' (not function names)
+static void collect_symbols(ASTNode *node, Symbol ***symbols, size_t *count, size_t *capacity) {
+    if (!node) return;
+    switch (node->type) {
+        case NODE_TYPE_IDENTIFIER:
+            add_symbol(node->data.identifier_symbol, symbols, count, capacity);
+            break;
+        case NODE_TYPE_VECTOR:
+            for (size_t i = 0; i < node->data.vector_elements.count; ++i) {
+                collect_symbols(node->data.vector_elements.items[i], symbols, count, capacity);
+            }
+            break;
+        case NODE_TYPE_BINARY_OP:
+            collect_symbols(node->data.binary_op.left, symbols, count, capacity);
+            collect_symbols(node->data.binary_op.right, symbols, count, capacity);
+            break;
+        case NODE_TYPE_UNARY_OP:
+            collect_symbols(node->data.unary_op.operand, symbols, count, capacity);
+            break;
+        case NODE_TYPE_ASSIGNMENT:
+            add_symbol(node->data.assignment.target_symbol, symbols, count, capacity);
+            collect_symbols(node->data.assignment.expression, symbols, count, capacity);
+            break;
+        case NODE_TYPE_STATEMENT_LIST:
+            for (size_t i = 0; i < node->data.statement_list.count; ++i) {
+                collect_symbols(node->data.statement_list.items[i], symbols, count, capacity);
+            }
+            break;
+        case NODE_TYPE_IF:
+            collect_symbols(node->data.if_stmt.condition, symbols, count, capacity);
+            collect_symbols(node->data.if_stmt.if_branch, symbols, count, capacity);
+            collect_symbols(node->data.if_stmt.else_branch, symbols, count, capacity);
+            break;
+        case NODE_TYPE_WHILE:
+            collect_symbols(node->data.while_loop.condition, symbols, count, capacity);
+            collect_symbols(node->data.while_loop.loop_body, symbols, count, capacity);
+            break;
+        case NODE_TYPE_FOR:
+            add_symbol(node->data.for_loop.index_symbol, symbols, count, capacity);
+            collect_symbols(node->data.for_loop.range_start, symbols, count, capacity);
+            collect_symbols(node->data.for_loop.range_end, symbols, count, capacity);
+            collect_symbols(node->data.for_loop.chunk_size, symbols, count, capacity);
+            for (size_t i = 0; i < node->data.for_loop.reduction_count; ++i) {
+                add_symbol(node->data.for_loop.reductions[i].variable, symbols, count, capacity);
+            }
+            collect_symbols(node->data.for_loop.loop_body, symbols, count, capacity);
+            break;
+        case NODE_TYPE_FUNC_CALL:
+            for (size_t i = 0; i < node->data.func_call.arguments.count; ++i) {
+                collect_symbols(node->data.func_call.arguments.items[i], symbols, count, capacity);
+            }
+            break;
+        case NODE_TYPE_RETURN:
+            collect_symbols(node->data.return_stmt.expression, symbols, count, capacity);
+            break;
+        default:
+            break;
+    }
+}
+
+static void generate_for(ASTNode *node) {
+    ForNode *loop = &node->data.for_loop;
+    ExprResult start, end;
+    emit(1, "// For loop over %s", var_name(loop->index_symbol));
+    forget_assigned_shapes(node);
+    if (generate_loop_range(loop, &start, &end)) {
+        char id[32]; // Loop names are numbered per partition (see Parallel Code Generation)
+        snprintf(id, sizeof(id), "%d_%d", loop_partition, loop_counter++);
+        emit(1, "{");
+        emit(1, "int64_t wz_end%s = %s(%s);", id, loop_bound_cast(&end), end.code);
+        emit(1, "for (int64_t wz_i%s = %s(%s); wz_i%s < wz_end%s; ++wz_i%s) {", id, loop_bound_cast(&start), start.code, id, id, id);
+        emit(1, "%s = %swz_i%s;", var_name(loop->index_symbol), (loop->index_symbol->dtype == DTYPE_I64) ? "" : "(double)", id);
+        generate_statement(loop->loop_body);
+        emit(1, "}");
+        emit(1, "} // End for");
+        if (loop->index_live_after != 1) emit(1, "(void)%s; // The body may not read the index either", var_name(loop->index_symbol));
+        forget_assigned_shapes(node);
+    }
+    if (start.is_temporary) free(start.code);
+    if (end.is_temporary) free(end.code);
+}
+
+static void generate_parallel_for(ASTNode *node) {
+    ForNode *loop = &node->data.for_loop;
+    Symbol *index = loop->index_symbol;
+    ExprResult start, end;
+    ExprResult chunk = {strdup("0"), SYMBOL_TYPE_SCALAR, DTYPE_F64, 1, 0, 0};
+    emit(1, "// Parallel for loop over %s", index->name);
+    forget_assigned_shapes(node);
+    if (!generate_loop_range(loop, &start, &end)) {
+        if (start.is_temporary) free(start.code);
+        if (end.is_temporary) free(end.code);
+        free(chunk.code);
+        return;
+    }
+    index = storage_of(index);
+    if (loop->chunk_size) {
+        free(chunk.code);
+        chunk = generate_expression(loop->chunk_size);
+        if (chunk.type != SYMBOL_TYPE_SCALAR) report_codegen_error("schedule(dynamic, n) expects a scalar chunk size.");
+    }
+    for (size_t r = 0; r < loop->reduction_count; ++r) {
+        Symbol *sym = storage_of(loop->reductions[r].variable);
+        if (sym == index) report_codegen_error("The loop variable '%s' cannot be a reduction variable.", source_name(sym));
+        for (size_t q = 0; q < r; ++q) {
+            if (storage_of(loop->reductions[q].variable) == sym) report_codegen_error("'%s' is reduced more than once.", source_name(sym));
+        }
+        if (sym->type_known && sym->type != SYMBOL_TYPE_SCALAR) {
+            report_codegen_error("Reduction variable '%s' must be a scalar (it is a %s).", source_name(sym),
+                                 type_name(sym->type, sym->dtype));
+        }
+        if (!sym->type_known) {
+            fix_symbol_type(loop->reductions[r].variable, SYMBOL_TYPE_SCALAR, DTYPE_F64);
+            sym = storage_of(loop->reductions[r].variable);
+        }
+    }
+
+    // Variables the body uses that already have a value are shared (copied in
+    // through the context); the others only exist inside the task
+    Symbol **symbols = NULL;
+    size_t symbol_count = 0, symbol_capacity = 0;
+    collect_symbols(loop->loop_body, &symbols, &symbol_count, &symbol_capacity);
+    int *shared = (int*)calloc(symbol_count > 0 ? symbol_count : 1, sizeof(int));
+    if (!shared) { perror("calloc failed for loop symbols"); exit(1); }
+    for (size_t s = 0; s < symbol_count; ++s) {
+        int is_reduction = 0;
+        for (size_t r = 0; r < loop->reduction_count; ++r) {
+            if (storage_of(loop->reductions[r].variable) == symbols[s]) is_reduction = 1;
+        }
+        shared[s] = symbols[s]->type_known && symbols[s] != index && !is_reduction;
+    }
+
+    // Generate the body with its own temporaries
+    char id[32];
+    snprintf(id, sizeof(id), "%d_%d", loop_partition, loop_counter++);
+    int saved_owner = current_owner;
+    int owner = current_owner = ++body_counter;
+    FILE *saved_output = output_file;
+    output_file = tmpfile();
+    if (!output_file) { perror("Failed to create temporary file for loop body"); exit(1); }
+    parallel_body_depth++;
+    generate_statement(loop->loop_body);
+    parallel_body_depth--;
+    FILE *body_file = output_file;
+    current_owner = saved_owner;
+
+    // Context and task function, before main (and before the function that
+    // contains the loop)
+    output_file = function_file;
+    emit(0, "// Body of the parallel for loop over %s", index->name);
+    emit(0, "typedef struct {");
+    emit(1, "int64_t wz_begin, wz_end;");
+    emit(1, "size_t wz_tasks;");
+    for (size_t s = 0; s < symbol_count; ++s) {
+        if (!shared[s]) continue;
+        ValueType type = { symbols[s]->type, symbols[s]->dtype, 0, 0 };
+        emit(1, "%s *v_%s;", c_type_name(&type), symbols[s]->name);
+    }
+    for (size_t r = 0; r < loop->reduction_count; ++r) {
+        emit(1, "double *r_%s; // Partial result of each task", var_name(loop->reductions[r].variable));
+    }
+    emit(0, "} WzFor%s;", id);
+    emit(0, "");
+    emit(0, "static void wz_for_%s(size_t wz_task, void *wz_arg) {", id);
+    emit(1, "WzFor%s *wz_ctx = (WzFor%s *)wz_arg;", id, id);
+    emit(1, "int64_t wz_first = runtime_range_start(wz_ctx->wz_begin, wz_ctx->wz_end, wz_ctx->wz_tasks, wz_task);");
+    emit(1, "int64_t wz_last = runtime_range_start(wz_ctx->wz_begin, wz_ctx->wz_end, wz_ctx->wz_tasks, wz_task + 1);");
+    if (recording(node)) emit(1, "uint64_t wz_t0 = runtime_profile_clock();");
+    for (size_t s = 0; s < symbol_count; ++s) {
+        if (!shared[s]) continue;
+        ValueType type = { symbols[s]->type, symbols[s]->dtype, 0, 0 };
+        emit(1, "%s %s = *wz_ctx->v_%s;", c_type_name(&type), symbols[s]->name, symbols[s]->name);
+        if (type.type != SYMBOL_TYPE_SCALAR) emit(1, "runtime_buffer_retain(%s.data);", symbols[s]->name);
+    }
+    for (size_t r = 0; r < loop->reduction_count; ++r) {
+        char op = loop->reductions[r].op;
+        emit(1, "double %s = %s;", var_name(loop->reductions[r].variable),
+             (op == '+') ? "0.0" : (op == '<') ? "INFINITY" : "-INFINITY");
+    }
+    int body_uses_index = 0; // Otherwise the task has no copy of it to set
+    for (size_t s = 0; s < symbol_count; ++s) {
+        if (symbols[s] == index) body_uses_index = 1;
+    }
+    if (body_uses_index) declare_symbol(index);
+    for (size_t s = 0; s < symbol_count; ++s) {
+        if (!shared[s] && symbols[s] != index && symbols[s]->type_known) {
+            int is_reduction = 0;
+            for (size_t r = 0; r < loop->reduction_count; ++r) {
+                if (storage_of(loop->reductions[r].variable) == symbols[s]) is_reduction = 1;
+            }
+            if (!is_reduction) declare_symbol(symbols[s]);
+        }
+    }
+    declare_temps(owner);
+    emit(1, "for (int64_t wz_i = wz_first; wz_i < wz_last; ++wz_i) {");
+    if (body_uses_index) emit(2, "%s = %swz_i;", index->name, (index->dtype == DTYPE_I64) ? "" : "(double)");
+    copy_file(body_file);
+    emit(1, "}");
+    if (body_uses_index) emit(1, "(void)%s; // The body may only assign it", index->name);
+    if (recording(node)) emit(1, "runtime_profile_work(%d, wz_t0);", node->site);
+    for (size_t r = 0; r < loop->reduction_count; ++r) {
+        emit(1, "wz_ctx->r_%s[wz_task] = %s;", var_name(loop->reductions[r].variable), var_name(loop->reductions[r].variable));
+    }
+    for (size_t s = 0; s < symbol_count; ++s) {
+        if (symbols[s] != index) free_symbol(symbols[s], "");
+    }
+    free_temps(owner);
+    emit(0, "}");
+    emit(0, "");
+    output_file = saved_output;
+
+    // Run it
+    emit(1, "{");
+    emit(1, "WzFor%s wz_loop%s;", id, id);
+    emit(1, "wz_loop%s.wz_begin = %s(%s);", id, loop_bound_cast(&start), start.code);
+    emit(1, "wz_loop%s.wz_end = %s(%s);", id, loop_bound_cast(&end), end.code);
+    // Versioned on the trip count with a profile: short runs are one task
+    char one_task[256] = "";
+    int64_t min_iterations = parallel_min_iterations(node);
+    if (min_iterations > 0) {
+        emit(1, "// Profile: runs of fewer than %lld iterations are not worth handing out", (long long)min_iterations);
+        snprintf(one_task, sizeof(one_task), "(wz_loop%s.wz_end - wz_loop%s.wz_begin < INT64_C(%lld)) ? (size_t)(wz_loop%s.wz_end > wz_loop%s.wz_begin) : ",
+                 id, id, (long long)min_iterations, id, id);
+    }
+    if (openmp) {
+        emit(1, "wz_loop%s.wz_tasks = %sruntime_range_tasks_for(wz_loop%s.wz_begin, wz_loop%s.wz_end, %d, (int64_t)(%s), wz_omp_threads());",
+             id, one_task, id, id, loop->dynamic_schedule, chunk.code);
+    } else {
+        emit(1, "wz_loop%s.wz_tasks = %sruntime_range_tasks(wz_loop%s.wz_begin, wz_loop%s.wz_end, %d, (int64_t)(%s));",
+             id, one_task, id, id, loop->dynamic_schedule, chunk.code);
+    }
+    if (recording(node)) emit(1, "runtime_profile_loop(%d, wz_loop%s.wz_end - wz_loop%s.wz_begin);", node->site, id, id);
+    for (size_t s = 0; s < symbol_count; ++s) {
+        if (shared[s]) emit(1, "wz_loop%s.v_%s = &%s;", id, symbols[s]->name, symbols[s]->name);
+    }
+    for (size_t r = 0; r < loop->reduction_count; ++r) {
+        const char *name = var_name(loop->reductions[r].variable);
+        emit(1, "wz_loop%s.r_%s = (double *)malloc((wz_loop%s.wz_tasks + 1) * sizeof(double));", id, name, id);
+        emit(1, "if (!wz_loop%s.r_%s) { perror(\"parallel for: malloc failed\"); exit(1); }", id, name);
+    }
+    if (openmp) {
+        // The tasks are the iterations of an OpenMP loop, and each task's partial
+        // results are combined through reduction clauses (in OpenMP's order)
+        size_t clauses_size = 1;
+        for (size_t r = 0; r < loop->reduction_count; ++r) {
+            clauses_size += strlen(var_name(loop->reductions[r].variable)) + 24;
+        }
+        char *clauses = (char*)malloc(clauses_size);
+        if (!clauses) { perror("malloc failed for reduction clauses"); exit(1); }
+        size_t length = 0;
+        clauses[0] = '\0';
+        for (size_t r = 0; r < loop->reduction_count; ++r) {
+            char op = loop->reductions[r].op;
+            length += snprintf(clauses + length, clauses_size - length, " reduction(%s: %s)",
+                               (op == '+') ? "+" : (op == '<') ? "min" : "max", var_name(loop->reductions[r].variable));
+        }
+        emit(1, "#pragma omp parallel for schedule(%s, 1) if(wz_loop%s.wz_tasks > 1)%s",
+             loop->dynamic_schedule ? "dynamic" : "static", id, clauses);
+        free(clauses);
+        emit(1, "for (size_t wz_t = 0; wz_t < wz_loop%s.wz_tasks; ++wz_t) {", id);
+        emit(2, "wz_for_%s(wz_t, &wz_loop%s);", id, id);
+    } else {
+        emit(1, "runtime_parallel_for(wz_loop%s.wz_tasks, wz_for_%s, &wz_loop%s);", id, id, id);
+        if (loop->reduction_count > 0) emit(1, "for (size_t wz_t = 0; wz_t < wz_loop%s.wz_tasks; ++wz_t) {", id);
+    }
+    if (openmp || loop->reduction_count > 0) {
+        for (size_t r = 0; r < loop->reduction_count; ++r) {
+            const char *name = var_name(loop->reductions[r].variable);
+            char op = loop->reductions[r].op;
+            if (op == '+') {
+                emit(2, "%s += wz_loop%s.r_%s[wz_t];", name, id, name);
+            } else {
+                emit(2, "if (wz_loop%s.r_%s[wz_t] %c %s) %s = wz_loop%s.r_%s[wz_t];", id, name, op, name, name, id, name);
+            }
+        }
+        emit(1, "}");
+    }
+    for (size_t r = 0; r < loop->reduction_count; ++r) {
+        emit(1, "free(wz_loop%s.r_%s);", id, var_name(loop->reductions[r].variable));
+    }
+    // The index keeps its last value only if something reads it; the task
+    // privates are declared here too but only their per-task copies are used
+    if (loop->index_live_after != 0) {
+        emit(1, "if (wz_loop%s.wz_end > wz_loop%s.wz_begin) %s = %s(wz_loop%s.wz_end - 1);", id, id, index->name,
+             (index->dtype == DTYPE_I64) ? "" : "(double)", id);
+    }
+    if (loop->index_live_after != 1) emit(1, "(void)%s;", index->name); // Not analysed (streamed) or dead
+    for (size_t s = 0; s < symbol_count; ++s) {
+        if (shared[s] || symbols[s] == index || !symbols[s]->type_known) continue;
+        int is_reduction = 0;
+        for (size_t r = 0; r < loop->reduction_count; ++r) {
+            if (storage_of(loop->reductions[r].variable) == symbols[s]) is_reduction = 1;
+        }
+        if (!is_reduction) emit(1, "(void)%s;", var_name(symbols[s]));
+    }
+    emit(1, "} // End parallel for");
+    forget_assigned_shapes(node);
+
+    free(shared);
+    free(symbols);
+    if (start.is_temporary) free(start.code);
+    if (end.is_temporary) free(end.code);
+    if (chunk.is_temporary) free(chunk.code);
+}
+
+//------------------------------------------------------------------------------
+// Program Parts
+// gcc's optimisers are superlinear in the size of a function, so a large
+// program is not generated as one main(). Its top-level statements are cut
+// into parts of about PART_BYTES of C, each a function wz_part_N(WzMain *wz_main),
+// PARTS_PER_FILE of them to a file <output>_partK.c (the files can be compiled
+// in parallel, make -j). WzMain holds the variables of the program: a part
+// loads the ones it uses into locals at its start and stores them back at its
+// end, like the context of a parallel for. The helpers, clone prototypes,
+// WzMain and the part prototypes go in <output>.h. A program that fits in one
+// part is generated as a single file.
+//------------------------------------------------------------------------------
+#define PART_BYTES (64 * 1024)
+#define PARTS_PER_FILE 8
+
+static int part_count = 0;            // Parts written so far
+static FILE *part_output = NULL;      // The part file being written
+static Symbol **part_symbols = NULL;  // Variables used by the statements of the current part
+static size_t part_symbol_count = 0;
+static size_t part_symbol_capacity = 0;
+static char *output_base = NULL;      // The output path without ".c"
+
+// The output path with 'format' (a suffix, which can number the file) in place of ".c"
+static char* output_name(const char *format, int number) {
+    size_t size = strlen(output_base) + strlen(format) + 16;
+    char *name = (char*)malloc(size);
+    if (!name) { perror("malloc failed for output file name"); exit(1); }
+    int length = snprintf(name, size, "%s", output_base);
+    snprintf(name + length, size - length, format, number);
+    return name;
+}
+
+// The output path without its directory, for #include
+static const char* output_base_name(void) {
+    const char *name = output_base;
+    for (const char *c = output_base; *c; ++c) {
+        if (*c == '/' || *c == '\\') name = c + 1;
+    }
+    return name;
+}
+
+// Deletes a file left by an earlier compilation, if it is one this compiler
+// generated. Returns 0 once there is no such file.
+static int remove_generated(const char *path) {
+    FILE *fp = fopen(path, "r");
+    if (!fp) return 0;
+    const char *marker = "// Generated by WIZUALL Compiler";
+    char line[64] = "";
+    int generated = fgets(line, sizeof(line), fp) && strncmp(line, marker, strlen(marker)) == 0;
+    fclose(fp);
+    return generated && remove(path) == 0;
+}
+
+// Writes the statements generated since the last part as the next part
+static void close_part(void) {
+    FILE *statements_file = output_file;
+    if (part_count % PARTS_PER_FILE == 0) {
+        if (part_output) fclose(part_output);
+        char *name = output_name("_part%d.c", part_count / PARTS_PER_FILE + 1);
+        part_output = open_output(name);
+        if (!part_output) { perror(name); exit(1); }
+        free(name);
+        output_file = part_output;
+        emit(0, "// Generated by WIZUALL Compiler: parts of the main program");
+        emit(0, "#include \"%s.h\"", output_base_name());
+        emit(0, "");
+    }
+    output_file = part_output;
+
+    // Loop bodies and clones first needed by this part
+    copy_file(function_file);
+    function_file = tmpfile();
+    if (!function_file) { perror("Failed to create temporary file for functions"); exit(1); }
+
+    emit(0, "void wz_part_%d(WzMain *wz_main) {", part_count);
+    for (size_t s = 0; s < part_symbol_count; ++s) {
+        Symbol *sym = part_symbols[s];
+        if (!sym->type_known || sym->storage) continue;
+        ValueType type = { sym->type, sym->dtype, 0, 0 };
+        emit(1, "%s %s = wz_main->%s;", c_type_name(&type), sym->name, sym->name);
+    }
+    copy_file(statements_file);
+    for (size_t s = 0; s < part_symbol_count; ++s) {
+        Symbol *sym = part_symbols[s];
+        if (sym->type_known && !sym->storage) emit(1, "wz_main->%s = %s;", sym->name, sym->name);
+    }
+    emit(0, "}");
+    emit(0, "");
+    part_symbol_count = 0;
+    part_count++;
+
+    output_file = tmpfile();
+    if (!output_file) { perror("Failed to create temporary file for generated statements"); exit(1); }
+}
+
+// Called after each top-level statement: notes the variables it uses and
+// starts a new part once the current one is full
+static void end_statement(ASTNode *statement) {
+    collect_symbols(statement, &part_symbols, &part_symbol_count, &part_symbol_capacity);
+    if (ftell(output_file) >= PART_BYTES || (ftell(output_file) > 0 && isolated_statement(statement))) close_part();
+}
+
+// <output>.h, then the main() of a program written as parts into main_file
+static void write_parts_main(FILE *helpers_file, FILE *main_file) {
+    char *header_name = output_name(".h", 0);
+    output_file = open_output(header_name);
+    if (!output_file) { perror(header_name); exit(1); }
+    emit(0, "// Generated by WIZUALL Compiler: declarations shared by the parts of the main program");
+    emit(0, "#ifndef WIZUALL_OUTPUT_H");
+    emit(0, "#define WIZUALL_OUTPUT_H");
+    copy_file(helpers_file);
+    if (ftell(prototype_file) > 0) emit(0, "// --- User Functions ---");
+    copy_file(prototype_file);
+    prototype_file = NULL;
+    emit(0, "");
+    emit(0, "// --- Variables of the Main Program ---");
+    emit(0, "typedef struct {");
+    int variable_count = 0;
+    for (Symbol *sym = symbol_get_list_head(); sym != NULL; sym = sym->next) {
+        if (!sym->type_known || sym->storage) continue;
+        ValueType type = { sym->type, sym->dtype, 0, 0 };
+        emit(1, "%s %s;", c_type_name(&type), sym->name);
+        variable_count++;
+    }
+    if (variable_count == 0) emit(1, "char wz_unused; // A struct cannot be empty");
+    emit(0, "} WzMain;");
+    emit(0, "");
+    for (int p = 0; p < part_count; ++p) {
+        emit(0, "void wz_part_%d(WzMain *wz_main);", p);
+    }
+    emit(0, "");
+    emit(0, "#endif // WIZUALL_OUTPUT_H");
+    fclose(output_file);
+    free(header_name);
+
+    output_file = main_file;
+    emit(0, "// Generated by WIZUALL Compiler");
+    emit(0, "#include \"%s.h\"", output_base_name());
+    emit(0, "");
+    emit(0, "// --- Main Program ---");
+    emit(0, "int main() {");
+    emit(1, "printf(\"Executing generated code...\\n\");");
+    emit(1, "static WzMain wz_main; // Zero / empty, like the variables of a single-file program");
+    if (profile_sites > 0) emit(1, "runtime_profile_begin(%lu, UINT64_C(%llu));", (unsigned long)profile_sites, (unsigned long long)profile_fingerprint);
+    emit(0, "");
+    emit(1, "// --- Program Parts ---");
+    for (int p = 0; p < part_count; ++p) {
+        emit(1, "wz_part_%d(&wz_main);", p);
+    }
+    emit(1, "// ------------------------");
+    emit(0, "");
+    generate_cleanup_code("wz_main.");
+}
+
+//------------------------------------------------------------------------------
+// Parallel Code Generation
+// generate_code cuts the top-level statements into partitions of about
+// PARTITION_NODES AST nodes and generates them on the runtime thread pool
+// (WIZUALL_NUM_THREADS threads), each into scratch files of its own. Two
+// partitions that use the same variable (any version of it) or call the same
+// function (directly or not) are generated one after the other, in program
+// order, so variable types, storage sharing and clones come out as in a
+// serial run. The cut does not depend on the number of threads, temporaries
+// are numbered per statement and loops per partition, so the output is the
+// same whatever the number of threads. The main thread then copies the
+// partitions out in order, as if it had generated them itself.
+//------------------------------------------------------------------------------
+#define PARTITION_NODES 4096
+
+typedef struct {
+    size_t first;            // Index of its first top-level statement
+    size_t count;            // Top-level statements
+    size_t generated;        // Statements generated (up to the first with an error)
+    void **resources;        // Base symbols and user functions used (sorted, unique)
+    size_t resource_count;
+    size_t resource_capacity;
+    size_t *waits_for;       // Earlier partitions sharing a resource
+    size_t wait_count;
+    FILE *text;              // The statements, one after the other
+    FILE *functions;         // Loop bodies and clones they need
+    FILE *prototypes;
+    FILE *errors;            // Semantic errors reported while generating it
+    long *ends;              // End of statement i in 'text' (2i) and in 'functions' (2i + 1)
+    int failed;
+    int done;
+} Partition;
+
+typedef struct {
+    ASTNode **items;         // The top-level statements
+    Partition *partitions;
+    size_t partition_count;
+    size_t first_failed;     // Lowest partition with an error (partition_count if none)
+    pthread_mutex_t lock;    // Guards 'done' and 'first_failed'
+    pthread_cond_t finished; // Signalled when a partition is done
+} PartitionJob;
+
+typedef struct {
+    void *resource;
+    size_t partition;
+} ResourceUse;
+
+static void add_resource(Partition *partition, void *resource) {
+    if (partition->resource_count == partition->resource_capacity) {
+        partition->resource_capacity = (partition->resource_capacity == 0) ? 64 : partition->resource_capacity * 2;
+        partition->resources = (void**)realloc(partition->resources, partition->resource_capacity * sizeof(void*));
+        if (!partition->resources) { perror("realloc failed for partition resources"); exit(1); }
+    }
+    partition->resources[partition->resource_count++] = resource;
+}
+
+// Adds the variables and functions 'node' uses to the resources of 'partition'
+// (number 'mark', 1-based) and returns its number of nodes. A called function
+// brings its body, once per partition.
+static size_t scan_resources(ASTNode *node, Partition *partition, int mark) {
+    if (!node) return 0;
+    size_t nodes = 1;
+    switch (node->type) {
+        case NODE_TYPE_IDENTIFIER: {
+            Symbol *sym = node->data.identifier_symbol;
+            add_resource(partition, sym->base ? sym->base : sym);
+            break;
+        }
+        case NODE_TYPE_VECTOR:
+            for (size_t i = 0; i < node->data.vector_elements.count; ++i) {
+                nodes += scan_resources(node->data.vector_elements.items[i], partition, mark);
+            }
+            break;
+        case NODE_TYPE_BINARY_OP:
+            nodes += scan_resources(node->data.binary_op.left, partition, mark);
+            nodes += scan_resources(node->data.binary_op.right, partition, mark);
+            break;
+        case NODE_TYPE_UNARY_OP:
+            nodes += scan_resources(node->data.unary_op.operand, partition, mark);
+            break;
+        case NODE_TYPE_ASSIGNMENT: {
+            Symbol *sym = node->data.assignment.target_symbol;
+            add_resource(partition, sym->base ? sym->base : sym);
+            nodes += scan_resources(node->data.assignment.expression, partition, mark);
+            break;
+        }
+        case NODE_TYPE_STATEMENT_LIST:
+            for (size_t i = 0; i < node->data.statement_list.count; ++i) {
+                nodes += scan_resources(node->data.statement_list.items[i], partition, mark);
+            }
+            break;
+        case NODE_TYPE_IF:
+            nodes += scan_resources(node->data.if_stmt.condition, partition, mark);
+            nodes += scan_resources(node->data.if_stmt.if_branch, partition, mark);
+            nodes += scan_resources(node->data.if_stmt.else_branch, partition, mark);
+            break;
+        case NODE_TYPE_WHILE:
+            nodes += scan_resources(node->data.while_loop.condition, partition, mark);
+            nodes += scan_resources(node->data.while_loop.loop_body, partition, mark);
+            break;
+        case NODE_TYPE_FOR: {
+            Symbol *index = node->data.for_loop.index_symbol;
+            add_resource(partition, index->base ? index->base : index);
+            nodes += scan_resources(node->data.for_loop.range_start, partition, mark);
+            nodes += scan_resources(node->data.for_loop.range_end, partition, mark);
+            nodes += scan_resources(node->data.for_loop.chunk_size, partition, mark);
+            for (size_t i = 0; i < node->data.for_loop.reduction_count; ++i) {
+                Symbol *sym = node->data.for_loop.reductions[i].variable;
+                add_resource(partition, sym->base ? sym->base : sym);
+            }
+            nodes += scan_resources(node->data.for_loop.loop_body, partition, mark);
+            break;
+        }
+        case NODE_TYPE_FUNC_CALL: {
+            for (size_t i = 0; i < node->data.func_call.arguments.count; ++i) {
+                nodes += scan_resources(node->data.func_call.arguments.items[i], partition, mark);
+            }
+            UserFunction *function = find_user_function(node->data.func_call.function_symbol->name);
+            if (function && function->partition_mark != mark) {
+                function->partition_mark = mark;
+                add_resource(partition, function);
+                nodes += scan_resources(function->def->data.func_def.body, partition, mark);
+            }
+            break;
+        }
+        case NODE_TYPE_RETURN:
+            nodes += scan_resources(node->data.return_stmt.expression, partition, mark);
+            break;
+        default: // Numbers, strings, dense vectors, definitions: nothing shared
+            break;
+    }
+    return nodes;
+}
+
+static int compare_resources(const void *a, const void *b) {
+    uintptr_t x = (uintptr_t)*(void* const*)a, y = (uintptr_t)*(void* const*)b;
+    return (x > y) - (x < y);
+}
+
+static int compare_resource_uses(const void *a, const void *b) {
+    const ResourceUse *x = (const ResourceUse*)a, *y = (const ResourceUse*)b;
+    int order = compare_resources(&x->resource, &y->resource);
+    if (order != 0) return order;
+    return (x->partition > y->partition) - (x->partition < y->partition);
+}
+
+// Cuts the top-level statements into partitions and works out which earlier
+// partitions each one waits for (the previous user of each of its resources)
+static void make_partitions(ASTNode *root, PartitionJob *job) {
+    size_t item_count = root->data.statement_list.count;
+    size_t capacity = 0;
+    job->items = root->data.statement_list.items;
+    job->partitions = NULL;
+    job->partition_count = 0;
+    size_t nodes = PARTITION_NODES;
+    size_t use_count = 0;
+    for (size_t i = 0; i < item_count; ++i) {
+        if (nodes >= PARTITION_NODES) {
+            if (job->partition_count == capacity) {
+                capacity = (capacity == 0) ? 16 : capacity * 2;
+                job->partitions = (Partition*)realloc(job->partitions, capacity * sizeof(Partition));
+                if (!job->partitions) { perror("realloc failed for partitions"); exit(1); }
+            }
+            memset(&job->partitions[job->partition_count], 0, sizeof(Partition));
+            job->partitions[job->partition_count].first = i;
+            job->partition_count++;
+            nodes = 0;
+        }
+        Partition *partition = &job->partitions[job->partition_count - 1];
+        nodes += scan_resources(job->items[i], partition, (int)job->partition_count);
+        partition->count++;
+        if (nodes >= PARTITION_NODES || i + 1 == item_count) {
+            qsort(partition->resources, partition->resource_count, sizeof(void*), compare_resources);
+            size_t unique = 0;
+            for (size_t r = 0; r < partition->resource_count; ++r) {
+                if (unique == 0 || partition->resources[unique - 1] != partition->resources[r]) {
+                    partition->resources[unique++] = partition->resources[r];
+                }
+            }
+            partition->resource_count = unique;
+            use_count += unique;
+        }
+    }
+
+    ResourceUse *uses = (ResourceUse*)malloc((use_count > 0 ? use_count : 1) * sizeof(ResourceUse));
+    if (!uses) { perror("malloc failed for resource uses"); exit(1); }
+    size_t u = 0;
+    for (size_t p = 0; p < job->partition_count; ++p) {
+        Partition *partition = &job->partitions[p];
+        for (size_t r = 0; r < partition->resource_count; ++r) {
+            uses[u].resource = partition->resources[r];
+            uses[u++].partition = p;
+        }
+        free(partition->resources);
+        partition->resources = NULL;
+        partition->waits_for = (size_t*)malloc((partition->resource_count > 0 ? partition->resource_count : 1) * sizeof(size_t));
+        if (!partition->waits_for) { perror("malloc failed for partition dependencies"); exit(1); }
+    }
+    qsort(uses, use_count, sizeof(ResourceUse), compare_resource_uses);
+    for (u = 1; u < use_count; ++u) {
+        if (uses[u].resource != uses[u - 1].resource) continue;
+        Partition *partition = &job->partitions[uses[u].partition];
+        partition->waits_for[partition->wait_count++] = uses[u - 1].partition;
+    }
+    free(uses);
+}
+
+// Appends bytes [begin, end) of a scratch file to 'to'
+static void copy_range(FILE *from, long begin, long end, FILE *to) {
+    fseek(from, begin, SEEK_SET);
+    char copy_buffer[4096];
+    while (begin < end) {
+        size_t wanted = (end - begin < (long)sizeof(copy_buffer)) ? (size_t)(end - begin) : sizeof(copy_buffer);
+        size_t copied = fread(copy_buffer, 1, wanted, from);
+        if (copied == 0) break;
+        fwrite(copy_buffer, 1, copied, to);
+        begin += (long)copied;
+    }
+}
+
+// Generates a top-level statement as a C block with its own temporaries, freed
+// at its end, so nothing about a statement has to be kept once it is generated
+// and temporary names only depend on the statement. 'scratch' is reused.
+static void generate_top_level(ASTNode *statement, FILE *scratch) {
+    FILE *statements_file = output_file;
+    output_file = scratch;
+    rewind(scratch);
+    generate_statement(statement);
+    long length = ftell(scratch); // Anything past this is left from a longer statement
+    output_file = statements_file;
+    int has_temps = 0;
+    for (int i = 0; i < temp_var_counter; ++i) {
+        if (temp_infos[i].owner == 0) has_temps = 1;
+    }
+    if (recording(statement)) {
+        emit(1, "{");
+        emit(1, "uint64_t wz_t0 = runtime_profile_clock();");
+    }
+    if (has_temps) {
+        emit(1, "{");
+        declare_temps(0);
+    }
+    copy_range(scratch, 0, length, output_file);
+    if (has_temps) {
+        free_temps(0);
+        emit(1, "}");
+    }
+    if (recording(statement)) {
+        emit(1, "runtime_profile_time(%d, wz_t0);", statement->site);
+        emit(1, "}");
+    }
+    release_temps();
+}
+
+static FILE* partition_file(void) {
+    FILE *file = tmpfile();
+    if (!file) { perror("Failed to create temporary file for a partition"); exit(1); }
+    return file;
+}
+
+// Task of runtime_parallel_for: waits for the partitions this one depends on,
+// then generates its statements into its own files. The state of the thread is
+// put back at the end, as the thread running generate_code takes part.
+static void generate_partition(size_t task, void *arg) {
+    PartitionJob *job = (PartitionJob*)arg;
+    Partition *partition = &job->partitions[task];
+    pthread_mutex_lock(&job->lock);
+    for (size_t w = 0; w < partition->wait_count; ++w) {
+        while (!job->partitions[partition->waits_for[w]].done) pthread_cond_wait(&job->finished, &job->lock);
+    }
+    int skip = job->first_failed < task; // Its output would be dropped
+    pthread_mutex_unlock(&job->lock);
+
+    FILE *saved_output = output_file, *saved_functions = function_file, *saved_prototypes = prototype_file;
+    FILE *saved_errors = error_file;
+    TempInfo *saved_temps = temp_infos;
+    int saved_temp_count = temp_var_counter, saved_temp_capacity = temp_infos_capacity;
+    int saved_error = codegen_error_occurred, saved_owner = current_owner;
+    int saved_bodies = body_counter, saved_loops = loop_counter, saved_partition = loop_partition;
+
+    if (!skip) {
+        output_file = partition->text = partition_file();
+        function_file = partition->functions = partition_file();
+        prototype_file = partition->prototypes = partition_file();
+        error_file = partition->errors = partition_file();
+        FILE *scratch = partition_file();
+        partition->ends = (long*)malloc(2 * partition->count * sizeof(long));
+        if (!partition->ends) { perror("malloc failed for partition statements"); exit(1); }
+        temp_infos = NULL;
+        temp_var_counter = 0;
+        temp_infos_capacity = 0;
+        codegen_error_occurred = 0;
+        current_owner = 0;
+        body_counter = 0;
+        loop_counter = 0;
+        loop_partition = (int)task;
+        for (size_t i = 0; i < partition->count && !codegen_error_occurred; ++i) {
+            generate_top_level(job->items[partition->first + i], scratch);
+            partition->ends[2 * i] = ftell(output_file);
+            partition->ends[2 * i + 1] = ftell(function_file);
+            partition->generated++;
+        }
+        partition->failed = codegen_error_occurred;
+        fclose(scratch);
+        release_temps();
+        free(temp_infos);
+    }
+
+    output_file = saved_output;
+    function_file = saved_functions;
+    prototype_file = saved_prototypes;
+    error_file = saved_errors;
+    temp_infos = saved_temps;
+    temp_var_counter = saved_temp_count;
+    temp_infos_capacity = saved_temp_capacity;
+    codegen_error_occurred = saved_error;
+    current_owner = saved_owner;
+    body_counter = saved_bodies;
+    loop_counter = saved_loops;
+    loop_partition = saved_partition;
+
+    pthread_mutex_lock(&job->lock);
+    if (partition->failed && task < job->first_failed) job->first_failed = task;
+    partition->done = 1;
+    pthread_cond_broadcast(&job->finished);
+    pthread_mutex_unlock(&job->lock);
+}
+
+// Copies the partitions out in order: errors to stderr, functions and
+// statements to the files of the main thread, one statement at a time so that
+// the program parts are cut as in a serial run. Frees the partitions.
+static void write_partitions(PartitionJob *job) {
+    for (size_t p = 0; p < job->partition_count; ++p) {
+        Partition *partition = &job->partitions[p];
+        size_t copied = 0;
+        if (partition->text && !codegen_error_occurred) {
+            copy_range(partition->errors, 0, ftell(partition->errors), stderr);
+            copy_range(partition->prototypes, 0, ftell(partition->prototypes), prototype_file);
+            long text_begin = 0, functions_begin = 0;
+            for (; copied < partition->generated; ++copied) {
+                ASTNode *statement = job->items[partition->first + copied];
+                if (ftell(output_file) > 0 && isolated_statement(statement)) close_part(); // Starts a part of its own
+                copy_range(partition->functions, functions_begin, partition->ends[2 * copied + 1], function_file);
+                copy_range(partition->text, text_begin, partition->ends[2 * copied], output_file);
+                functions_begin = partition->ends[2 * copied + 1];
+                text_begin = partition->ends[2 * copied];
+                end_statement(statement);
+            }
+            if (partition->failed) codegen_error_occurred = 1;
+        }
+        for (size_t i = copied; i < partition->count; ++i) { // Not generated, as after an error
+            end_statement(job->items[partition->first + i]);
+        }
+        if (partition->text) {
+            fclose(partition->text);
+            fclose(partition->functions);
+            fclose(partition->prototypes);
+            fclose(partition->errors);
+        }
+        free(partition->ends);
+        free(partition->waits_for);
+    }
+    free(job->partitions);
+    job->partitions = NULL;
+}
+
+//------------------------------------------------------------------------------
+// Main code generation functions (entry points)
+// The statements are generated into a scratch file first: variable and
+// temporary types (including dtypes) are only known once the whole program is
+// seen, so their declarations are patched in before the statements at the end.
+// Function clones are generated on the way, into files of their own.
+//------------------------------------------------------------------------------
+static FILE *main_output = NULL;      // The output C file while statements go to a scratch file
+static FILE *header_file = NULL;      // Includes and helpers, for output.c or output.h
+static const char *output_path = NULL;
+static FILE *statement_file = NULL;   // Scratch file reused for each streamed statement (see generate_top_level)
+
+// The output files are written as "<name>.tmp" and renamed by codegen_end, so
+// a compilation that stops half-way (under --stream, a syntax error exits from
+// the parser) leaves the output of the previous one as it was
+static char **pending_outputs = NULL;
+static size_t pending_output_count = 0;
+
+static char* temporary_output_name(const char *path) {
+    size_t size = strlen(path) + 5;
+    char *name = (char*)malloc(size);
+    if (!name) { perror("malloc failed for output file name"); exit(1); }
+    snprintf(name, size, "%s.tmp", path);
+    return name;
+}
+
+static FILE* open_output(const char *path) {
+    char *temporary = temporary_output_name(path);
+    FILE *fp = fopen(temporary, "w");
+    free(temporary);
+    if (!fp) return NULL;
+    char **grown = (char**)realloc(pending_outputs, (pending_output_count + 1) * sizeof(char*));
+    char *copy = strdup(path);
+    if (!grown || !copy) { perror("realloc failed for output files"); exit(1); }
+    pending_outputs = grown;
+    pending_outputs[pending_output_count++] = copy;
+    return fp;
+}
+
+// Renames (commit) or deletes the files written under temporary names
+static void finish_outputs(int commit) {
+    for (size_t i = 0; i < pending_output_count; ++i) {
+        char *temporary = temporary_output_name(pending_outputs[i]);
+        if (commit) {
+            remove(pending_outputs[i]); // rename() does not replace a file on Windows
+            if (rename(temporary, pending_outputs[i]) != 0) perror(pending_outputs[i]);
+        } else {
+            remove(temporary);
+        }
+        free(temporary);
+        free(pending_outputs[i]);
+    }
+    free(pending_outputs);
+    pending_outputs = NULL;
+    pending_output_count = 0;
+}
+
+// atexit handler: the outputs of a compilation that did not reach codegen_end
+static void discard_outputs(void) {
+    if (main_output) fclose(main_output);
+    if (part_output) fclose(part_output);
+    main_output = NULL;
+    part_output = NULL;
+    finish_outputs(0);
+}
+
+int codegen_begin(const char *output_filename) {
+    static int discard_registered = 0;
+    if (!discard_registered) atexit(discard_outputs);
+    discard_registered = 1;
+    main_output = open_output(output_filename);
+    if (!main_output) {
+        perror("Failed to open output C file");
+        return 0;
+    }
+    output_path = output_filename;
+    size_t base_length = strlen(output_filename);
+    if (base_length > 2 && strcmp(output_filename + base_length - 2, ".c") == 0) base_length -= 2;
+    output_base = (char*)malloc(base_length + 1);
+    if (!output_base) { perror("malloc failed for output file name"); exit(1); }
+    memcpy(output_base, output_filename, base_length);
+    output_base[base_length] = '\0';
+    temp_var_counter = 0; 
+    codegen_error_occurred = 0;
+    current_owner = 0;
+    body_counter = 0;
+    loop_counter = 0;
+    loop_partition = 0;
+    part_count = 0;
+    part_symbol_count = 0;
+
+    header_file = tmpfile();
+    if (!header_file) {
+        perror("Failed to create temporary file for generated statements");
+        fclose(main_output);
+        main_output = NULL;
+        return 0;
+    }
+    output_file = header_file;
+    // Emit C Boilerplate & Helpers
+    emit(0, "");
+    emit(0, "#include <stdio.h>");
+    emit(0, "#include <stdlib.h>");
+    emit(0, "#include <math.h>"); 
+    emit(0, "#include <string.h> // For memcpy");
+    emit(0, "#include <stddef.h> // For size_t");
+    emit(0, "#include <stdint.h> // For int64_t (i64 vectors)");
+    emit(0, "#include <assert.h>");
+    emit(0, "#include \"runtime_mem.h\" // Refcounted buffers backing Vector data");
+    emit(0, "#include \"runtime_viz.h\" // Include viz function declarations");
+    emit(0, "#include \"runtime_io.h\" // read_csv, print, save_vector");
+    emit(0, "#include \"runtime_scan.h\" // cumsum, cumprod, compact");
+    emit(0, "#include \"runtime_sort.h\" // sort, argsort");
+    emit(0, "#include \"runtime_quantile.h\" // quantile, median, quantile_approx");
+    emit(0, "#include \"runtime_rolling.h\" // rolling_sum, rolling_mean, rolling_std, rolling_min, rolling_max");
+    emit(0, "#include \"runtime_fft.h\" // fft, ifft, convolve, correlate");
+    emit(0, "#include \"runtime_matrix.h\" // matmul, matvec, transpose, row, col");
+    emit(0, "#include \"runtime_parallel.h\" // parallel for");
+    if (profile_sites > 0) emit(0, "#include \"runtime_profile.h\" // --pgo-gen");
+    emit(0, "");
+    generate_runtime_helpers(); 
+
+    output_file = tmpfile();
+    prototype_file = tmpfile();
+    function_file = tmpfile();
+    if (!output_file || !prototype_file || !function_file) {
+        perror("Failed to create temporary file for generated statements");
+        fclose(main_output);
+        main_output = NULL;
+        return 0;
+    }
+    return 1;
+}
+
+void codegen_set_openmp(int enabled) {
+    openmp = enabled;
+}
+
+void codegen_set_profile_generate(size_t site_count, uint64_t fingerprint) {
+    profile_sites = site_count;
+    profile_fingerprint = fingerprint;
+}
+
+void codegen_set_profile(const ProfileSite *sites) {
+    profile = sites;
+}
+
+void codegen_function(ASTNode *func_def) {
+    register_function(func_def);
+}
+
+// Streamed statements are generated one by one on the calling thread
+void codegen_statement(ASTNode *statement) {
+    if (codegen_error_occurred) return;
+    if (!statement_file) statement_file = tmpfile();
+    if (!statement_file) { perror("Failed to create temporary file for a statement"); exit(1); }
+    generate_top_level(statement, statement_file);
+    end_statement(statement);
+}
+
+void codegen_end(void) {
+    if (part_count > 0 && ftell(output_file) > 0) close_part();
+    FILE *statements_file = output_file;
+
+    if (part_count > 0) {
+        fclose(statements_file);
+        write_parts_main(header_file, main_output);
+        fclose(part_output);
+        part_output = NULL;
+        fclose(function_file); // Empty: the last part took the functions
+        function_file = NULL;
+    } else {
+        output_file = main_output;
+        emit(0, "// Generated by WIZUALL Compiler");
+        copy_file(header_file);
+
+        // User functions (clones) before main
+        int has_functions = ftell(function_file) > 0;
+        if (has_functions) emit(0, "// --- User Functions and Parallel Loop Bodies ---");
+        copy_file(prototype_file);
+        if (has_functions) emit(0, "");
+        copy_file(function_file);
+        prototype_file = NULL;
+        function_file = NULL;
+
+        // Main function start
+        emit(0, "// --- Main Program ---");
+        emit(0, "int main() {");
+        emit(1, "printf(\"Executing generated code...\\n\");");
+        if (profile_sites > 0) emit(1, "runtime_profile_begin(%lu, UINT64_C(%llu));", (unsigned long)profile_sites, (unsigned long long)profile_fingerprint);
+        emit(0, "");
+
+        // Declare variables 
+        declare_variables();
+
+        // Copy in the program statements
+        emit(1, "// --- Program Statements ---");
+        copy_file(statements_file);
+        emit(1, "// ------------------------");
+        emit(0, "");
+
+        // Generate cleanup code (freeing vectors)
+        generate_cleanup_code("");
+    }
+    header_file = NULL;
+    main_output = NULL;
+    if (statement_file) fclose(statement_file);
+    statement_file = NULL;
+
+    emit(1, "printf(\"Code execution finished.\\n\");");
+    emit(1, "return 0;");
+    emit(0, "} // end main");
+
+    // Close the file and move the outputs into place
+    fclose(output_file);
+    output_file = NULL;
+    finish_outputs(1);
+
+    // Delete the files of an earlier, longer split of the program
+    int file_count = (part_count + PARTS_PER_FILE - 1) / PARTS_PER_FILE;
+    if (part_count == 0) {
+        char *header_name = output_name(".h", 0);
+        remove_generated(header_name);
+        free(header_name);
+    }
+    for (int file = file_count + 1; ; ++file) {
+        char *name = output_name("_part%d.c", file);
+        int removed = remove_generated(name);
+        free(name);
+        if (!removed) break;
+    }
+
+    release_temps();
+    free(temp_infos);
+    temp_infos = NULL;
+    temp_infos_capacity = 0;
+    free(part_symbols);
+    part_symbols = NULL;
+    part_symbol_capacity = 0;
+    for (int i = 0; i < user_function_count; ++i) {
+        for (int c = 0; c < user_functions[i].clone_count; ++c) {
+            free(user_functions[i].clones[c].params);
+            free(user_functions[i].clones[c].c_name);
+        }
+        free(user_functions[i].clones);
+    }
+    free(user_functions);
+    user_functions = NULL;
+    user_function_count = 0;
+    split_program = 0;
+    profiled_ns = 0;
+
+    if (codegen_error_occurred) {
+        fprintf(stderr, "Code generation failed due to semantic errors. Output file '%s' may be incomplete or incorrect.\n", output_path);
+        // remove(output_filename);
+    } else if (part_count > 0) {
+        printf("Code generation complete: %s, %s.h and %d part file(s) (%d parts)\n", output_path, output_base, file_count, part_count);
+    } else {
+        printf("Code generation complete: %s\n", output_path);
+    }
+    free(output_base);
+    output_base = NULL;
+}
+
+void generate_code(ASTNode *ast_root, const char *output_filename) {
+    if (!ast_root || ast_root->type != NODE_TYPE_STATEMENT_LIST) {
+        fprintf(stderr, "Error: Cannot generate code from empty or non-statement-list root AST.\n");
+        return;
+    }
+    if (!codegen_begin(output_filename)) return;
+    for (size_t i = 0; i < ast_root->data.statement_list.count; ++i) {
+        if (ast_root->data.statement_list.items[i]->type == NODE_TYPE_FUNC_DEF) {
+            register_function(ast_root->data.statement_list.items[i]);
+        }
+    }
+    PartitionJob job;
+    make_partitions(ast_root, &job);
+    job.first_failed = job.partition_count;
+    if (!codegen_error_occurred) {
+        pthread_mutex_init(&job.lock, NULL);
+        pthread_cond_init(&job.finished, NULL);
+        runtime_parallel_for(job.partition_count, generate_partition, &job);
+        pthread_mutex_destroy(&job.lock);
+        pthread_cond_destroy(&job.finished);
+    }
+    if (profile) { // For isolated_statement
+        long text = 0;
+        for (size_t p = 0; p < job.partition_count; ++p) {
+            if (job.partitions[p].text) text += ftell(job.partitions[p].text);
+        }
+        split_program = text >= PART_BYTES;
+        for (size_t i = 0; i < ast_root->data.statement_list.count; ++i) {
+            const ProfileSite *site = profile_of(ast_root->data.statement_list.items[i]);
+            if (site) profiled_ns += site->ns;
+        }
     }
-} 
\ No newline at end of file
+    write_partitions(&job);
+    codegen_end();
+}
\ No newline at end of file
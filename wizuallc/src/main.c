@@ -1,54 +1,126 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "ast.h" // Include AST header for Node type and functions
 #include "symtab.h" // Include Symbol Table header
 #include "codegen.h" // Include Codegen header
+#include "optimize.h" // Include AST optimisation passes
+#include "runtime_profile.h" // Profiles read for --pgo-use
 
 // External declarations for Flex/Bison
-extern FILE *yyin; // Input stream for the lexer
+extern int lexer_open(const char *path); // Maps the source for the lexer (0 on failure, errno set)
+extern void lexer_close(void); // Releases it
 extern int yylex();  // Lexer function (though usually called by yyparse)
 extern int yyparse(); // Parser function
 extern ASTNode *ast_root; // Declare the global AST root from parser.y
+extern void (*stream_top_level)(ASTNode *item); // Set for --stream
+
+// --stream: each top-level statement is compiled and freed as soon as it is parsed
+static void stream_item(ASTNode *item) {
+    if (item->type == NODE_TYPE_FUNC_DEF) {
+        codegen_function(item); // Stays in ast_root
+    } else {
+        codegen_statement(item);
+        ast_free_node(item);
+    }
+}
 
 int main(int argc, char **argv) {
-    // Check for the correct number of command-line arguments
-    if (argc != 2) {
-        fprintf(stderr, "Usage: %s <input_filename>\n", argv[0]);
+    const char *input_file = NULL;
+    int streaming = 0;
+    int profile_generate = 0;
+    const char *profile_file = NULL;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--stream") == 0) {
+            streaming = 1;
+        } else if (strcmp(argv[i], "--openmp") == 0) {
+            codegen_set_openmp(1);
+        } else if (strcmp(argv[i], "--pgo-gen") == 0) {
+            profile_generate = 1;
+        } else if (strcmp(argv[i], "--pgo-use") == 0 && i + 1 < argc) {
+            profile_file = argv[++i];
+        } else if (argv[i][0] != '-' && !input_file) {
+            input_file = argv[i];
+        } else {
+            input_file = NULL;
+            break;
+        }
+    }
+    // Check for the correct command-line arguments (profiles need the whole
+    // program, so they do not go with --stream)
+    if (!input_file || (streaming && (profile_generate || profile_file)) || (profile_generate && profile_file)) {
+        fprintf(stderr, "Usage: %s [--stream] [--openmp] [--pgo-gen | --pgo-use <profile.json>] <input_filename>\n", argv[0]);
         return 1; // Indicate error
     }
 
     const char* output_c_file = "output.c"; // Default output filename
 
     // Try to open the input file specified in the arguments
-    yyin = fopen(argv[1], "r");
-    if (yyin == NULL) {
-        perror(argv[1]); // Print system error message (e.g., "file not found")
+    if (!lexer_open(input_file)) {
+        perror(input_file); // Print system error message (e.g., "file not found")
         return 1; // Indicate error
     }
 
-    printf("Parsing file: %s\n", argv[1]);
+    printf("Parsing file: %s\n", input_file);
 
-    // Call the Bison-generated parser
+    // Call the Bison-generated parser. When streaming, code is generated as it
+    // parses; the whole-program passes (optimisation, renaming, integer
+    // inference) need the complete AST and are skipped.
+    if (streaming) {
+        if (!codegen_begin(output_c_file)) return 1;
+        stream_top_level = stream_item;
+        printf("--- Generating C code to %s while parsing ---\n", output_c_file);
+    }
     int parse_result = yyparse();
+    if (streaming) {
+        stream_top_level = NULL;
+        codegen_end();
+    }
 
     // Close the input file
-    fclose(yyin);
+    lexer_close();
 
     int return_code = 1; // Default to failure
 
     // Check the result of parsing
     if (parse_result == 0) {
         printf("\nParsing completed successfully.\n");
-        printf("--- Abstract Syntax Tree ---\n");
-        if (ast_root) {
+        if (streaming) {
+            ast_free_node(ast_root); // Only the function definitions are left
+            ast_root = NULL;
+            return_code = 0; // Success
+        } else if (ast_root) {
+            printf("--- Abstract Syntax Tree ---\n");
             print_ast(ast_root, 0);
-            printf("--- Generating C code to %s ---\n", output_c_file);
-            generate_code(ast_root, output_c_file);
+            int removed = optimize_ast(ast_root);
+            printf("--- Optimizing: %d dead statement(s) removed ---\n", removed);
+            int versions = rename_variables(ast_root);
+            printf("--- Renaming: %d variable version(s) created ---\n", versions);
+            int integers = infer_integers(ast_root);
+            printf("--- Integer inference: %d integer variable(s) ---\n", integers);
+            ProfileSite *profile = NULL;
+            if (profile_generate || profile_file) {
+                uint64_t fingerprint;
+                int sites = number_profile_sites(ast_root, &fingerprint);
+                printf("--- Profile: %d site(s) ---\n", sites);
+                if (profile_generate) {
+                    codegen_set_profile_generate((size_t)sites, fingerprint);
+                } else {
+                    profile = runtime_profile_load(profile_file, (size_t)sites, fingerprint);
+                    codegen_set_profile(profile);
+                }
+            }
+            if (!profile_file || profile) {
+                printf("--- Generating C code to %s ---\n", output_c_file);
+                generate_code(ast_root, output_c_file);
+                return_code = 0; // Success
+            }
+            free(profile);
             printf("--- Freeing AST ---\n");
             ast_free_node(ast_root);
             ast_root = NULL; // Avoid dangling pointer
-            return_code = 0; // Success
         } else {
+            printf("--- Abstract Syntax Tree ---\n");
             printf("(No AST generated - empty input?)\n");
             return_code = 0; // Technically success if input was empty and parsed
         }
@@ -0,0 +1,1344 @@
+#include "optimize.h"
+#include "symtab.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+//------------------------------------------------------------------------------
+// Purity Table
+// Built-ins whose only effect is their result. Anything not listed here (I/O
+// such as print, save_vector, scatter_plot, read_vector and read_csv, and
+// external C functions) is assumed to have side effects. Runtime checks of
+// a pure built-in (e.g. a size mismatch) are not effects: an unused result
+// is not computed, so it is not checked either.
+//------------------------------------------------------------------------------
+static const char *pure_builtins[] = {
+    "to_f64", "to_f32", "to_i64",
+    "cumsum", "cumprod", "compact",
+    "sort", "argsort",
+    "quantile", "median", "quantile_approx",
+    "rolling_sum", "rolling_mean", "rolling_std", "rolling_min", "rolling_max",
+    "fft", "ifft", "convolve", "correlate",
+    "matrix", "rows", "cols", "row", "col", "transpose", "matmul", "matvec",
+    NULL
+};
+
+// Functions defined with 'def' are pure if their bodies only make pure calls
+typedef enum { PURITY_UNKNOWN, PURITY_CHECKING, PURITY_PURE, PURITY_IMPURE } Purity;
+
+typedef struct {
+    ASTNode *def;
+    Purity purity;
+} FunctionInfo;
+
+static FunctionInfo *functions = NULL;
+static size_t function_count = 0;
+
+// Maps pointers (symbols, nodes) to dense ids, with open addressing
+typedef struct {
+    const void **keys;
+    size_t *values;
+    size_t capacity;
+    size_t count;
+} PointerMap;
+
+// Variable and definition sets are bitsets over these ids
+static PointerMap symbol_ids;
+static size_t set_words = 0;
+
+static int removed_count = 0;
+
+static int node_is_pure(ASTNode *node);
+static void live_statement(ASTNode **slot, uint64_t *live, int apply);
+
+//------------------------------------------------------------------------------
+// Ids and Sets
+//------------------------------------------------------------------------------
+static size_t map_slot(const PointerMap *map, const void *key) {
+    size_t slot = ((uintptr_t)key >> 4) & (map->capacity - 1);
+    while (map->keys[slot] && map->keys[slot] != key) slot = (slot + 1) & (map->capacity - 1);
+    return slot;
+}
+
+// Id of 'key'; keys seen for the first time get the next id (map->count)
+static size_t map_id(PointerMap *map, const void *key) {
+    if (2 * (map->count + 1) > map->capacity) {
+        PointerMap old = *map;
+        map->capacity = (old.capacity == 0) ? 64 : old.capacity * 2;
+        map->keys = (const void**)calloc(map->capacity, sizeof(void*));
+        map->values = (size_t*)malloc(map->capacity * sizeof(size_t));
+        if (!map->keys || !map->values) { perror("malloc failed for pointer map"); exit(1); }
+        for (size_t i = 0; i < old.capacity; ++i) {
+            if (!old.keys[i]) continue;
+            size_t slot = map_slot(map, old.keys[i]);
+            map->keys[slot] = old.keys[i];
+            map->values[slot] = old.values[i];
+        }
+        free(old.keys);
+        free(old.values);
+    }
+    size_t slot = map_slot(map, key);
+    if (!map->keys[slot]) {
+        map->keys[slot] = key;
+        map->values[slot] = map->count++;
+    }
+    return map->values[slot];
+}
+
+static void map_free(PointerMap *map) {
+    free(map->keys);
+    free(map->values);
+    memset(map, 0, sizeof(PointerMap));
+}
+
+static size_t symbol_id(Symbol *sym) {
+    return map_id(&symbol_ids, sym);
+}
+
+static uint64_t *set_new() {
+    uint64_t *set = (uint64_t*)calloc(set_words, sizeof(uint64_t));
+    if (!set) { perror("calloc failed for bitset"); exit(1); }
+    return set;
+}
+
+static uint64_t *set_copy(const uint64_t *set) {
+    uint64_t *copy = set_new();
+    memcpy(copy, set, set_words * sizeof(uint64_t));
+    return copy;
+}
+
+static int set_has(const uint64_t *set, size_t id) {
+    return (set[id / 64] >> (id % 64)) & 1;
+}
+
+static void set_add(uint64_t *set, size_t id) {
+    set[id / 64] |= (uint64_t)1 << (id % 64);
+}
+
+static void set_remove(uint64_t *set, size_t id) {
+    set[id / 64] &= ~((uint64_t)1 << (id % 64));
+}
+
+static void set_union(uint64_t *set, const uint64_t *other) {
+    for (size_t i = 0; i < set_words; ++i) set[i] |= other[i];
+}
+
+static int set_equal(const uint64_t *a, const uint64_t *b) {
+    return memcmp(a, b, set_words * sizeof(uint64_t)) == 0;
+}
+
+// Gives every symbol in the tree an id (so the set size is known up front)
+static void number_symbols(ASTNode *node) {
+    if (!node) return;
+    switch (node->type) {
+        case NODE_TYPE_IDENTIFIER: symbol_id(node->data.identifier_symbol); break;
+        case NODE_TYPE_VECTOR:
+            for (size_t i = 0; i < node->data.vector_elements.count; ++i) number_symbols(node->data.vector_elements.items[i]);
+            break;
+        case NODE_TYPE_BINARY_OP:
+            number_symbols(node->data.binary_op.left);
+            number_symbols(node->data.binary_op.right);
+            break;
+        case NODE_TYPE_UNARY_OP: number_symbols(node->data.unary_op.operand); break;
+        case NODE_TYPE_ASSIGNMENT:
+            symbol_id(node->data.assignment.target_symbol);
+            number_symbols(node->data.assignment.expression);
+            break;
+        case NODE_TYPE_STATEMENT_LIST:
+            for (size_t i = 0; i < node->data.statement_list.count; ++i) number_symbols(node->data.statement_list.items[i]);
+            break;
+        case NODE_TYPE_IF:
+            number_symbols(node->data.if_stmt.condition);
+            number_symbols(node->data.if_stmt.if_branch);
+            number_symbols(node->data.if_stmt.else_branch);
+            break;
+        case NODE_TYPE_WHILE:
+            number_symbols(node->data.while_loop.condition);
+            number_symbols(node->data.while_loop.loop_body);
+            break;
+        case NODE_TYPE_FOR:
+            symbol_id(node->data.for_loop.index_symbol);
+            for (size_t i = 0; i < node->data.for_loop.reduction_count; ++i) symbol_id(node->data.for_loop.reductions[i].variable);
+            number_symbols(node->data.for_loop.range_start);
+            number_symbols(node->data.for_loop.range_end);
+            number_symbols(node->data.for_loop.chunk_size);
+            number_symbols(node->data.for_loop.loop_body);
+            break;
+        case NODE_TYPE_FUNC_CALL:
+            for (size_t i = 0; i < node->data.func_call.arguments.count; ++i) number_symbols(node->data.func_call.arguments.items[i]);
+            break;
+        case NODE_TYPE_FUNC_DEF:
+            for (size_t i = 0; i < node->data.func_def.parameters.count; ++i) number_symbols(node->data.func_def.parameters.items[i]);
+            number_symbols(node->data.func_def.body);
+            break;
+        case NODE_TYPE_RETURN: number_symbols(node->data.return_stmt.expression); break;
+        default: break;
+    }
+}
+
+//------------------------------------------------------------------------------
+// Purity
+//------------------------------------------------------------------------------
+static int call_is_pure(const char *name) {
+    for (size_t i = 0; i < function_count; ++i) {
+        FunctionInfo *function = &functions[i];
+        if (strcmp(function->def->data.func_def.function_symbol->name, name) != 0) continue;
+        if (function->purity == PURITY_UNKNOWN) {
+            function->purity = PURITY_CHECKING; // Recursive calls count as impure
+            function->purity = node_is_pure(function->def->data.func_def.body) ? PURITY_PURE : PURITY_IMPURE;
+        }
+        return function->purity == PURITY_PURE; // User functions hide built-ins
+    }
+    for (size_t i = 0; pure_builtins[i]; ++i) {
+        if (strcmp(pure_builtins[i], name) == 0) return 1;
+    }
+    return 0;
+}
+
+// Whether running 'node' can have an effect other than assigning variables
+static int node_is_pure(ASTNode *node) {
+    if (!node) return 1;
+    switch (node->type) {
+        case NODE_TYPE_VECTOR:
+            for (size_t i = 0; i < node->data.vector_elements.count; ++i) {
+                if (!node_is_pure(node->data.vector_elements.items[i])) return 0;
+            }
+            return 1;
+        case NODE_TYPE_BINARY_OP:
+            return node_is_pure(node->data.binary_op.left) && node_is_pure(node->data.binary_op.right);
+        case NODE_TYPE_UNARY_OP:
+            return node_is_pure(node->data.unary_op.operand);
+        case NODE_TYPE_ASSIGNMENT:
+            return node_is_pure(node->data.assignment.expression);
+        case NODE_TYPE_STATEMENT_LIST:
+            for (size_t i = 0; i < node->data.statement_list.count; ++i) {
+                if (!node_is_pure(node->data.statement_list.items[i])) return 0;
+            }
+            return 1;
+        case NODE_TYPE_IF:
+            return node_is_pure(node->data.if_stmt.condition) && node_is_pure(node->data.if_stmt.if_branch) &&
+                   node_is_pure(node->data.if_stmt.else_branch);
+        case NODE_TYPE_WHILE:
+            return node_is_pure(node->data.while_loop.condition) && node_is_pure(node->data.while_loop.loop_body);
+        case NODE_TYPE_FOR:
+            return node_is_pure(node->data.for_loop.range_start) && node_is_pure(node->data.for_loop.range_end) &&
+                   node_is_pure(node->data.for_loop.chunk_size) && node_is_pure(node->data.for_loop.loop_body);
+        case NODE_TYPE_FUNC_CALL:
+            for (size_t i = 0; i < node->data.func_call.arguments.count; ++i) {
+                if (!node_is_pure(node->data.func_call.arguments.items[i])) return 0;
+            }
+            return call_is_pure(node->data.func_call.function_symbol->name);
+        case NODE_TYPE_RETURN:
+            return node_is_pure(node->data.return_stmt.expression);
+        default: // Numbers, strings, identifiers
+            return 1;
+    }
+}
+
+//------------------------------------------------------------------------------
+// Liveness
+// Statements are visited backwards with the set of variables live after them,
+// which becomes the set live before them. With 'apply' set, dead statements
+// are removed on the way; loops are first iterated without it to a fixed
+// point.
+//------------------------------------------------------------------------------
+static void add_uses(ASTNode *node, uint64_t *live) {
+    if (!node) return;
+    switch (node->type) {
+        case NODE_TYPE_IDENTIFIER: set_add(live, symbol_id(node->data.identifier_symbol)); break;
+        case NODE_TYPE_VECTOR:
+            for (size_t i = 0; i < node->data.vector_elements.count; ++i) add_uses(node->data.vector_elements.items[i], live);
+            break;
+        case NODE_TYPE_BINARY_OP:
+            add_uses(node->data.binary_op.left, live);
+            add_uses(node->data.binary_op.right, live);
+            break;
+        case NODE_TYPE_UNARY_OP: add_uses(node->data.unary_op.operand, live); break;
+        case NODE_TYPE_FUNC_CALL:
+            for (size_t i = 0; i < node->data.func_call.arguments.count; ++i) add_uses(node->data.func_call.arguments.items[i], live);
+            break;
+        default: break;
+    }
+}
+
+static void remove_statement(ASTNode **slot) {
+    ast_free_node(*slot);
+    *slot = NULL;
+    removed_count++;
+}
+
+static int branch_is_empty(ASTNode *branch) {
+    return !branch || (branch->type == NODE_TYPE_STATEMENT_LIST && branch->data.statement_list.count == 0);
+}
+
+// The body of an if or loop: a removed statement becomes an empty block
+static void live_branch(ASTNode **slot, uint64_t *live, int apply) {
+    live_statement(slot, live, apply);
+    if (!*slot) *slot = ast_new_statement_list();
+}
+
+static void live_list(ASTNode *list, uint64_t *live, int apply) {
+    NodeList *items = &list->data.statement_list;
+    if (apply) { // Nothing after a return runs
+        for (size_t k = 0; k < items->count; ++k) {
+            if (items->items[k]->type != NODE_TYPE_RETURN) continue;
+            for (size_t j = k + 1; j < items->count; ++j) remove_statement(&items->items[j]);
+            items->count = k + 1;
+            break;
+        }
+    }
+    for (size_t k = items->count; k-- > 0; ) {
+        live_statement(&items->items[k], live, apply);
+    }
+    if (apply) {
+        size_t kept = 0;
+        for (size_t k = 0; k < items->count; ++k) {
+            if (items->items[k]) items->items[kept++] = items->items[k];
+        }
+        items->count = kept;
+    }
+}
+
+// Live set at the top of a loop whose body leaves 'exit_live' live (plus
+// whatever the next iteration reads). The index (for loops) is assigned
+// before each iteration.
+static uint64_t *loop_head(ASTNode *body, const uint64_t *exit_live, Symbol *index) {
+    uint64_t *head = set_copy(exit_live);
+    for (;;) {
+        uint64_t *next = set_copy(head);
+        live_statement(&body, next, 0);
+        if (index) set_remove(next, symbol_id(index));
+        set_union(next, exit_live);
+        if (set_equal(next, head)) {
+            free(next);
+            return head;
+        }
+        free(head);
+        head = next;
+    }
+}
+
+static void live_statement(ASTNode **slot, uint64_t *live, int apply) {
+    ASTNode *node = *slot;
+    if (!node) return;
+    switch (node->type) {
+        case NODE_TYPE_ASSIGNMENT: {
+            Symbol *target = node->data.assignment.target_symbol;
+            ASTNode *expression = node->data.assignment.expression;
+            if (set_has(live, symbol_id(target))) {
+                set_remove(live, symbol_id(target));
+                add_uses(expression, live);
+            } else if (node_is_pure(expression)) {
+                if (apply) remove_statement(slot); // Dead store
+            } else {
+                if (apply) { // Keep the effects, drop the store
+                    node->data.assignment.expression = NULL;
+                    ast_free_node(node);
+                    *slot = expression;
+                    removed_count++;
+                }
+                add_uses(expression, live);
+            }
+            break;
+        }
+
+        case NODE_TYPE_NUMBER:
+        case NODE_TYPE_STRING:
+        case NODE_TYPE_IDENTIFIER:
+        case NODE_TYPE_VECTOR:
+        case NODE_TYPE_DENSE_VECTOR:
+        case NODE_TYPE_BINARY_OP:
+        case NODE_TYPE_UNARY_OP:
+        case NODE_TYPE_FUNC_CALL:
+            if (node_is_pure(node)) {
+                if (apply) remove_statement(slot); // Value discarded, no effects
+            } else {
+                add_uses(node, live);
+            }
+            break;
+
+        case NODE_TYPE_STATEMENT_LIST:
+            live_list(node, live, apply);
+            break;
+
+        case NODE_TYPE_IF: {
+            uint64_t *else_live = set_copy(live);
+            live_branch(&node->data.if_stmt.if_branch, live, apply);
+            if (node->data.if_stmt.else_branch) live_branch(&node->data.if_stmt.else_branch, else_live, apply);
+            set_union(live, else_live);
+            free(else_live);
+            add_uses(node->data.if_stmt.condition, live);
+            if (apply && branch_is_empty(node->data.if_stmt.if_branch) &&
+                branch_is_empty(node->data.if_stmt.else_branch) && node_is_pure(node->data.if_stmt.condition)) {
+                remove_statement(slot);
+            }
+            break;
+        }
+
+        case NODE_TYPE_WHILE: {
+            // The condition is evaluated before every iteration and once more at the end
+            uint64_t *exit_live = set_copy(live);
+            add_uses(node->data.while_loop.condition, exit_live);
+            uint64_t *head = loop_head(node->data.while_loop.loop_body, exit_live, NULL);
+            if (apply) {
+                uint64_t *body_live = set_copy(head);
+                live_branch(&node->data.while_loop.loop_body, body_live, 1);
+                free(body_live);
+            }
+            memcpy(live, head, set_words * sizeof(uint64_t));
+            free(head);
+            free(exit_live);
+            break;
+        }
+
+        case NODE_TYPE_FOR: {
+            ForNode *loop = &node->data.for_loop;
+            uint64_t *head;
+            if (apply) loop->index_live_after = set_has(live, symbol_id(loop->index_symbol)); // For the write-back of a parallel for
+            if (loop->is_parallel) {
+                // Each task has private copies: only the reductions (and values
+                // carried between iterations of a task) are live after the body
+                uint64_t *exit_live = set_new();
+                for (size_t r = 0; r < loop->reduction_count; ++r) set_add(exit_live, symbol_id(loop->reductions[r].variable));
+                head = loop_head(loop->loop_body, exit_live, loop->index_symbol);
+                free(exit_live);
+            } else {
+                // The index keeps its old value if the range is empty
+                head = loop_head(loop->loop_body, live, loop->index_symbol);
+            }
+            if (apply) {
+                uint64_t *body_live = set_copy(head);
+                live_branch(&loop->loop_body, body_live, 1);
+                free(body_live);
+            }
+            set_union(live, head);
+            free(head);
+            add_uses(loop->range_start, live);
+            add_uses(loop->range_end, live);
+            add_uses(loop->chunk_size, live);
+            break;
+        }
+
+        case NODE_TYPE_RETURN:
+            memset(live, 0, set_words * sizeof(uint64_t)); // Locals die at the return
+            add_uses(node->data.return_stmt.expression, live);
+            break;
+
+        default: // Function definitions are optimised on their own
+            break;
+    }
+}
+
+//------------------------------------------------------------------------------
+// Entry Point
+//------------------------------------------------------------------------------
+int optimize_ast(ASTNode *ast_root) {
+    if (!ast_root || ast_root->type != NODE_TYPE_STATEMENT_LIST) return 0;
+    removed_count = 0;
+    number_symbols(ast_root);
+    set_words = symbol_ids.count / 64 + 1;
+
+    NodeList *items = &ast_root->data.statement_list;
+    for (size_t i = 0; i < items->count; ++i) {
+        if (items->items[i]->type != NODE_TYPE_FUNC_DEF) continue;
+        FunctionInfo *grown = (FunctionInfo*)realloc(functions, (function_count + 1) * sizeof(FunctionInfo));
+        if (!grown) { perror("realloc failed for function info"); exit(1); }
+        functions = grown;
+        functions[function_count].def = items->items[i];
+        functions[function_count].purity = PURITY_UNKNOWN;
+        function_count++;
+    }
+
+    // Function bodies (nothing is live after them), then the program (nothing
+    // is read after its last statement)
+    for (size_t i = 0; i < function_count; ++i) {
+        uint64_t *live = set_new();
+        live_list(functions[i].def->data.func_def.body, live, 1);
+        free(live);
+    }
+    uint64_t *live = set_new();
+    live_list(ast_root, live, 1);
+    free(live);
+
+    free(functions);
+    functions = NULL;
+    function_count = 0;
+    map_free(&symbol_ids);
+    return removed_count;
+}
+
+//------------------------------------------------------------------------------
+// Variable Renaming
+// Reaching definitions are followed forwards through the program; the
+// definitions that reach the same use are merged into one web (union-find).
+// Each web becomes a variable of its own, so codegen infers a type per web
+// and a name can hold values of different types in different parts of the
+// program. Codegen puts versions of the same type back into one C variable
+// (see Symbol.storage).
+//------------------------------------------------------------------------------
+typedef struct {
+    Symbol *symbol;
+    FuncDefNode *owner;     // Function whose scope holds the variable, NULL for globals
+    int is_parameter;
+    size_t first_bit;       // Its definitions are bits first_bit .. first_bit + def_count - 1
+    size_t def_count;
+    int version_count;
+} VariableInfo;
+
+typedef struct {
+    size_t variable;
+    ASTNode *node;          // Assignment or for loop (its index), NULL for the value on entry
+    size_t web;             // Union-find parent
+    Symbol *version;        // Variable of the web (set on its root)
+    int used;               // Reaches at least one use
+} Definition;
+
+// A symbol pointer in the AST that reads the variable, and one definition reaching it
+typedef struct {
+    Symbol **slot;
+    size_t definition;
+} UseSite;
+
+static VariableInfo *variables = NULL;
+static Definition *definitions = NULL;
+static size_t definition_count = 0;
+static size_t *definition_at_bit = NULL;
+static PointerMap definition_ids;
+static UseSite *use_sites = NULL;
+static size_t use_count = 0;
+static size_t use_capacity = 0;
+static int versions_created = 0;
+
+static void reach_statement(ASTNode *node, uint64_t *reaching, int apply);
+
+static void add_definition(size_t variable, ASTNode *node, const void *key) {
+    size_t id = map_id(&definition_ids, key);
+    if ((id & (id + 1)) == 0) { // Grow at powers of two
+        Definition *grown = (Definition*)realloc(definitions, 2 * (id + 1) * sizeof(Definition));
+        if (!grown) { perror("realloc failed for definitions"); exit(1); }
+        definitions = grown;
+    }
+    definitions[id].variable = variable;
+    definitions[id].node = node;
+    definitions[id].web = id;
+    definitions[id].version = NULL;
+    definitions[id].used = 0;
+    variables[variable].def_count++;
+    definition_count = id + 1;
+}
+
+// Numbers a variable the first time it is seen, with its value on entry as
+// its first definition
+static size_t add_variable(Symbol *sym, FuncDefNode *owner) {
+    size_t known = symbol_ids.count;
+    size_t id = symbol_id(sym);
+    if (id == known) {
+        if ((id & (id + 1)) == 0) {
+            VariableInfo *grown = (VariableInfo*)realloc(variables, 2 * (id + 1) * sizeof(VariableInfo));
+            if (!grown) { perror("realloc failed for variables"); exit(1); }
+            variables = grown;
+        }
+        memset(&variables[id], 0, sizeof(VariableInfo));
+        variables[id].symbol = sym;
+        variables[id].owner = owner;
+        add_definition(id, NULL, sym);
+    }
+    return id;
+}
+
+static void collect_definitions(ASTNode *node, FuncDefNode *owner) {
+    if (!node) return;
+    switch (node->type) {
+        case NODE_TYPE_IDENTIFIER: add_variable(node->data.identifier_symbol, owner); break;
+        case NODE_TYPE_VECTOR:
+            for (size_t i = 0; i < node->data.vector_elements.count; ++i) collect_definitions(node->data.vector_elements.items[i], owner);
+            break;
+        case NODE_TYPE_BINARY_OP:
+            collect_definitions(node->data.binary_op.left, owner);
+            collect_definitions(node->data.binary_op.right, owner);
+            break;
+        case NODE_TYPE_UNARY_OP: collect_definitions(node->data.unary_op.operand, owner); break;
+        case NODE_TYPE_ASSIGNMENT:
+            add_definition(add_variable(node->data.assignment.target_symbol, owner), node, node);
+            collect_definitions(node->data.assignment.expression, owner);
+            break;
+        case NODE_TYPE_STATEMENT_LIST:
+            for (size_t i = 0; i < node->data.statement_list.count; ++i) collect_definitions(node->data.statement_list.items[i], owner);
+            break;
+        case NODE_TYPE_IF:
+            collect_definitions(node->data.if_stmt.condition, owner);
+            collect_definitions(node->data.if_stmt.if_branch, owner);
+            collect_definitions(node->data.if_stmt.else_branch, owner);
+            break;
+        case NODE_TYPE_WHILE:
+            collect_definitions(node->data.while_loop.condition, owner);
+            collect_definitions(node->data.while_loop.loop_body, owner);
+            break;
+        case NODE_TYPE_FOR:
+            add_definition(add_variable(node->data.for_loop.index_symbol, owner), node, node);
+            for (size_t i = 0; i < node->data.for_loop.reduction_count; ++i) add_variable(node->data.for_loop.reductions[i].variable, owner);
+            collect_definitions(node->data.for_loop.range_start, owner);
+            collect_definitions(node->data.for_loop.range_end, owner);
+            collect_definitions(node->data.for_loop.chunk_size, owner);
+            collect_definitions(node->data.for_loop.loop_body, owner);
+            break;
+        case NODE_TYPE_FUNC_CALL:
+            for (size_t i = 0; i < node->data.func_call.arguments.count; ++i) collect_definitions(node->data.func_call.arguments.items[i], owner);
+            break;
+        case NODE_TYPE_FUNC_DEF: {
+            FuncDefNode *def = &node->data.func_def;
+            for (size_t i = 0; i < def->parameters.count; ++i) {
+                size_t parameter = add_variable(def->parameters.items[i]->data.identifier_symbol, def);
+                variables[parameter].is_parameter = 1;
+            }
+            collect_definitions(def->body, def);
+            break;
+        }
+        case NODE_TYPE_RETURN: collect_definitions(node->data.return_stmt.expression, owner); break;
+        default: break;
+    }
+}
+
+static size_t web_find(size_t def) {
+    while (definitions[def].web != def) {
+        definitions[def].web = definitions[definitions[def].web].web;
+        def = definitions[def].web;
+    }
+    return def;
+}
+
+static void web_union(size_t a, size_t b) {
+    a = web_find(a);
+    b = web_find(b);
+    if (a != b) definitions[a > b ? a : b].web = (a > b) ? b : a; // The earlier definition stays the root
+}
+
+// Definitions are keyed by their node, or by the symbol for the value on entry
+static const void *definition_key(size_t def) {
+    if (definitions[def].node) return definitions[def].node;
+    return variables[definitions[def].variable].symbol;
+}
+
+// All definitions of the variable that reach a use belong to one web
+static void reach_use(Symbol **slot, const uint64_t *reaching, int apply) {
+    VariableInfo *var = &variables[symbol_id(*slot)];
+    size_t first = SIZE_MAX;
+    for (size_t bit = var->first_bit; bit < var->first_bit + var->def_count; ++bit) {
+        if (!set_has(reaching, bit)) continue;
+        size_t def = definition_at_bit[bit];
+        definitions[def].used = 1;
+        if (first == SIZE_MAX) first = def;
+        else web_union(first, def);
+    }
+    if (!apply || first == SIZE_MAX) return; // Unreachable code keeps its symbol
+    if (use_count == use_capacity) {
+        use_capacity = (use_capacity == 0) ? 64 : use_capacity * 2;
+        use_sites = (UseSite*)realloc(use_sites, use_capacity * sizeof(UseSite));
+        if (!use_sites) { perror("realloc failed for use sites"); exit(1); }
+    }
+    use_sites[use_count].slot = slot;
+    use_sites[use_count].definition = first;
+    use_count++;
+}
+
+static void reach_definition(Symbol *sym, ASTNode *node, uint64_t *reaching) {
+    VariableInfo *var = &variables[symbol_id(sym)];
+    for (size_t bit = var->first_bit; bit < var->first_bit + var->def_count; ++bit) set_remove(reaching, bit);
+    set_add(reaching, map_id(&definition_ids, node));
+}
+
+static void reach_expression(ASTNode *node, const uint64_t *reaching, int apply) {
+    if (!node) return;
+    switch (node->type) {
+        case NODE_TYPE_IDENTIFIER: reach_use(&node->data.identifier_symbol, reaching, apply); break;
+        case NODE_TYPE_VECTOR:
+            for (size_t i = 0; i < node->data.vector_elements.count; ++i) reach_expression(node->data.vector_elements.items[i], reaching, apply);
+            break;
+        case NODE_TYPE_BINARY_OP:
+            reach_expression(node->data.binary_op.left, reaching, apply);
+            reach_expression(node->data.binary_op.right, reaching, apply);
+            break;
+        case NODE_TYPE_UNARY_OP: reach_expression(node->data.unary_op.operand, reaching, apply); break;
+        case NODE_TYPE_FUNC_CALL:
+            for (size_t i = 0; i < node->data.func_call.arguments.count; ++i) reach_expression(node->data.func_call.arguments.items[i], reaching, apply);
+            break;
+        default: break;
+    }
+}
+
+// One iteration of a loop, from the top of the condition (while) or the
+// assignment of the index (for) to the end of the body
+static void reach_iteration(ASTNode *node, uint64_t *reaching, int apply) {
+    if (node->type == NODE_TYPE_WHILE) {
+        reach_expression(node->data.while_loop.condition, reaching, apply);
+        reach_statement(node->data.while_loop.loop_body, reaching, apply);
+    } else {
+        reach_definition(node->data.for_loop.index_symbol, node, reaching);
+        reach_statement(node->data.for_loop.loop_body, reaching, apply);
+    }
+}
+
+// Definitions reaching the top of a loop entered with 'before': iterated
+// until the ones coming round from the end of the body stop growing
+static uint64_t *reach_loop(ASTNode *node, const uint64_t *before, int apply) {
+    uint64_t *head = set_copy(before);
+    for (;;) {
+        uint64_t *next = set_copy(head);
+        reach_iteration(node, next, 0);
+        set_union(next, head);
+        if (set_equal(next, head)) {
+            free(next);
+            break;
+        }
+        free(head);
+        head = next;
+    }
+    if (apply) {
+        uint64_t *body = set_copy(head);
+        reach_iteration(node, body, 1);
+        free(body);
+    }
+    return head;
+}
+
+static void reach_statement(ASTNode *node, uint64_t *reaching, int apply) {
+    if (!node) return;
+    switch (node->type) {
+        case NODE_TYPE_ASSIGNMENT:
+            reach_expression(node->data.assignment.expression, reaching, apply);
+            reach_definition(node->data.assignment.target_symbol, node, reaching);
+            break;
+
+        case NODE_TYPE_NUMBER:
+        case NODE_TYPE_STRING:
+        case NODE_TYPE_IDENTIFIER:
+        case NODE_TYPE_VECTOR:
+        case NODE_TYPE_DENSE_VECTOR:
+        case NODE_TYPE_BINARY_OP:
+        case NODE_TYPE_UNARY_OP:
+        case NODE_TYPE_FUNC_CALL:
+            reach_expression(node, reaching, apply);
+            break;
+
+        case NODE_TYPE_STATEMENT_LIST:
+            for (size_t i = 0; i < node->data.statement_list.count; ++i) {
+                reach_statement(node->data.statement_list.items[i], reaching, apply);
+            }
+            break;
+
+        case NODE_TYPE_IF: {
+            reach_expression(node->data.if_stmt.condition, reaching, apply);
+            uint64_t *then_reaching = set_copy(reaching);
+            reach_statement(node->data.if_stmt.if_branch, then_reaching, apply);
+            reach_statement(node->data.if_stmt.else_branch, reaching, apply);
+            set_union(reaching, then_reaching);
+            free(then_reaching);
+            break;
+        }
+
+        case NODE_TYPE_WHILE: {
+            uint64_t *head = reach_loop(node, reaching, apply);
+            memcpy(reaching, head, set_words * sizeof(uint64_t)); // Leaves after the condition
+            free(head);
+            break;
+        }
+
+        case NODE_TYPE_FOR: {
+            ForNode *loop = &node->data.for_loop;
+            reach_expression(loop->range_start, reaching, apply);
+            reach_expression(loop->range_end, reaching, apply);
+            reach_expression(loop->chunk_size, reaching, apply);
+            uint64_t *head = reach_loop(node, reaching, apply);
+            if (!loop->is_parallel) {
+                memcpy(reaching, head, set_words * sizeof(uint64_t)); // An empty range leaves the index as it was
+            } else {
+                // Tasks assign private copies: afterwards only the reductions
+                // (combined with the value before the loop) and the index change
+                for (size_t r = 0; r < loop->reduction_count; ++r) {
+                    reach_use(&loop->reductions[r].variable, head, apply);
+                    VariableInfo *var = &variables[symbol_id(loop->reductions[r].variable)];
+                    for (size_t bit = var->first_bit; bit < var->first_bit + var->def_count; ++bit) {
+                        if (set_has(head, bit)) set_add(reaching, bit);
+                    }
+                }
+                set_add(reaching, map_id(&definition_ids, node));
+            }
+            free(head);
+            break;
+        }
+
+        case NODE_TYPE_RETURN:
+            reach_expression(node->data.return_stmt.expression, reaching, apply);
+            memset(reaching, 0, set_words * sizeof(uint64_t)); // Nothing reaches past a return
+            break;
+
+        default: // Function definitions are followed on their own
+            break;
+    }
+}
+
+// A new variable "name__N" next to the original, in the same scope
+static Symbol *new_version(VariableInfo *var) {
+    size_t size = strlen(var->symbol->name) + 32;
+    char *name = (char*)malloc(size);
+    if (!name) { perror("malloc failed for version name"); exit(1); }
+    if (var->owner) symbol_reopen_scope(var->owner->locals);
+    do {
+        snprintf(name, size, "%s__%d", var->symbol->name, ++var->version_count + 1);
+    } while (symbol_lookup(name));
+    Symbol *version = symbol_insert(name);
+    version->base = var->symbol;
+    if (var->owner) var->owner->locals = symbol_pop_scope();
+    free(name);
+    versions_created++;
+    return version;
+}
+
+int rename_variables(ASTNode *ast_root) {
+    if (!ast_root || ast_root->type != NODE_TYPE_STATEMENT_LIST) return 0;
+    versions_created = 0;
+    collect_definitions(ast_root, NULL);
+
+    // Lay the definitions out by variable (the value on entry first), so a
+    // definition kills the others by clearing one range of bits
+    size_t variable_count = symbol_ids.count;
+    size_t next_bit = 0;
+    for (size_t v = 0; v < variable_count; ++v) {
+        variables[v].first_bit = next_bit;
+        next_bit += variables[v].def_count;
+        variables[v].def_count = 0;
+    }
+    definition_at_bit = (size_t*)malloc((definition_count > 0 ? definition_count : 1) * sizeof(size_t));
+    if (!definition_at_bit) { perror("malloc failed for definitions"); exit(1); }
+    for (size_t def = 0; def < definition_count; ++def) {
+        VariableInfo *var = &variables[definitions[def].variable];
+        definition_at_bit[var->first_bit + var->def_count++] = def;
+    }
+    map_free(&definition_ids);
+    for (size_t bit = 0; bit < definition_count; ++bit) {
+        map_id(&definition_ids, definition_key(definition_at_bit[bit])); // Now maps each key to its bit
+    }
+    set_words = definition_count / 64 + 1;
+
+    // Every function body, then the program, starts from the values on entry
+    uint64_t *entry = set_new();
+    for (size_t v = 0; v < variable_count; ++v) set_add(entry, variables[v].first_bit);
+    NodeList *items = &ast_root->data.statement_list;
+    for (size_t i = 0; i < items->count; ++i) {
+        if (items->items[i]->type != NODE_TYPE_FUNC_DEF) continue;
+        uint64_t *reaching = set_copy(entry);
+        reach_statement(items->items[i]->data.func_def.body, reaching, 1);
+        free(reaching);
+    }
+    reach_statement(ast_root, entry, 1);
+    free(entry);
+
+    // The original symbol goes to the web holding the value on entry if that
+    // is read (parameters always), otherwise to the first web assigned
+    for (size_t v = 0; v < variable_count; ++v) {
+        VariableInfo *var = &variables[v];
+        size_t entry_def = definition_at_bit[var->first_bit];
+        size_t keep = (definitions[entry_def].used || var->is_parameter) ? web_find(entry_def) : SIZE_MAX;
+        var->symbol->entry_unread = (keep == SIZE_MAX);
+        for (size_t bit = var->first_bit; bit < var->first_bit + var->def_count; ++bit) {
+            size_t def = definition_at_bit[bit];
+            if (def == entry_def && keep == SIZE_MAX) continue; // Value on entry never read
+            size_t web = web_find(def);
+            if (definitions[web].version) continue;
+            if (keep == SIZE_MAX) keep = web;
+            definitions[web].version = (web == keep) ? var->symbol : new_version(var);
+        }
+    }
+    for (size_t def = 0; def < definition_count; ++def) {
+        ASTNode *node = definitions[def].node;
+        if (!node) continue;
+        Symbol *version = definitions[web_find(def)].version;
+        if (node->type == NODE_TYPE_ASSIGNMENT) node->data.assignment.target_symbol = version;
+        else node->data.for_loop.index_symbol = version;
+    }
+    for (size_t u = 0; u < use_count; ++u) {
+        *use_sites[u].slot = definitions[web_find(use_sites[u].definition)].version;
+    }
+
+    free(variables);
+    variables = NULL;
+    free(definitions);
+    definitions = NULL;
+    definition_count = 0;
+    free(definition_at_bit);
+    definition_at_bit = NULL;
+    free(use_sites);
+    use_sites = NULL;
+    use_count = 0;
+    use_capacity = 0;
+    map_free(&definition_ids);
+    map_free(&symbol_ids);
+    return versions_created;
+}
+
+//------------------------------------------------------------------------------
+// Integer Inference
+// A range analysis over the variable versions left by rename_variables: each
+// gets the interval of every value assigned to it (flow-insensitive, which
+// the renaming makes precise enough), and whether those are all integers.
+// Additions, subtractions and products of integers stay integers while the
+// result interval is within +-2^53, where int64_t and double arithmetic agree
+// exactly. Loop indices are int64_t counters to begin with. Counters of the
+// form x = x + step are bounded by the step times the number of times the
+// assignment can run, which is known inside for loops with bounded ranges.
+// Inside a while loop it is only known for the counter the condition tests:
+// while (x - c) or while (c - x), with x moved once per iteration by 1 towards
+// c, from starting values on the near side of c, stays between them and c.
+// Other counters in while loops stay double.
+//------------------------------------------------------------------------------
+#define EXACT_INTEGER_LIMIT 9007199254740992.0 // 2^53
+#define WIDEN_AFTER 8                          // Updates before an interval is widened to infinity
+
+typedef struct {
+    double lo, hi;  // lo > hi: no value seen yet
+    int integer;    // Every value is an integer that fits an int64_t
+} Range;
+
+typedef struct {
+    Symbol *symbol;
+    Range range;
+    Range next;     // Values assigned, collected in the current round
+    double moved_lo, moved_hi; // Total movement of counters from those values
+    int moved_integer;
+    int while_direction; // 1 / -1: counted up / down to while_limit by a while loop (2: more than one)
+    double while_limit;
+    int updates;
+    int fixed;      // Parameters and reduction variables: any double
+} RangeInfo;
+
+static RangeInfo *ranges = NULL;
+static size_t range_count = 0;
+
+static const Range range_empty = { INFINITY, -INFINITY, 1 };
+static const Range range_any = { -INFINITY, INFINITY, 0 };
+
+static RangeInfo *range_info(Symbol *sym) {
+    size_t id = symbol_id(sym);
+    if (id >= range_count) {
+        size_t count = 2 * id + 16;
+        RangeInfo *grown = (RangeInfo*)realloc(ranges, count * sizeof(RangeInfo));
+        if (!grown) { perror("realloc failed for ranges"); exit(1); }
+        ranges = grown;
+        memset(ranges + range_count, 0, (count - range_count) * sizeof(RangeInfo));
+        range_count = count;
+    }
+    if (!ranges[id].symbol) {
+        ranges[id].symbol = sym;
+        ranges[id].range = range_empty;
+        ranges[id].next = range_empty;
+        ranges[id].moved_integer = 1;
+    }
+    return &ranges[id];
+}
+
+static Range range_join(Range a, Range b) {
+    Range r = { fmin(a.lo, b.lo), fmax(a.hi, b.hi), a.integer && b.integer };
+    return r;
+}
+
+static int range_is_exact(Range r) {
+    return r.lo >= -EXACT_INTEGER_LIMIT && r.hi <= EXACT_INTEGER_LIMIT;
+}
+
+// Result of integer arithmetic, which must stay exact to be computed as int64_t
+static Range range_arithmetic(double lo, double hi, int integer) {
+    Range r = { lo, hi, integer };
+    if (isnan(lo) || isnan(hi)) { r.lo = -INFINITY; r.hi = INFINITY; }
+    if (r.integer && !range_is_exact(r)) r.integer = 0;
+    return r;
+}
+
+static Range range_of(ASTNode *node) {
+    if (!node) return range_any;
+    switch (node->type) {
+        case NODE_TYPE_NUMBER: {
+            double value = node->data.number_value;
+            Range r = { value, value, value == floor(value) && fabs(value) <= EXACT_INTEGER_LIMIT };
+            return r;
+        }
+        case NODE_TYPE_IDENTIFIER: return range_info(node->data.identifier_symbol)->range;
+        case NODE_TYPE_UNARY_OP: {
+            Range a = range_of(node->data.unary_op.operand);
+            if (node->data.unary_op.op != '-') return a;
+            return range_arithmetic(-a.hi, -a.lo, a.integer);
+        }
+        case NODE_TYPE_BINARY_OP: {
+            Range a = range_of(node->data.binary_op.left);
+            Range b = range_of(node->data.binary_op.right);
+            int integer = a.integer && b.integer;
+            if (a.lo > a.hi || b.lo > b.hi) { // No value yet
+                Range r = range_empty;
+                r.integer = integer;
+                return r;
+            }
+            switch (node->data.binary_op.op) {
+                case '+': return range_arithmetic(a.lo + b.lo, a.hi + b.hi, integer);
+                case '-': return range_arithmetic(a.lo - b.hi, a.hi - b.lo, integer);
+                case '*': {
+                    double p1 = a.lo * b.lo, p2 = a.lo * b.hi, p3 = a.hi * b.lo, p4 = a.hi * b.hi;
+                    return range_arithmetic(fmin(fmin(p1, p2), fmin(p3, p4)), fmax(fmax(p1, p2), fmax(p3, p4)), integer);
+                }
+                default: return range_any; // Division
+            }
+        }
+        default: // Vectors, calls and strings
+            return range_any;
+    }
+}
+
+static void range_assign(Symbol *sym, Range value) {
+    RangeInfo *info = range_info(sym);
+    info->next = range_join(info->next, value);
+}
+
+static int mentions(ASTNode *node, Symbol *sym) {
+    if (!node) return 0;
+    switch (node->type) {
+        case NODE_TYPE_IDENTIFIER: return node->data.identifier_symbol == sym;
+        case NODE_TYPE_BINARY_OP: return mentions(node->data.binary_op.left, sym) || mentions(node->data.binary_op.right, sym);
+        case NODE_TYPE_UNARY_OP: return mentions(node->data.unary_op.operand, sym);
+        case NODE_TYPE_VECTOR:
+            for (size_t i = 0; i < node->data.vector_elements.count; ++i) {
+                if (mentions(node->data.vector_elements.items[i], sym)) return 1;
+            }
+            return 0;
+        case NODE_TYPE_FUNC_CALL:
+            for (size_t i = 0; i < node->data.func_call.arguments.count; ++i) {
+                if (mentions(node->data.func_call.arguments.items[i], sym)) return 1;
+            }
+            return 0;
+        default: return 0;
+    }
+}
+
+// The step of x = x + step, x = step + x or x = x - step (NULL otherwise)
+static ASTNode *counter_step(Symbol *target, ASTNode *expression, int *negated) {
+    if (expression->type != NODE_TYPE_BINARY_OP) return NULL;
+    ASTNode *left = expression->data.binary_op.left, *right = expression->data.binary_op.right;
+    char op = expression->data.binary_op.op;
+    int left_is_target = left->type == NODE_TYPE_IDENTIFIER && left->data.identifier_symbol == target;
+    int right_is_target = right->type == NODE_TYPE_IDENTIFIER && right->data.identifier_symbol == target;
+    *negated = (op == '-');
+    if ((op == '+' || op == '-') && left_is_target && !mentions(right, target)) return right;
+    if (op == '+' && right_is_target && !mentions(left, target)) return left;
+    return NULL;
+}
+
+// How many times one run of a statement can assign 'sym' (2: more than once,
+// or any number of times inside a loop), and the assignment if it is one
+static int assignment_count(ASTNode *node, Symbol *sym, ASTNode **found) {
+    if (!node) return 0;
+    switch (node->type) {
+        case NODE_TYPE_ASSIGNMENT:
+            if (node->data.assignment.target_symbol != sym) return 0;
+            *found = node;
+            return 1;
+        case NODE_TYPE_STATEMENT_LIST: {
+            int count = 0;
+            for (size_t i = 0; i < node->data.statement_list.count; ++i) count += assignment_count(node->data.statement_list.items[i], sym, found);
+            return count > 2 ? 2 : count;
+        }
+        case NODE_TYPE_IF: {
+            int count = assignment_count(node->data.if_stmt.if_branch, sym, found) + assignment_count(node->data.if_stmt.else_branch, sym, found);
+            return count > 2 ? 2 : count;
+        }
+        case NODE_TYPE_WHILE:
+            return assignment_count(node->data.while_loop.loop_body, sym, found) ? 2 : 0;
+        case NODE_TYPE_FOR:
+            if (node->data.for_loop.index_symbol == sym) return 2;
+            return assignment_count(node->data.for_loop.loop_body, sym, found) ? 2 : 0;
+        default:
+            return 0;
+    }
+}
+
+// The counter update x = x +- 1 of while (x - c) or while (c - x), if x is
+// assigned nowhere else in the body; 'limit' is c, 'direction' the step
+static ASTNode *while_counter(WhileNode *loop, double *limit, int *direction) {
+    ASTNode *condition = loop->condition;
+    if (condition->type != NODE_TYPE_BINARY_OP || condition->data.binary_op.op != '-') return NULL;
+    ASTNode *left = condition->data.binary_op.left, *right = condition->data.binary_op.right;
+    ASTNode *counter = (left->type == NODE_TYPE_IDENTIFIER) ? left : right;
+    ASTNode *bound = (counter == left) ? right : left;
+    if (counter->type != NODE_TYPE_IDENTIFIER || bound->type != NODE_TYPE_NUMBER) return NULL;
+    Range c = range_of(bound);
+    if (!c.integer) return NULL;
+
+    Symbol *sym = counter->data.identifier_symbol;
+    ASTNode *update = NULL;
+    if (assignment_count(loop->loop_body, sym, &update) != 1) return NULL;
+    int negated;
+    ASTNode *step = counter_step(sym, update->data.assignment.expression, &negated);
+    if (!step || step->type != NODE_TYPE_NUMBER || step->data.number_value != 1.0) return NULL;
+    *limit = c.lo;
+    *direction = negated ? -1 : 1;
+    return update;
+}
+
+static ASTNode *bounded_update = NULL; // Counter update of the while loop being visited
+
+// Collects the values assigned in one round. 'runs' bounds how often a
+// statement runs per call of the body it is in (INFINITY inside while loops).
+static void range_statement(ASTNode *node, double runs) {
+    if (!node) return;
+    switch (node->type) {
+        case NODE_TYPE_ASSIGNMENT: {
+            Symbol *target = node->data.assignment.target_symbol;
+            ASTNode *expression = node->data.assignment.expression;
+            Range value = range_of(expression);
+            int negated;
+            ASTNode *step = counter_step(target, expression, &negated);
+            if (node == bounded_update && value.integer) {
+                break; // Bounded by the loop condition (see NODE_TYPE_WHILE)
+            } else if (step && value.integer) {
+                // Every run moves the value by at most the step, from a value
+                // assigned elsewhere (the counter's start)
+                RangeInfo *info = range_info(target);
+                Range delta = range_of(step);
+                double down = negated ? -delta.hi : delta.lo, up = negated ? -delta.lo : delta.hi;
+                if (runs > 0.0 && down < 0.0) info->moved_lo += runs * down;
+                if (runs > 0.0 && up > 0.0) info->moved_hi += runs * up;
+            } else {
+                range_assign(target, value);
+            }
+            break;
+        }
+        case NODE_TYPE_STATEMENT_LIST:
+            for (size_t i = 0; i < node->data.statement_list.count; ++i) range_statement(node->data.statement_list.items[i], runs);
+            break;
+        case NODE_TYPE_IF:
+            range_statement(node->data.if_stmt.if_branch, runs);
+            range_statement(node->data.if_stmt.else_branch, runs);
+            break;
+        case NODE_TYPE_WHILE: {
+            double limit;
+            int direction;
+            ASTNode *update = while_counter(&node->data.while_loop, &limit, &direction);
+            if (update && range_of(update->data.assignment.expression).integer) {
+                RangeInfo *info = range_info(update->data.assignment.target_symbol);
+                if (info->while_direction == 0) {
+                    info->while_direction = direction;
+                    info->while_limit = limit;
+                } else if (info->while_direction != direction || info->while_limit != limit) {
+                    info->while_direction = 2; // One loop could start the next past its limit
+                }
+            }
+            ASTNode *saved_update = bounded_update;
+            bounded_update = update;
+            range_statement(node->data.while_loop.loop_body, INFINITY);
+            bounded_update = saved_update;
+            break;
+        }
+        case NODE_TYPE_FOR: {
+            ForNode *loop = &node->data.for_loop;
+            Range start = range_of(loop->range_start), end = range_of(loop->range_end);
+            Range index = { ceil(start.lo), ceil(end.hi) - 1.0, 1 };
+            if (start.lo > start.hi || end.lo > end.hi) index = range_empty;
+            else if (isnan(index.lo) || isnan(index.hi)) { index.lo = -INFINITY; index.hi = INFINITY; }
+            range_assign(loop->index_symbol, index);
+            for (size_t r = 0; r < loop->reduction_count; ++r) range_info(loop->reductions[r].variable)->fixed = 1;
+            double trips = (index.hi >= index.lo) ? index.hi - index.lo + 1.0 : 0.0;
+            range_statement(loop->loop_body, (trips == 0.0) ? 0.0 : runs * trips);
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+static void range_round(ASTNode *ast_root) {
+    NodeList *items = &ast_root->data.statement_list;
+    for (size_t i = 0; i < items->count; ++i) {
+        if (items->items[i]->type != NODE_TYPE_FUNC_DEF) continue;
+        FuncDefNode *def = &items->items[i]->data.func_def;
+        for (size_t p = 0; p < def->parameters.count; ++p) range_info(def->parameters.items[p]->data.identifier_symbol)->fixed = 1;
+        range_statement(def->body, 1.0);
+    }
+    range_statement(ast_root, 1.0); // Skips the function definitions
+}
+
+static void mark_integers(ASTNode *node) {
+    if (!node) return;
+    switch (node->type) {
+        case NODE_TYPE_NUMBER:
+        case NODE_TYPE_IDENTIFIER:
+            node->is_integer = range_of(node).integer;
+            break;
+        case NODE_TYPE_BINARY_OP:
+            node->is_integer = range_of(node).integer;
+            mark_integers(node->data.binary_op.left);
+            mark_integers(node->data.binary_op.right);
+            break;
+        case NODE_TYPE_UNARY_OP:
+            node->is_integer = range_of(node).integer;
+            mark_integers(node->data.unary_op.operand);
+            break;
+        case NODE_TYPE_VECTOR:
+            for (size_t i = 0; i < node->data.vector_elements.count; ++i) mark_integers(node->data.vector_elements.items[i]);
+            break;
+        case NODE_TYPE_ASSIGNMENT: mark_integers(node->data.assignment.expression); break;
+        case NODE_TYPE_STATEMENT_LIST:
+            for (size_t i = 0; i < node->data.statement_list.count; ++i) mark_integers(node->data.statement_list.items[i]);
+            break;
+        case NODE_TYPE_IF:
+            mark_integers(node->data.if_stmt.condition);
+            mark_integers(node->data.if_stmt.if_branch);
+            mark_integers(node->data.if_stmt.else_branch);
+            break;
+        case NODE_TYPE_WHILE:
+            mark_integers(node->data.while_loop.condition);
+            mark_integers(node->data.while_loop.loop_body);
+            break;
+        case NODE_TYPE_FOR:
+            mark_integers(node->data.for_loop.range_start);
+            mark_integers(node->data.for_loop.range_end);
+            mark_integers(node->data.for_loop.chunk_size);
+            mark_integers(node->data.for_loop.loop_body);
+            break;
+        case NODE_TYPE_FUNC_CALL:
+            for (size_t i = 0; i < node->data.func_call.arguments.count; ++i) mark_integers(node->data.func_call.arguments.items[i]);
+            break;
+        case NODE_TYPE_FUNC_DEF: mark_integers(node->data.func_def.body); break;
+        case NODE_TYPE_RETURN: mark_integers(node->data.return_stmt.expression); break;
+        default: break;
+    }
+}
+
+int infer_integers(ASTNode *ast_root) {
+    if (!ast_root || ast_root->type != NODE_TYPE_STATEMENT_LIST) return 0;
+    int changed = 1;
+    while (changed) {
+        // Source variables can be read before their first assignment (as 0)
+        for (size_t i = 0; i < range_count; ++i) {
+            RangeInfo *info = &ranges[i];
+            if (!info->symbol) continue;
+            info->next = (info->symbol->base || info->symbol->entry_unread) ? range_empty : (Range){ 0.0, 0.0, 1 };
+            info->moved_lo = info->moved_hi = 0.0;
+            info->moved_integer = 1;
+            info->while_direction = 0;
+        }
+        range_round(ast_root);
+        changed = 0;
+        for (size_t i = 0; i < range_count; ++i) {
+            RangeInfo *info = &ranges[i];
+            if (!info->symbol) continue;
+            Range value = info->fixed ? range_any : info->next;
+            if (value.lo <= value.hi) {
+                value.lo += info->moved_lo;
+                value.hi += info->moved_hi;
+                value.integer &= info->moved_integer;
+            }
+            if (info->while_direction != 0 && value.lo <= value.hi) {
+                // The counter runs from its starting values to the limit, if
+                // they are all on one side of it and nothing else moves it
+                int bounded = info->moved_lo == 0.0 && info->moved_hi == 0.0 &&
+                              ((info->while_direction == 1 && value.hi <= info->while_limit) ||
+                               (info->while_direction == -1 && value.lo >= info->while_limit));
+                if (!bounded) value = range_any;
+                else if (info->while_direction == 1) value.hi = info->while_limit;
+                else value.lo = info->while_limit;
+            }
+            Range joined = (info->range.lo > info->range.hi) ? value : range_join(info->range, value);
+            if (joined.lo == info->range.lo && joined.hi == info->range.hi && joined.integer == info->range.integer) continue;
+            if (++info->updates > WIDEN_AFTER) {
+                if (joined.lo < info->range.lo) joined.lo = -INFINITY;
+                if (joined.hi > info->range.hi) joined.hi = INFINITY;
+            }
+            info->range = joined;
+            changed = 1;
+        }
+    }
+
+    int integer_count = 0;
+    for (size_t i = 0; i < range_count; ++i) {
+        RangeInfo *info = &ranges[i];
+        if (!info->symbol) continue;
+        info->symbol->is_integer = info->range.integer && info->range.lo <= info->range.hi;
+        integer_count += info->symbol->is_integer;
+    }
+    mark_integers(ast_root);
+
+    free(ranges);
+    ranges = NULL;
+    range_count = 0;
+    map_free(&symbol_ids);
+    return integer_count;
+}
+
+//------------------------------------------------------------------------------
+// Profile Sites
+// wizuallc --pgo-gen records, and --pgo-use reads back, what happens at the
+// numbered nodes of a program (see runtime_profile.h). The numbers only depend
+// on the shape of the AST, so two compilations of the same program number it
+// alike; the fingerprint, a hash of that shape, catches the profile of another.
+//------------------------------------------------------------------------------
+static int site_count = 0;
+static uint64_t site_hash = 0;
+
+static void number_sites(ASTNode *node) {
+    if (!node) return;
+    site_hash = (site_hash ^ (uint64_t)node->type) * 1099511628211ull; // FNV-1a
+    switch (node->type) {
+        case NODE_TYPE_BINARY_OP:
+            number_sites(node->data.binary_op.left);
+            number_sites(node->data.binary_op.right);
+            break;
+        case NODE_TYPE_UNARY_OP: number_sites(node->data.unary_op.operand); break;
+        case NODE_TYPE_VECTOR:
+            for (size_t i = 0; i < node->data.vector_elements.count; ++i) number_sites(node->data.vector_elements.items[i]);
+            break;
+        case NODE_TYPE_ASSIGNMENT:
+            if (!node->site) node->site = ++site_count;
+            number_sites(node->data.assignment.expression);
+            break;
+        case NODE_TYPE_STATEMENT_LIST:
+            for (size_t i = 0; i < node->data.statement_list.count; ++i) number_sites(node->data.statement_list.items[i]);
+            break;
+        case NODE_TYPE_IF:
+            if (!node->site) node->site = ++site_count;
+            number_sites(node->data.if_stmt.condition);
+            number_sites(node->data.if_stmt.if_branch);
+            number_sites(node->data.if_stmt.else_branch);
+            break;
+        case NODE_TYPE_WHILE:
+            if (!node->site) node->site = ++site_count;
+            number_sites(node->data.while_loop.condition);
+            number_sites(node->data.while_loop.loop_body);
+            break;
+        case NODE_TYPE_FOR:
+            if (node->data.for_loop.is_parallel && !node->site) node->site = ++site_count;
+            number_sites(node->data.for_loop.range_start);
+            number_sites(node->data.for_loop.range_end);
+            number_sites(node->data.for_loop.chunk_size);
+            number_sites(node->data.for_loop.loop_body);
+            break;
+        case NODE_TYPE_FUNC_CALL:
+            if (!node->site) node->site = ++site_count;
+            for (size_t i = 0; i < node->data.func_call.arguments.count; ++i) number_sites(node->data.func_call.arguments.items[i]);
+            break;
+        case NODE_TYPE_FUNC_DEF: number_sites(node->data.func_def.body); break;
+        case NODE_TYPE_RETURN: number_sites(node->data.return_stmt.expression); break;
+        default: break;
+    }
+}
+
+int number_profile_sites(ASTNode *ast_root, uint64_t *fingerprint) {
+    site_count = 0;
+    site_hash = 14695981039346656037ull;
+    if (ast_root && ast_root->type == NODE_TYPE_STATEMENT_LIST) {
+        for (size_t i = 0; i < ast_root->data.statement_list.count; ++i) {
+            ASTNode *item = ast_root->data.statement_list.items[i];
+            if (item->type != NODE_TYPE_FUNC_DEF) item->site = ++site_count; // Timed as a whole
+            number_sites(item);
+        }
+    }
+    *fingerprint = (site_hash ^ (uint64_t)site_count) * 1099511628211ull;
+    return site_count;
+}
\ No newline at end of file
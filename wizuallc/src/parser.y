@@ -15,11 +15,17 @@ void yyerror(const char *s);
 
 // Global variable to store the root of the AST
 ASTNode *ast_root = NULL;
+
+// If set, called with each top-level statement and function definition as
+// soon as it is parsed. Statements are handed over (not added to ast_root);
+// function definitions are also kept in ast_root.
+void (*stream_top_level)(ASTNode *item) = NULL;
 %}
 
 /* Define the union of possible semantic values */
 %union {
     double number_val;     // For NUMBER tokens
+    char* string_val;      // For STRING tokens (malloc'd, owned by the AST node)
     struct Symbol* symbol_ptr; // For ID tokens and symbols
     struct ASTNode* node_ptr; // For non-terminals returning AST nodes
     NodeList node_list; // Add type for argument list construction
@@ -28,11 +34,16 @@ ASTNode *ast_root = NULL;
 /* Declare tokens with their types from the union */
 %token <number_val> NUMBER
 %token <symbol_ptr> ID // ID token now carries a Symbol*
+%token <string_val> STRING // String literal, e.g. a file name
+%token <node_ptr> DENSE_VECTOR // Vector literal of plain numbers, parsed whole by the lexer
 %token IF ELSE WHILE // New keywords
+%token DEF RETURN // Function definitions
+%token FOR IN RANGE PARALLEL REDUCE SCHEDULE // Counted loops
 
 /* Declare non-terminals with their types from the union */
 %type <node_ptr> program statement_list statement assignment expression vector element_list block func_call
-%type <node_list> arg_list arg_list_non_empty // For building the list
+%type <node_ptr> top_level_list function_def for_header parallel_for_header
+%type <node_list> arg_list arg_list_non_empty param_list param_list_non_empty // For building the list
 
 /* Define operator precedence and associativity */
 %left '+' '-'
@@ -49,10 +60,43 @@ ASTNode *ast_root = NULL;
 
 /* Grammar Rules */
 
-program: statement_list
+program: top_level_list
     { ast_root = $1; /* Assign the final list to the global root */ }
     ;
 
+// Functions can only be defined at the top level
+top_level_list: /* empty */
+    { $$ = ast_new_statement_list(); }
+    | top_level_list statement
+    { if ($2 && stream_top_level) stream_top_level($2);
+      else if ($2) ast_add_statement($1, $2);
+      $$ = $1; }
+    | top_level_list function_def
+    { ast_add_statement($1, $2);
+      if (stream_top_level) stream_top_level($2);
+      $$ = $1; }
+    ;
+
+// The parameters and body are lexed in a scope of their own: every name used
+// in the body is local to the function
+function_def: DEF ID { symbol_push_scope(); } '(' param_list ')' block
+    { $$ = ast_new_func_def($2, $5, $7, symbol_pop_scope()); }
+    ;
+
+param_list: /* empty */
+    { $$.items = NULL; $$.count = 0; $$.capacity = 0; }
+    | param_list_non_empty
+    { $$ = $1; }
+    ;
+
+param_list_non_empty: ID
+    { $$.items = NULL; $$.count = 0; $$.capacity = 0;
+      ast_add_argument(&$$, ast_new_identifier($1)); }
+    | param_list_non_empty ',' ID
+    { $$ = $1;
+      ast_add_argument(&$$, ast_new_identifier($3)); }
+    ;
+
 statement_list: /* empty */
     { $$ = ast_new_statement_list(); }
     | statement_list statement
@@ -73,10 +117,41 @@ statement: assignment ';'
     { $$ = ast_new_if($3, $5, $7); }
     | WHILE '(' expression ')' statement
     { $$ = ast_new_while($3, $5); }
+    | RETURN expression ';'
+    { $$ = ast_new_return($2); }
+    | for_header statement
+    { $$ = ast_set_for_body($1, $2); }
+    | parallel_for_header statement
+    { $$ = ast_set_for_body($1, $2); }
     | ';'
     { $$ = NULL; /* Represent empty statement as NULL? Or create a specific node? NULL for now */ }
     ;
 
+for_header: FOR ID IN RANGE '(' expression ',' expression ')'
+    { $$ = ast_new_for($2, $6, $8); }
+    ;
+
+// Clauses follow the header: reduce(+: s) reduce(min: lo) schedule(dynamic, 64)
+parallel_for_header: PARALLEL for_header
+    { $$ = $2; $$->data.for_loop.is_parallel = 1; }
+    | parallel_for_header REDUCE '(' '+' ':' ID ')'
+    { ast_add_reduction($1, '+', $6); $$ = $1; }
+    | parallel_for_header REDUCE '(' ID ':' ID ')'
+    { if (strcmp($4->name, "min") == 0) ast_add_reduction($1, '<', $6);
+      else if (strcmp($4->name, "max") == 0) ast_add_reduction($1, '>', $6);
+      else yyerror("reduce() expects +, min or max");
+      $$ = $1; }
+    | parallel_for_header SCHEDULE '(' ID ')'
+    { if (strcmp($4->name, "static") == 0) ast_set_schedule($1, 0, NULL);
+      else if (strcmp($4->name, "dynamic") == 0) ast_set_schedule($1, 1, NULL);
+      else yyerror("schedule() expects static or dynamic");
+      $$ = $1; }
+    | parallel_for_header SCHEDULE '(' ID ',' expression ')'
+    { if (strcmp($4->name, "dynamic") != 0) yyerror("only schedule(dynamic, n) takes a chunk size");
+      ast_set_schedule($1, 1, $6);
+      $$ = $1; }
+    ;
+
 block: '{' statement_list '}'
     { $$ = $2; /* Return the statement list node */ }
     ;
@@ -87,6 +162,8 @@ assignment: ID '=' expression
 
 expression: NUMBER
     { $$ = ast_new_number($1); /* $1 is double from lexer */ }
+    | STRING
+    { $$ = ast_new_string($1); /* Takes ownership of the lexer's string */ }
     | ID
     { $$ = ast_new_identifier($1); /* $1 is Symbol* from lexer */ }
     | vector
@@ -112,7 +189,9 @@ func_call: ID '(' arg_list ')'
     { $$ = ast_new_func_call($1, $3); /* $1=Symbol*, $3=NodeList */ }
     ;
 
-vector: '[' element_list ']'
+vector: DENSE_VECTOR
+      { $$ = $1; /* One array, no node per element */ }
+      | '[' element_list ']'
       { $$ = $2; /* Return the NodeList node created by element_list */ }
       | '[' ']'
       { $$ = ast_new_vector(); /* Create an empty vector node */ }
@@ -0,0 +1,446 @@
+#include "runtime_fft.h"
+#include "runtime_mem.h"
+#include "runtime_parallel.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define FFT_PARALLEL_MIN 32768   // Complex lengths below this run on one thread
+#define FFT_COMBINE_TASK 8192    // Butterflies per task in the parallel top-level combine
+#define CONV_DIRECT_MAX 64       // Kernels up to this length are convolved directly
+#define CONV_TASK_OUTPUTS 16384  // Outputs per direct convolution task
+
+static const double PI = 3.14159265358979323846;
+
+// Twiddle tables by log2 of the transform length, built on first use and
+// kept for the rest of the program
+static pthread_mutex_t twiddle_lock = PTHREAD_MUTEX_INITIALIZER;
+static double *twiddle_tables[64];
+
+// Top level of a parallel power-of-two transform
+typedef struct {
+    const double *in;
+    double *out;
+    size_t radix;   // 4 or 2
+    size_t m;       // Length of each sub-transform
+    const double *twiddles;
+} FftJob;
+
+// Direct convolution split over the output
+typedef struct {
+    const double *a; // The longer input
+    size_t a_size;
+    const double *b; // The kernel
+    size_t b_size;
+    double *out;
+    size_t out_size;
+} ConvolveJob;
+
+//------------------------------------------------------------------------------
+// Complex Arithmetic (one interleaved complex value per SSE2 register)
+//------------------------------------------------------------------------------
+#ifdef __SSE2__
+typedef __m128d Complex;
+
+static inline Complex complex_load(const double *p) { return _mm_loadu_pd(p); }
+static inline void complex_store(double *p, Complex a) { _mm_storeu_pd(p, a); }
+static inline Complex complex_add(Complex a, Complex b) { return _mm_add_pd(a, b); }
+static inline Complex complex_sub(Complex a, Complex b) { return _mm_sub_pd(a, b); }
+
+// (ar*wr - ai*wi, ai*wr + ar*wi)
+static inline Complex complex_mul(Complex a, Complex w) {
+    __m128d w_re = _mm_unpacklo_pd(w, w);
+    __m128d w_im = _mm_unpackhi_pd(w, w);
+    __m128d cross = _mm_mul_pd(_mm_shuffle_pd(a, a, 1), w_im);
+    cross = _mm_xor_pd(cross, _mm_set_pd(0.0, -0.0));
+    return _mm_add_pd(_mm_mul_pd(a, w_re), cross);
+}
+
+// -i * a = (ai, -ar)
+static inline Complex complex_mul_neg_i(Complex a) {
+    return _mm_xor_pd(_mm_shuffle_pd(a, a, 1), _mm_set_pd(-0.0, 0.0));
+}
+#else
+typedef struct { double re, im; } Complex;
+
+static inline Complex complex_load(const double *p) { Complex a = { p[0], p[1] }; return a; }
+static inline void complex_store(double *p, Complex a) { p[0] = a.re; p[1] = a.im; }
+static inline Complex complex_add(Complex a, Complex b) { Complex r = { a.re + b.re, a.im + b.im }; return r; }
+static inline Complex complex_sub(Complex a, Complex b) { Complex r = { a.re - b.re, a.im - b.im }; return r; }
+static inline Complex complex_mul(Complex a, Complex w) {
+    Complex r = { a.re * w.re - a.im * w.im, a.im * w.re + a.re * w.im };
+    return r;
+}
+static inline Complex complex_mul_neg_i(Complex a) { Complex r = { a.im, -a.re }; return r; }
+#endif
+
+//------------------------------------------------------------------------------
+// Power-of-Two FFT
+//------------------------------------------------------------------------------
+
+// exp(-2*pi*i*k/n) for k up to 3n/4, which covers every radix-4 twiddle and
+// the real-input post-processing (k <= n/2)
+static const double *twiddles(size_t n) {
+    unsigned log2n = 0;
+    while (((size_t)1 << log2n) < n) ++log2n;
+    pthread_mutex_lock(&twiddle_lock);
+    double *table = twiddle_tables[log2n];
+    if (!table) {
+        size_t count = n / 2 + n / 4 + 1;
+        table = (double *)malloc(2 * count * sizeof(double));
+        if (!table) { perror("twiddle table malloc failed"); exit(1); }
+        // Evaluate within the first quadrant and rotate by (-i)^q, so the
+        // quarter turns come out exact
+        size_t quarter = n % 4 == 0 ? n / 4 : n;
+        for (size_t k = 0; k < count; ++k) {
+            double angle = -2.0 * PI * (double)(k % quarter) / (double)n;
+            double re = cos(angle), im = sin(angle), swap;
+            for (size_t q = k / quarter; q > 0; --q) {
+                swap = re; re = im; im = -swap;
+            }
+            table[2 * k] = re;
+            table[2 * k + 1] = im;
+        }
+        twiddle_tables[log2n] = table;
+    }
+    pthread_mutex_unlock(&twiddle_lock);
+    return table;
+}
+
+// Butterflies k in [begin, end) joining four transforms of length m in out
+static void radix4_combine(double *out, size_t m, const double *tw, size_t tw_stride, size_t begin, size_t end) {
+    for (size_t k = begin; k < end; ++k) {
+        Complex a0 = complex_load(out + 2 * k);
+        Complex a1 = complex_mul(complex_load(out + 2 * (m + k)), complex_load(tw + 2 * k * tw_stride));
+        Complex a2 = complex_mul(complex_load(out + 2 * (2 * m + k)), complex_load(tw + 4 * k * tw_stride));
+        Complex a3 = complex_mul(complex_load(out + 2 * (3 * m + k)), complex_load(tw + 6 * k * tw_stride));
+        Complex t0 = complex_add(a0, a2), t1 = complex_sub(a0, a2);
+        Complex t2 = complex_add(a1, a3), t3 = complex_mul_neg_i(complex_sub(a1, a3));
+        complex_store(out + 2 * k, complex_add(t0, t2));
+        complex_store(out + 2 * (m + k), complex_add(t1, t3));
+        complex_store(out + 2 * (2 * m + k), complex_sub(t0, t2));
+        complex_store(out + 2 * (3 * m + k), complex_sub(t1, t3));
+    }
+}
+
+static void radix2_combine(double *out, size_t m, const double *tw, size_t tw_stride, size_t begin, size_t end) {
+    for (size_t k = begin; k < end; ++k) {
+        Complex a0 = complex_load(out + 2 * k);
+        Complex a1 = complex_mul(complex_load(out + 2 * (m + k)), complex_load(tw + 2 * k * tw_stride));
+        complex_store(out + 2 * k, complex_add(a0, a1));
+        complex_store(out + 2 * (m + k), complex_sub(a0, a1));
+    }
+}
+
+// Out-of-place decimation in time: the sub-transforms recurse until they fit
+// in cache on their own, without tuning for a cache size. in is read with the
+// given stride (in complex values); tw is the table of the full transform.
+static void fft_recursive(const double *in, size_t stride, double *out, size_t n,
+                          const double *tw, size_t tw_stride) {
+    if (n == 1) {
+        out[0] = in[0];
+        out[1] = in[1];
+    } else if (n == 2) {
+        Complex a0 = complex_load(in), a1 = complex_load(in + 2 * stride);
+        complex_store(out, complex_add(a0, a1));
+        complex_store(out + 2, complex_sub(a0, a1));
+    } else if (n == 4) {
+        Complex a0 = complex_load(in), a1 = complex_load(in + 2 * stride);
+        Complex a2 = complex_load(in + 4 * stride), a3 = complex_load(in + 6 * stride);
+        Complex t0 = complex_add(a0, a2), t1 = complex_sub(a0, a2);
+        Complex t2 = complex_add(a1, a3), t3 = complex_mul_neg_i(complex_sub(a1, a3));
+        complex_store(out, complex_add(t0, t2));
+        complex_store(out + 2, complex_add(t1, t3));
+        complex_store(out + 4, complex_sub(t0, t2));
+        complex_store(out + 6, complex_sub(t1, t3));
+    } else if (n % 4 == 0) {
+        size_t m = n / 4;
+        for (size_t r = 0; r < 4; ++r) {
+            fft_recursive(in + 2 * r * stride, 4 * stride, out + 2 * r * m, m, tw, 4 * tw_stride);
+        }
+        radix4_combine(out, m, tw, tw_stride, 0, m);
+    } else {
+        size_t m = n / 2;
+        fft_recursive(in, 2 * stride, out, m, tw, 2 * tw_stride);
+        fft_recursive(in + 2 * stride, 2 * stride, out + 2 * m, m, tw, 2 * tw_stride);
+        radix2_combine(out, m, tw, tw_stride, 0, m);
+    }
+}
+
+static void sub_fft_task(size_t task, void *ctx) {
+    FftJob *job = (FftJob *)ctx;
+    fft_recursive(job->in + 2 * task, job->radix, job->out + 2 * task * job->m, job->m,
+                  job->twiddles, job->radix);
+}
+
+static void combine_task(size_t task, void *ctx) {
+    FftJob *job = (FftJob *)ctx;
+    size_t begin = task * FFT_COMBINE_TASK;
+    size_t end = begin + FFT_COMBINE_TASK < job->m ? begin + FFT_COMBINE_TASK : job->m;
+    if (job->radix == 4) {
+        radix4_combine(job->out, job->m, job->twiddles, 1, begin, end);
+    } else {
+        radix2_combine(job->out, job->m, job->twiddles, 1, begin, end);
+    }
+}
+
+// Forward transform, n a power of two, in != out. Large transforms run their
+// top-level sub-transforms and butterflies on the thread pool.
+static void fft_pow2(const double *in, double *out, size_t n) {
+    const double *tw = twiddles(n);
+    if (n < FFT_PARALLEL_MIN || runtime_thread_count() == 1) {
+        fft_recursive(in, 1, out, n, tw, 1);
+        return;
+    }
+    FftJob job = { in, out, n % 4 == 0 ? 4 : 2, 0, tw };
+    job.m = n / job.radix;
+    runtime_parallel_for(job.radix, sub_fft_task, &job);
+    runtime_parallel_for((job.m + FFT_COMBINE_TASK - 1) / FFT_COMBINE_TASK, combine_task, &job);
+}
+
+//------------------------------------------------------------------------------
+// Any Length (Bluestein)
+//------------------------------------------------------------------------------
+
+// Writes the transform of in to out as a convolution with a chirp, evaluated
+// with power-of-two FFTs of at least 2n-1 points
+static void fft_bluestein(const double *in, double *out, size_t n) {
+    size_t m = 1;
+    while (m < 2 * n - 1) m <<= 1;
+    double *chirp = (double *)malloc(2 * n * sizeof(double));
+    double *a = (double *)calloc(2 * m, sizeof(double));
+    double *b = (double *)calloc(2 * m, sizeof(double));
+    double *spectrum_a = (double *)malloc(2 * m * sizeof(double));
+    double *spectrum_b = (double *)malloc(2 * m * sizeof(double));
+    if (!chirp || !a || !b || !spectrum_a || !spectrum_b) { perror("bluestein malloc failed"); exit(1); }
+
+    // chirp[k] = exp(-pi*i*k^2/n), with k^2 reduced mod 2n to keep the angle exact
+    for (size_t k = 0; k < n; ++k) {
+        double angle = -PI * (double)((uint64_t)k * k % (2 * (uint64_t)n)) / (double)n;
+        chirp[2 * k] = cos(angle);
+        chirp[2 * k + 1] = sin(angle);
+    }
+    for (size_t k = 0; k < n; ++k) {
+        complex_store(a + 2 * k, complex_mul(complex_load(in + 2 * k), complex_load(chirp + 2 * k)));
+        b[2 * k] = chirp[2 * k];
+        b[2 * k + 1] = -chirp[2 * k + 1];
+        if (k > 0) {
+            b[2 * (m - k)] = chirp[2 * k];
+            b[2 * (m - k) + 1] = -chirp[2 * k + 1];
+        }
+    }
+    fft_pow2(a, spectrum_a, m);
+    fft_pow2(b, spectrum_b, m);
+
+    // Inverse of the product via conj(fft(conj(x)))
+    for (size_t k = 0; k < m; ++k) {
+        complex_store(a + 2 * k, complex_mul(complex_load(spectrum_a + 2 * k), complex_load(spectrum_b + 2 * k)));
+        a[2 * k + 1] = -a[2 * k + 1];
+    }
+    fft_pow2(a, spectrum_a, m);
+    for (size_t k = 0; k < n; ++k) {
+        spectrum_a[2 * k] /= (double)m;
+        spectrum_a[2 * k + 1] /= -(double)m;
+        complex_store(out + 2 * k, complex_mul(complex_load(spectrum_a + 2 * k), complex_load(chirp + 2 * k)));
+    }
+    free(chirp);
+    free(a);
+    free(b);
+    free(spectrum_a);
+    free(spectrum_b);
+}
+
+static void fft_forward(const double *in, double *out, size_t n) {
+    if (n == 0) return;
+    if ((n & (n - 1)) == 0) {
+        fft_pow2(in, out, n);
+    } else {
+        fft_bluestein(in, out, n);
+    }
+}
+
+void runtime_fft(double *data, size_t n, int inverse) {
+    if (n == 0) return;
+    double *work = (double *)malloc(2 * n * sizeof(double));
+    if (!work) { perror("fft malloc failed"); exit(1); }
+    if (inverse) {
+        for (size_t k = 0; k < n; ++k) data[2 * k + 1] = -data[2 * k + 1];
+    }
+    fft_forward(data, work, n);
+    if (inverse) {
+        for (size_t k = 0; k < n; ++k) {
+            data[2 * k] = work[2 * k] / (double)n;
+            data[2 * k + 1] = -work[2 * k + 1] / (double)n;
+        }
+    } else {
+        memcpy(data, work, 2 * n * sizeof(double));
+    }
+    free(work);
+}
+
+//------------------------------------------------------------------------------
+// Real Transforms
+//------------------------------------------------------------------------------
+double *c_fft(const double *data, size_t size, size_t *out_size) {
+    *out_size = 0;
+    if (size == 0) return NULL;
+    size_t bins = size / 2 + 1;
+    double *spectrum = (double *)runtime_buffer_alloc(2 * bins * sizeof(double));
+    *out_size = 2 * bins;
+
+    if (size % 2) {
+        // Odd length: transform as complex values with zero imaginary parts
+        double *z = (double *)calloc(4 * size, sizeof(double));
+        if (!z) { perror("fft malloc failed"); exit(1); }
+        for (size_t k = 0; k < size; ++k) z[2 * k] = data[k];
+        fft_forward(z, z + 2 * size, size);
+        memcpy(spectrum, z + 2 * size, 2 * bins * sizeof(double));
+        free(z);
+        return spectrum;
+    }
+
+    // Even length: the input read as size/2 complex values (even elements
+    // real, odd elements imaginary) gives both halves in one transform
+    size_t half = size / 2;
+    double *z = (double *)malloc(2 * half * sizeof(double));
+    if (!z) { perror("fft malloc failed"); exit(1); }
+    fft_forward(data, z, half);
+    const double *tw = (size & (size - 1)) == 0 ? twiddles(size) : NULL;
+    for (size_t k = 0; k <= half; ++k) {
+        size_t j = (half - k) % half;
+        double zr = z[2 * (k % half)], zi = z[2 * (k % half) + 1];
+        double cr = z[2 * j], ci = -z[2 * j + 1];
+        double even_re = 0.5 * (zr + cr), even_im = 0.5 * (zi + ci);
+        double odd_re = 0.5 * (zi - ci), odd_im = -0.5 * (zr - cr);
+        double wr, wi;
+        if (tw) {
+            wr = tw[2 * k];
+            wi = tw[2 * k + 1];
+        } else {
+            wr = cos(-2.0 * PI * (double)k / (double)size);
+            wi = sin(-2.0 * PI * (double)k / (double)size);
+        }
+        spectrum[2 * k] = even_re + wr * odd_re - wi * odd_im;
+        spectrum[2 * k + 1] = even_im + wr * odd_im + wi * odd_re;
+    }
+    free(z);
+    return spectrum;
+}
+
+double *c_ifft(const double *spectrum, size_t size, double length, size_t *out_size) {
+    *out_size = 0;
+    if (size % 2) {
+        fprintf(stderr, "Runtime Error: ifft() expects interleaved complex values (got an odd size %ld)\n", (long)size);
+        exit(1);
+    }
+    size_t bins = size / 2;
+    if (length < 0.0) length = bins ? 2.0 * (double)(bins - 1) : 0.0;
+    if (length != floor(length)) {
+        fprintf(stderr, "Runtime Error: ifft() length must be a whole number (got %g)\n", length);
+        exit(1);
+    }
+    size_t n = (size_t)length;
+    if (n == 0) return NULL;
+    if (n / 2 + 1 > bins) {
+        fprintf(stderr, "Runtime Error: ifft() needs %ld bins for length %ld (got %ld)\n",
+                (long)(n / 2 + 1), (long)n, (long)bins);
+        exit(1);
+    }
+
+    // Rebuild the full Hermitian spectrum and transform back
+    double *full = (double *)malloc(2 * n * sizeof(double));
+    if (!full) { perror("ifft malloc failed"); exit(1); }
+    for (size_t k = 0; k <= n / 2; ++k) {
+        full[2 * k] = spectrum[2 * k];
+        full[2 * k + 1] = spectrum[2 * k + 1];
+    }
+    for (size_t k = n / 2 + 1; k < n; ++k) {
+        full[2 * k] = spectrum[2 * (n - k)];
+        full[2 * k + 1] = -spectrum[2 * (n - k) + 1];
+    }
+    runtime_fft(full, n, 1);
+
+    double *values = (double *)runtime_buffer_alloc(n * sizeof(double));
+    for (size_t k = 0; k < n; ++k) values[k] = full[2 * k];
+    free(full);
+    *out_size = n;
+    return values;
+}
+
+//------------------------------------------------------------------------------
+// Convolution
+//------------------------------------------------------------------------------
+static void convolve_task(size_t task, void *ctx) {
+    ConvolveJob *job = (ConvolveJob *)ctx;
+    size_t begin = task * CONV_TASK_OUTPUTS;
+    size_t end = begin + CONV_TASK_OUTPUTS < job->out_size ? begin + CONV_TASK_OUTPUTS : job->out_size;
+    for (size_t k = begin; k < end; ++k) {
+        size_t first = k >= job->a_size ? k - job->a_size + 1 : 0;
+        size_t last = k < job->b_size ? k : job->b_size - 1;
+        double sum = 0.0;
+        for (size_t t = first; t <= last; ++t) sum += job->b[t] * job->a[k - t];
+        job->out[k] = sum;
+    }
+}
+
+// Both real inputs go into one complex transform (a real, b imaginary); the
+// two spectra are separated with the conjugate symmetry of real transforms
+static void convolve_fft(const double *a, size_t a_size, const double *b, size_t b_size,
+                         double *out, size_t out_size) {
+    size_t m = 1;
+    while (m < out_size) m <<= 1;
+    double *z = (double *)calloc(2 * m, sizeof(double));
+    double *spectrum = (double *)malloc(2 * m * sizeof(double));
+    if (!z || !spectrum) { perror("convolve malloc failed"); exit(1); }
+    for (size_t j = 0; j < a_size; ++j) z[2 * j] = a[j];
+    for (size_t j = 0; j < b_size; ++j) z[2 * j + 1] = b[j];
+    fft_pow2(z, spectrum, m);
+
+    for (size_t k = 0; k < m; ++k) {
+        size_t j = (m - k) % m;
+        double zr = spectrum[2 * k], zi = spectrum[2 * k + 1];
+        double cr = spectrum[2 * j], ci = -spectrum[2 * j + 1];
+        double a_re = 0.5 * (zr + cr), a_im = 0.5 * (zi + ci);
+        double b_re = 0.5 * (zi - ci), b_im = -0.5 * (zr - cr);
+        // Conjugated product, so a forward transform acts as the inverse
+        z[2 * k] = a_re * b_re - a_im * b_im;
+        z[2 * k + 1] = -(a_re * b_im + a_im * b_re);
+    }
+    fft_pow2(z, spectrum, m);
+    for (size_t k = 0; k < out_size; ++k) out[k] = spectrum[2 * k] / (double)m;
+    free(z);
+    free(spectrum);
+}
+
+double *c_convolve(const double *a, size_t a_size, const double *b, size_t b_size, size_t *out_size) {
+    *out_size = 0;
+    if (a_size == 0 || b_size == 0) return NULL;
+    if (a_size < b_size) { // Convolution commutes; make b the kernel
+        const double *swap = a; a = b; b = swap;
+        size_t swap_size = a_size; a_size = b_size; b_size = swap_size;
+    }
+    size_t n = a_size + b_size - 1;
+    double *out = (double *)runtime_buffer_alloc(n * sizeof(double));
+    if (b_size <= CONV_DIRECT_MAX) {
+        ConvolveJob job = { a, a_size, b, b_size, out, n };
+        runtime_parallel_for((n + CONV_TASK_OUTPUTS - 1) / CONV_TASK_OUTPUTS, convolve_task, &job);
+    } else {
+        convolve_fft(a, a_size, b, b_size, out, n);
+    }
+    *out_size = n;
+    return out;
+}
+
+double *c_correlate(const double *a, size_t a_size, const double *b, size_t b_size, size_t *out_size) {
+    double *reversed = (double *)malloc((b_size ? b_size : 1) * sizeof(double));
+    if (!reversed) { perror("correlate malloc failed"); exit(1); }
+    for (size_t j = 0; j < b_size; ++j) reversed[j] = b[b_size - 1 - j];
+    double *out = c_convolve(a, a_size, reversed, b_size, out_size);
+    free(reversed);
+    return out;
+}
\ No newline at end of file
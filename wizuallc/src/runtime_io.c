@@ -0,0 +1,651 @@
+#define _POSIX_C_SOURCE 200809L // For mmap, fstat and clock_gettime under -std=c11
+#define _DEFAULT_SOURCE         // For madvise
+#include "runtime_io.h"
+#include "runtime_mem.h"
+#include "runtime_parallel.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+#include <errno.h>
+#include <pthread.h>
+#include <fcntl.h>
+#ifdef _WIN32
+#include <io.h> // For open, write and close
+#else
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#define RUNTIME_HAVE_MMAP 1
+#endif
+#ifndef O_BINARY
+#define O_BINARY 0
+#endif
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+//------------------------------------------------------------------------------
+// CSV Cache
+// read_csv("file", col) parses every column of the file at once; the columns
+// are kept here so reading the other columns of the same file is free.
+//------------------------------------------------------------------------------
+typedef struct CsvCacheEntry {
+    char *path;
+    size_t rows;
+    size_t column_count;
+    double **columns; // column_count runtime buffers of 'rows' doubles
+    struct CsvCacheEntry *next;
+} CsvCacheEntry;
+
+static pthread_mutex_t csv_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static CsvCacheEntry *csv_cache_head = NULL;
+
+// A newline-aligned slice of the file, parsed by one task
+typedef struct {
+    const char *begin;
+    const char *end;
+    size_t rows;      // Non-blank lines in the slice (filled by the count pass)
+    size_t first_row; // Index of the slice's first row in the columns
+} CsvChunk;
+
+typedef struct {
+    CsvChunk *chunks;
+    size_t column_count;
+    double **columns;
+} CsvParseContext;
+
+#define CSV_MIN_CHUNK_BYTES (256 * 1024) // Don't split small files into tiny tasks
+#define CSV_CHUNKS_PER_THREAD 4          // Extra chunks so uneven lines balance out
+
+// Text output is formatted in parallel batches of FORMAT_TASK_VALUES values per
+// task; each batch is written in order before the next one is formatted.
+typedef struct {
+    const double *data;
+    size_t size;
+    size_t first;          // Index of the first value in this batch
+    const char *separator; // Written before every value except data[0]
+    char **texts;          // One buffer per task
+    size_t *lengths;
+} FormatBatch;
+
+typedef void (*TextSink)(const char *text, size_t length, void *ctx);
+
+#define FORMAT_TASK_VALUES 16384
+#define FORMAT_TASKS_PER_THREAD 4
+#define FORMAT_MAX_CHARS 32                // Longest formatted double plus separator
+#define SAVE_BLOCK_BYTES ((size_t)8 << 20) // Binary saves issue 8 MiB write() calls
+
+//------------------------------------------------------------------------------
+// Scanning and Number Parsing
+//------------------------------------------------------------------------------
+
+// Returns the first ',' or '\n' in [p, end), or end. Checks 16 bytes per step
+// with SSE2 compares where available.
+static const char *scan_delimiter(const char *p, const char *end) {
+#ifdef __SSE2__
+    const __m128i comma = _mm_set1_epi8(',');
+    const __m128i newline = _mm_set1_epi8('\n');
+    while (end - p >= 16) {
+        __m128i block = _mm_loadu_si128((const __m128i *)p);
+        int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(block, comma),
+                                                  _mm_cmpeq_epi8(block, newline)));
+        if (mask) return p + __builtin_ctz((unsigned)mask);
+        p += 16;
+    }
+#endif
+    while (p < end && *p != ',' && *p != '\n') ++p;
+    return p;
+}
+
+static int is_blank(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+static void trim_field(const char **begin, const char **end) {
+    while (*begin < *end && is_blank(**begin)) ++*begin;
+    while (*end > *begin && is_blank((*end)[-1])) --*end;
+}
+
+// Slow path: anything the fast path can't do exactly (long mantissas, large
+// exponents, nan/inf). Text that isn't a complete number becomes NaN.
+static double parse_number_fallback(const char *begin, const char *end) {
+    char local[64];
+    size_t length = (size_t)(end - begin);
+    char *text = length < sizeof(local) ? local : (char *)malloc(length + 1);
+    if (!text) { perror("csv field malloc failed"); exit(1); }
+    memcpy(text, begin, length);
+    text[length] = '\0';
+    char *parsed_end = NULL;
+    double value = strtod(text, &parsed_end);
+    if (parsed_end != text + length) value = NAN;
+    if (text != local) free(text);
+    return value;
+}
+
+// Parses one trimmed field. Up to 19 significant digits with a decimal
+// exponent in [-22, 22] is converted exactly with one multiply or divide by
+// an exact power of ten (Clinger's fast path); everything else uses strtod.
+static double parse_number(const char *begin, const char *end) {
+    static const double exact_pow10[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+    if (begin == end) return NAN;
+
+    const char *p = begin;
+    int negative = 0;
+    if (*p == '-' || *p == '+') {
+        negative = (*p == '-');
+        ++p;
+    }
+
+    uint64_t mantissa = 0;
+    int significant = 0; // Digits in mantissa, not counting leading zeros
+    int exponent = 0;
+    int any_digit = 0;
+    for (; p < end && *p >= '0' && *p <= '9'; ++p) {
+        any_digit = 1;
+        if (significant >= 19) return parse_number_fallback(begin, end);
+        mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+        if (mantissa) ++significant;
+    }
+    if (p < end && *p == '.') {
+        for (++p; p < end && *p >= '0' && *p <= '9'; ++p) {
+            any_digit = 1;
+            if (significant >= 19) return parse_number_fallback(begin, end);
+            mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+            if (mantissa) ++significant;
+            --exponent;
+        }
+    }
+    if (!any_digit) return parse_number_fallback(begin, end);
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        ++p;
+        int exponent_negative = 0;
+        if (p < end && (*p == '-' || *p == '+')) {
+            exponent_negative = (*p == '-');
+            ++p;
+        }
+        if (p == end) return NAN;
+        int written = 0;
+        for (; p < end && *p >= '0' && *p <= '9'; ++p) {
+            if (written < 10000) written = written * 10 + (*p - '0');
+        }
+        exponent += exponent_negative ? -written : written;
+    }
+    if (p != end) return parse_number_fallback(begin, end);
+
+    if (mantissa > ((uint64_t)1 << 53) || exponent < -22 || exponent > 22) {
+        return parse_number_fallback(begin, end);
+    }
+    double value = (double)mantissa;
+    value = (exponent < 0) ? value / exact_pow10[-exponent] : value * exact_pow10[exponent];
+    return negative ? -value : value;
+}
+
+double runtime_parse_number(const char *begin, const char *end) {
+    return parse_number(begin, end);
+}
+
+//------------------------------------------------------------------------------
+// Parallel Passes
+//------------------------------------------------------------------------------
+
+// Returns 1 if [begin, end) holds only blanks
+static int line_is_blank(const char *begin, const char *end) {
+    while (begin < end && is_blank(*begin)) ++begin;
+    return begin == end;
+}
+
+// Pass 1: count the rows of one chunk so every chunk knows where its rows go
+static void csv_count_task(size_t task, void *ctx) {
+    CsvChunk *chunk = &((CsvParseContext *)ctx)->chunks[task];
+    size_t rows = 0;
+    const char *p = chunk->begin;
+    while (p < chunk->end) {
+        const char *newline = memchr(p, '\n', (size_t)(chunk->end - p));
+        const char *line_end = newline ? newline : chunk->end;
+        if (!line_is_blank(p, line_end)) ++rows;
+        p = line_end + 1;
+    }
+    chunk->rows = rows;
+}
+
+// Pass 2: parse the chunk's rows straight into the preallocated columns
+static void csv_parse_task(size_t task, void *ctx) {
+    CsvParseContext *parse = (CsvParseContext *)ctx;
+    CsvChunk *chunk = &parse->chunks[task];
+    size_t row = chunk->first_row;
+    const char *p = chunk->begin;
+    const char *end = chunk->end;
+
+    while (p < end) {
+        size_t column = 0;
+        for (;;) {
+            const char *delimiter = scan_delimiter(p, end);
+            const char *field_begin = p;
+            const char *field_end = delimiter;
+            trim_field(&field_begin, &field_end);
+            int at_line_end = (delimiter == end || *delimiter == '\n');
+
+            if (column == 0 && at_line_end && field_begin == field_end) {
+                column = SIZE_MAX; // Blank line: no row
+            } else if (column < parse->column_count) {
+                parse->columns[column][row] = parse_number(field_begin, field_end);
+            }
+            p = delimiter + 1;
+            if (at_line_end) break;
+            ++column;
+        }
+        if (column == SIZE_MAX) continue;
+        for (++column; column < parse->column_count; ++column) {
+            parse->columns[column][row] = NAN; // Short row
+        }
+        ++row;
+    }
+}
+
+//------------------------------------------------------------------------------
+// File Loading
+//------------------------------------------------------------------------------
+
+// Maps (or on Windows, reads) the whole file. Returns NULL for empty files.
+static const char *load_file(const char *path, size_t *out_size) {
+#ifdef RUNTIME_HAVE_MMAP
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Runtime Error: Cannot open CSV file '%s': ", path);
+        perror(NULL);
+        exit(1);
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        perror("Runtime Error: Cannot stat CSV file");
+        exit(1);
+    }
+    *out_size = (size_t)info.st_size;
+    if (*out_size == 0) {
+        close(fd);
+        return NULL;
+    }
+    void *data = mmap(NULL, *out_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        perror("Runtime Error: Cannot map CSV file");
+        exit(1);
+    }
+    madvise(data, *out_size, MADV_WILLNEED);
+    return (const char *)data;
+#else
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        fprintf(stderr, "Runtime Error: Cannot open CSV file '%s': ", path);
+        perror(NULL);
+        exit(1);
+    }
+    fseek(fp, 0, SEEK_END);
+    *out_size = (size_t)ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    if (*out_size == 0) {
+        fclose(fp);
+        return NULL;
+    }
+    char *data = (char *)malloc(*out_size);
+    if (!data || fread(data, 1, *out_size, fp) != *out_size) {
+        perror("Runtime Error: Cannot read CSV file");
+        exit(1);
+    }
+    fclose(fp);
+    return data;
+#endif
+}
+
+static void unload_file(const char *data, size_t size) {
+    if (!data) return;
+#ifdef RUNTIME_HAVE_MMAP
+    munmap((void *)data, size);
+#else
+    (void)size;
+    free((void *)data);
+#endif
+}
+
+static double elapsed_seconds(const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)(now.tv_sec - start->tv_sec) + (double)(now.tv_nsec - start->tv_nsec) * 1e-9;
+}
+
+// Parses every column of a CSV file into a new cache entry
+static CsvCacheEntry *parse_csv_file(const char *path) {
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    CsvCacheEntry *entry = (CsvCacheEntry *)calloc(1, sizeof(CsvCacheEntry));
+    if (!entry) { perror("csv cache malloc failed"); exit(1); }
+    entry->path = (char *)malloc(strlen(path) + 1);
+    if (!entry->path) { perror("csv cache malloc failed"); exit(1); }
+    strcpy(entry->path, path);
+
+    size_t size = 0;
+    const char *data = load_file(path, &size);
+    const char *p = data;
+    const char *end = data + size;
+
+    // Skip leading blank lines, then a header line if the first field isn't numeric
+    while (p < end) {
+        const char *newline = memchr(p, '\n', (size_t)(end - p));
+        const char *line_end = newline ? newline : end;
+        if (!line_is_blank(p, line_end)) break;
+        p = line_end + 1;
+    }
+    if (p < end) {
+        const char *first = p;
+        while (first < end && is_blank(*first)) ++first;
+        if (first < end && !(*first == '-' || *first == '+' || *first == '.' ||
+                             (*first >= '0' && *first <= '9'))) {
+            const char *newline = memchr(p, '\n', (size_t)(end - p));
+            p = newline ? newline + 1 : end;
+        }
+    }
+
+    // Column count comes from the first data line
+    if (p < end) {
+        const char *newline = memchr(p, '\n', (size_t)(end - p));
+        const char *line_end = newline ? newline : end;
+        entry->column_count = 1;
+        for (const char *q = p; q < line_end; ++q) {
+            if (*q == ',') ++entry->column_count;
+        }
+    }
+
+    // Split the data into newline-aligned chunks
+    size_t data_bytes = (size_t)(end > p ? end - p : 0);
+    size_t chunk_count = runtime_thread_count() * CSV_CHUNKS_PER_THREAD;
+    if (chunk_count > data_bytes / CSV_MIN_CHUNK_BYTES + 1) chunk_count = data_bytes / CSV_MIN_CHUNK_BYTES + 1;
+    CsvChunk *chunks = (CsvChunk *)calloc(chunk_count, sizeof(CsvChunk));
+    if (!chunks) { perror("csv chunk malloc failed"); exit(1); }
+    const char *chunk_begin = p;
+    for (size_t k = 0; k < chunk_count; ++k) {
+        const char *chunk_end = end;
+        if (k + 1 < chunk_count) {
+            chunk_end = p + data_bytes * (k + 1) / chunk_count;
+            if (chunk_end < chunk_begin) chunk_end = chunk_begin;
+            const char *newline = memchr(chunk_end, '\n', (size_t)(end - chunk_end));
+            chunk_end = newline ? newline + 1 : end;
+        }
+        chunks[k].begin = chunk_begin;
+        chunks[k].end = chunk_end;
+        chunk_begin = chunk_end;
+    }
+
+    CsvParseContext parse = { chunks, entry->column_count, NULL };
+    runtime_parallel_for(chunk_count, csv_count_task, &parse);
+    for (size_t k = 0; k < chunk_count; ++k) {
+        chunks[k].first_row = entry->rows;
+        entry->rows += chunks[k].rows;
+    }
+
+    entry->columns = (double **)calloc(entry->column_count ? entry->column_count : 1, sizeof(double *));
+    if (!entry->columns) { perror("csv column malloc failed"); exit(1); }
+    for (size_t c = 0; c < entry->column_count; ++c) {
+        entry->columns[c] = (double *)runtime_buffer_alloc(entry->rows * sizeof(double));
+    }
+    parse.columns = entry->columns;
+    if (entry->rows > 0) {
+        runtime_parallel_for(chunk_count, csv_parse_task, &parse);
+    }
+
+    free(chunks);
+    unload_file(data, size);
+
+    double seconds = elapsed_seconds(&start);
+    printf("<<< Read %ld rows x %ld columns from %s (%.1f MB/s)\n",
+           (long)entry->rows, (long)entry->column_count, path,
+           seconds > 0 ? (double)size / seconds / 1e6 : 0.0);
+    return entry;
+}
+
+//------------------------------------------------------------------------------
+// Output Formatting
+//------------------------------------------------------------------------------
+
+// Writes the shortest text that strtod reads back as exactly value (at most
+// 24 chars, no terminator). Integral values skip snprintf entirely.
+static size_t format_double(char *out, double value) {
+    if (isnan(value)) {
+        memcpy(out, "nan", 3);
+        return 3;
+    }
+    if (isinf(value)) {
+        memcpy(out, value < 0 ? "-inf" : "inf", value < 0 ? 4 : 3);
+        return value < 0 ? 4 : 3;
+    }
+    if (value == floor(value) && fabs(value) < 1e15) {
+        char digits[20];
+        size_t digit_count = 0;
+        size_t length = 0;
+        if (signbit(value)) out[length++] = '-';
+        uint64_t whole = (uint64_t)fabs(value);
+        do {
+            digits[digit_count++] = (char)('0' + whole % 10);
+            whole /= 10;
+        } while (whole);
+        while (digit_count) out[length++] = digits[--digit_count];
+        return length;
+    }
+    char text[FORMAT_MAX_CHARS];
+    int length = 0;
+    for (int precision = 15; precision <= 17; ++precision) {
+        length = snprintf(text, sizeof(text), "%.*g", precision, value);
+        if (strtod(text, NULL) == value) break;
+    }
+    memcpy(out, text, (size_t)length);
+    return (size_t)length;
+}
+
+size_t runtime_format_number(char *out, double value) {
+    return format_double(out, value);
+}
+
+static void format_task(size_t task, void *ctx) {
+    FormatBatch *batch = (FormatBatch *)ctx;
+    size_t begin = batch->first + task * FORMAT_TASK_VALUES;
+    size_t end = begin + FORMAT_TASK_VALUES;
+    if (end > batch->size) end = batch->size;
+    size_t separator_length = strlen(batch->separator);
+
+    char *out = batch->texts[task];
+    for (size_t i = begin; i < end; ++i) {
+        if (i > 0) {
+            memcpy(out, batch->separator, separator_length);
+            out += separator_length;
+        }
+        out += format_double(out, batch->data[i]);
+    }
+    batch->lengths[task] = (size_t)(out - batch->texts[task]);
+}
+
+// Formats data[0..size) with separator between values and hands the text to
+// sink in order. Formatting runs on the thread pool, one batch at a time, so
+// memory stays bounded for any vector size.
+static void format_values(const double *data, size_t size, const char *separator,
+                          TextSink sink, void *sink_ctx) {
+    if (size == 0) return;
+    size_t task_count = (size + FORMAT_TASK_VALUES - 1) / FORMAT_TASK_VALUES;
+    size_t batch_tasks = runtime_thread_count() * FORMAT_TASKS_PER_THREAD;
+    if (batch_tasks > task_count) batch_tasks = task_count;
+    size_t task_values = size < FORMAT_TASK_VALUES ? size : FORMAT_TASK_VALUES;
+
+    FormatBatch batch = { data, size, 0, separator, NULL, NULL };
+    batch.texts = (char **)calloc(batch_tasks, sizeof(char *));
+    batch.lengths = (size_t *)calloc(batch_tasks, sizeof(size_t));
+    if (!batch.texts || !batch.lengths) { perror("format batch malloc failed"); exit(1); }
+    for (size_t t = 0; t < batch_tasks; ++t) {
+        batch.texts[t] = (char *)malloc(task_values * FORMAT_MAX_CHARS);
+        if (!batch.texts[t]) { perror("format batch malloc failed"); exit(1); }
+    }
+
+    for (size_t first = 0; first < size; first += batch_tasks * FORMAT_TASK_VALUES) {
+        size_t tasks = (size - first + FORMAT_TASK_VALUES - 1) / FORMAT_TASK_VALUES;
+        if (tasks > batch_tasks) tasks = batch_tasks;
+        batch.first = first;
+        runtime_parallel_for(tasks, format_task, &batch);
+        for (size_t t = 0; t < tasks; ++t) {
+            sink(batch.texts[t], batch.lengths[t], sink_ctx);
+        }
+    }
+
+    for (size_t t = 0; t < batch_tasks; ++t) free(batch.texts[t]);
+    free(batch.texts);
+    free(batch.lengths);
+}
+
+static void stdout_sink(const char *text, size_t length, void *ctx) {
+    (void)ctx;
+    fwrite(text, 1, length, stdout);
+}
+
+// Destination of save_vector
+typedef struct {
+    int fd;
+    const char *path;
+} OutputFile;
+
+// write() until everything is out, in blocks of at most SAVE_BLOCK_BYTES
+static void write_all(const OutputFile *file, const char *data, size_t length) {
+    while (length > 0) {
+        size_t request = length < SAVE_BLOCK_BYTES ? length : SAVE_BLOCK_BYTES;
+        ssize_t written = write(file->fd, data, request);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            fprintf(stderr, "Runtime Error: Cannot write to '%s': ", file->path);
+            perror(NULL);
+            exit(1);
+        }
+        data += written;
+        length -= (size_t)written;
+    }
+}
+
+static void file_sink(const char *text, size_t length, void *ctx) {
+    write_all((const OutputFile *)ctx, text, length);
+}
+
+static int has_suffix(const char *text, const char *suffix) {
+    size_t text_length = strlen(text);
+    size_t suffix_length = strlen(suffix);
+    return text_length >= suffix_length && strcmp(text + text_length - suffix_length, suffix) == 0;
+}
+
+//------------------------------------------------------------------------------
+// Public Runtime Functions
+//------------------------------------------------------------------------------
+double *c_read_csv_column(const char *path, double column, size_t *out_size) {
+    pthread_mutex_lock(&csv_cache_lock);
+    CsvCacheEntry *entry = csv_cache_head;
+    while (entry && strcmp(entry->path, path) != 0) {
+        entry = entry->next;
+    }
+    if (!entry) {
+        entry = parse_csv_file(path);
+        entry->next = csv_cache_head;
+        csv_cache_head = entry;
+    }
+    pthread_mutex_unlock(&csv_cache_lock);
+
+    if (column < 0 || column != floor(column) || (size_t)column >= entry->column_count) {
+        fprintf(stderr, "Runtime Error: read_csv column %g out of range for '%s' (%ld columns)\n",
+                column, path, (long)entry->column_count);
+        exit(1);
+    }
+    *out_size = entry->rows;
+    return (double *)runtime_buffer_retain(entry->columns[(size_t)column]);
+}
+
+void c_csv_cache_clear(void) {
+    pthread_mutex_lock(&csv_cache_lock);
+    CsvCacheEntry *entry = csv_cache_head;
+    while (entry) {
+        CsvCacheEntry *next = entry->next;
+        for (size_t c = 0; c < entry->column_count; ++c) {
+            runtime_buffer_release(entry->columns[c]);
+        }
+        free(entry->columns);
+        free(entry->path);
+        free(entry);
+        entry = next;
+    }
+    csv_cache_head = NULL;
+    pthread_mutex_unlock(&csv_cache_lock);
+}
+
+void c_print_scalar(double value) {
+    char text[FORMAT_MAX_CHARS];
+    size_t length = format_double(text, value);
+    text[length++] = '\n';
+    fwrite(text, 1, length, stdout);
+}
+
+void c_print_vector(const double *data, size_t size) {
+    fputc('[', stdout);
+    format_values(data, size, ", ", stdout_sink, NULL);
+    fputs("]\n", stdout);
+}
+
+void c_print_string(const char *text) {
+    puts(text);
+}
+
+// Shared by c_save_vector and c_save_binary. Text output requires doubles.
+static void save_vector_file(const void *data, size_t size, size_t element_size,
+                             int as_text, const char *path) {
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    OutputFile file = { open(path, O_WRONLY | O_CREAT | O_TRUNC | O_BINARY, 0644), path };
+    if (file.fd < 0) {
+        fprintf(stderr, "Runtime Error: Cannot create '%s': ", path);
+        perror(NULL);
+        exit(1);
+    }
+
+    size_t bytes_written = 0;
+    if (as_text) {
+        format_values((const double *)data, size, "\n", file_sink, &file);
+        if (size > 0) write_all(&file, "\n", 1);
+        bytes_written = (size_t)lseek(file.fd, 0, SEEK_CUR);
+    } else {
+        // Straight from the vector, no staging copy; spilled vectors are paged
+        // in one block ahead and dropped behind
+        size_t bytes = size * element_size;
+        for (size_t offset = 0; offset < bytes; offset += SAVE_BLOCK_BYTES) {
+            size_t block_end = offset + SAVE_BLOCK_BYTES < bytes ? offset + SAVE_BLOCK_BYTES : bytes;
+            runtime_buffer_stream(data, offset, block_end);
+            write_all(&file, (const char *)data + offset, block_end - offset);
+        }
+        bytes_written = bytes;
+    }
+
+    if (close(file.fd) != 0) {
+        fprintf(stderr, "Runtime Error: Cannot write to '%s': ", path);
+        perror(NULL);
+        exit(1);
+    }
+    double seconds = elapsed_seconds(&start);
+    printf("Saved %ld elements to %s as %s (%.1f MB/s)\n", (long)size, path,
+           as_text ? "text" : "binary",
+           seconds > 0 ? (double)bytes_written / seconds / 1e6 : 0.0);
+}
+
+void c_save_vector(const double *data, size_t size, const char *path) {
+    int as_text = has_suffix(path, ".txt") || has_suffix(path, ".csv");
+    save_vector_file(data, size, sizeof(double), as_text, path);
+}
+
+void c_save_binary(const void *data, size_t size, size_t element_size, const char *path) {
+    save_vector_file(data, size, element_size, 0, path);
+}
\ No newline at end of file
@@ -0,0 +1,289 @@
+#include "runtime_matrix.h"
+#include "runtime_mem.h"
+#include "runtime_parallel.h"
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Register block of the micro-kernel: a GEMM_MR x GEMM_NR tile of C is kept in
+// registers (eight SSE2 accumulators) while the shared dimension is walked
+#define GEMM_MR 4
+#define GEMM_NR 4
+// Cache blocks: a GEMM_KC x GEMM_NR sliver of B stays in L1, a GEMM_MC x
+// GEMM_KC block of A in L2 and a GEMM_KC x GEMM_NC panel of B in L3
+#define GEMM_KC 256
+#define GEMM_MC 64
+#define GEMM_NC 2048
+#define GEMM_TASK_COLS 512      // Columns of the B panel per task (a multiple of GEMM_NR)
+#define MATVEC_TASK_ROWS 256    // Rows per matvec task
+#define TRANSPOSE_TILE 32       // Tiles are TRANSPOSE_TILE x TRANSPOSE_TILE elements
+
+// One matmul: C (m x n) = A (m x k) * B (k x n), all row-major. The work is
+// done one B panel at a time; tasks split the panel's rows of C into GEMM_MC
+// blocks and its columns into GEMM_TASK_COLS groups.
+typedef struct {
+    const double *a;
+    const double *b;
+    double *c;
+    size_t m, n, k;
+    size_t jc, nc;     // Columns of the current panel
+    size_t pc, kc;     // Shared-dimension range of the current panel
+    double *packed_b;  // The panel, as GEMM_NR-wide slivers
+    size_t row_blocks;
+    size_t col_groups;
+} GemmJob;
+
+static double *alloc_result(size_t count) {
+    return count == 0 ? NULL : (double *)runtime_buffer_alloc(count * sizeof(double));
+}
+
+//------------------------------------------------------------------------------
+// Packing
+//------------------------------------------------------------------------------
+
+// Copies rows [ic, ic+mc) x columns [pc, pc+kc) of A into GEMM_MR-row slivers:
+// sliver s holds, for each p, the GEMM_MR values of column pc+p. Rows past the
+// end are zero-padded so the micro-kernel never needs a bounds check.
+static void pack_a(const GemmJob *job, size_t ic, size_t mc, double *packed) {
+    for (size_t i = 0; i < mc; i += GEMM_MR) {
+        for (size_t p = 0; p < job->kc; ++p) {
+            for (size_t r = 0; r < GEMM_MR; ++r) {
+                *packed++ = (i + r < mc) ? job->a[(ic + i + r) * job->k + job->pc + p] : 0.0;
+            }
+        }
+    }
+}
+
+// Copies one GEMM_NR-column sliver of the B panel; columns past the end are zero
+static void pack_b_sliver(const GemmJob *job, size_t j, double *packed) {
+    size_t width = job->nc - j < GEMM_NR ? job->nc - j : GEMM_NR;
+    for (size_t p = 0; p < job->kc; ++p) {
+        const double *row = job->b + (job->pc + p) * job->n + job->jc + j;
+        for (size_t col = 0; col < GEMM_NR; ++col) {
+            *packed++ = col < width ? row[col] : 0.0;
+        }
+    }
+}
+
+static void pack_b_task(size_t task, void *ctx) {
+    GemmJob *job = (GemmJob *)ctx;
+    size_t first = task * GEMM_TASK_COLS;
+    size_t last = first + GEMM_TASK_COLS < job->nc ? first + GEMM_TASK_COLS : job->nc;
+    for (size_t j = first; j < last; j += GEMM_NR) {
+        pack_b_sliver(job, j, job->packed_b + j * job->kc);
+    }
+}
+
+//------------------------------------------------------------------------------
+// Micro-kernel
+//------------------------------------------------------------------------------
+
+// C[0..mr) x [0..nr) += packed A sliver * packed B sliver over kc steps
+static void micro_kernel(size_t kc, const double *a, const double *b, double *c, size_t ldc,
+                         size_t mr, size_t nr) {
+    double tile[GEMM_MR * GEMM_NR];
+#ifdef __SSE2__
+    __m128d c00 = _mm_setzero_pd(), c01 = _mm_setzero_pd();
+    __m128d c10 = _mm_setzero_pd(), c11 = _mm_setzero_pd();
+    __m128d c20 = _mm_setzero_pd(), c21 = _mm_setzero_pd();
+    __m128d c30 = _mm_setzero_pd(), c31 = _mm_setzero_pd();
+    for (size_t p = 0; p < kc; ++p) {
+        __m128d b0 = _mm_loadu_pd(b);
+        __m128d b1 = _mm_loadu_pd(b + 2);
+        __m128d a_i = _mm_set1_pd(a[0]);
+        c00 = _mm_add_pd(c00, _mm_mul_pd(a_i, b0));
+        c01 = _mm_add_pd(c01, _mm_mul_pd(a_i, b1));
+        a_i = _mm_set1_pd(a[1]);
+        c10 = _mm_add_pd(c10, _mm_mul_pd(a_i, b0));
+        c11 = _mm_add_pd(c11, _mm_mul_pd(a_i, b1));
+        a_i = _mm_set1_pd(a[2]);
+        c20 = _mm_add_pd(c20, _mm_mul_pd(a_i, b0));
+        c21 = _mm_add_pd(c21, _mm_mul_pd(a_i, b1));
+        a_i = _mm_set1_pd(a[3]);
+        c30 = _mm_add_pd(c30, _mm_mul_pd(a_i, b0));
+        c31 = _mm_add_pd(c31, _mm_mul_pd(a_i, b1));
+        a += GEMM_MR;
+        b += GEMM_NR;
+    }
+    if (mr == GEMM_MR && nr == GEMM_NR) {
+        double *c0 = c, *c1 = c + ldc, *c2 = c + 2 * ldc, *c3 = c + 3 * ldc;
+        _mm_storeu_pd(c0, _mm_add_pd(_mm_loadu_pd(c0), c00));
+        _mm_storeu_pd(c0 + 2, _mm_add_pd(_mm_loadu_pd(c0 + 2), c01));
+        _mm_storeu_pd(c1, _mm_add_pd(_mm_loadu_pd(c1), c10));
+        _mm_storeu_pd(c1 + 2, _mm_add_pd(_mm_loadu_pd(c1 + 2), c11));
+        _mm_storeu_pd(c2, _mm_add_pd(_mm_loadu_pd(c2), c20));
+        _mm_storeu_pd(c2 + 2, _mm_add_pd(_mm_loadu_pd(c2 + 2), c21));
+        _mm_storeu_pd(c3, _mm_add_pd(_mm_loadu_pd(c3), c30));
+        _mm_storeu_pd(c3 + 2, _mm_add_pd(_mm_loadu_pd(c3 + 2), c31));
+        return;
+    }
+    _mm_storeu_pd(tile, c00);
+    _mm_storeu_pd(tile + 2, c01);
+    _mm_storeu_pd(tile + 4, c10);
+    _mm_storeu_pd(tile + 6, c11);
+    _mm_storeu_pd(tile + 8, c20);
+    _mm_storeu_pd(tile + 10, c21);
+    _mm_storeu_pd(tile + 12, c30);
+    _mm_storeu_pd(tile + 14, c31);
+#else
+    memset(tile, 0, sizeof(tile));
+    for (size_t p = 0; p < kc; ++p) {
+        for (size_t i = 0; i < GEMM_MR; ++i) {
+            for (size_t j = 0; j < GEMM_NR; ++j) tile[i * GEMM_NR + j] += a[i] * b[j];
+        }
+        a += GEMM_MR;
+        b += GEMM_NR;
+    }
+#endif
+    // Edge tile: only the part inside C is written back
+    for (size_t i = 0; i < mr; ++i) {
+        for (size_t j = 0; j < nr; ++j) c[i * ldc + j] += tile[i * GEMM_NR + j];
+    }
+}
+
+// One GEMM_MC row block x GEMM_TASK_COLS column group of the current panel
+static void gemm_task(size_t task, void *ctx) {
+    GemmJob *job = (GemmJob *)ctx;
+    size_t ic = task / job->col_groups * GEMM_MC;
+    size_t mc = job->m - ic < GEMM_MC ? job->m - ic : GEMM_MC;
+    size_t first = task % job->col_groups * GEMM_TASK_COLS;
+    size_t last = first + GEMM_TASK_COLS < job->nc ? first + GEMM_TASK_COLS : job->nc;
+
+    // Each task packs its own copy of the A block, so tasks share nothing they write
+    double *packed_a = (double *)malloc(GEMM_MC * GEMM_KC * sizeof(double));
+    if (!packed_a) { perror("matmul block malloc failed"); exit(1); }
+    pack_a(job, ic, mc, packed_a);
+    for (size_t j = first; j < last; j += GEMM_NR) {
+        size_t nr = last - j < GEMM_NR ? last - j : GEMM_NR;
+        const double *b_sliver = job->packed_b + j * job->kc;
+        for (size_t i = 0; i < mc; i += GEMM_MR) {
+            size_t mr = mc - i < GEMM_MR ? mc - i : GEMM_MR;
+            micro_kernel(job->kc, packed_a + i * job->kc, b_sliver,
+                         job->c + (ic + i) * job->n + job->jc + j, job->n, mr, nr);
+        }
+    }
+    free(packed_a);
+}
+
+//------------------------------------------------------------------------------
+// Row and Tile Tasks (matvec, transpose)
+//------------------------------------------------------------------------------
+typedef struct {
+    const double *a;
+    const double *x;
+    double *out;
+    size_t rows, cols;
+} MatrixJob;
+
+static void matvec_task(size_t task, void *ctx) {
+    MatrixJob *job = (MatrixJob *)ctx;
+    size_t end = (task + 1) * MATVEC_TASK_ROWS < job->rows ? (task + 1) * MATVEC_TASK_ROWS : job->rows;
+    for (size_t i = task * MATVEC_TASK_ROWS; i < end; ++i) {
+        const double *row = job->a + i * job->cols;
+        // Four partial sums so the additions don't wait on each other
+        double s0 = 0.0, s1 = 0.0, s2 = 0.0, s3 = 0.0;
+        size_t j = 0;
+        for (; j + 4 <= job->cols; j += 4) {
+            s0 += row[j] * job->x[j];
+            s1 += row[j + 1] * job->x[j + 1];
+            s2 += row[j + 2] * job->x[j + 2];
+            s3 += row[j + 3] * job->x[j + 3];
+        }
+        for (; j < job->cols; ++j) s0 += row[j] * job->x[j];
+        job->out[i] = (s0 + s1) + (s2 + s3);
+    }
+}
+
+// One row of tiles: out (cols x rows) gets the transpose of those rows of a
+static void transpose_task(size_t task, void *ctx) {
+    MatrixJob *job = (MatrixJob *)ctx;
+    size_t i0 = task * TRANSPOSE_TILE;
+    size_t i_end = i0 + TRANSPOSE_TILE < job->rows ? i0 + TRANSPOSE_TILE : job->rows;
+    for (size_t j0 = 0; j0 < job->cols; j0 += TRANSPOSE_TILE) {
+        size_t j_end = j0 + TRANSPOSE_TILE < job->cols ? j0 + TRANSPOSE_TILE : job->cols;
+        for (size_t i = i0; i < i_end; ++i) {
+            for (size_t j = j0; j < j_end; ++j) {
+                job->out[j * job->rows + i] = job->a[i * job->cols + j];
+            }
+        }
+    }
+}
+
+static size_t matrix_index(double index, size_t limit, const char *what) {
+    if (!(index >= 0.0) || index != floor(index) || index >= (double)limit) {
+        fprintf(stderr, "Runtime Error: %s index %g out of range (0 .. %ld)\n", what, index, (long)limit - 1);
+        exit(1);
+    }
+    return (size_t)index;
+}
+
+//------------------------------------------------------------------------------
+// Public Runtime Functions
+//------------------------------------------------------------------------------
+double *c_matmul(const double *a, size_t a_rows, size_t a_cols,
+                 const double *b, size_t b_rows, size_t b_cols) {
+    if (a_cols != b_rows) {
+        fprintf(stderr, "Runtime Error: matmul shape mismatch (%ldx%ld times %ldx%ld)\n",
+                (long)a_rows, (long)a_cols, (long)b_rows, (long)b_cols);
+        exit(1);
+    }
+    double *c = alloc_result(a_rows * b_cols);
+    if (!c) return NULL;
+    memset(c, 0, a_rows * b_cols * sizeof(double));
+    if (a_cols == 0) return c;
+
+    GemmJob job = { a, b, c, a_rows, b_cols, a_cols, 0, 0, 0, 0, NULL, 0, 0 };
+    size_t panel_cols = b_cols < GEMM_NC ? b_cols : GEMM_NC;
+    size_t panel_k = a_cols < GEMM_KC ? a_cols : GEMM_KC;
+    job.packed_b = (double *)malloc((panel_cols + GEMM_NR) * panel_k * sizeof(double));
+    if (!job.packed_b) { perror("matmul panel malloc failed"); exit(1); }
+    job.row_blocks = (a_rows + GEMM_MC - 1) / GEMM_MC;
+
+    for (job.jc = 0; job.jc < b_cols; job.jc += GEMM_NC) {
+        job.nc = b_cols - job.jc < GEMM_NC ? b_cols - job.jc : GEMM_NC;
+        job.col_groups = (job.nc + GEMM_TASK_COLS - 1) / GEMM_TASK_COLS;
+        for (job.pc = 0; job.pc < a_cols; job.pc += GEMM_KC) {
+            job.kc = a_cols - job.pc < GEMM_KC ? a_cols - job.pc : GEMM_KC;
+            runtime_parallel_for(job.col_groups, pack_b_task, &job);
+            runtime_parallel_for(job.row_blocks * job.col_groups, gemm_task, &job);
+        }
+    }
+    free(job.packed_b);
+    return c;
+}
+
+double *c_matvec(const double *a, size_t rows, size_t cols, const double *x, size_t x_size) {
+    if (cols != x_size) {
+        fprintf(stderr, "Runtime Error: matvec shape mismatch (%ldx%ld matrix, vector of %ld)\n",
+                (long)rows, (long)cols, (long)x_size);
+        exit(1);
+    }
+    MatrixJob job = { a, x, alloc_result(rows), rows, cols };
+    if (!job.out) return NULL;
+    runtime_parallel_for((rows + MATVEC_TASK_ROWS - 1) / MATVEC_TASK_ROWS, matvec_task, &job);
+    return job.out;
+}
+
+double *c_transpose(const double *a, size_t rows, size_t cols) {
+    MatrixJob job = { a, NULL, alloc_result(rows * cols), rows, cols };
+    if (!job.out) return NULL;
+    runtime_parallel_for((rows + TRANSPOSE_TILE - 1) / TRANSPOSE_TILE, transpose_task, &job);
+    return job.out;
+}
+
+double *c_matrix_row(const double *a, size_t rows, size_t cols, double index) {
+    size_t i = matrix_index(index, rows, "Row");
+    double *out = alloc_result(cols);
+    if (out) memcpy(out, a + i * cols, cols * sizeof(double));
+    return out;
+}
+
+double *c_matrix_col(const double *a, size_t rows, size_t cols, double index) {
+    size_t j = matrix_index(index, cols, "Column");
+    double *out = alloc_result(rows);
+    for (size_t i = 0; i < rows; ++i) out[i] = a[i * cols + j];
+    return out;
+}
\ No newline at end of file
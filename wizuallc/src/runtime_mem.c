@@ -0,0 +1,305 @@
+#define _POSIX_C_SOURCE 200809L // For mkstemp, ftruncate and mmap under -std=c11
+#define _DEFAULT_SOURCE         // For madvise
+#include "runtime_mem.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#ifndef _WIN32
+#include <unistd.h>
+#include <sys/mman.h>
+#define RUNTIME_HAVE_MMAP 1
+#endif
+
+// Where a buffer's bytes live
+typedef enum {
+    BUFFER_KIND_HEAP,   // malloc'd, counts against the memory budget
+    BUFFER_KIND_SPILLED // mmap'd scratch file, paged in and out by the kernel
+} BufferKind;
+
+// Header stored in front of every buffer. Padded to a full cache line so the
+// refcount never shares a line with the vector data that follows it, and so
+// the data keeps the block's RUNTIME_BUFFER_ALIGNMENT.
+typedef struct {
+    atomic_size_t refcount; // Number of owners (generated code + runtime snapshots)
+    size_t bytes;           // Size of the data area in bytes
+    BufferKind kind;
+    size_t mapped_bytes;    // Length of the mapping (header included) for SPILLED buffers
+} BufferHeader;
+
+#define BUFFER_HEADER_SIZE 64
+_Static_assert(BUFFER_HEADER_SIZE % RUNTIME_BUFFER_ALIGNMENT == 0 && sizeof(BufferHeader) <= BUFFER_HEADER_SIZE,
+               "The buffer header must keep the data aligned");
+
+// Out-of-core configuration, read once from the environment:
+//   WIZUALL_MEM_BUDGET       enables out-of-core mode; bytes of vector data kept in RAM (e.g. 48G)
+//   WIZUALL_SPILL_THRESHOLD  buffers smaller than this are never spilled (default 64M)
+//   WIZUALL_SCRATCH_DIR      directory for spill files (default $TMPDIR, then /tmp)
+typedef struct {
+    int out_of_core;
+    size_t budget;
+    size_t spill_threshold;
+    const char *scratch_dir;
+} MemConfig;
+
+static MemConfig mem_config;
+static pthread_once_t mem_config_once = PTHREAD_ONCE_INIT;
+static atomic_size_t resident_bytes; // Heap bytes currently allocated
+
+//------------------------------------------------------------------------------
+// Helpers to move between the data pointer and its header
+//------------------------------------------------------------------------------
+static BufferHeader *header_of(const void *data) {
+    return (BufferHeader *)((char *)data - BUFFER_HEADER_SIZE);
+}
+
+static void *data_of(BufferHeader *header) {
+    return (char *)header + BUFFER_HEADER_SIZE;
+}
+
+//------------------------------------------------------------------------------
+// Configuration
+//------------------------------------------------------------------------------
+
+// Parses sizes such as "512M", "64G" or "1048576". Returns 0 if unset/invalid.
+static size_t parse_size(const char *text) {
+    if (!text || !*text) return 0;
+    char *end = NULL;
+    double value = strtod(text, &end);
+    if (end == text || value <= 0) return 0;
+    switch (*end) {
+        case 'k': case 'K': value *= 1024.0; break;
+        case 'm': case 'M': value *= 1024.0 * 1024.0; break;
+        case 'g': case 'G': value *= 1024.0 * 1024.0 * 1024.0; break;
+        case 't': case 'T': value *= 1024.0 * 1024.0 * 1024.0 * 1024.0; break;
+        default: break;
+    }
+    return (size_t)value;
+}
+
+static void load_mem_config() {
+    mem_config.budget = parse_size(getenv("WIZUALL_MEM_BUDGET"));
+    mem_config.spill_threshold = parse_size(getenv("WIZUALL_SPILL_THRESHOLD"));
+    if (mem_config.spill_threshold == 0) mem_config.spill_threshold = (size_t)64 << 20;
+    mem_config.scratch_dir = getenv("WIZUALL_SCRATCH_DIR");
+    if (!mem_config.scratch_dir) mem_config.scratch_dir = getenv("TMPDIR");
+    if (!mem_config.scratch_dir) mem_config.scratch_dir = "/tmp";
+#ifdef RUNTIME_HAVE_MMAP
+    mem_config.out_of_core = mem_config.budget > 0;
+#else
+    if (mem_config.budget > 0) {
+        fprintf(stderr, "Warning: WIZUALL_MEM_BUDGET ignored, out-of-core vectors need mmap.\n");
+    }
+    mem_config.out_of_core = 0;
+#endif
+    if (mem_config.out_of_core) {
+        printf("Out-of-core mode: budget %lu MiB, spill threshold %lu MiB, scratch dir %s\n",
+               (unsigned long)(mem_config.budget >> 20),
+               (unsigned long)(mem_config.spill_threshold >> 20),
+               mem_config.scratch_dir);
+    }
+}
+
+static const MemConfig *get_mem_config() {
+    pthread_once(&mem_config_once, load_mem_config);
+    return &mem_config;
+}
+
+// Large buffers stay in RAM while the budget allows; the rest go to disk
+static int should_spill(size_t bytes) {
+    const MemConfig *config = get_mem_config();
+    if (!config->out_of_core || bytes < config->spill_threshold) return 0;
+    return atomic_load(&resident_bytes) + bytes > config->budget;
+}
+
+//------------------------------------------------------------------------------
+// Allocation Backends
+//------------------------------------------------------------------------------
+// Heap blocks are RUNTIME_BUFFER_ALIGNMENT aligned (malloc only guarantees 16)
+static void *aligned_block(size_t bytes) {
+#ifdef _WIN32
+    return _aligned_malloc(bytes, RUNTIME_BUFFER_ALIGNMENT);
+#else
+    void *block = NULL;
+    return posix_memalign(&block, RUNTIME_BUFFER_ALIGNMENT, bytes) == 0 ? block : NULL;
+#endif
+}
+
+static void free_block(void *block) {
+#ifdef _WIN32
+    _aligned_free(block);
+#else
+    free(block);
+#endif
+}
+
+static BufferHeader *alloc_heap(size_t bytes) {
+    BufferHeader *header = (BufferHeader *)aligned_block(BUFFER_HEADER_SIZE + bytes);
+    if (!header) {
+        perror("runtime_buffer_alloc malloc failed");
+        exit(1);
+    }
+    header->kind = BUFFER_KIND_HEAP;
+    header->mapped_bytes = 0;
+    atomic_fetch_add(&resident_bytes, bytes);
+    return header;
+}
+
+#ifdef RUNTIME_HAVE_MMAP
+// Backs the buffer with an anonymous (already unlinked) file in the scratch
+// directory, so the kernel can page it out instead of exhausting RAM.
+static BufferHeader *alloc_spilled(size_t bytes) {
+    const MemConfig *config = get_mem_config();
+    size_t path_len = strlen(config->scratch_dir) + 32;
+    char *path = (char *)malloc(path_len);
+    if (!path) { perror("spill path malloc failed"); exit(1); }
+    snprintf(path, path_len, "%s/wizuall-spill-XXXXXX", config->scratch_dir);
+
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        fprintf(stderr, "Runtime Error: Cannot create spill file in %s: ", config->scratch_dir);
+        perror(NULL);
+        exit(1);
+    }
+    unlink(path); // Space is reclaimed automatically once unmapped
+    free(path);
+
+    size_t mapped_bytes = BUFFER_HEADER_SIZE + bytes;
+    if (ftruncate(fd, (off_t)mapped_bytes) != 0) {
+        perror("Runtime Error: Cannot size spill file");
+        exit(1);
+    }
+    void *base = mmap(NULL, mapped_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        perror("Runtime Error: Cannot map spill file");
+        exit(1);
+    }
+    madvise(base, mapped_bytes, MADV_SEQUENTIAL); // Kernels stream front to back
+
+    BufferHeader *header = (BufferHeader *)base;
+    header->kind = BUFFER_KIND_SPILLED;
+    header->mapped_bytes = mapped_bytes;
+    return header;
+}
+#endif
+
+static void free_header(BufferHeader *header) {
+#ifdef RUNTIME_HAVE_MMAP
+    if (header->kind == BUFFER_KIND_SPILLED) {
+        munmap(header, header->mapped_bytes);
+        return;
+    }
+#endif
+    atomic_fetch_sub(&resident_bytes, header->bytes);
+    free_block(header);
+}
+
+//------------------------------------------------------------------------------
+// Buffer Functions (Implementations)
+//------------------------------------------------------------------------------
+
+void *runtime_buffer_alloc(size_t bytes) {
+    if (bytes == 0) return NULL;
+
+    BufferHeader *header;
+#ifdef RUNTIME_HAVE_MMAP
+    header = should_spill(bytes) ? alloc_spilled(bytes) : alloc_heap(bytes);
+#else
+    header = alloc_heap(bytes);
+#endif
+    atomic_init(&header->refcount, 1);
+    header->bytes = bytes;
+    return data_of(header);
+}
+
+void *runtime_buffer_realloc(void *data, size_t bytes) {
+    if (!data) return runtime_buffer_alloc(bytes);
+    if (bytes == 0) {
+        runtime_buffer_release(data);
+        return NULL;
+    }
+
+    BufferHeader *header = header_of(data);
+    if (atomic_load(&header->refcount) != 1) {
+        fprintf(stderr, "Runtime Error: Attempted to resize a shared buffer.\n");
+        exit(1);
+    }
+
+    // Spilled buffers (or growth past the budget) move to a fresh buffer
+    if (header->kind != BUFFER_KIND_HEAP || should_spill(bytes)) {
+        void *moved = runtime_buffer_alloc(bytes);
+        memcpy(moved, data, header->bytes < bytes ? header->bytes : bytes);
+        runtime_buffer_release(data);
+        return moved;
+    }
+
+    size_t old_bytes = header->bytes;
+#ifdef _WIN32
+    header = (BufferHeader *)_aligned_realloc(header, BUFFER_HEADER_SIZE + bytes, RUNTIME_BUFFER_ALIGNMENT);
+#else
+    header = (BufferHeader *)realloc(header, BUFFER_HEADER_SIZE + bytes);
+    // realloc only keeps malloc's alignment: move the block if it lost ours
+    if (header && (uintptr_t)header % RUNTIME_BUFFER_ALIGNMENT != 0) {
+        BufferHeader *aligned = (BufferHeader *)aligned_block(BUFFER_HEADER_SIZE + bytes);
+        if (aligned) memcpy(aligned, header, BUFFER_HEADER_SIZE + bytes);
+        free(header);
+        header = aligned;
+    }
+#endif
+    if (!header) {
+        perror("runtime_buffer_realloc failed");
+        exit(1);
+    }
+    header->bytes = bytes;
+    atomic_fetch_add(&resident_bytes, bytes);
+    atomic_fetch_sub(&resident_bytes, old_bytes);
+    return data_of(header);
+}
+
+void *runtime_buffer_retain(void *data) {
+    if (data) {
+        atomic_fetch_add_explicit(&header_of(data)->refcount, 1, memory_order_relaxed);
+    }
+    return data;
+}
+
+void runtime_buffer_release(void *data) {
+    if (!data) return;
+    BufferHeader *header = header_of(data);
+    // acq_rel so the freeing thread sees every write made by the other owners
+    if (atomic_fetch_sub_explicit(&header->refcount, 1, memory_order_acq_rel) == 1) {
+        free_header(header);
+    }
+}
+
+void runtime_buffer_stream(const void *data, size_t chunk_begin, size_t chunk_end) {
+#ifdef RUNTIME_HAVE_MMAP
+    if (!data) return;
+    BufferHeader *header = header_of(data);
+    if (header->kind != BUFFER_KIND_SPILLED) return;
+
+    // madvise works on whole pages, measured from the (page aligned) mapping
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    char *base = (char *)header;
+    size_t begin = BUFFER_HEADER_SIZE + chunk_begin;
+    size_t end = BUFFER_HEADER_SIZE + chunk_end;
+
+    // The previous chunk is done: drop its pages from our working set
+    // (the data stays in the page cache / spill file)
+    size_t chunk_bytes = chunk_end - chunk_begin;
+    size_t done_begin = begin > chunk_bytes ? (begin - chunk_bytes) / page * page : 0;
+    size_t done_end = begin / page * page;
+    if (done_end > done_begin) madvise(base + done_begin, done_end - done_begin, MADV_DONTNEED);
+
+    // Read ahead the chunk after this one
+    size_t ahead_begin = end / page * page;
+    size_t ahead_end = end + chunk_bytes;
+    if (ahead_end > header->mapped_bytes) ahead_end = header->mapped_bytes;
+    if (ahead_end > ahead_begin) madvise(base + ahead_begin, ahead_end - ahead_begin, MADV_WILLNEED);
+#else
+    (void)data; (void)chunk_begin; (void)chunk_end;
+#endif
+}
\ No newline at end of file
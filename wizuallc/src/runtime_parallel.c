@@ -0,0 +1,162 @@
+#define _POSIX_C_SOURCE 200809L // For pthreads and sysconf under -std=c11
+#include "runtime_parallel.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+// One parallel_for invocation. Tasks are claimed through next_task.
+typedef struct {
+    RuntimeTaskFn fn;
+    void *ctx;
+    size_t task_count;
+    atomic_size_t next_task;
+} ParallelJob;
+
+// Persistent pool: worker_count threads plus the calling thread
+static pthread_once_t pool_once = PTHREAD_ONCE_INIT;
+static size_t thread_count = 1;
+static size_t worker_count = 0;
+
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pool_wake = PTHREAD_COND_INITIALIZER;  // New job published
+static pthread_cond_t pool_done = PTHREAD_COND_INITIALIZER;  // Last worker finished a job
+static ParallelJob *current_job = NULL;
+static unsigned long job_generation = 0;
+static size_t workers_busy = 0;
+
+// Serialises callers: one job runs on the pool at a time
+static pthread_mutex_t dispatch_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Set while a thread executes tasks, so nested parallel_for calls run inline
+static _Thread_local int in_parallel_task = 0;
+
+//------------------------------------------------------------------------------
+// Pool Internals
+//------------------------------------------------------------------------------
+static void run_tasks(ParallelJob *job) {
+    int was_in_task = in_parallel_task;
+    in_parallel_task = 1;
+    size_t task;
+    while ((task = atomic_fetch_add(&job->next_task, 1)) < job->task_count) {
+        job->fn(task, job->ctx);
+    }
+    in_parallel_task = was_in_task;
+}
+
+static void *pool_worker(void *arg) {
+    (void)arg;
+    unsigned long seen_generation = 0;
+    pthread_mutex_lock(&pool_lock);
+    for (;;) {
+        while (job_generation == seen_generation) {
+            pthread_cond_wait(&pool_wake, &pool_lock);
+        }
+        seen_generation = job_generation;
+        ParallelJob *job = current_job;
+        pthread_mutex_unlock(&pool_lock);
+
+        run_tasks(job);
+
+        pthread_mutex_lock(&pool_lock);
+        if (--workers_busy == 0) {
+            pthread_cond_signal(&pool_done);
+        }
+    }
+    return NULL;
+}
+
+static void start_pool() {
+    const char *env = getenv("WIZUALL_NUM_THREADS");
+    long requested = env ? atol(env) : 0;
+    if (requested <= 0) {
+#ifdef _WIN32
+        requested = 1;
+#else
+        requested = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    }
+    if (requested < 1) requested = 1;
+    thread_count = (size_t)requested;
+
+    // Workers are detached and live until the program exits
+    for (size_t i = 0; i + 1 < thread_count; ++i) {
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, pool_worker, NULL) != 0) {
+            fprintf(stderr, "Warning: runtime thread pool started with %lu of %lu threads.\n",
+                    (unsigned long)(worker_count + 1), (unsigned long)thread_count);
+            break;
+        }
+        pthread_detach(thread);
+        ++worker_count;
+    }
+    thread_count = worker_count + 1;
+}
+
+//------------------------------------------------------------------------------
+// Public Functions
+//------------------------------------------------------------------------------
+size_t runtime_thread_count(void) {
+    pthread_once(&pool_once, start_pool);
+    return thread_count;
+}
+
+void runtime_parallel_for(size_t task_count, RuntimeTaskFn fn, void *ctx) {
+    if (task_count == 0) return;
+
+    ParallelJob job;
+    job.fn = fn;
+    job.ctx = ctx;
+    job.task_count = task_count;
+    atomic_init(&job.next_task, 0);
+
+    // Serial path: single task, nested call, no workers, or pool already busy
+    if (task_count == 1 || in_parallel_task || runtime_thread_count() == 1 ||
+        pthread_mutex_trylock(&dispatch_lock) != 0) {
+        run_tasks(&job);
+        return;
+    }
+
+    pthread_mutex_lock(&pool_lock);
+    current_job = &job;
+    workers_busy = worker_count;
+    ++job_generation;
+    pthread_cond_broadcast(&pool_wake);
+    pthread_mutex_unlock(&pool_lock);
+
+    run_tasks(&job); // The caller works too
+
+    pthread_mutex_lock(&pool_lock);
+    while (workers_busy > 0) {
+        pthread_cond_wait(&pool_done, &pool_lock);
+    }
+    current_job = NULL;
+    pthread_mutex_unlock(&pool_lock);
+
+    pthread_mutex_unlock(&dispatch_lock);
+}
+size_t runtime_range_tasks(int64_t begin, int64_t end, int dynamic_schedule, int64_t chunk) {
+    if (end <= begin) return 0;
+    return runtime_range_tasks_for(begin, end, dynamic_schedule, chunk, runtime_thread_count());
+}
+
+size_t runtime_range_tasks_for(int64_t begin, int64_t end, int dynamic_schedule, int64_t chunk, size_t threads) {
+    if (end <= begin) return 0;
+    uint64_t count = (uint64_t)end - (uint64_t)begin;
+    uint64_t tasks = threads > 0 ? threads : 1;
+    if (dynamic_schedule) {
+        tasks = (chunk > 0) ? count / (uint64_t)chunk + (count % (uint64_t)chunk != 0) : tasks * 8;
+    }
+    return (size_t)(tasks < count ? tasks : count);
+}
+
+int64_t runtime_range_start(int64_t begin, int64_t end, size_t task_count, size_t task) {
+    // The first count % task_count blocks get one extra index
+    uint64_t count = (uint64_t)end - (uint64_t)begin;
+    uint64_t base = count / task_count, extra = count % task_count;
+    uint64_t offset = (uint64_t)task * base + ((uint64_t)task < extra ? (uint64_t)task : extra);
+    return (int64_t)((uint64_t)begin + offset);
+}
\ No newline at end of file
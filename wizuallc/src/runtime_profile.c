@@ -0,0 +1,210 @@
+#define _POSIX_C_SOURCE 200809L // For clock_gettime under -std=c11
+#include "runtime_profile.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <limits.h>
+#include <stdatomic.h>
+#include <time.h>
+
+//------------------------------------------------------------------------------
+// Recording
+// The counters of a site are updated atomically: parallel for bodies and the
+// functions they call record from several threads at once.
+//------------------------------------------------------------------------------
+typedef struct {
+    atomic_ullong count;
+    atomic_ullong taken;
+    atomic_ullong ns;
+    atomic_ullong work_ns;
+    atomic_ullong size_min; // ULLONG_MAX until a size is recorded
+    atomic_ullong size_max;
+    atomic_ullong size_sum;
+} SiteCounters;
+
+static SiteCounters *counters = NULL;
+static size_t counter_count = 0; // Sites + 1 (site 0 is unused)
+static uint64_t program_fingerprint = 0;
+
+// The fields of ProfileSite, as named in the JSON file
+static const struct {
+    const char *name;
+    size_t offset;
+} profile_fields[] = {
+    { "count",    offsetof(ProfileSite, count) },
+    { "taken",    offsetof(ProfileSite, taken) },
+    { "ns",       offsetof(ProfileSite, ns) },
+    { "work_ns",  offsetof(ProfileSite, work_ns) },
+    { "size_min", offsetof(ProfileSite, size_min) },
+    { "size_max", offsetof(ProfileSite, size_max) },
+    { "size_sum", offsetof(ProfileSite, size_sum) }
+};
+#define PROFILE_FIELD_COUNT (sizeof(profile_fields) / sizeof(profile_fields[0]))
+
+static void write_profile(void) {
+    const char *path = getenv("WIZUALL_PROFILE");
+    if (!path || !*path) path = "wizuall_profile.json";
+    FILE *fp = fopen(path, "w");
+    if (!fp) { perror(path); return; }
+    fprintf(fp, "{\n");
+    fprintf(fp, "  \"fingerprint\": %llu,\n", (unsigned long long)program_fingerprint);
+    fprintf(fp, "  \"sites\": %llu,\n", (unsigned long long)(counter_count - 1));
+    fprintf(fp, "  \"records\": [");
+    int first = 1;
+    for (size_t s = 1; s < counter_count; ++s) {
+        ProfileSite site;
+        site.count = atomic_load(&counters[s].count);
+        site.taken = atomic_load(&counters[s].taken);
+        site.ns = atomic_load(&counters[s].ns);
+        site.work_ns = atomic_load(&counters[s].work_ns);
+        site.size_min = atomic_load(&counters[s].size_min);
+        site.size_max = atomic_load(&counters[s].size_max);
+        site.size_sum = atomic_load(&counters[s].size_sum);
+        if (site.size_min == ULLONG_MAX) site.size_min = 0;
+        if (site.count == 0 && site.ns == 0) continue; // Never reached
+        fprintf(fp, "%s\n    {\"site\": %llu", first ? "" : ",", (unsigned long long)s);
+        for (size_t f = 0; f < PROFILE_FIELD_COUNT; ++f) {
+            uint64_t value = *(const uint64_t *)((const char *)&site + profile_fields[f].offset);
+            fprintf(fp, ", \"%s\": %llu", profile_fields[f].name, (unsigned long long)value);
+        }
+        fprintf(fp, "}");
+        first = 0;
+    }
+    fprintf(fp, "\n  ]\n}\n");
+    if (fclose(fp) != 0) perror(path);
+}
+
+void runtime_profile_begin(size_t site_count, uint64_t fingerprint) {
+    counter_count = site_count + 1;
+    program_fingerprint = fingerprint;
+    counters = (SiteCounters *)malloc(counter_count * sizeof(SiteCounters));
+    if (!counters) { perror("profile malloc failed"); exit(1); }
+    for (size_t s = 0; s < counter_count; ++s) {
+        atomic_init(&counters[s].count, 0);
+        atomic_init(&counters[s].taken, 0);
+        atomic_init(&counters[s].ns, 0);
+        atomic_init(&counters[s].work_ns, 0);
+        atomic_init(&counters[s].size_min, ULLONG_MAX);
+        atomic_init(&counters[s].size_max, 0);
+        atomic_init(&counters[s].size_sum, 0);
+    }
+    atexit(write_profile); // Also on a runtime error, with what ran so far
+}
+
+uint64_t runtime_profile_clock(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
+
+void runtime_profile_time(size_t site, uint64_t start) {
+    atomic_fetch_add_explicit(&counters[site].ns, runtime_profile_clock() - start, memory_order_relaxed);
+}
+
+void runtime_profile_work(size_t site, uint64_t start) {
+    atomic_fetch_add_explicit(&counters[site].work_ns, runtime_profile_clock() - start, memory_order_relaxed);
+}
+
+int runtime_profile_branch(size_t site, int taken) {
+    atomic_fetch_add_explicit(&counters[site].count, 1, memory_order_relaxed);
+    if (taken) atomic_fetch_add_explicit(&counters[site].taken, 1, memory_order_relaxed);
+    return taken;
+}
+
+void runtime_profile_loop(size_t site, int64_t iterations) {
+    atomic_fetch_add_explicit(&counters[site].count, 1, memory_order_relaxed);
+    if (iterations > 0) atomic_fetch_add_explicit(&counters[site].taken, (uint64_t)iterations, memory_order_relaxed);
+}
+
+void runtime_profile_size(size_t site, size_t size) {
+    SiteCounters *c = &counters[site];
+    atomic_fetch_add_explicit(&c->count, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&c->size_sum, size, memory_order_relaxed);
+    unsigned long long seen = atomic_load_explicit(&c->size_min, memory_order_relaxed);
+    while (size < seen && !atomic_compare_exchange_weak_explicit(&c->size_min, &seen, size, memory_order_relaxed, memory_order_relaxed)) {}
+    seen = atomic_load_explicit(&c->size_max, memory_order_relaxed);
+    while (size > seen && !atomic_compare_exchange_weak_explicit(&c->size_max, &seen, size, memory_order_relaxed, memory_order_relaxed)) {}
+}
+
+void runtime_profile_count(size_t site) {
+    atomic_fetch_add_explicit(&counters[site].count, 1, memory_order_relaxed);
+}
+
+//------------------------------------------------------------------------------
+// Loading
+// Reads back exactly the JSON written above: the top-level numbers, then one
+// object of "name": number pairs per record. Unknown names are skipped.
+//------------------------------------------------------------------------------
+
+// The number after the first "name":, or 'missing' if there is none
+static uint64_t top_level_number(const char *text, const char *name, uint64_t missing) {
+    char key[32];
+    snprintf(key, sizeof(key), "\"%s\"", name);
+    const char *at = strstr(text, key);
+    if (!at) return missing;
+    at = strchr(at + strlen(key), ':');
+    return at ? strtoull(at + 1, NULL, 10) : missing;
+}
+
+ProfileSite *runtime_profile_load(const char *path, size_t site_count, uint64_t fingerprint) {
+    FILE *fp = fopen(path, "rb");
+    if (!fp) { perror(path); return NULL; }
+    size_t length = 0, capacity = 4096;
+    char *text = (char *)malloc(capacity);
+    if (!text) { perror("profile malloc failed"); exit(1); }
+    size_t got;
+    while ((got = fread(text + length, 1, capacity - length - 1, fp)) > 0) {
+        length += got;
+        if (capacity - length - 1 == 0) {
+            capacity *= 2;
+            text = (char *)realloc(text, capacity);
+            if (!text) { perror("profile realloc failed"); exit(1); }
+        }
+    }
+    fclose(fp);
+    text[length] = '\0';
+
+    const char *records = strstr(text, "\"records\"");
+    if (!records) {
+        fprintf(stderr, "Error: %s is not a WIZUALL profile.\n", path);
+        free(text);
+        return NULL;
+    }
+    uint64_t sites = top_level_number(text, "sites", UINT64_MAX); // Records only have "site"
+    uint64_t recorded_fingerprint = top_level_number(text, "fingerprint", 0);
+    if (sites != site_count || recorded_fingerprint != fingerprint) {
+        fprintf(stderr, "Error: %s is the profile of a different program (profile it again with --pgo-gen).\n", path);
+        free(text);
+        return NULL;
+    }
+
+    ProfileSite *profile = (ProfileSite *)calloc(site_count + 1, sizeof(ProfileSite));
+    if (!profile) { perror("profile calloc failed"); exit(1); }
+    for (const char *at = strchr(records, '{'); at; at = strchr(at, '{')) {
+        const char *close = strchr(at, '}');
+        if (!close) break;
+        ProfileSite site;
+        memset(&site, 0, sizeof(site));
+        uint64_t index = 0;
+        for (const char *key = strchr(at, '"'); key && key < close; key = strchr(key, '"')) {
+            const char *key_end = strchr(key + 1, '"');
+            const char *colon = key_end ? strchr(key_end, ':') : NULL;
+            if (!colon || colon > close) break;
+            char *value_end;
+            uint64_t value = strtoull(colon + 1, &value_end, 10);
+            size_t key_length = (size_t)(key_end - key - 1);
+            if (key_length == 4 && strncmp(key + 1, "site", 4) == 0) index = value;
+            for (size_t f = 0; f < PROFILE_FIELD_COUNT; ++f) {
+                if (strlen(profile_fields[f].name) == key_length && strncmp(key + 1, profile_fields[f].name, key_length) == 0) {
+                    *(uint64_t *)((char *)&site + profile_fields[f].offset) = value;
+                }
+            }
+            key = value_end;
+        }
+        if (index >= 1 && index <= site_count) profile[index] = site;
+        at = close + 1;
+    }
+    free(text);
+    return profile;
+}
\ No newline at end of file
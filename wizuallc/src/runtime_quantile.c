@@ -0,0 +1,309 @@
+#include "runtime_quantile.h"
+#include "runtime_mem.h"
+#include "runtime_parallel.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+
+#define SKETCH_DEFAULT_K 200
+#define SKETCH_MIN_K 8
+#define SELECT_SAMPLE_MIN 600          // Floyd-Rivest samples ranges larger than this
+#define QUANTILE_MIN_CHUNK 65536       // Elements per sketch task at least
+#define QUANTILE_TASKS_PER_THREAD 4
+#define QUANTILE_STREAM_CHUNK 131072   // Elements between runtime_buffer_stream hints
+
+// One level of the sketch. Items at level h stand for 2^h input values.
+typedef struct {
+    double *items;
+    size_t size;
+    size_t allocated;
+} Compactor;
+
+struct RuntimeSketch {
+    size_t k;
+    Compactor *levels;
+    size_t level_count;
+    size_t item_count;   // Items held over all levels
+    size_t max_items;    // Sum of the level capacities; compress when reached
+    size_t value_count;  // Values added (non-NaN)
+    double min, max;     // Exact extremes, returned for q = 0 and q = 1
+    uint64_t random;     // xorshift state for the compaction coin
+};
+
+// Arguments for the quantile_approx sketch tasks
+typedef struct {
+    const double *data;
+    size_t size;
+    size_t task_count;
+    RuntimeSketch **sketches;
+} SketchJob;
+
+static void check_quantile(double q) {
+    if (!(q >= 0.0 && q <= 1.0)) {
+        fprintf(stderr, "Runtime Error: Quantile %g is outside [0, 1]\n", q);
+        exit(1);
+    }
+}
+
+static int compare_doubles(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+//------------------------------------------------------------------------------
+// KLL Sketch
+//------------------------------------------------------------------------------
+
+// Capacities shrink by 2/3 per level below the top, never below 2
+static size_t level_capacity(const RuntimeSketch *sketch, size_t level) {
+    double capacity = ceil((double)sketch->k * pow(2.0 / 3.0, (double)(sketch->level_count - 1 - level)));
+    return capacity < 2.0 ? 2 : (size_t)capacity;
+}
+
+static void add_level(RuntimeSketch *sketch) {
+    sketch->levels = (Compactor *)realloc(sketch->levels, (sketch->level_count + 1) * sizeof(Compactor));
+    if (!sketch->levels) { perror("sketch level realloc failed"); exit(1); }
+    sketch->levels[sketch->level_count].items = NULL;
+    sketch->levels[sketch->level_count].size = 0;
+    sketch->levels[sketch->level_count].allocated = 0;
+    sketch->level_count++;
+
+    sketch->max_items = 0;
+    for (size_t h = 0; h < sketch->level_count; ++h) sketch->max_items += level_capacity(sketch, h);
+}
+
+static void level_push(Compactor *level, double value) {
+    if (level->size == level->allocated) {
+        level->allocated = level->allocated ? level->allocated * 2 : 16;
+        level->items = (double *)realloc(level->items, level->allocated * sizeof(double));
+        if (!level->items) { perror("sketch item realloc failed"); exit(1); }
+    }
+    level->items[level->size++] = value;
+}
+
+// Compacts the lowest full level: sorts it and promotes every other item
+// (starting at a random offset) to the level above with twice the weight.
+static void compress(RuntimeSketch *sketch) {
+    for (size_t h = 0; h < sketch->level_count; ++h) {
+        Compactor *level = &sketch->levels[h];
+        if (level->size < level_capacity(sketch, h)) continue;
+        if (h + 1 == sketch->level_count) {
+            add_level(sketch);
+            level = &sketch->levels[h]; // add_level may move the array
+        }
+
+        qsort(level->items, level->size, sizeof(double), compare_doubles);
+        sketch->random ^= sketch->random << 13;
+        sketch->random ^= sketch->random >> 7;
+        sketch->random ^= sketch->random << 17;
+        size_t pairs = level->size / 2;
+        size_t offset = sketch->random & 1;
+        for (size_t i = 0; i < pairs; ++i) {
+            level_push(&sketch->levels[h + 1], level->items[2 * i + offset]);
+        }
+        // An odd item out stays behind
+        if (level->size % 2) level->items[0] = level->items[level->size - 1];
+        level->size %= 2;
+        sketch->item_count -= pairs;
+        return;
+    }
+}
+
+RuntimeSketch *runtime_sketch_create(size_t k) {
+    RuntimeSketch *sketch = (RuntimeSketch *)calloc(1, sizeof(RuntimeSketch));
+    if (!sketch) { perror("sketch malloc failed"); exit(1); }
+    sketch->k = k < SKETCH_MIN_K ? SKETCH_MIN_K : k;
+    sketch->min = INFINITY;
+    sketch->max = -INFINITY;
+    sketch->random = 0x9E3779B97F4A7C15ULL; // Fixed seed: results are reproducible
+    add_level(sketch);
+    return sketch;
+}
+
+void runtime_sketch_add(RuntimeSketch *sketch, const double *values, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        double value = values[i];
+        if (value != value) continue;
+        if (value < sketch->min) sketch->min = value;
+        if (value > sketch->max) sketch->max = value;
+        level_push(&sketch->levels[0], value);
+        sketch->value_count++;
+        if (++sketch->item_count >= sketch->max_items) compress(sketch);
+    }
+}
+
+void runtime_sketch_merge(RuntimeSketch *dst, const RuntimeSketch *src) {
+    while (dst->level_count < src->level_count) add_level(dst);
+    for (size_t h = 0; h < src->level_count; ++h) {
+        const Compactor *level = &src->levels[h];
+        for (size_t i = 0; i < level->size; ++i) level_push(&dst->levels[h], level->items[i]);
+        dst->item_count += level->size;
+    }
+    dst->value_count += src->value_count;
+    if (src->min < dst->min) dst->min = src->min;
+    if (src->max > dst->max) dst->max = src->max;
+    while (dst->item_count >= dst->max_items) compress(dst);
+}
+
+typedef struct {
+    double value;
+    double weight;
+} WeightedItem;
+
+static int compare_weighted(const void *a, const void *b) {
+    return compare_doubles(&((const WeightedItem *)a)->value, &((const WeightedItem *)b)->value);
+}
+
+double runtime_sketch_quantile(const RuntimeSketch *sketch, double q) {
+    check_quantile(q);
+    if (sketch->value_count == 0) return NAN;
+    if (q == 0.0) return sketch->min;
+    if (q == 1.0) return sketch->max;
+
+    WeightedItem *items = (WeightedItem *)malloc(sketch->item_count * sizeof(WeightedItem));
+    if (!items) { perror("sketch query malloc failed"); exit(1); }
+    size_t count = 0;
+    double total = 0.0;
+    for (size_t h = 0; h < sketch->level_count; ++h) {
+        double weight = ldexp(1.0, (int)h);
+        for (size_t i = 0; i < sketch->levels[h].size; ++i) {
+            items[count].value = sketch->levels[h].items[i];
+            items[count++].weight = weight;
+        }
+        total += weight * (double)sketch->levels[h].size;
+    }
+    qsort(items, count, sizeof(WeightedItem), compare_weighted);
+
+    double target = q * total, seen = 0.0, result = sketch->max;
+    for (size_t i = 0; i < count; ++i) {
+        seen += items[i].weight;
+        if (seen >= target) {
+            result = items[i].value;
+            break;
+        }
+    }
+    free(items);
+    return result;
+}
+
+void runtime_sketch_free(RuntimeSketch *sketch) {
+    if (!sketch) return;
+    for (size_t h = 0; h < sketch->level_count; ++h) free(sketch->levels[h].items);
+    free(sketch->levels);
+    free(sketch);
+}
+
+//------------------------------------------------------------------------------
+// Exact Selection
+//------------------------------------------------------------------------------
+
+// Floyd-Rivest selection: afterwards a[k] holds the k-th smallest element,
+// with smaller elements before it and larger ones after it.
+static void select_kth(double *a, ptrdiff_t left, ptrdiff_t right, ptrdiff_t k) {
+    while (right > left) {
+        // Recurse on a sample first so the pivot lands close to k
+        if (right - left > SELECT_SAMPLE_MIN) {
+            double n = (double)(right - left + 1);
+            double i = (double)(k - left + 1);
+            double z = log(n);
+            double s = 0.5 * exp(2.0 * z / 3.0);
+            double sd = 0.5 * sqrt(z * s * (n - s) / n) * (i < n / 2 ? -1.0 : 1.0);
+            ptrdiff_t new_left = (ptrdiff_t)((double)k - i * s / n + sd);
+            ptrdiff_t new_right = (ptrdiff_t)((double)k + (n - i) * s / n + sd);
+            select_kth(a, new_left > left ? new_left : left, new_right < right ? new_right : right, k);
+        }
+
+        double pivot = a[k], swap;
+        ptrdiff_t i = left, j = right;
+        swap = a[left]; a[left] = a[k]; a[k] = swap;
+        if (a[right] > pivot) { swap = a[right]; a[right] = a[left]; a[left] = swap; }
+        while (i < j) {
+            swap = a[i]; a[i] = a[j]; a[j] = swap;
+            ++i;
+            --j;
+            while (a[i] < pivot) ++i;
+            while (a[j] > pivot) --j;
+        }
+        if (a[left] == pivot) {
+            swap = a[left]; a[left] = a[j]; a[j] = swap;
+        } else {
+            ++j;
+            swap = a[j]; a[j] = a[right]; a[right] = swap;
+        }
+        if (j <= k) left = j + 1;
+        if (k <= j) right = j - 1;
+    }
+}
+
+//------------------------------------------------------------------------------
+// Public Runtime Functions
+//------------------------------------------------------------------------------
+double c_quantile(const double *data, size_t size, double q) {
+    check_quantile(q);
+    double *work = (double *)malloc((size ? size : 1) * sizeof(double));
+    if (!work) { perror("quantile malloc failed"); exit(1); }
+    size_t count = 0;
+    for (size_t i = 0; i < size; ++i) {
+        if (data[i] == data[i]) work[count++] = data[i];
+    }
+    if (count == 0) {
+        free(work);
+        return NAN;
+    }
+
+    // Linear interpolation between order statistics k and k+1
+    double position = q * (double)(count - 1);
+    size_t k = (size_t)position;
+    double fraction = position - (double)k;
+    select_kth(work, 0, (ptrdiff_t)count - 1, (ptrdiff_t)k);
+    double result = work[k];
+    if (fraction > 0.0) {
+        double next = work[k + 1]; // Everything after k is >= work[k]; take the smallest
+        for (size_t i = k + 2; i < count; ++i) {
+            if (work[i] < next) next = work[i];
+        }
+        result += fraction * (next - result);
+    }
+    free(work);
+    return result;
+}
+
+static size_t task_begin(const SketchJob *job, size_t task) {
+    return job->size / job->task_count * task + (task < job->size % job->task_count ? task : job->size % job->task_count);
+}
+
+static void sketch_task(size_t task, void *ctx) {
+    SketchJob *job = (SketchJob *)ctx;
+    size_t begin = task_begin(job, task), end = task_begin(job, task + 1);
+
+    RuntimeSketch *sketch = runtime_sketch_create(SKETCH_DEFAULT_K);
+    for (size_t chunk = begin; chunk < end; chunk += QUANTILE_STREAM_CHUNK) {
+        size_t chunk_end = chunk + QUANTILE_STREAM_CHUNK < end ? chunk + QUANTILE_STREAM_CHUNK : end;
+        runtime_buffer_stream(job->data, chunk * sizeof(double), chunk_end * sizeof(double));
+        runtime_sketch_add(sketch, job->data + chunk, chunk_end - chunk);
+    }
+    job->sketches[task] = sketch;
+}
+
+double c_quantile_approx(const double *data, size_t size, double q) {
+    check_quantile(q);
+    size_t task_count = runtime_thread_count() * QUANTILE_TASKS_PER_THREAD;
+    if (task_count > size / QUANTILE_MIN_CHUNK) task_count = size / QUANTILE_MIN_CHUNK;
+    if (task_count == 0) task_count = 1;
+
+    SketchJob job = { data, size, task_count, NULL };
+    job.sketches = (RuntimeSketch **)malloc(task_count * sizeof(RuntimeSketch *));
+    if (!job.sketches) { perror("quantile sketch malloc failed"); exit(1); }
+    runtime_parallel_for(task_count, sketch_task, &job);
+
+    for (size_t task = 1; task < task_count; ++task) {
+        runtime_sketch_merge(job.sketches[0], job.sketches[task]);
+        runtime_sketch_free(job.sketches[task]);
+    }
+    double result = runtime_sketch_quantile(job.sketches[0], q);
+    runtime_sketch_free(job.sketches[0]);
+    free(job.sketches);
+    return result;
+}
\ No newline at end of file
@@ -0,0 +1,187 @@
+#include "runtime_rolling.h"
+#include "runtime_mem.h"
+#include "runtime_parallel.h"
+#include <stdio.h>
+#include <math.h>
+
+#define ROLLING_MIN_CHUNK 65536      // Output elements per task at least
+#define ROLLING_TASKS_PER_THREAD 4
+#define ROLLING_REANCHOR 4096        // Steps between exact recomputations (at least one window)
+
+typedef enum {
+    ROLLING_SUM,
+    ROLLING_MEAN,
+    ROLLING_STD,
+    ROLLING_MIN,
+    ROLLING_MAX
+} RollingOp;
+
+// One rolling call, split into tasks over the output
+typedef struct {
+    const double *in;
+    double *out;
+    size_t size;
+    size_t window;
+    size_t task_count;
+    RollingOp op;
+} RollingJob;
+
+// Running state of the current window: sums of x - shift and (x - shift)^2,
+// with the shift taken from the data so the variance doesn't cancel badly.
+// NaNs are only counted.
+typedef struct {
+    double shift;
+    size_t nan_count;
+    double sum;
+    double sum_squares;
+} WindowState;
+
+static size_t task_begin(const RollingJob *job, size_t task) {
+    return job->size / job->task_count * task + (task < job->size % job->task_count ? task : job->size % job->task_count);
+}
+
+//------------------------------------------------------------------------------
+// Running Sums (sum, mean, std)
+//------------------------------------------------------------------------------
+static void state_add(WindowState *state, double x) {
+    if (x != x) { state->nan_count++; return; }
+    double d = x - state->shift;
+    state->sum += d;
+    state->sum_squares += d * d;
+}
+
+// Inverse of state_add
+static void state_remove(WindowState *state, double x) {
+    if (x != x) { state->nan_count--; return; }
+    double d = x - state->shift;
+    state->sum -= d;
+    state->sum_squares -= d * d;
+}
+
+// Fresh state for the window in[begin, end), shifted by its last non-NaN value
+static WindowState state_anchor(const double *in, size_t begin, size_t end) {
+    WindowState state = { 0.0, 0, 0.0, 0.0 };
+    for (size_t j = end; j > begin; --j) {
+        if (in[j - 1] == in[j - 1]) {
+            state.shift = in[j - 1];
+            break;
+        }
+    }
+    for (size_t j = begin; j < end; ++j) state_add(&state, in[j]);
+    return state;
+}
+
+static void running_task(size_t task, void *ctx) {
+    RollingJob *job = (RollingJob *)ctx;
+    size_t begin = task_begin(job, task), end = task_begin(job, task + 1);
+    size_t window = job->window;
+    size_t first = begin + 1 >= window ? begin + 1 - window : 0; // Start of the halo
+    size_t reanchor = window > ROLLING_REANCHOR ? window : ROLLING_REANCHOR;
+
+    // Anchor on the halo (or the first window), then slide
+    size_t anchor_end = begin + 1 > first + window ? first + window : begin + 1;
+    if (anchor_end > end) anchor_end = end;
+    WindowState state = state_anchor(job->in, first, anchor_end);
+    size_t since_anchor = 0;
+    for (size_t i = first; i < end; ++i) {
+        if (i >= anchor_end) {
+            if (i >= first + window) state_remove(&state, job->in[i - window]);
+            state_add(&state, job->in[i]);
+        }
+        if (i < begin) continue;
+        if (i + 1 < window) {
+            job->out[i] = NAN;
+            continue;
+        }
+
+        // Recompute the window from scratch now and then so drift can't build up
+        if (++since_anchor >= reanchor) {
+            state = state_anchor(job->in, i + 1 - window, i + 1);
+            since_anchor = 0;
+        }
+
+        if (state.nan_count > 0) {
+            job->out[i] = NAN;
+        } else if (job->op == ROLLING_SUM) {
+            job->out[i] = state.sum + state.shift * (double)window;
+        } else if (job->op == ROLLING_MEAN) {
+            job->out[i] = state.sum / (double)window + state.shift;
+        } else {
+            double m2 = state.sum_squares - state.sum * state.sum / (double)window;
+            job->out[i] = window < 2 ? NAN : sqrt(fmax(m2, 0.0) / (double)(window - 1));
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+// Monotonic Deque (min, max)
+//------------------------------------------------------------------------------
+
+// The deque holds indices whose values increase (min) or decrease (max) from
+// front to back; the front is the extreme of the current window.
+static void extreme_task(size_t task, void *ctx) {
+    RollingJob *job = (RollingJob *)ctx;
+    size_t begin = task_begin(job, task), end = task_begin(job, task + 1);
+    size_t window = job->window;
+    size_t first = begin + 1 >= window ? begin + 1 - window : 0;
+    int is_min = (job->op == ROLLING_MIN);
+    const double *in = job->in;
+
+    size_t *deque = (size_t *)malloc((end - first) * sizeof(size_t));
+    if (!deque) { perror("rolling deque malloc failed"); exit(1); }
+    size_t head = 0, tail = 0, nan_count = 0;
+    for (size_t i = first; i < end; ++i) {
+        if (i >= first + window && in[i - window] != in[i - window]) nan_count--;
+        double x = in[i];
+        if (x != x) {
+            nan_count++;
+        } else {
+            while (tail > head && (is_min ? in[deque[tail - 1]] >= x : in[deque[tail - 1]] <= x)) tail--;
+            deque[tail++] = i;
+        }
+        if (head < tail && deque[head] + window <= i) head++; // At most one index expires per step
+        if (i < begin) continue;
+        job->out[i] = (i + 1 < window || nan_count > 0) ? NAN : in[deque[head]];
+    }
+    free(deque);
+}
+
+//------------------------------------------------------------------------------
+// Public Runtime Functions
+//------------------------------------------------------------------------------
+static double *rolling(const double *data, size_t size, double window, RollingOp op) {
+    if (!(window >= 1.0) || window != floor(window)) {
+        fprintf(stderr, "Runtime Error: Rolling window must be a positive integer (got %g)\n", window);
+        exit(1);
+    }
+    if (size == 0) return NULL;
+
+    RollingJob job = { data, (double *)runtime_buffer_alloc(size * sizeof(double)), size, (size_t)window, 0, op };
+    job.task_count = runtime_thread_count() * ROLLING_TASKS_PER_THREAD;
+    if (job.task_count > size / ROLLING_MIN_CHUNK) job.task_count = size / ROLLING_MIN_CHUNK;
+    if (job.task_count == 0) job.task_count = 1;
+
+    int use_deque = (op == ROLLING_MIN || op == ROLLING_MAX);
+    runtime_parallel_for(job.task_count, use_deque ? extreme_task : running_task, &job);
+    return job.out;
+}
+
+double *c_rolling_sum(const double *data, size_t size, double window) {
+    return rolling(data, size, window, ROLLING_SUM);
+}
+
+double *c_rolling_mean(const double *data, size_t size, double window) {
+    return rolling(data, size, window, ROLLING_MEAN);
+}
+
+double *c_rolling_std(const double *data, size_t size, double window) {
+    return rolling(data, size, window, ROLLING_STD);
+}
+
+double *c_rolling_min(const double *data, size_t size, double window) {
+    return rolling(data, size, window, ROLLING_MIN);
+}
+
+double *c_rolling_max(const double *data, size_t size, double window) {
+    return rolling(data, size, window, ROLLING_MAX);
+}
\ No newline at end of file
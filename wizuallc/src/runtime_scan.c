@@ -0,0 +1,217 @@
+#include "runtime_scan.h"
+#include "runtime_mem.h"
+#include "runtime_parallel.h"
+#include <stdio.h>
+#include <stdlib.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define SCAN_MIN_BLOCK 65536      // Elements per block at least; smaller inputs run serially
+#define SCAN_BLOCKS_PER_THREAD 4  // Extra blocks so the dynamic scheduler can balance
+
+// One runtime_blocked_scan invocation
+typedef struct {
+    size_t size;
+    size_t block_count;
+    RuntimeBlockReduceFn reduce;
+    RuntimeBlockScanFn scan;
+    void *ctx;
+    double *summaries; // Block summaries after pass 1, carry-ins after the serial scan
+} BlockedScan;
+
+// Arrays for the cumsum/cumprod block kernels
+typedef struct {
+    const double *in;
+    double *out;
+} ScanArrays;
+
+// Arrays for compact
+typedef struct {
+    const double *data;
+    const double *mask;
+    double *out;
+    size_t size;
+    size_t kept; // Written by the block that ends the input
+} CompactArrays;
+
+//------------------------------------------------------------------------------
+// Blocked Scan Skeleton
+//------------------------------------------------------------------------------
+static size_t block_begin(const BlockedScan *job, size_t block) {
+    return job->size / job->block_count * block + (block < job->size % job->block_count ? block : job->size % job->block_count);
+}
+
+static void reduce_task(size_t task, void *ctx) {
+    BlockedScan *job = (BlockedScan *)ctx;
+    job->summaries[task] = job->reduce(block_begin(job, task), block_begin(job, task + 1), job->ctx);
+}
+
+static void scan_task(size_t task, void *ctx) {
+    BlockedScan *job = (BlockedScan *)ctx;
+    job->scan(block_begin(job, task), block_begin(job, task + 1), job->summaries[task], job->ctx);
+}
+
+void runtime_blocked_scan(size_t size, RuntimeScanOp op, RuntimeBlockReduceFn reduce,
+                          RuntimeBlockScanFn scan, void *ctx) {
+    if (size == 0) return;
+    double identity = (op == RUNTIME_SCAN_SUM) ? 0.0 : 1.0;
+
+    size_t block_count = runtime_thread_count() * SCAN_BLOCKS_PER_THREAD;
+    if (block_count > size / SCAN_MIN_BLOCK) block_count = size / SCAN_MIN_BLOCK;
+    if (block_count <= 1) {
+        scan(0, size, identity, ctx);
+        return;
+    }
+
+    BlockedScan job = { size, block_count, reduce, scan, ctx, NULL };
+    job.summaries = (double *)malloc(block_count * sizeof(double));
+    if (!job.summaries) { perror("scan block malloc failed"); exit(1); }
+
+    // Pass 1: summarise every block (the last one isn't needed as a carry)
+    runtime_parallel_for(block_count - 1, reduce_task, &job);
+
+    // Exclusive scan of the block summaries gives every block its carry-in
+    double carry = identity;
+    for (size_t b = 0; b < block_count; ++b) {
+        double summary = job.summaries[b];
+        job.summaries[b] = carry;
+        if (b + 1 < block_count) {
+            carry = (op == RUNTIME_SCAN_SUM) ? carry + summary : carry * summary;
+        }
+    }
+
+    // Pass 2: scan every block from its carry-in
+    runtime_parallel_for(block_count, scan_task, &job);
+    free(job.summaries);
+}
+
+//------------------------------------------------------------------------------
+// cumsum / cumprod Block Kernels
+//------------------------------------------------------------------------------
+
+// Four independent accumulators so the adds pipeline (and vectorise)
+static double sum_block(size_t begin, size_t end, void *ctx) {
+    const double *in = ((ScanArrays *)ctx)->in;
+    double s0 = 0.0, s1 = 0.0, s2 = 0.0, s3 = 0.0;
+    size_t i = begin;
+    for (; i + 4 <= end; i += 4) {
+        s0 += in[i];
+        s1 += in[i + 1];
+        s2 += in[i + 2];
+        s3 += in[i + 3];
+    }
+    for (; i < end; ++i) s0 += in[i];
+    return (s0 + s1) + (s2 + s3);
+}
+
+static double product_block(size_t begin, size_t end, void *ctx) {
+    const double *in = ((ScanArrays *)ctx)->in;
+    double p0 = 1.0, p1 = 1.0, p2 = 1.0, p3 = 1.0;
+    size_t i = begin;
+    for (; i + 4 <= end; i += 4) {
+        p0 *= in[i];
+        p1 *= in[i + 1];
+        p2 *= in[i + 2];
+        p3 *= in[i + 3];
+    }
+    for (; i < end; ++i) p0 *= in[i];
+    return (p0 * p1) * (p2 * p3);
+}
+
+// In-register scan of two lanes at a time: [a0, a1] -> [c+a0, c+a0+a1],
+// then the high lane becomes the carry for the next pair
+static void cumsum_block(size_t begin, size_t end, double carry, void *ctx) {
+    const double *in = ((ScanArrays *)ctx)->in;
+    double *out = ((ScanArrays *)ctx)->out;
+    size_t i = begin;
+#ifdef __SSE2__
+    __m128d running = _mm_set1_pd(carry);
+    const __m128d zero = _mm_setzero_pd();
+    for (; i + 2 <= end; i += 2) {
+        __m128d x = _mm_loadu_pd(in + i);
+        x = _mm_add_pd(x, _mm_unpacklo_pd(zero, x));
+        x = _mm_add_pd(x, running);
+        _mm_storeu_pd(out + i, x);
+        running = _mm_unpackhi_pd(x, x);
+    }
+    carry = _mm_cvtsd_f64(running);
+#endif
+    for (; i < end; ++i) {
+        carry += in[i];
+        out[i] = carry;
+    }
+}
+
+static void cumprod_block(size_t begin, size_t end, double carry, void *ctx) {
+    const double *in = ((ScanArrays *)ctx)->in;
+    double *out = ((ScanArrays *)ctx)->out;
+    size_t i = begin;
+#ifdef __SSE2__
+    __m128d running = _mm_set1_pd(carry);
+    const __m128d one = _mm_set1_pd(1.0);
+    for (; i + 2 <= end; i += 2) {
+        __m128d x = _mm_loadu_pd(in + i);
+        x = _mm_mul_pd(x, _mm_unpacklo_pd(one, x));
+        x = _mm_mul_pd(x, running);
+        _mm_storeu_pd(out + i, x);
+        running = _mm_unpackhi_pd(x, x);
+    }
+    carry = _mm_cvtsd_f64(running);
+#endif
+    for (; i < end; ++i) {
+        carry *= in[i];
+        out[i] = carry;
+    }
+}
+
+//------------------------------------------------------------------------------
+// compact Block Kernels
+//------------------------------------------------------------------------------
+static double count_block(size_t begin, size_t end, void *ctx) {
+    const double *mask = ((CompactArrays *)ctx)->mask;
+    size_t count = 0;
+    for (size_t i = begin; i < end; ++i) {
+        count += (mask[i] != 0.0);
+    }
+    return (double)count;
+}
+
+static void compact_block(size_t begin, size_t end, double carry, void *ctx) {
+    CompactArrays *arrays = (CompactArrays *)ctx;
+    size_t position = (size_t)carry;
+    for (size_t i = begin; i < end; ++i) {
+        if (arrays->mask[i] != 0.0) arrays->out[position++] = arrays->data[i];
+    }
+    if (end == arrays->size) arrays->kept = position;
+}
+
+//------------------------------------------------------------------------------
+// Public Runtime Functions
+//------------------------------------------------------------------------------
+double *c_cumsum(const double *data, size_t size) {
+    ScanArrays arrays = { data, (double *)runtime_buffer_alloc(size * sizeof(double)) };
+    runtime_blocked_scan(size, RUNTIME_SCAN_SUM, sum_block, cumsum_block, &arrays);
+    return arrays.out;
+}
+
+double *c_cumprod(const double *data, size_t size) {
+    ScanArrays arrays = { data, (double *)runtime_buffer_alloc(size * sizeof(double)) };
+    runtime_blocked_scan(size, RUNTIME_SCAN_PRODUCT, product_block, cumprod_block, &arrays);
+    return arrays.out;
+}
+
+double *c_compact(const double *data, size_t size, const double *mask, size_t mask_size,
+                  size_t *out_size) {
+    if (size != mask_size) {
+        fprintf(stderr, "Runtime Error: Vector size mismatch for compact (%ld != %ld)\n",
+                (long)size, (long)mask_size);
+        exit(1);
+    }
+    // Sized for the worst case, then shrunk to what was kept
+    CompactArrays arrays = { data, mask, (double *)runtime_buffer_alloc(size * sizeof(double)), size, 0 };
+    runtime_blocked_scan(size, RUNTIME_SCAN_SUM, count_block, compact_block, &arrays);
+    *out_size = arrays.kept;
+    if (arrays.kept == size) return arrays.out;
+    return (double *)runtime_buffer_realloc(arrays.out, arrays.kept * sizeof(double));
+}
\ No newline at end of file
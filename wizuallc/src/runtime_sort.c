@@ -0,0 +1,181 @@
+#include "runtime_sort.h"
+#include "runtime_mem.h"
+#include "runtime_parallel.h"
+#include <stdio.h>
+#include <string.h>
+
+#define SORT_RADIX_BITS 8
+#define SORT_BUCKETS (1 << SORT_RADIX_BITS)
+#define SORT_PASSES (64 / SORT_RADIX_BITS)
+#define SORT_MIN_CHUNK 65536   // Elements per chunk at least; smaller inputs use one chunk
+#define SORT_INSERTION_MAX 64  // Inputs up to this size skip the radix passes
+
+#define SIGN_BIT 0x8000000000000000ULL
+
+// One radix sort. Chunks are contiguous ranges of the input; each keeps its
+// own histogram so the scatter can run in parallel and stay stable.
+typedef struct {
+    size_t size;
+    size_t chunk_count;
+    uint64_t *keys;       // Current order
+    uint64_t *keys_out;   // Scatter target, swapped with keys after each pass
+    int64_t *index;       // Carried along for argsort, NULL for sort
+    int64_t *index_out;
+    size_t (*counts)[SORT_BUCKETS]; // Per chunk: bucket counts, then scatter offsets
+    unsigned shift;       // Digit of the current pass
+} RadixSort;
+
+//------------------------------------------------------------------------------
+// Key Mapping
+//------------------------------------------------------------------------------
+
+// Maps a double to an unsigned key with the same order: negative values have
+// all bits flipped, positive values get the sign bit set. NaNs map to the
+// largest key so they sort last.
+static uint64_t key_of(double value) {
+    if (value != value) return UINT64_MAX;
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return (bits & SIGN_BIT) ? ~bits : (bits | SIGN_BIT);
+}
+
+static double value_of(uint64_t key) {
+    uint64_t bits = (key & SIGN_BIT) ? (key & ~SIGN_BIT) : ~key;
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+//------------------------------------------------------------------------------
+// Parallel Radix Passes
+//------------------------------------------------------------------------------
+static size_t chunk_begin(const RadixSort *job, size_t chunk) {
+    return job->size / job->chunk_count * chunk + (chunk < job->size % job->chunk_count ? chunk : job->size % job->chunk_count);
+}
+
+static void histogram_task(size_t chunk, void *ctx) {
+    RadixSort *job = (RadixSort *)ctx;
+    size_t *counts = job->counts[chunk];
+    memset(counts, 0, SORT_BUCKETS * sizeof(size_t));
+    size_t end = chunk_begin(job, chunk + 1);
+    for (size_t i = chunk_begin(job, chunk); i < end; ++i) {
+        counts[(job->keys[i] >> job->shift) & (SORT_BUCKETS - 1)]++;
+    }
+}
+
+static void scatter_task(size_t chunk, void *ctx) {
+    RadixSort *job = (RadixSort *)ctx;
+    size_t *offsets = job->counts[chunk];
+    size_t end = chunk_begin(job, chunk + 1);
+    if (job->index) {
+        for (size_t i = chunk_begin(job, chunk); i < end; ++i) {
+            uint64_t key = job->keys[i];
+            size_t position = offsets[(key >> job->shift) & (SORT_BUCKETS - 1)]++;
+            job->keys_out[position] = key;
+            job->index_out[position] = job->index[i];
+        }
+    } else {
+        for (size_t i = chunk_begin(job, chunk); i < end; ++i) {
+            uint64_t key = job->keys[i];
+            job->keys_out[offsets[(key >> job->shift) & (SORT_BUCKETS - 1)]++] = key;
+        }
+    }
+}
+
+// Turns the per-chunk counts into scatter offsets: bucket-major, then chunk
+// order, which keeps equal digits in input order. Returns 0 when every key
+// has the same digit, so the pass can be skipped.
+static int prefix_offsets(RadixSort *job) {
+    size_t position = 0;
+    for (size_t bucket = 0; bucket < SORT_BUCKETS; ++bucket) {
+        size_t bucket_begin = position;
+        for (size_t chunk = 0; chunk < job->chunk_count; ++chunk) {
+            size_t count = job->counts[chunk][bucket];
+            job->counts[chunk][bucket] = position;
+            position += count;
+        }
+        if (position - bucket_begin == job->size) return 0;
+    }
+    return 1;
+}
+
+static void insertion_sort(RadixSort *job) {
+    for (size_t i = 1; i < job->size; ++i) {
+        uint64_t key = job->keys[i];
+        int64_t index = job->index ? job->index[i] : 0;
+        size_t j = i;
+        for (; j > 0 && job->keys[j - 1] > key; --j) {
+            job->keys[j] = job->keys[j - 1];
+            if (job->index) job->index[j] = job->index[j - 1];
+        }
+        job->keys[j] = key;
+        if (job->index) job->index[j] = index;
+    }
+}
+
+// Sorts job->keys (and job->index alongside). The result ends up in job->keys.
+static void radix_sort(RadixSort *job) {
+    if (job->size <= SORT_INSERTION_MAX) {
+        insertion_sort(job);
+        return;
+    }
+    job->chunk_count = runtime_thread_count();
+    if (job->chunk_count > job->size / SORT_MIN_CHUNK) job->chunk_count = job->size / SORT_MIN_CHUNK;
+    if (job->chunk_count == 0) job->chunk_count = 1;
+
+    job->counts = malloc(job->chunk_count * sizeof(*job->counts));
+    if (!job->counts) { perror("sort histogram malloc failed"); exit(1); }
+
+    for (unsigned pass = 0; pass < SORT_PASSES; ++pass) {
+        job->shift = pass * SORT_RADIX_BITS;
+        runtime_parallel_for(job->chunk_count, histogram_task, job);
+        if (!prefix_offsets(job)) continue; // e.g. the exponent bytes of similar values
+        runtime_parallel_for(job->chunk_count, scatter_task, job);
+
+        uint64_t *keys = job->keys;
+        job->keys = job->keys_out;
+        job->keys_out = keys;
+        int64_t *index = job->index;
+        job->index = job->index_out;
+        job->index_out = index;
+    }
+    free(job->counts);
+}
+
+//------------------------------------------------------------------------------
+// Public Runtime Functions
+//------------------------------------------------------------------------------
+double *c_sort(const double *data, size_t size) {
+    if (size == 0) return NULL;
+    uint64_t *keys = malloc(2 * size * sizeof(uint64_t));
+    if (!keys) { perror("sort key malloc failed"); exit(1); }
+    for (size_t i = 0; i < size; ++i) keys[i] = key_of(data[i]);
+
+    RadixSort job = { size, 1, keys, keys + size, NULL, NULL, NULL, 0 };
+    radix_sort(&job);
+
+    double *sorted = (double *)runtime_buffer_alloc(size * sizeof(double));
+    for (size_t i = 0; i < size; ++i) sorted[i] = value_of(job.keys[i]);
+    free(keys);
+    return sorted;
+}
+
+int64_t *c_argsort(const double *data, size_t size) {
+    if (size == 0) return NULL;
+    uint64_t *keys = malloc(2 * size * sizeof(uint64_t));
+    int64_t *index = malloc(2 * size * sizeof(int64_t));
+    if (!keys || !index) { perror("argsort malloc failed"); exit(1); }
+    for (size_t i = 0; i < size; ++i) {
+        keys[i] = key_of(data[i]);
+        index[i] = (int64_t)i;
+    }
+
+    RadixSort job = { size, 1, keys, keys + size, index, index + size, NULL, 0 };
+    radix_sort(&job);
+
+    int64_t *order = (int64_t *)runtime_buffer_alloc(size * sizeof(int64_t));
+    memcpy(order, job.index, size * sizeof(int64_t));
+    free(keys);
+    free(index);
+    return order;
+}
\ No newline at end of file
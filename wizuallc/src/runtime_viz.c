@@ -1,7 +1,244 @@
+#define _POSIX_C_SOURCE 200809L // For pthreads and fdopen under -std=c11
 #include "runtime_viz.h"
+#include "runtime_mem.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#ifndef _WIN32
+#include <signal.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#endif
 
+// A queued plot request. The data pointers are retained runtime buffers, so the
+// job holds an immutable snapshot even if the program reassigns its vectors.
+typedef struct PlotJob {
+    double *x_data;
+    double *y_data;
+    size_t size;
+    struct PlotJob *next;
+} PlotJob;
+
+// The long-lived gnuplot child. Commands and binary data go down 'to_gnuplot';
+// 'from_gnuplot' carries the acknowledgements used to know a render finished.
+typedef struct {
+    FILE *to_gnuplot;
+    FILE *from_gnuplot; // NULL on Windows (_popen is one-directional)
+#ifndef _WIN32
+    pid_t pid;
+#endif
+    int failed;         // Set once gnuplot could not be started; plots are dropped
+} GnuplotSession;
+
+#define PLOT_BATCH_MAX 16           // Most plots combined into one multiplot render
+#define PLOT_STREAM_CHUNK 4096      // (x, y) pairs interleaved per fwrite
+#define PLOT_ACK "__wizuall_plot_done__"
+
+// Render queue shared between the program thread and the render worker
+static pthread_mutex_t queue_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queue_cond = PTHREAD_COND_INITIALIZER;
+static PlotJob *queue_head = NULL;
+static PlotJob *queue_tail = NULL;
+static pthread_t worker_thread;
+static int worker_running = 0; // Worker thread has been started
+static int worker_stop = 0;    // Set by c_plot_flush: drain the queue, then exit
+
+// Only touched by the worker thread
+static GnuplotSession session = { 0 };
+
+//------------------------------------------------------------------------------
+// Gnuplot Session (runs on the worker thread)
+//------------------------------------------------------------------------------
+
+// Waits for the acknowledgement line printed after a batch of commands.
+// Returns 0 on success, -1 if gnuplot went away.
+static int session_wait_ack() {
+    if (!session.from_gnuplot) return 0;
+    char line[256];
+    while (fgets(line, sizeof(line), session.from_gnuplot)) {
+        if (strncmp(line, PLOT_ACK, strlen(PLOT_ACK)) == 0) return 0;
+    }
+    return -1;
+}
+
+static void session_send_ack_request() {
+    fprintf(session.to_gnuplot, "print \"%s\"\n", PLOT_ACK);
+    fflush(session.to_gnuplot);
+}
+
+static void session_close() {
+    if (session.to_gnuplot) {
+        fprintf(session.to_gnuplot, "exit\n");
+#ifdef _WIN32
+        _pclose(session.to_gnuplot);
+#else
+        fclose(session.to_gnuplot);
+        if (session.from_gnuplot) fclose(session.from_gnuplot);
+        waitpid(session.pid, NULL, 0);
+#endif
+    }
+    session.to_gnuplot = NULL;
+    session.from_gnuplot = NULL;
+}
+
+// Starts gnuplot once, loads plot.gp for the terminal/label settings and
+// checks that it answers. Returns 0 when the session is usable.
+static int session_open() {
+    if (session.to_gnuplot) return 0;
+    if (session.failed) return -1;
+
+#ifdef _WIN32
+    session.to_gnuplot = _popen("gnuplot -persist", "wb");
+    session.from_gnuplot = NULL;
+    if (!session.to_gnuplot) {
+        perror("Failed to start gnuplot");
+        session.failed = 1;
+        return -1;
+    }
+#else
+    int to_child[2], from_child[2];
+    if (pipe(to_child) != 0) {
+        perror("Failed to create gnuplot pipes");
+        session.failed = 1;
+        return -1;
+    }
+    if (pipe(from_child) != 0) {
+        perror("Failed to create gnuplot pipes");
+        close(to_child[0]); close(to_child[1]);
+        session.failed = 1;
+        return -1;
+    }
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("Failed to fork gnuplot");
+        close(to_child[0]); close(to_child[1]);
+        close(from_child[0]); close(from_child[1]);
+        session.failed = 1;
+        return -1;
+    }
+    if (pid == 0) {
+        // Child: wire the pipes to stdin/stdout and become gnuplot
+        dup2(to_child[0], STDIN_FILENO);
+        dup2(from_child[1], STDOUT_FILENO);
+        close(to_child[0]); close(to_child[1]);
+        close(from_child[0]); close(from_child[1]);
+        execlp("gnuplot", "gnuplot", "-persist", (char *)NULL);
+        _exit(127);
+    }
+    close(to_child[0]);
+    close(from_child[1]);
+    session.pid = pid;
+    session.to_gnuplot = fdopen(to_child[1], "w");
+    session.from_gnuplot = fdopen(from_child[0], "r");
+#endif
+
+    printf("Starting persistent gnuplot session (settings from plot.gp)\n");
+    fprintf(session.to_gnuplot, "set print \"-\"\n"); // Acknowledgements on stdout
+    fprintf(session.to_gnuplot, "load \"plot.gp\"\n");
+    session_send_ack_request();
+    if (session_wait_ack() != 0) {
+        fprintf(stderr, "Warning: gnuplot did not respond. Is gnuplot installed and in PATH? Plots will be skipped.\n");
+        session_close();
+        session.failed = 1;
+        return -1;
+    }
+    return 0;
+}
+
+// Streams one plot as inline binary data: x and y are interleaved into
+// (x, y) records so gnuplot reads them straight from the pipe.
+static void session_stream_plot(const PlotJob *job) {
+    fprintf(session.to_gnuplot,
+            "plot '-' binary record=(%lu) format=\"%%float64%%float64\" using 1:2 with points pointtype 7 title 'Data Points'\n",
+            (unsigned long)job->size);
+
+    double chunk[2 * PLOT_STREAM_CHUNK];
+    for (size_t start = 0; start < job->size; start += PLOT_STREAM_CHUNK) {
+        size_t count = job->size - start;
+        if (count > PLOT_STREAM_CHUNK) count = PLOT_STREAM_CHUNK;
+        for (size_t i = 0; i < count; ++i) {
+            chunk[2 * i] = job->x_data[start + i];
+            chunk[2 * i + 1] = job->y_data[start + i];
+        }
+        fwrite(chunk, sizeof(double), 2 * count, session.to_gnuplot);
+    }
+}
+
+// Renders a batch of jobs in one go. Several pending plots are combined into
+// a single multiplot so the terminal is only redrawn once.
+static void render_batch(PlotJob **jobs, size_t count) {
+    if (session_open() != 0) return;
+
+    if (count > 1) {
+        size_t cols = 1;
+        while (cols * cols < count) ++cols;
+        size_t rows = (count + cols - 1) / cols;
+        printf("Rendering %lu plots as one multiplot\n", (unsigned long)count);
+        fprintf(session.to_gnuplot, "set multiplot layout %lu,%lu\n",
+                (unsigned long)rows, (unsigned long)cols);
+    }
+    for (size_t i = 0; i < count; ++i) {
+        session_stream_plot(jobs[i]);
+    }
+    if (count > 1) {
+        fprintf(session.to_gnuplot, "unset multiplot\n");
+    }
+    session_send_ack_request();
+    if (session_wait_ack() != 0) {
+        fprintf(stderr, "Warning: gnuplot session ended unexpectedly. Further plots will be skipped.\n");
+        session_close();
+        session.failed = 1;
+    }
+}
+
+static void free_plot_job(PlotJob *job) {
+    runtime_buffer_release(job->x_data);
+    runtime_buffer_release(job->y_data);
+    free(job);
+}
+
+static void *render_worker(void *arg) {
+    (void)arg;
+#ifndef _WIN32
+    // A dead gnuplot must surface as a write error, not kill the program
+    sigset_t sigpipe_set;
+    sigemptyset(&sigpipe_set);
+    sigaddset(&sigpipe_set, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &sigpipe_set, NULL);
+#endif
+
+    PlotJob *batch[PLOT_BATCH_MAX];
+    for (;;) {
+        pthread_mutex_lock(&queue_lock);
+        while (!queue_head && !worker_stop) {
+            pthread_cond_wait(&queue_cond, &queue_lock);
+        }
+        // Take everything that is pending (up to the batch limit)
+        size_t count = 0;
+        while (queue_head && count < PLOT_BATCH_MAX) {
+            batch[count++] = queue_head;
+            queue_head = queue_head->next;
+        }
+        if (!queue_head) queue_tail = NULL;
+        pthread_mutex_unlock(&queue_lock);
+
+        if (count == 0) break; // Stop requested and queue drained
+
+        render_batch(batch, count);
+        for (size_t i = 0; i < count; ++i) {
+            free_plot_job(batch[i]);
+        }
+    }
+
+    session_close();
+    return NULL;
+}
+
+//------------------------------------------------------------------------------
+// Public Runtime Functions
+//------------------------------------------------------------------------------
 void c_scatter_plot(double *x_data, size_t x_size, double *y_data, size_t y_size) {
     printf("Executing scatter_plot runtime function...\n");
 
@@ -11,7 +248,7 @@ void c_scatter_plot(double *x_data, size_t x_size, double *y_data, size_t y_size
     }
 
     if (x_size != y_size) {
-        fprintf(stderr, "Error: scatter_plot requires vectors of the same size (%ld != %ld).\n", x_size, y_size);
+        fprintf(stderr, "Error: scatter_plot requires vectors of the same size (%ld != %ld).\n", (long)x_size, (long)y_size);
         return;
     }
 
@@ -20,28 +257,68 @@ void c_scatter_plot(double *x_data, size_t x_size, double *y_data, size_t y_size
         return;
     }
 
-    // --- Write data to file ---
-    const char* data_filename = "plot_data.txt";
-    FILE *fp = fopen(data_filename, "w");
-    if (!fp) {
-        perror("Error opening plot data file");
+    PlotJob *job = (PlotJob *)malloc(sizeof(PlotJob));
+    if (!job) {
+        perror("scatter_plot job malloc failed");
         return;
     }
+    job->x_data = runtime_buffer_retain(x_data);
+    job->y_data = runtime_buffer_retain(y_data);
+    job->size = x_size;
+    job->next = NULL;
 
-    fprintf(fp, "# X Y\n"); // Header
-    for (size_t i = 0; i < x_size; ++i) {
-        fprintf(fp, "%f %f\n", x_data[i], y_data[i]);
+    pthread_mutex_lock(&queue_lock);
+    if (!worker_running) {
+        if (pthread_create(&worker_thread, NULL, render_worker, NULL) != 0) {
+            pthread_mutex_unlock(&queue_lock);
+            // No worker available: fall back to rendering synchronously
+            fprintf(stderr, "Warning: could not start plot render thread, rendering synchronously.\n");
+#ifndef _WIN32
+            // As in render_worker, a dead gnuplot must not kill the program.
+            // No render thread exists here, so ignoring SIGPIPE for the
+            // process while this batch renders affects nothing else.
+            struct sigaction ignore_sigpipe, previous_sigpipe;
+            memset(&ignore_sigpipe, 0, sizeof(ignore_sigpipe));
+            ignore_sigpipe.sa_handler = SIG_IGN;
+            sigemptyset(&ignore_sigpipe.sa_mask);
+            sigaction(SIGPIPE, &ignore_sigpipe, &previous_sigpipe);
+            render_batch(&job, 1);
+            sigaction(SIGPIPE, &previous_sigpipe, NULL);
+#else
+            render_batch(&job, 1);
+#endif
+            free_plot_job(job);
+            return;
+        }
+        worker_running = 1;
     }
-    fclose(fp);
-    printf("Data written to %s\n", data_filename);
+    if (queue_tail) {
+        queue_tail->next = job;
+    } else {
+        queue_head = job;
+    }
+    queue_tail = job;
+    pthread_cond_signal(&queue_cond);
+    pthread_mutex_unlock(&queue_lock);
+
+    printf("scatter_plot queued for rendering.\n");
+}
 
-    // --- Call Gnuplot --- 
-    // Assumes gnuplot is in the system's PATH and plot.gp exists
-    const char* gnuplot_command = "gnuplot plot.gp"; 
-    printf("Calling Gnuplot: %s\n", gnuplot_command);
-    int ret = system(gnuplot_command);
-    if (ret != 0) {
-        fprintf(stderr, "Warning: system() call to gnuplot returned %d. Is gnuplot installed and in PATH? Does plot.gp exist?\n", ret);
+void c_plot_flush(void) {
+    pthread_mutex_lock(&queue_lock);
+    if (!worker_running) {
+        pthread_mutex_unlock(&queue_lock);
+        session_close(); // Synchronous fallback may have opened a session
+        return;
     }
-    printf("scatter_plot runtime function finished.\n");
-} 
\ No newline at end of file
+    worker_stop = 1;
+    pthread_cond_signal(&queue_cond);
+    pthread_mutex_unlock(&queue_lock);
+
+    pthread_join(worker_thread, NULL);
+
+    pthread_mutex_lock(&queue_lock);
+    worker_running = 0;
+    worker_stop = 0;
+    pthread_mutex_unlock(&queue_lock);
+}
\ No newline at end of file
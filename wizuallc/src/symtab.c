@@ -3,9 +3,75 @@
 #include <stdlib.h>
 #include <string.h>
 
+#define MAX_SCOPE_DEPTH 16
+
 // Head of the global symbol list
 static Symbol *symbol_list_head = NULL;
 
+// Symbol lists of the open function scopes; the innermost one is searched
+static Symbol *scope_heads[MAX_SCOPE_DEPTH];
+static int scope_depth = 0;
+
+// List that lookups and inserts currently work on
+static Symbol **current_scope() {
+    return scope_depth > 0 ? &scope_heads[scope_depth - 1] : &symbol_list_head;
+}
+
+//------------------------------------------------------------------------------
+// Scope Index
+// The lexer looks up every identifier it reads, so each open scope has an
+// open-addressing hash table over its list (index 0 is the global scope).
+//------------------------------------------------------------------------------
+typedef struct {
+    Symbol **slots;
+    size_t capacity; // Power of two (0: not allocated yet)
+    size_t count;
+} ScopeIndex;
+
+static ScopeIndex scope_indexes[MAX_SCOPE_DEPTH + 1];
+
+static ScopeIndex *current_index() {
+    return &scope_indexes[scope_depth];
+}
+
+// FNV-1a
+static size_t hash_name(const char *name) {
+    size_t hash = (size_t)14695981039346656037ULL;
+    for (; *name; ++name) hash = (hash ^ (unsigned char)*name) * (size_t)1099511628211ULL;
+    return hash;
+}
+
+static void index_add(ScopeIndex *index, Symbol *sym);
+
+static void index_grow(ScopeIndex *index) {
+    ScopeIndex grown = { NULL, index->capacity ? index->capacity * 2 : 64, 0 };
+    grown.slots = (Symbol **)calloc(grown.capacity, sizeof(Symbol *));
+    if (!grown.slots) {
+        perror("Failed to allocate symbol index");
+        exit(EXIT_FAILURE);
+    }
+    for (size_t i = 0; i < index->capacity; ++i) {
+        if (index->slots[i]) index_add(&grown, index->slots[i]);
+    }
+    free(index->slots);
+    *index = grown;
+}
+
+static void index_add(ScopeIndex *index, Symbol *sym) {
+    if (2 * (index->count + 1) > index->capacity) index_grow(index); // At most half full
+    size_t slot = hash_name(sym->name) & (index->capacity - 1);
+    while (index->slots[slot]) slot = (slot + 1) & (index->capacity - 1);
+    index->slots[slot] = sym;
+    index->count++;
+}
+
+static void index_clear(ScopeIndex *index) {
+    free(index->slots);
+    index->slots = NULL;
+    index->capacity = 0;
+    index->count = 0;
+}
+
 //------------------------------------------------------------------------------
 // Helper Function to free symbol data (vector)
 //------------------------------------------------------------------------------
@@ -24,12 +90,13 @@ static void free_symbol_value_data(Symbol *sym) {
 
 Symbol *symbol_lookup(const char *name) {
     if (!name) return NULL;
-    Symbol *current = symbol_list_head;
-    while (current != NULL) {
+    ScopeIndex *index = current_index();
+    if (index->capacity == 0) return NULL; // Empty scope
+    size_t slot = hash_name(name) & (index->capacity - 1);
+    for (Symbol *current; (current = index->slots[slot]) != NULL; slot = (slot + 1) & (index->capacity - 1)) {
         if (strcmp(current->name, name) == 0) {
             return current;
         }
-        current = current->next;
     }
     return NULL; // Not found
 }
@@ -61,16 +128,56 @@ Symbol *symbol_insert(const char *name) {
 
     // Initialize to default: scalar 0.0
     sym->type = SYMBOL_TYPE_SCALAR;
+    sym->dtype = DTYPE_F64;
+    sym->type_known = 0;
+    sym->rows = 0;
+    sym->cols = 0;
+    sym->base = NULL;
+    sym->entry_unread = 0;
+    sym->storage = NULL;
+    sym->is_integer = 0;
     sym->value.scalar_value = 0.0;
     sym->next = NULL; // Initialize next pointer
 
-    // Insert at the head of the list (simple approach)
-    sym->next = symbol_list_head;
-    symbol_list_head = sym;
+    // Insert at the head of the current scope's list (simple approach)
+    Symbol **head = current_scope();
+    sym->next = *head;
+    *head = sym;
+    index_add(current_index(), sym);
 
     return sym;
 }
 
+void symbol_push_scope() {
+    if (scope_depth == MAX_SCOPE_DEPTH) {
+        fprintf(stderr, "Error: Scopes nested more than %d deep.\n", MAX_SCOPE_DEPTH);
+        exit(EXIT_FAILURE);
+    }
+    scope_heads[scope_depth++] = NULL;
+}
+
+void symbol_reopen_scope(Symbol *symbols) {
+    symbol_push_scope();
+    scope_heads[scope_depth - 1] = symbols;
+    for (Symbol *sym = symbols; sym != NULL; sym = sym->next) index_add(current_index(), sym);
+}
+
+Symbol *symbol_pop_scope() {
+    if (scope_depth == 0) return NULL;
+    index_clear(current_index());
+    return scope_heads[--scope_depth];
+}
+
+void symbol_list_free(Symbol *list) {
+    while (list != NULL) {
+        Symbol *next_sym = list->next;
+        free(list->name);
+        free_symbol_value_data(list);
+        free(list);
+        list = next_sym;
+    }
+}
+
 void symbol_set_scalar(Symbol *sym, double val) {
     if (!sym) return;
     
@@ -135,16 +242,14 @@ void symbol_print_table() {
 }
 
 void symbol_table_destroy() {
-    Symbol *current = symbol_list_head;
-    Symbol *next_sym;
-    while (current != NULL) {
-        next_sym = current->next;
-        
-        free(current->name); // Free the duplicated name
-        free_symbol_value_data(current); // Free vector data if any
-        free(current); // Free the symbol struct itself
-        
-        current = next_sym;
+    while (scope_depth > 0) { // Scopes left open by a syntax error
+        symbol_list_free(symbol_pop_scope());
     }
+    symbol_list_free(symbol_list_head);
     symbol_list_head = NULL; // Reset the head pointer
+    index_clear(current_index());
+}
+
+Symbol* symbol_get_list_head() {
+    return symbol_list_head;
 } 
\ No newline at end of file